@@ -10,9 +10,11 @@
 
 #pragma once
 
+#include <atomic>
 #include <list>
 #include <map>
 #include <memory>
+#include <set>
 #include <vector>
 
 #include <boost/iterator/filter_iterator.hpp>
@@ -30,7 +32,7 @@ class Pack;
 class Schedule;
 class ConfigParserPlugin;
 
-/// The name of the executing query within the single-threaded schedule.
+/// The names of the executing scheduled queries, separated by newlines.
 extern const std::string kExecutingQuery;
 
 /**
@@ -74,16 +76,14 @@ class Config : private boost::noncopyable {
    * to the updates/changes reflected in the schedule, from the config.
    *
    * @param name The unique name of the scheduled item
-   * @param delay Number of seconds (wall time) taken by the query
+   * @param usage The time, CPU, memory, and table rows used by the execution
    * @param size Number of characters generated by query
-   * @param r0 the process row before the query
-   * @param r1 the process row after the query
+   * @param cached true if the query reused a cached prepared statement
    */
   void recordQueryPerformance(const std::string& name,
-                              size_t delay,
+                              const QueryResourceUsage& usage,
                               size_t size,
-                              const Row& r0,
-                              const Row& r1);
+                              bool cached = false);
 
   /**
    * @brief Record a query 'initialization', meaning the query will run.
@@ -98,6 +98,24 @@ class Config : private boost::noncopyable {
    */
   void recordQueryStart(const std::string& name);
 
+  /**
+   * @brief Record how late a scheduled query began executing.
+   *
+   * @param name The unique name of the scheduled item
+   * @param lag Milliseconds between when the query was due and its start
+   */
+  void recordQueryLag(const std::string& name, size_t lag);
+
+  /**
+   * @brief The name of the scheduled query executing on the calling thread.
+   *
+   * Scheduled queries may execute concurrently on worker threads. Tables
+   * that keep per-query state, such as event subscribers, use this name.
+   *
+   * @return The query name, empty if the thread is not running a query.
+   */
+  static const std::string& getExecutingQuery();
+
   /**
    * @brief Calculate the hash of the osquery config
    *
@@ -173,6 +191,35 @@ class Config : private boost::noncopyable {
       std::function<void(const std::string& name, const ScheduledQuery& query)>
           predicate);
 
+  /**
+   * @brief Map a function across every query of every pack.
+   *
+   * Unlike scheduledQueries this does not evaluate pack discovery queries or
+   * the blacklist. The scheduler keeps its own deadlines for each query and
+   * uses isScheduled when one is due.
+   *
+   * @param predicate is called with the owning pack, the unique query name,
+   * and the query for every query in the schedule.
+   */
+  void allScheduledQueries(
+      std::function<void(const std::shared_ptr<Pack>& pack,
+                         const std::string& name,
+                         const ScheduledQuery& query)> predicate);
+
+  /**
+   * @brief Check if a pack's query should execute now.
+   *
+   * @param pack The pack provided by allScheduledQueries.
+   * @param name The unique query name.
+   * @return false if the pack is not active or the query is blacklisted.
+   */
+  bool isScheduled(const std::shared_ptr<Pack>& pack, const std::string& name);
+
+  /// A counter incremented each time packs are added or removed.
+  size_t getScheduleGeneration() const {
+    return schedule_generation_;
+  }
+
   /**
    * @brief Map a function across the set of configured files
    *
@@ -300,13 +347,27 @@ class Config : private boost::noncopyable {
    */
   void reset();
 
+ protected:
+  /**
+   * @brief Check and expire a query's entry in the schedule blacklist.
+   *
+   * The caller must hold the schedule lock.
+   */
+  bool isBlacklisted(const std::string& name);
+
  protected:
   /// Schedule of packs and their queries.
   std::shared_ptr<Schedule> schedule_;
 
+  /// Incremented whenever the packs within the schedule change.
+  std::atomic<size_t> schedule_generation_{0};
+
   /// A set of performance stats for each query in the schedule.
   std::map<std::string, QueryPerformance> performance_;
 
+  /// Names of the scheduled queries currently executing.
+  std::set<std::string> executing_;
+
   /// A set of named categories filled with filesystem globbing paths.
   using FileCategories = std::map<std::string, std::vector<std::string>>;
   std::map<std::string, FileCategories> files_;
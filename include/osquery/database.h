@@ -13,9 +13,11 @@
 #include <atomic>
 #include <map>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <boost/property_tree/ptree.hpp>
+#include <boost/utility/string_ref.hpp>
 
 #include <osquery/registry.h>
 #include <osquery/status.h>
@@ -168,6 +170,266 @@ Status deserializeQueryData(const boost::property_tree::ptree& tree,
 /// Inverse of serializeQueryDataJSON, convert a JSON string to QueryData.
 Status deserializeQueryDataJSON(const std::string& json, QueryData& qd);
 
+/**
+ * @brief Serialize a Row object into the compact binary results encoding.
+ *
+ * The binary encoding is used for stored results: a scheduled query's
+ * previous results, table caches, and event rows. The first two bytes are a
+ * magic NUL (never valid JSON) and an encoding version. Column names follow
+ * once, then each row as length-prefixed values.
+ *
+ * @param r the Row to serialize
+ * @param bin the output binary string
+ *
+ * @return Status indicating the success or failure of the operation
+ */
+Status serializeRowBinary(const Row& r, std::string& bin);
+
+/**
+ * @brief Deserialize a Row object from the binary results encoding.
+ *
+ * Content that is not binary-encoded is parsed as legacy JSON, this allows
+ * results written by previous versions to be migrated when next written.
+ *
+ * @param bin the input binary (or JSON) string
+ * @param r the output Row structure
+ *
+ * @return Status indicating the success or failure of the operation
+ */
+Status deserializeRowBinary(const std::string& bin, Row& r);
+
+/**
+ * @brief Serialize a QueryData object into the binary results encoding.
+ *
+ * Column names are written once for the result set, rows that do not include
+ * a column store an 'absent' marker instead of an empty value.
+ *
+ * @param q the QueryData to serialize
+ * @param bin the output binary string
+ *
+ * @return Status indicating the success or failure of the operation
+ */
+Status serializeQueryDataBinary(const QueryData& q, std::string& bin);
+
+/**
+ * @brief Serialize a QueryData object into the indexed binary encoding.
+ *
+ * The indexed encoding adds a table of row fingerprints, sorted, each with
+ * the offset of its row. A scheduled query's previous results are stored
+ * indexed so the next differential is a linear merge of fingerprints, see
+ * diffStoredResults. Rows keep their original order.
+ *
+ * @param q the QueryData to serialize
+ * @param bin the output binary string
+ *
+ * @return Status indicating the success or failure of the operation
+ */
+Status serializeQueryDataIndexed(const QueryData& q, std::string& bin);
+
+/// Inverse of serializeQueryDataBinary, also accepts legacy JSON content.
+Status deserializeQueryDataBinary(const std::string& bin, QueryData& qd);
+
+/// A stable 64-bit fingerprint of a string, such as a query.
+uint64_t getFingerprint(const std::string& content);
+
+/// A stable 64-bit fingerprint of a row's column names and values.
+uint64_t getRowFingerprint(const Row& r);
+
+/// A stable 64-bit fingerprint of a result set, independent of row order.
+uint64_t getQueryDataFingerprint(const QueryData& q);
+
+/// Check if stored results content uses the binary encoding.
+bool isBinaryEncoded(const std::string& content);
+
+/**
+ * @brief A zero-copy view of binary-encoded results.
+ *
+ * The view references the input content, which must outlive the view. Column
+ * names and values are exposed as string references into that content. This
+ * is useful when a caller only inspects a few columns, or compares rows,
+ * and does not need to materialize a QueryData.
+ */
+class QueryDataView {
+ public:
+  /// Index the binary content, this does not accept legacy JSON.
+  Status load(const std::string& bin);
+
+  /// The number of rows in the result set.
+  size_t rows() const {
+    return rows_;
+  }
+
+  /// The column names, once per result set, in sorted order.
+  const std::vector<boost::string_ref>& columns() const {
+    return columns_;
+  }
+
+  /// Check if the row includes the column at index col.
+  bool has(size_t row, size_t col) const {
+    return present_[row * columns_.size() + col];
+  }
+
+  /// The value of a row's column, empty if the column is not present.
+  boost::string_ref get(size_t row, size_t col) const {
+    return values_[row * columns_.size() + col];
+  }
+
+  /// Copy a single row into a Row structure.
+  Row getRow(size_t row) const;
+
+ private:
+  /// Column names referencing the input content.
+  std::vector<boost::string_ref> columns_;
+
+  /// Row-major values for each row and column.
+  std::vector<boost::string_ref> values_;
+
+  /// Row-major presence for each row and column.
+  std::vector<bool> present_;
+
+  /// The number of rows in the result set.
+  size_t rows_{0};
+};
+
+/// The native type of a CompactQueryData cell.
+enum class CellType : unsigned char {
+  /// The row does not include the column.
+  NONE = 0,
+
+  /// A string value, also used for blobs.
+  TEXT,
+
+  /// A 64-bit signed integer.
+  INTEGER,
+
+  /// A double precision floating point number.
+  DOUBLE,
+};
+
+/**
+ * @brief Result rows that share a single set of column names.
+ *
+ * Every Row carries its own copy of each column name and a tree node for each
+ * cell. CompactQueryData stores the column names once and the cells in
+ * row-major vectors indexed by column position, values short enough for the
+ * small-string buffer do not allocate. Row and QueryData remain the format
+ * used by the SDK and extensions, use addRow and getRow to convert.
+ *
+ * Cells may hold a native integer or double, these are formatted as text only
+ * when read with get, so numeric values reach SQLite without a string round
+ * trip.
+ */
+class CompactQueryData {
+ public:
+  CompactQueryData() = default;
+
+  /// Create an empty result set with a known schema, such as a table's.
+  explicit CompactQueryData(const std::vector<std::string>& columns);
+
+  /// The number of rows in the result set.
+  size_t rows() const {
+    return rows_;
+  }
+
+  /// The column names, in the order they were added.
+  const std::vector<std::string>& columns() const {
+    return columns_;
+  }
+
+  /// The position of a column, or columns().size() if it does not exist.
+  size_t getColumnIndex(const std::string& name) const;
+
+  /// Add a column if it does not exist, return its position.
+  size_t addColumn(const std::string& name);
+
+  /// Column positions ordered by name, the iteration order of a Row.
+  const std::vector<size_t>& sortedColumns() const {
+    return sorted_;
+  }
+
+  /// The native type of a row's column.
+  CellType type(size_t row, size_t col) const {
+    return (col < columns_.size()) ? types_[row * columns_.size() + col]
+                                   : CellType::NONE;
+  }
+
+  /// Check if the row includes the column at index col.
+  bool has(size_t row, size_t col) const {
+    return type(row, col) != CellType::NONE;
+  }
+
+  /// The value of a row's column as text, empty if the column is not present.
+  const std::string& get(size_t row, size_t col) const;
+
+  /// The value of an INTEGER cell.
+  long long getInteger(size_t row, size_t col) const {
+    return numbers_[row * columns_.size() + col].integer;
+  }
+
+  /// The value of a DOUBLE cell.
+  double getDouble(size_t row, size_t col) const {
+    return numbers_[row * columns_.size() + col].real;
+  }
+
+  /// Append a row without any columns, return its position.
+  size_t addRow();
+
+  /// Append a row, its values are moved and new columns are added.
+  void addRow(Row&& r);
+
+  /// Append a copy of a row.
+  void addRow(const Row& r);
+
+  /// Set a text cell.
+  void setText(size_t row, size_t col, std::string value);
+
+  /// Set a native integer cell.
+  void setInteger(size_t row, size_t col, long long value);
+
+  /// Set a native double cell.
+  void setDouble(size_t row, size_t col, double value);
+
+  /// Copy a single row into a Row structure.
+  Row getRow(size_t row) const;
+
+  /// Copy every row into a QueryData.
+  QueryData getQueryData() const;
+
+  /// Remove all rows but keep the columns.
+  void clear();
+
+  /// Reserve storage for a number of rows.
+  void reserve(size_t rows);
+
+ private:
+  /// Storage for the native value of a numeric cell.
+  union CellNumber {
+    long long integer;
+    double real;
+  };
+
+  /// Column names, the schema shared by every row.
+  std::vector<std::string> columns_;
+
+  /// Column name to position lookup.
+  std::unordered_map<std::string, size_t> index_;
+
+  /// Column positions ordered by name, the iteration order of a Row.
+  std::vector<size_t> sorted_;
+
+  /// Row-major text values, numeric cells are formatted on first read.
+  mutable std::vector<std::string> values_;
+
+  /// Row-major native values for numeric cells.
+  std::vector<CellNumber> numbers_;
+
+  /// Row-major cell types, NONE if the row does not include the column.
+  std::vector<CellType> types_;
+
+  /// The number of rows in the result set.
+  size_t rows_{0};
+};
+
 /**
  * @brief Data structure representing the difference between the results of
  * two queries
@@ -228,6 +490,29 @@ Status serializeDiffResultsJSON(const DiffResults& d, std::string& json);
  */
 DiffResults diff(const QueryData& old_, const QueryData& new_);
 
+/**
+ * @brief Diff stored previous results with a new set of results.
+ *
+ * When the previous results use the indexed binary encoding the differential
+ * is a linear merge over sorted row fingerprints, and only the removed rows
+ * are decoded. Other encodings are decoded in full and passed to diff.
+ *
+ * Without verification rows with equal fingerprints are considered equal.
+ * With verification the rows are also compared, which is safe against
+ * fingerprint collisions.
+ *
+ * @param previous the stored "old" results
+ * @param current the "new" set of results
+ * @param dr the output differential
+ * @param verify compare the full rows when fingerprints are equal
+ *
+ * @return Status indicating the success or failure of the operation
+ */
+Status diffStoredResults(const std::string& previous,
+                         const QueryData& current,
+                         DiffResults& dr,
+                         bool verify = false);
+
 /**
  * @brief Add a Row to a QueryData if the Row hasn't appeared in the QueryData
  * already
@@ -261,6 +546,36 @@ void escapeQueryData(const QueryData& oldData, QueryData& newData);
 /**
  * @brief performance statistics about a query
  */
+/// Rows and bytes a scheduled query's execution read from one table.
+struct QueryTableUsage {
+  /// Number of times the table was scanned.
+  size_t scans{0};
+
+  /// Number of rows the table generated.
+  unsigned long long int rows{0};
+
+  /// Approximate bytes of the generated cells.
+  unsigned long long int bytes{0};
+};
+
+/// Resources used by a single execution of a scheduled query.
+struct QueryResourceUsage {
+  /// Monotonic wall time in nanoseconds.
+  unsigned long long int wall_time_ns{0};
+
+  /// User CPU time of the executing thread in microseconds.
+  unsigned long long int user_time{0};
+
+  /// System CPU time of the executing thread in microseconds.
+  unsigned long long int system_time{0};
+
+  /// Change in bytes allocated from the process heap.
+  long long int heap_delta{0};
+
+  /// Rows and bytes generated by each table the query scanned.
+  std::map<std::string, QueryTableUsage> tables;
+};
+
 struct QueryPerformance {
   /// Number of executions.
   size_t executions;
@@ -268,29 +583,48 @@ struct QueryPerformance {
   /// Last UNIX time in seconds the query was executed successfully.
   size_t last_executed;
 
-  /// Total wall time taken
+  /// Total wall time taken in seconds.
   unsigned long long int wall_time;
 
-  /// Total user time (cycles)
+  /// Total monotonic wall time taken in nanoseconds.
+  unsigned long long int wall_time_ns;
+
+  /// Total user CPU time of the executing threads in microseconds.
   unsigned long long int user_time;
 
-  /// Total system time (cycles)
+  /// Total system CPU time of the executing threads in microseconds.
   unsigned long long int system_time;
 
-  /// Average memory differentials. This should be near 0.
+  /// Average heap bytes left allocated after executing. This should be near 0.
   unsigned long long int average_memory;
 
   /// Total characters, bytes, generated by query.
   unsigned long long int output_size;
 
+  /// Number of executions that reused a cached prepared statement.
+  size_t statement_cache_hits;
+
+  /// Total milliseconds between when executions were due and when they began.
+  unsigned long long int lag;
+
+  /// The longest milliseconds an execution began after it was due.
+  unsigned long long int max_lag;
+
+  /// Total rows and bytes generated by each table the query scanned.
+  std::map<std::string, QueryTableUsage> tables;
+
   QueryPerformance()
       : executions(0),
         last_executed(0),
         wall_time(0),
+        wall_time_ns(0),
         user_time(0),
         system_time(0),
         average_memory(0),
-        output_size(0) {}
+        output_size(0),
+        statement_cache_hits(0),
+        lag(0),
+        max_lag(0) {}
 };
 
 /**
@@ -312,6 +646,12 @@ struct ScheduledQuery {
   /// Set of query options.
   std::map<std::string, bool> options;
 
+  /// The name of the pack that scheduled the query.
+  std::string pack;
+
+  /// Maximum queries from the pack run at once by scheduler workers.
+  size_t pack_concurrency{0};
+
   ScheduledQuery() : interval(0), splayed_interval(0) {}
 
   /// equals operator
@@ -417,6 +757,100 @@ Status serializeQueryLogItemAsEvents(const QueryLogItem& item,
 Status serializeQueryLogItemAsEventsJSON(const QueryLogItem& i,
                                          std::vector<std::string>& items);
 
+/**
+ * @brief Stream a QueryLogItem as a JSON log line into a reusable buffer.
+ *
+ * This produces the same content as serializeQueryLogItemJSON without
+ * building a property tree or copying column names and values. The buffer is
+ * cleared, but keeps its capacity, and does not include a trailing newline.
+ *
+ * Column names are written as-is, a name containing a '.' is not expanded
+ * into a nested object.
+ *
+ * @param item the QueryLogItem to write
+ * @param json the output buffer
+ */
+void writeQueryLogItemJSON(const QueryLogItem& item, std::string& json);
+
+/**
+ * @brief Stream a single differential row of a QueryLogItem as a JSON event.
+ *
+ * This is the streaming equivalent of one line from
+ * serializeQueryLogItemAsEventsJSON, also without a trailing newline.
+ *
+ * @param item the QueryLogItem with the legacy fields and decorations
+ * @param action the event action, "added" or "removed"
+ * @param row the row written as the event "columns"
+ * @param json the output buffer
+ */
+void writeQueryLogEventJSON(const QueryLogItem& item,
+                            const std::string& action,
+                            const Row& row,
+                            std::string& json);
+
+/// A list of key/value pairs returned by value-returning database scans.
+using DatabaseKeyValues = std::vector<std::pair<std::string, std::string>>;
+
+/**
+ * @brief A set of writes applied atomically to a single domain.
+ *
+ * Components that update several related keys for one logical operation, such
+ * as an event's data and its time indexes, should collect the writes into a
+ * DatabaseBatch and apply them with writeDatabaseBatch. Either every write is
+ * applied or none are, and the backing store commits (and syncs) once.
+ *
+ * Writes are applied in the order they were added.
+ */
+class DatabaseBatch {
+ public:
+  /// The types of writes supported within a batch.
+  enum class Op {
+    PUT,
+    REMOVE,
+  };
+
+  /// A single write within a batch.
+  struct Write {
+    Op op;
+    std::string key;
+    std::string value;
+  };
+
+ public:
+  /// Store a value using a key, see DatabasePlugin::put.
+  void put(std::string key, std::string value) {
+    writes_.push_back({Op::PUT, std::move(key), std::move(value)});
+  }
+
+  /// Remove a key, see DatabasePlugin::remove.
+  void remove(std::string key) {
+    writes_.push_back({Op::REMOVE, std::move(key), ""});
+  }
+
+  /// The ordered list of writes.
+  const std::vector<Write>& writes() const {
+    return writes_;
+  }
+
+  /// The number of writes in the batch.
+  size_t size() const {
+    return writes_.size();
+  }
+
+  /// True if there are no writes in the batch.
+  bool empty() const {
+    return writes_.empty();
+  }
+
+  /// Remove all writes from the batch.
+  void clear() {
+    writes_.clear();
+  }
+
+ private:
+  std::vector<Write> writes_;
+};
+
 /**
  * @brief An osquery backing storage (database) type that persists executions.
  *
@@ -467,6 +901,19 @@ class DatabasePlugin : public Plugin {
   /// Data removal method.
   virtual Status remove(const std::string& domain, const std::string& k) = 0;
 
+  /**
+   * @brief Collect the keys within a domain that begin with a prefix.
+   *
+   * Plugins should seek directly to the prefix and stop iterating at the first
+   * key that no longer matches, the cost of a scan must not depend on the
+   * number of keys outside of the prefix.
+   *
+   * @param domain A string value representing abstract storage indexing.
+   * @param results The output list of keys, in lexicographic order.
+   * @param prefix An optional key prefix, an empty prefix matches all keys.
+   * @param max The optional maximum number of keys to return (0 = unlimited).
+   * @return Failure if the domain could not be iterated.
+   */
   virtual Status scan(const std::string& domain,
                       std::vector<std::string>& results,
                       const std::string& prefix,
@@ -474,6 +921,71 @@ class DatabasePlugin : public Plugin {
     return Status(0, "Not used");
   }
 
+  /**
+   * @brief Collect the key/value pairs for keys within [start, stop).
+   *
+   * This is the value-returning equivalent of DatabasePlugin::scan. A bounded
+   * range is iterated once and each value is read from the same iterator,
+   * which avoids a scan followed by a DatabasePlugin::get for each key.
+   *
+   * The default implementation uses DatabasePlugin::scan and
+   * DatabasePlugin::get so that plugins without an iterator API still work.
+   *
+   * @param domain A string value representing abstract storage indexing.
+   * @param results The output list of key/value pairs, in key order.
+   * @param start The inclusive lower bound key.
+   * @param stop The exclusive upper bound key, empty if unbounded.
+   * @param max The optional maximum number of pairs to return (0 = unlimited).
+   * @return Failure if the domain could not be iterated.
+   */
+  virtual Status scanRange(const std::string& domain,
+                           DatabaseKeyValues& results,
+                           const std::string& start,
+                           const std::string& stop,
+                           size_t max = 0) const;
+
+  /**
+   * @brief Remove every key within the range [start, stop).
+   *
+   * Plugins should implement this without visiting each key, such that the
+   * cost of removing a range does not depend on the number of keys within it.
+   * The default implementation uses DatabasePlugin::scanRange and applies a
+   * batch of removes.
+   *
+   * @param domain A string value representing abstract storage indexing.
+   * @param start The inclusive lower bound key.
+   * @param stop The exclusive upper bound key, empty if unbounded.
+   * @return Failure if the range could not be removed.
+   */
+  virtual Status removeRange(const std::string& domain,
+                             const std::string& start,
+                             const std::string& stop);
+
+  /**
+   * @brief Apply a batch of writes to a domain atomically.
+   *
+   * Plugins should apply every write in a single transaction or write batch.
+   * The default implementation applies each write using DatabasePlugin::put
+   * and DatabasePlugin::remove, which is not atomic, so that plugins without
+   * transactions still work.
+   *
+   * @param domain A string value representing abstract storage indexing.
+   * @param batch The ordered set of writes.
+   * @return Failure if any write could not be applied.
+   */
+  virtual Status writeBatch(const std::string& domain,
+                            const DatabaseBatch& batch);
+
+  /**
+   * @brief Return the smallest key that is greater than every key beginning
+   * with prefix.
+   *
+   * An empty string is returned if no such key exists, for example when the
+   * prefix is empty or is made of 0xFF bytes. This is used as the exclusive
+   * stop for DatabasePlugin::scanRange when scanning a prefix.
+   */
+  static std::string getPrefixUpperBound(const std::string& prefix);
+
   /**
    * @brief Shutdown the database and release initialization resources.
    *
@@ -578,6 +1090,33 @@ Status setDatabaseValue(const std::string& domain,
 /// Remove a domain/key identified value from backing-store.
 Status deleteDatabaseValue(const std::string& domain, const std::string& key);
 
+/**
+ * @brief Remove every key within [start, stop) from the active DatabasePlugin.
+ *
+ * See DatabasePlugin::removeRange. Use a prefix and its upper bound, from
+ * DatabasePlugin::getPrefixUpperBound, to remove every key with a prefix.
+ *
+ * @param domain A string value representing abstract storage indexing.
+ * @param start The inclusive lower bound key.
+ * @param stop The exclusive upper bound key, empty if unbounded.
+ * @return Storage operation status.
+ */
+Status deleteDatabaseRange(const std::string& domain,
+                           const std::string& start,
+                           const std::string& stop);
+
+/**
+ * @brief Apply a set of writes to the active DatabasePlugin atomically.
+ *
+ * See DatabaseBatch and DatabasePlugin::writeBatch. An empty batch is a no-op.
+ *
+ * @param domain A string value representing abstract storage indexing.
+ * @param batch The ordered set of writes.
+ * @return Storage operation status.
+ */
+Status writeDatabaseBatch(const std::string& domain,
+                          const DatabaseBatch& batch);
+
 /// Get a list of keys for a given domain.
 Status scanDatabaseKeys(const std::string& domain,
                         std::vector<std::string>& keys,
@@ -589,6 +1128,31 @@ Status scanDatabaseKeys(const std::string& domain,
                         const std::string& prefix,
                         size_t max = 0);
 
+/**
+ * @brief Get the key/value pairs for keys beginning with a prefix.
+ *
+ * This is the value-returning equivalent of scanDatabaseKeys. It performs a
+ * single bounded iteration of the domain rather than a scan followed by a
+ * getDatabaseValue for each key.
+ *
+ * @param domain A string value representing abstract storage indexing.
+ * @param values The output list of key/value pairs, in key order.
+ * @param prefix An optional key prefix, an empty prefix matches all keys.
+ * @param max The optional maximum number of pairs to return (0 = unlimited).
+ * @return Storage operation status.
+ */
+Status scanDatabaseValues(const std::string& domain,
+                          DatabaseKeyValues& values,
+                          const std::string& prefix,
+                          size_t max = 0);
+
+/// Get the key/value pairs for keys within [start, stop) for a given domain.
+Status scanDatabaseRange(const std::string& domain,
+                         DatabaseKeyValues& values,
+                         const std::string& start,
+                         const std::string& stop,
+                         size_t max = 0);
+
 /// Allow callers to reload or reset the database plugin.
 void resetDatabase();
 
@@ -32,6 +32,7 @@ class EventPublisher;
 template <class PUB>
 class EventSubscriber;
 class EventFactory;
+class EventDispatchQueue;
 
 using EventPublisherID = const std::string;
 using EventSubscriberID = const std::string;
@@ -343,9 +344,14 @@ class EventPublisherPlugin : public Plugin,
    */
   virtual void fire(const EventContextRef& ec, EventTime time = 0) final;
 
-  /// The internal fire method used by the typed EventPublisher.
-  virtual void fireCallback(const SubscriptionRef& sub,
-                            const EventContextRef& ec) const = 0;
+  /**
+   * @brief Check if a Subscription%'s callback should receive an event.
+   *
+   * This is evaluated on the publisher's thread, the callback itself may be
+   * called later from the subscriber's dispatch queue.
+   */
+  virtual bool shouldFireCallback(const SubscriptionRef& sub,
+                                  const EventContextRef& ec) const = 0;
 
   /// The EventPublisher will keep track of Subscription%s that contain callins.
   SubscriptionVector subscriptions_;
@@ -377,6 +383,8 @@ class EventPublisherPlugin : public Plugin,
  private:
   FRIEND_TEST(EventsTests, test_event_publisher);
   FRIEND_TEST(EventsTests, test_fire_event);
+  FRIEND_TEST(EventsTests, test_fire_event_queued);
+  FRIEND_TEST(EventsTests, test_fire_event_blocked);
 };
 
 class EventSubscriberPlugin : public Plugin, public Eventer {
@@ -426,24 +434,32 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
    */
   virtual QueryData get(EventTime start, EventTime stop) final;
 
- private:
-  /// Overload add for tests and allow them to override the event time.
-  virtual Status add(Row& r, EventTime event_time) final;
+  /**
+   * @brief Get the number of fired events queued for this subscriber
+   *
+   * The default implementation retrieves this value from
+   * FLAGS_events_queue_size. A subscriber doing slow work in its callbacks
+   * may override this to run them on its own thread. 0 calls them inline.
+   *
+   * @return The size of this subscriber's dispatch queue
+   */
+  virtual size_t getEventsQueueSize();
 
- private:
-  /*
-   * @brief When `get`ing event results, return EventID%s from time indexes.
+  /**
+   * @brief Check if a full dispatch queue blocks the publisher
    *
-   * Used by EventSubscriber::get to retrieve EventID, EventTime indexes. This
-   * applies the lookup-efficiency checks for time list appropriate bins.
-   * If the time range in 24 hours and there is a 24-hour list bin it will
-   * be queried using a single backing store `Get` followed by two `Get`s of
-   * the most-specific boundary lists.
+   * The default implementation checks FLAGS_events_queue_overflow. A
+   * subscriber that cannot lose events may override this to always block.
    *
-   * @return List of EventID, EventTime%s
+   * @return true to wait for space, false to drop the oldest event
    */
-  std::vector<EventRecord> getRecords(const std::vector<std::string>& indexes);
+  virtual bool getEventsQueueBlocks();
 
+ private:
+  /// Overload add for tests and allow them to override the event time.
+  virtual Status add(Row& r, EventTime event_time) final;
+
+ private:
   /**
    * @brief Get a unique storage-related EventID.
    *
@@ -455,35 +471,23 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
    * indexing is required within-EventCallback consider an
    * EventSubscriber%-unique indexing, counting mechanic.
    *
+   * IDs are allocated from an in-memory counter. Blocks of IDs are reserved
+   * in the backing store, such that IDs are never reused after a restart.
+   * After a restart, allocation continues after the last EventID marker's
+   * interval when it is within the reservation.
+   * Each ID is a fixed-width zero-padded decimal, so IDs sort as strings.
+   *
    * @return A unique ID for backing storage.
    */
   EventID getEventID();
 
   /**
-   * @brief Plan the best set of indexes for event record access.
-   *
-   * @param start an inclusive time to begin searching.
-   * @param stop an inclusive time to end searching.
+   * @brief Remove every event at or before the expiration time.
    *
-   * @return List of 'index.step' index strings.
+   * Event data is keyed by time, so expiration is a single range removal
+   * regardless of the number of expired events.
    */
-  std::vector<std::string> getIndexes(EventTime start, EventTime stop);
-
-  /**
-   * @brief Expire indexes and eventually records.
-   *
-   * @param list_type the string representation of list binning type.
-   * @param indexes complete set of 'index.step' indexes for the list_type.
-   * @param expirations of the indexes, the set to expire.
-   */
-  void expireIndexes(const std::string& list_type,
-                     const std::vector<std::string>& indexes,
-                     const std::vector<std::string>& expirations);
-
-  /// Expire all datums within a bin.
-  void expireRecords(const std::string& list_type,
-                     const std::string& index,
-                     bool all);
+  void expireEvents();
 
   /**
    * @brief Inspect the number of events, expire those overflowing events_max.
@@ -491,28 +495,22 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
    * When the event manager starts, or after a checkpoint number of events,
    * the EventFactory will call expireCheck for each subscriber.
    *
-   * The subscriber must count the number of buffered records and check if
-   * that count exceeds the configured `events_max` limit. If an overflow
-   * occurs the subscriber will expire N-events_max from the end of the queue.
-   *
-   * @param cleanup Perform an intense scan of zombie event IDs.
+   * The subscriber compares the last EventID with the configured `events_max`
+   * limit. If an overflow occurs the subscriber finds the most-recent marker,
+   * a periodic EventID to time mapping, for an overflowing event and removes
+   * the events up to and including the marked event. The limit is applied
+   * with a precision of the marker interval.
    */
-  void expireCheck(bool cleanup = false);
+  void expireCheck();
 
   /**
-   * @brief Add an EventID, EventTime pair to all matching list types.
-   *
-   * The list types are defined by time size. Based on the EventTime this pair
-   * is added to the list bin for each list type. If there are two list types:
-   * 60 seconds and 3600 seconds and `time` is 92, this pair will be added to
-   * list type 1 bin 4 and list type 2 bin 1.
+   * @brief Move events stored using the previous layout into the timeline.
    *
-   * @param eid A unique EventID.
-   * @param time The time when this EventID%'s event occurred.
-   *
-   * @return Were the indexes recorded.
+   * Previous versions stored event data by EventID with separate record and
+   * index lists. When the subscriber is registered, buffered events are
+   * re-keyed by their time and the lists are removed.
    */
-  Status recordEvent(EventID& eid, EventTime time);
+  void migrateEvents();
 
   /**
    * @brief Get the expiration timeout for this event type
@@ -570,6 +568,12 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
     return event_count_;
   }
 
+  /// The number of fired events waiting in the subscriber's dispatch queue.
+  size_t queueDepth() const;
+
+  /// The number of fired events dropped because the queue was full.
+  size_t queueDrops() const;
+
  private:
   explicit EventSubscriberPlugin(EventSubscriberPlugin const&) = delete;
   EventSubscriberPlugin& operator=(EventSubscriberPlugin const&) = delete;
@@ -622,7 +626,13 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
   EventTime expire_time_{0};
 
   /// Cached value of last generated EventID.
-  size_t last_eid_{0};
+  std::atomic<size_t> last_eid_{0};
+
+  /// The last EventID reserved in the backing store.
+  std::atomic<size_t> reserved_eid_{0};
+
+  /// True once the last reservation was read from the backing store.
+  std::atomic<bool> eid_loaded_{false};
 
   /**
    * @brief Optimize subscriber selects by tracking the last select time.
@@ -642,11 +652,16 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
    */
   size_t optimize_eid_{0};
 
-  /// Lock used when incrementing the EventID database index.
+  /// Lock used when reserving a block of EventIDs in the database.
   Mutex event_id_lock_;
 
-  /// Lock used when recording an EventID and time into search bins.
-  Mutex event_record_lock_;
+  /**
+   * @brief Fired events waiting for this subscriber's callbacks.
+   *
+   * This is only set while the subscriber runs and getEventsQueueSize is not
+   * 0. It is read by publisher threads, use the atomic shared_ptr accessors.
+   */
+  std::shared_ptr<EventDispatchQueue> dispatch_queue_;
 
  private:
   friend class EventFactory;
@@ -659,6 +674,7 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
   FRIEND_TEST(EventsDatabaseTests, test_record_expiration);
   FRIEND_TEST(EventsDatabaseTests, test_gentable);
   FRIEND_TEST(EventsDatabaseTests, test_expire_check);
+  FRIEND_TEST(EventsDatabaseTests, test_migrate_events);
   FRIEND_TEST(EventsDatabaseTests, test_optimize);
   friend class DBFakeEventSubscriber;
   friend class BenchmarkEventSubscriber;
@@ -788,6 +804,9 @@ class EventFactory : private boost::noncopyable {
   /// Set log forwarding by adding a logger receiver.
   static void addForwarder(const std::string& logger);
 
+  /// Check if any logger receives forwarded events.
+  static bool hasForwarders();
+
   /// Optionally forward events to loggers.
   static void forwardEvent(const std::string& event);
 
@@ -839,6 +858,9 @@ class EventFactory : private boost::noncopyable {
   EventFactory() {}
   ~EventFactory() {}
 
+  /// Deliver a subscriber's queued events and stop its dispatch thread.
+  static void stopDispatchQueue(const EventSubscriberRef& sub);
+
  private:
   /// Set of registered EventPublisher instances.
   std::map<EventPublisherID, EventPublisherRef> event_pubs_;
@@ -931,13 +953,11 @@ class EventPublisher : public EventPublisherPlugin {
    * @param sub The SubscriptionContext and optional EventCallback.
    * @param ec The event that was fired.
    */
-  void fireCallback(const SubscriptionRef& sub,
-                    const EventContextRef& ec) const override {
-    auto pub_sc = getSubscriptionContext(sub->context);
-    auto pub_ec = getEventContext(ec);
-    if (shouldFire(pub_sc, pub_ec) && sub->callback != nullptr) {
-      sub->callback(pub_ec, pub_sc);
-    }
+  bool shouldFireCallback(const SubscriptionRef& sub,
+                          const EventContextRef& ec) const override {
+    return sub->callback != nullptr &&
+           shouldFire(getSubscriptionContext(sub->context),
+                      getEventContext(ec));
   }
 
  protected:
@@ -82,6 +82,11 @@ class Pack : private boost::noncopyable {
     return shard_;
   }
 
+  /// Maximum queries from this pack run at once by scheduler workers.
+  size_t getConcurrency() const {
+    return concurrency_;
+  }
+
   /// Returns the schedule dictated by the pack
   const std::map<std::string, ScheduledQuery>& getSchedule() const;
 
@@ -126,6 +131,9 @@ class Pack : private boost::noncopyable {
   /// Optional shard requirement for pack.
   size_t shard_{0};
 
+  /// Optional limit of concurrently executing queries, 0 for no limit.
+  size_t concurrency_{0};
+
   /// Pack canonicalized name.
   std::string name_;
 
@@ -23,6 +23,9 @@ namespace osquery {
 
 DECLARE_int32(value_max);
 
+/// Values bound, in order, to the '?' parameters of a query.
+using QueryParameters = std::vector<std::string>;
+
 /**
  * @brief An abstract similar to boost's noncopyable that defines moves.
  *
@@ -75,6 +78,18 @@ class SQL : private only_movable {
    */
   explicit SQL(const std::string& q);
 
+  /**
+   * @brief Instantiate an instance of the class with bound parameters.
+   *
+   * Parameters are bound as values, they are never interpolated into the
+   * query text. This allows the SQL implementation to reuse a prepared
+   * statement across executions with different values.
+   *
+   * @param q An osquery SQL query containing '?' parameters.
+   * @param params The values bound, in order, to the query's parameters.
+   */
+  SQL(const std::string& q, const QueryParameters& params);
+
   /// Allow moving.
   SQL(SQL&&) = default;
 
@@ -187,6 +202,16 @@ class SQLPlugin : public Plugin {
   /// Run a SQL query string against the SQL implementation.
   virtual Status query(const std::string& q, QueryData& results) const = 0;
 
+  /// Run a SQL query string with values bound to its parameters.
+  virtual Status queryWithParameters(const std::string& q,
+                                     const QueryParameters& params,
+                                     QueryData& results) const {
+    if (!params.empty()) {
+      return Status(1, "Bound parameters are not supported");
+    }
+    return query(q, results);
+  }
+
   /// Use the SQL implementation to parse a query string and return details
   /// (name, type) about the columns.
   virtual Status getQueryColumns(const std::string& q,
@@ -198,8 +223,13 @@ class SQLPlugin : public Plugin {
    * The SQL implementation plugin may need to manage how virtual tables are
    * attached at run time. In the case of SQLite where a single DB object is
    * managed, tables are enumerated and attached during initialization.
+   *
+   * @param name The table name.
+   * @param definition The table's column definition, or empty if the SQL
+   * implementation should request it from the table.
    */
-  virtual Status attach(const std::string& name) {
+  virtual Status attach(const std::string& name,
+                        const std::string& definition) {
     return Status(0, "Not used");
   }
 
@@ -236,6 +266,18 @@ class SQLPlugin : public Plugin {
  */
 Status query(const std::string& query, QueryData& results);
 
+/**
+ * @brief Execute a query with bound parameters.
+ *
+ * @param query the query to execute, containing '?' parameters
+ * @param params the values bound, in order, to the query's parameters
+ * @param results A QueryData structure to emit result rows on success.
+ * @return A status indicating query success.
+ */
+Status query(const std::string& query,
+             const QueryParameters& params,
+             QueryData& results);
+
 /**
  * @brief Analyze a query, providing information about the result columns.
  *
@@ -15,9 +15,12 @@
 #include <memory>
 #include <set>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include <boost/coroutine2/coroutine.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/optional.hpp>
 #include <boost/property_tree/ptree.hpp>
 
 #include <osquery/core.h>
@@ -272,6 +275,28 @@ using TableColumns =
 /// Alias for map of column alias sets.
 using ColumnAliasSet = std::map<std::string, std::set<std::string>>;
 
+/**
+ * @brief The columns, aliases, and attributes of a table compiled from its
+ * spec file.
+ *
+ * Each table generated from a spec defines its schema as static data and adds
+ * it to a process-wide catalog, see registerTableSchema. SQLite may connect
+ * such a table without a "columns" call to its plugin.
+ */
+struct TableSchema {
+  /// The table's columns, types, and options.
+  TableColumns columns;
+
+  /// Other names of the table.
+  std::vector<std::string> aliases;
+
+  /// Other names of columns, keyed by the column name.
+  ColumnAliasSet column_aliases;
+
+  /// The table's attributes.
+  TableAttributes attributes;
+};
+
 /// Forward declaration of QueryContext for ConstraintList relationships.
 struct QueryContext;
 
@@ -437,6 +462,9 @@ using ConstraintMap = std::map<std::string, struct ConstraintList>;
 /// Populate a constraint list from a query's parsed predicate.
 using ConstraintSet = std::vector<std::pair<std::string, struct Constraint>>;
 
+/// The set of column names referenced by a query.
+using UsedColumns = std::unordered_set<std::string>;
+
 /**
  * @brief osquery table content descriptor.
  *
@@ -471,9 +499,6 @@ struct VirtualTableContent {
    */
   std::map<std::string, size_t> aliases;
 
-  /// Transient set of virtual table access constraints.
-  std::unordered_map<size_t, ConstraintSet> constraints;
-
   /*
    * @brief A table implementation specific query result cache.
    *
@@ -526,6 +551,23 @@ struct QueryContext : private boost::noncopyable {
   bool hasConstraint(const std::string& column,
                      ConstraintOperator op = EQUALS) const;
 
+  /**
+   * @brief Check if a column is referenced by the query.
+   *
+   * SQLite reports the columns each table scan may read, including columns
+   * only used within constraints. A table generator may skip expensive work
+   * for the columns that are not used. If the context was not created by a
+   * SQLite scan, such as a selectAllFrom or extension call, every column is
+   * considered used.
+   *
+   * @param column The name of a column within this table.
+   * @return true if the column may be read from the generated rows.
+   */
+  bool isColumnUsed(const std::string& column) const;
+
+  /// Check if any of the columns is referenced by the query.
+  bool isAnyColumnUsed(const std::vector<std::string>& columns) const;
+
   /**
    * @brief Apply a predicate function to each expression in a constraint list.
    *
@@ -625,6 +667,9 @@ struct QueryContext : private boost::noncopyable {
   /// The map of column name to constraint list.
   ConstraintMap constraints;
 
+  /// The columns referenced by the query, if unset all columns may be used.
+  boost::optional<UsedColumns> colsUsed;
+
  private:
   /// If false then the context is maintaining a ephemeral cache.
   bool enable_cache_{false};
@@ -639,6 +684,102 @@ struct QueryContext : private boost::noncopyable {
 using QueryContext = struct QueryContext;
 using Constraint = struct Constraint;
 
+/**
+ * @brief A generated row that may keep numeric cells in their native type.
+ *
+ * Text cells are set with operator[], like a Row. Cells set with setInteger
+ * and setDouble reach SQLite without being formatted and parsed again, they
+ * are only formatted when the row is converted with takeRow. If a column is
+ * set as both text and a number the number is used.
+ */
+class TableRow {
+ public:
+  /// A native numeric cell value.
+  struct Number {
+    /// The column name.
+    std::string column;
+
+    /// Either INTEGER_TYPE or DOUBLE_TYPE.
+    ColumnType type;
+
+    /// The value for an INTEGER_TYPE cell.
+    long long integer;
+
+    /// The value for a DOUBLE_TYPE cell.
+    double real;
+  };
+
+ public:
+  TableRow() = default;
+
+  /// Adapt a Row, every cell is text.
+  explicit TableRow(Row&& r) : text_(std::move(r)) {}
+
+  /// Access a text cell.
+  std::string& operator[](const std::string& column) {
+    return text_[column];
+  }
+
+  /// Set a native integer cell.
+  void setInteger(const std::string& column, long long value) {
+    numbers_.push_back({column, INTEGER_TYPE, value, 0});
+  }
+
+  /// Set a native double cell.
+  void setDouble(const std::string& column, double value) {
+    numbers_.push_back({column, DOUBLE_TYPE, 0, value});
+  }
+
+  /// The text cells.
+  Row& text() {
+    return text_;
+  }
+
+  /// The numeric cells, in the order they were set.
+  const std::vector<Number>& numbers() const {
+    return numbers_;
+  }
+
+  /// Move the cells into a Row, numeric cells are formatted as text.
+  Row takeRow();
+
+ private:
+  /// Text cells.
+  Row text_;
+
+  /// Native numeric cells.
+  std::vector<Number> numbers_;
+};
+
+/**
+ * @brief A lazily-evaluated source of table rows.
+ *
+ * The pull side is owned by the virtual table cursor, which resumes the
+ * table's generator each time SQLite steps to the next row. The push side is
+ * wrapped in a RowYield and handed to TablePlugin::generator.
+ */
+using RowGenerator = boost::coroutines2::coroutine<TableRow&>;
+
+/// Tables yield each generated row into a RowYield, the row may be moved from.
+class RowYield : private boost::noncopyable {
+ public:
+  explicit RowYield(RowGenerator::push_type& push) : push_(push) {}
+
+  /// Yield a row that may include native numeric cells.
+  void operator()(TableRow& r) {
+    push_(r);
+  }
+
+  /// Yield a row of text cells.
+  void operator()(Row& r) {
+    TableRow row(std::move(r));
+    push_(row);
+  }
+
+ private:
+  RowGenerator::push_type& push_;
+};
+
 /**
  * @brief The TablePlugin defines the name, types, and column information.
  *
@@ -695,8 +836,32 @@ class TablePlugin : public Plugin {
    * @param request A query context filled in by SQLite's virtual table API.
    * @return The result rows for this table, given the query context.
    */
-  virtual QueryData generate(QueryContext& request) {
-    return QueryData();
+  virtual QueryData generate(QueryContext& request);
+
+ public:
+  /**
+   * @brief Generate the table's rows incrementally.
+   *
+   * Tables returning true from TablePlugin::usesGenerator implement this
+   * instead of TablePlugin::generate. SQLite resumes the generator for every
+   * row it steps over, so a query with a LIMIT or an EXISTS subquery stops
+   * the scan as soon as it has seen enough rows and rows are never held in
+   * memory as a whole set.
+   *
+   * If the cursor is closed before the generator completes, the generator's
+   * stack is unwound with an exception. Generators must not swallow it with
+   * a catch (...) block.
+   *
+   * The default implementation adapts TablePlugin::generate.
+   *
+   * @param yield Receives each row, the row may be moved from.
+   * @param context A query context filled in by SQLite's virtual table API.
+   */
+  virtual void generator(RowYield& yield, QueryContext& context);
+
+  /// True if rows should be pulled lazily from TablePlugin::generator.
+  virtual bool usesGenerator() const {
+    return false;
   }
 
  protected:
@@ -755,14 +920,15 @@ class TablePlugin : public Plugin {
   /**
    * @brief The scheduled interval for the executing query.
    *
-   * Scheduled queries execute within a pseudo-mutex, and each may communicate
-   * their scheduled interval to internal TablePlugin implementations. If the
-   * table is cachable then the interval can be used to calculate freshness.
+   * Scheduled queries each communicate their scheduled interval to internal
+   * TablePlugin implementations. If the table is cachable then the interval
+   * can be used to calculate freshness. Scheduler workers execute queries
+   * concurrently, so the interval is set for the executing thread.
    */
-  static size_t kCacheInterval;
+  static thread_local size_t kCacheInterval;
 
   /// The schedule step, this is the current position of the schedule.
-  static size_t kCacheStep;
+  static thread_local size_t kCacheStep;
 
  public:
   /**
@@ -819,6 +985,31 @@ std::string columnDefinition(const TableColumns& columns);
 std::string columnDefinition(const PluginResponse& response,
                              bool aliases = false);
 
+/**
+ * @brief Add the schema of a table generated from a spec to the catalog.
+ *
+ * Generated tables call this during static initialization. The schema is
+ * static data and is not copied.
+ *
+ * @param name The table name.
+ * @param schema The table schema.
+ * @return true, such that the call may initialize a static.
+ */
+bool registerTableSchema(const std::string& name, const TableSchema& schema);
+
+/**
+ * @brief Find a generated table schema by table name or table alias.
+ *
+ * @param module A table name or a table alias.
+ * @param name The output table name.
+ * @return The table schema, or nullptr if the table was not generated.
+ */
+const TableSchema* getTableSchema(const std::string& module,
+                                  std::string& name);
+
+/// Serialize a table schema as the response to a "columns" request.
+PluginResponse getTableRouteInfo(const TableSchema& schema);
+
 /// Get the string representation for an SQLite column type.
 inline const std::string& columnTypeName(ColumnType type) {
   return kColumnTypeNames.at(type);
@@ -12,6 +12,7 @@
 #include <mutex>
 #include <random>
 
+#include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/trim.hpp>
 
@@ -27,6 +28,7 @@
 
 #include "osquery/core/conversions.h"
 #include "osquery/core/json.h"
+#include "osquery/database/query.h"
 
 namespace pt = boost::property_tree;
 
@@ -88,6 +90,9 @@ RecursiveMutex config_schedule_mutex_;
 RecursiveMutex config_files_mutex_;
 RecursiveMutex config_performance_mutex_;
 
+/// The scheduled query executing on this thread, see Config::recordQueryStart.
+static thread_local std::string kThreadExecutingQuery;
+
 using PackRef = std::shared_ptr<Pack>;
 
 /**
@@ -239,10 +244,12 @@ Schedule::Schedule() {
   // Check if any queries were executing when the tool last stopped.
   getDatabaseValue(kPersistentSettings, kExecutingQuery, failed_query_);
   if (!failed_query_.empty()) {
-    LOG(WARNING) << "Scheduled query may have failed: " << failed_query_;
     setDatabaseValue(kPersistentSettings, kExecutingQuery, "");
-    // Add this query name to the blacklist and save the blacklist.
-    blacklist_[failed_query_] = getUnixTime() + 86400;
+    // Add each query name to the blacklist and save the blacklist.
+    for (const auto& name : split(failed_query_, "\n")) {
+      LOG(WARNING) << "Scheduled query may have failed: " << name;
+      blacklist_[name] = getUnixTime() + 86400;
+    }
     saveScheduleBlacklist(blacklist_);
   }
 }
@@ -260,6 +267,7 @@ void Config::addPack(const std::string& name,
     RecursiveLock wlock(config_schedule_mutex_);
     try {
       schedule_->add(std::make_shared<Pack>(pack_name, source, pack_tree));
+      schedule_generation_++;
       if (schedule_->last()->shouldPackExecute()) {
         applyParsers(
             source + FLAGS_pack_delimiter + pack_name, pack_tree, true);
@@ -283,7 +291,8 @@ void Config::addPack(const std::string& name,
 
 void Config::removePack(const std::string& pack) {
   RecursiveLock wlock(config_schedule_mutex_);
-  return schedule_->remove(pack);
+  schedule_->remove(pack);
+  schedule_generation_++;
 }
 
 void Config::addFile(const std::string& source,
@@ -300,29 +309,42 @@ void Config::removeFiles(const std::string& source) {
   }
 }
 
+/// The unique name of a pack's query, the query name may be synthetic.
+static std::string getScheduledQueryName(const PackRef& pack,
+                                         const std::string& query) {
+  if (pack->getName() != "main" && pack->getName() != "legacy_main") {
+    return "pack" + FLAGS_pack_delimiter + pack->getName() +
+           FLAGS_pack_delimiter + query;
+  }
+  return query;
+}
+
+bool Config::isBlacklisted(const std::string& name) {
+  // They query may have failed and been added to the schedule's blacklist.
+  auto blacklisted_query = schedule_->blacklist_.find(name);
+  if (blacklisted_query == schedule_->blacklist_.end()) {
+    return false;
+  }
+
+  if (getUnixTime() > blacklisted_query->second) {
+    // The blacklisted query passed the expiration time (remove).
+    schedule_->blacklist_.erase(blacklisted_query);
+    saveScheduleBlacklist(schedule_->blacklist_);
+    return false;
+  }
+  // The query is still blacklisted.
+  return true;
+}
+
 void Config::scheduledQueries(
     std::function<void(const std::string& name, const ScheduledQuery& query)>
         predicate) {
   RecursiveLock lock(config_schedule_mutex_);
   for (const PackRef& pack : *schedule_) {
     for (const auto& it : pack->getSchedule()) {
-      std::string name = it.first;
-      // The query name may be synthetic.
-      if (pack->getName() != "main" && pack->getName() != "legacy_main") {
-        name = "pack" + FLAGS_pack_delimiter + pack->getName() +
-               FLAGS_pack_delimiter + it.first;
-      }
-      // They query may have failed and been added to the schedule's blacklist.
-      if (schedule_->blacklist_.count(name) > 0) {
-        auto blacklisted_query = schedule_->blacklist_.find(name);
-        if (getUnixTime() > blacklisted_query->second) {
-          // The blacklisted query passed the expiration time (remove).
-          schedule_->blacklist_.erase(blacklisted_query);
-          saveScheduleBlacklist(schedule_->blacklist_);
-        } else {
-          // The query is still blacklisted.
-          continue;
-        }
+      auto name = getScheduledQueryName(pack, it.first);
+      if (isBlacklisted(name)) {
+        continue;
       }
       // Call the predicate.
       predicate(name, it.second);
@@ -330,6 +352,23 @@ void Config::scheduledQueries(
   }
 }
 
+void Config::allScheduledQueries(
+    std::function<void(const PackRef& pack,
+                       const std::string& name,
+                       const ScheduledQuery& query)> predicate) {
+  RecursiveLock lock(config_schedule_mutex_);
+  for (const PackRef& pack : schedule_->packs_) {
+    for (const auto& it : pack->getSchedule()) {
+      predicate(pack, getScheduledQueryName(pack, it.first), it.second);
+    }
+  }
+}
+
+bool Config::isScheduled(const PackRef& pack, const std::string& name) {
+  RecursiveLock lock(config_schedule_mutex_);
+  return pack->shouldPackExecute() && !isBlacklisted(name);
+}
+
 void Config::packs(std::function<void(PackRef& pack)> predicate) {
   RecursiveLock lock(config_schedule_mutex_);
   for (PackRef& pack : schedule_->packs_) {
@@ -412,6 +451,7 @@ Status Config::updateSource(const std::string& source,
     RecursiveLock lock(config_schedule_mutex_);
     // Remove all packs from this source.
     schedule_->removeAll(source);
+    schedule_generation_++;
     // Remove all files from this source.
     removeFiles(source);
   }
@@ -606,6 +646,11 @@ void Config::purge() {
       continue;
     }
 
+    if (saved_query.find(kQueryMetadataPrefix) == 0) {
+      // Query metadata is expired with the query's results.
+      continue;
+    }
+
     std::string content;
     getDatabaseValue(kPersistentSettings, "timestamp." + saved_query, content);
     if (content.empty()) {
@@ -630,6 +675,7 @@ void Config::purge() {
     if (last_executed < getUnixTime() - 592200) {
       // Query has not run in the last week, expire results and interval.
       deleteDatabaseValue(kQueries, saved_query);
+      deleteDatabaseValue(kQueries, kQueryMetadataPrefix + saved_query);
       deleteDatabaseValue(kPersistentSettings, "interval." + saved_query);
       deleteDatabaseValue(kPersistentSettings, "timestamp." + saved_query);
       VLOG(1) << "Expiring results for scheduled query: " << saved_query;
@@ -639,6 +685,7 @@ void Config::purge() {
 
 void Config::reset() {
   schedule_ = std::make_shared<Schedule>();
+  schedule_generation_++;
   std::map<std::string, QueryPerformance>().swap(performance_);
   std::map<std::string, FileCategories>().swap(files_);
   std::map<std::string, std::string>().swap(hash_);
@@ -669,10 +716,9 @@ void ConfigParserPlugin::reset() {
 }
 
 void Config::recordQueryPerformance(const std::string& name,
-                                    size_t delay,
+                                    const QueryResourceUsage& usage,
                                     size_t size,
-                                    const Row& r0,
-                                    const Row& r1) {
+                                    bool cached) {
   RecursiveLock lock(config_performance_mutex_);
   if (performance_.count(name) == 0) {
     performance_[name] = QueryPerformance();
@@ -680,45 +726,47 @@ void Config::recordQueryPerformance(const std::string& name,
 
   // Grab access to the non-const schedule item.
   auto& query = performance_.at(name);
-  BIGINT_LITERAL diff = 0;
-  if (!r1.at("user_time").empty() && !r0.at("user_time").empty()) {
-    diff = AS_LITERAL(BIGINT_LITERAL, r1.at("user_time")) -
-           AS_LITERAL(BIGINT_LITERAL, r0.at("user_time"));
-    if (diff > 0) {
-      query.user_time += diff;
-    }
+  query.user_time += usage.user_time;
+  query.system_time += usage.system_time;
+  if (usage.heap_delta > 0) {
+    // Memory is stored as an average of heap changes between query executions.
+    auto delta = static_cast<unsigned long long int>(usage.heap_delta);
+    query.average_memory = (query.average_memory * query.executions) + delta;
+    query.average_memory = (query.average_memory / (query.executions + 1));
   }
 
-  if (!r1.at("system_time").empty() && !r0.at("system_time").empty()) {
-    diff = AS_LITERAL(BIGINT_LITERAL, r1.at("system_time")) -
-           AS_LITERAL(BIGINT_LITERAL, r0.at("system_time"));
-    if (diff > 0) {
-      query.system_time += diff;
-    }
-  }
-
-  if (!r1.at("resident_size").empty() && !r0.at("resident_size").empty()) {
-    diff = AS_LITERAL(BIGINT_LITERAL, r1.at("resident_size")) -
-           AS_LITERAL(BIGINT_LITERAL, r0.at("resident_size"));
-    if (diff > 0) {
-      // Memory is stored as an average of RSS changes between query executions.
-      query.average_memory = (query.average_memory * query.executions) + diff;
-      query.average_memory = (query.average_memory / (query.executions + 1));
-    }
+  for (const auto& table : usage.tables) {
+    auto& total = query.tables[table.first];
+    total.scans += table.second.scans;
+    total.rows += table.second.rows;
+    total.bytes += table.second.bytes;
   }
 
-  query.wall_time += delay;
+  query.wall_time_ns += usage.wall_time_ns;
+  query.wall_time = query.wall_time_ns / 1000000000;
   query.output_size += size;
   query.executions += 1;
+  if (cached) {
+    query.statement_cache_hits += 1;
+  }
   query.last_executed = getUnixTime();
 
   // Clear the executing query (remove the dirty bit).
-  setDatabaseValue(kPersistentSettings, kExecutingQuery, "");
+  executing_.erase(name);
+  setDatabaseValue(
+      kPersistentSettings, kExecutingQuery, boost::join(executing_, "\n"));
+  kThreadExecutingQuery.clear();
 }
 
 void Config::recordQueryStart(const std::string& name) {
-  // There should only ever be a single executing query in the schedule.
-  setDatabaseValue(kPersistentSettings, kExecutingQuery, name);
+  // Scheduler workers may execute several queries at once, all are recorded.
+  {
+    RecursiveLock lock(config_performance_mutex_);
+    executing_.insert(name);
+    setDatabaseValue(
+        kPersistentSettings, kExecutingQuery, boost::join(executing_, "\n"));
+  }
+  kThreadExecutingQuery = name;
   // Store the time this query name last executed for later results eviction.
   // When configuration updates occur the previous schedule is searched for
   // 'stale' query names, aka those that have week-old or longer last execute
@@ -727,6 +775,17 @@ void Config::recordQueryStart(const std::string& name) {
       kPersistentSettings, "timestamp." + name, std::to_string(getUnixTime()));
 }
 
+void Config::recordQueryLag(const std::string& name, size_t lag) {
+  RecursiveLock lock(config_performance_mutex_);
+  auto& query = performance_[name];
+  query.lag += lag;
+  query.max_lag = std::max(query.max_lag, static_cast<unsigned long long>(lag));
+}
+
+const std::string& Config::getExecutingQuery() {
+  return kThreadExecutingQuery;
+}
+
 void Config::getPerformanceStats(
     const std::string& name,
     std::function<void(const QueryPerformance& query)> predicate) {
@@ -129,6 +129,9 @@ void Pack::initialize(const std::string& name,
     version_ = tree.get<std::string>("version", "");
   }
 
+  // Check for a limit of concurrently executing queries.
+  concurrency_ = tree.get<size_t>("concurrency", 0);
+
   // Apply the shard, platform, and version checking.
   // It is important to set each value such that the packs meta-table can report
   // each of the restrictions.
@@ -194,6 +197,8 @@ void Pack::initialize(const std::string& name,
     query.splayed_interval = restoreSplayedValue(q.first, query.interval);
     query.options["snapshot"] = q.second.get<bool>("snapshot", false);
     query.options["removed"] = q.second.get<bool>("removed", true);
+    query.pack = name_;
+    query.pack_concurrency = concurrency_;
     schedule_[q.first] = query;
   }
 }
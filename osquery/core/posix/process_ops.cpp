@@ -13,6 +13,13 @@
 #include <dlfcn.h>
 #include <stdlib.h>
 
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#include <malloc/malloc.h>
+#elif defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
 #include <sys/resource.h>
 #include <sys/syscall.h>
 #include <sys/time.h>
@@ -94,4 +101,55 @@ int platformGetTid() {
 #endif
   return 0;
 }
+
+size_t platformGetProcessCPUTime() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+  return static_cast<size_t>(
+      (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+      usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+void platformGetThreadCPUTime(size_t& user_time, size_t& system_time) {
+  user_time = 0;
+  system_time = 0;
+#if defined(RUSAGE_THREAD)
+  struct rusage usage;
+  if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+    user_time = static_cast<size_t>(usage.ru_utime.tv_sec * 1000000 +
+                                    usage.ru_utime.tv_usec);
+    system_time = static_cast<size_t>(usage.ru_stime.tv_sec * 1000000 +
+                                      usage.ru_stime.tv_usec);
+  }
+#elif defined(__APPLE__)
+  auto thread = mach_thread_self();
+  thread_basic_info_data_t info;
+  mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+  if (thread_info(thread, THREAD_BASIC_INFO, (thread_info_t)&info, &count) ==
+      KERN_SUCCESS) {
+    user_time = static_cast<size_t>(info.user_time.seconds * 1000000 +
+                                    info.user_time.microseconds);
+    system_time = static_cast<size_t>(info.system_time.seconds * 1000000 +
+                                      info.system_time.microseconds);
+  }
+  mach_port_deallocate(mach_task_self(), thread);
+#endif
+}
+
+size_t platformGetHeapAllocated() {
+#if defined(__APPLE__)
+  malloc_statistics_t stats;
+  malloc_zone_statistics(nullptr, &stats);
+  return stats.size_in_use;
+#elif defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+  return mallinfo2().uordblks;
+#elif defined(__GLIBC__)
+  // The legacy counters are int and wrap above 4GB.
+  return static_cast<size_t>(static_cast<unsigned int>(mallinfo().uordblks));
+#else
+  return 0;
+#endif
+}
 }
@@ -286,4 +286,28 @@ int platformGetPid();
 * and on posix platforms returns gettid()
 */
 int platformGetTid();
+
+/**
+* @brief Returns the CPU time, in microseconds, used by the current process
+*
+* This is the sum of user and system time of every thread. On Windows, this
+* uses GetProcessTimes and on posix platforms uses getrusage(RUSAGE_SELF)
+*/
+size_t platformGetProcessCPUTime();
+
+/**
+* @brief Returns the user and system CPU time, in microseconds, of this thread
+*
+* On Windows, this uses GetThreadTimes, on Linux and FreeBSD it uses
+* getrusage(RUSAGE_THREAD), and on macOS the Mach thread_info.
+*/
+void platformGetThreadCPUTime(size_t& user_time, size_t& system_time);
+
+/**
+* @brief Returns the bytes currently allocated from the process heap
+*
+* This is read from the allocator's counters without walking the heap.
+* It returns 0 on platforms without a cheap counter.
+*/
+size_t platformGetHeapAllocated();
 }
@@ -23,8 +23,8 @@ FLAG(bool, disable_caching, false, "Disable scheduled query caching");
 
 CREATE_LAZY_REGISTRY(TablePlugin, "table");
 
-size_t TablePlugin::kCacheInterval = 0;
-size_t TablePlugin::kCacheStep = 0;
+thread_local size_t TablePlugin::kCacheInterval = 0;
+thread_local size_t TablePlugin::kCacheStep = 0;
 
 const std::map<ColumnType, std::string> kColumnTypeNames = {
     {UNKNOWN_TYPE, "UNKNOWN"},
@@ -47,7 +47,11 @@ Status TablePlugin::addExternal(const std::string& name,
   }
 
   // Use the SQL registry to attach the name/definition.
-  return Registry::call("sql", "sql", {{"action", "attach"}, {"table", name}});
+  return Registry::call("sql",
+                        "sql",
+                        {{"action", "attach"},
+                         {"table", name},
+                         {"definition", osquery::columnDefinition(response)}});
 }
 
 void TablePlugin::removeExternal(const std::string& name) {
@@ -71,6 +75,15 @@ void TablePlugin::setRequestFromContext(const QueryContext& context,
   }
   tree.add_child("constraints", constraints);
 
+  // Forward the used columns, if known, so extensions may skip work.
+  if (context.colsUsed) {
+    pt::ptree columns;
+    for (const auto& column : *context.colsUsed) {
+      columns.push_back(std::make_pair("", pt::ptree(column)));
+    }
+    tree.add_child("colsUsed", columns);
+  }
+
   // Write the property tree as a JSON string into the PluginRequest.
   std::ostringstream output;
   try {
@@ -102,6 +115,14 @@ void TablePlugin::setContextFromRequest(const PluginRequest& request,
     auto column_name = constraint.second.get<std::string>("name");
     context.constraints[column_name].unserialize(constraint.second);
   }
+
+  if (tree.count("colsUsed") > 0) {
+    UsedColumns columns;
+    for (const auto& column : tree.get_child("colsUsed")) {
+      columns.insert(column.second.data());
+    }
+    context.colsUsed = std::move(columns);
+  }
 }
 
 Status TablePlugin::call(const PluginRequest& request,
@@ -134,14 +155,90 @@ Status TablePlugin::call(const PluginRequest& request,
   return Status(0, "OK");
 }
 
+QueryData TablePlugin::generate(QueryContext& request) {
+  QueryData results;
+  if (usesGenerator()) {
+    // Drain the generator for callers that need the complete row set, such
+    // as extension requests and the schedule cache.
+    RowGenerator::pull_type rows(
+        [this, &request](RowGenerator::push_type& push) {
+          RowYield yield(push);
+          generator(yield, request);
+        });
+    for (auto& row : rows) {
+      results.push_back(row.takeRow());
+    }
+  }
+  return results;
+}
+
+Row TableRow::takeRow() {
+  for (const auto& number : numbers_) {
+    text_[number.column] = (number.type == INTEGER_TYPE)
+                               ? std::to_string(number.integer)
+                               : DOUBLE(number.real);
+  }
+  numbers_.clear();
+  return std::move(text_);
+}
+
+void TablePlugin::generator(RowYield& yield, QueryContext& context) {
+  auto results = generate(context);
+  for (auto& row : results) {
+    yield(row);
+  }
+}
+
 std::string TablePlugin::columnDefinition() const {
   return osquery::columnDefinition(columns());
 }
 
 PluginResponse TablePlugin::routeInfo() const {
+  return getTableRouteInfo(
+      {columns(), aliases(), columnAliases(), attributes()});
+}
+
+/// Schemas of tables generated from specs, keyed by table name and alias.
+struct TableSchemaCatalog {
+  /// Each module name mapped to its table name and schema.
+  std::map<std::string, std::pair<std::string, const TableSchema*>> modules;
+
+  /// Protect the catalog from tables registered at run time.
+  Mutex mutex;
+};
+
+/// The catalog is filled during static initialization, construct it on use.
+static TableSchemaCatalog& getTableSchemaCatalog() {
+  static TableSchemaCatalog catalog;
+  return catalog;
+}
+
+bool registerTableSchema(const std::string& name, const TableSchema& schema) {
+  auto& catalog = getTableSchemaCatalog();
+  WriteLock lock(catalog.mutex);
+  catalog.modules[name] = std::make_pair(name, &schema);
+  for (const auto& alias : schema.aliases) {
+    catalog.modules[alias] = std::make_pair(name, &schema);
+  }
+  return true;
+}
+
+const TableSchema* getTableSchema(const std::string& module,
+                                  std::string& name) {
+  auto& catalog = getTableSchemaCatalog();
+  ReadLock lock(catalog.mutex);
+  auto table = catalog.modules.find(module);
+  if (table == catalog.modules.end()) {
+    return nullptr;
+  }
+  name = table->second.first;
+  return table->second.second;
+}
+
+PluginResponse getTableRouteInfo(const TableSchema& schema) {
   // Route info consists of the serialized column information.
   PluginResponse response;
-  for (const auto& column : columns()) {
+  for (const auto& column : schema.columns) {
     response.push_back(
         {{"id", "column"},
          {"name", std::get<0>(column)},
@@ -150,13 +247,13 @@ PluginResponse TablePlugin::routeInfo() const {
   }
   // Each table name alias is provided such that the core may add the views.
   // These views need to be removed when the backing table is detached.
-  for (const auto& alias : aliases()) {
+  for (const auto& alias : schema.aliases) {
     response.push_back({{"id", "alias"}, {"alias", alias}});
   }
 
   // Each column alias must be provided, additionally to the column's option.
   // This sets up the value-replacement move within the SQL implementation.
-  for (const auto& target : columnAliases()) {
+  for (const auto& target : schema.column_aliases) {
     for (const auto& alias : target.second) {
       response.push_back(
           {{"id", "columnAlias"}, {"name", alias}, {"target", target.first}});
@@ -165,7 +262,7 @@ PluginResponse TablePlugin::routeInfo() const {
 
   response.push_back(
       {{"id", "attributes"},
-       {"attributes", INTEGER(static_cast<size_t>(attributes()))}});
+       {"attributes", INTEGER(static_cast<size_t>(schema.attributes))}});
   return response;
 }
 
@@ -179,7 +276,7 @@ QueryData TablePlugin::getCache() const {
   std::string content;
   getDatabaseValue(kQueries, "cache." + getName(), content);
   QueryData results;
-  deserializeQueryDataJSON(content, results);
+  deserializeQueryDataBinary(content, results);
   return results;
 }
 
@@ -188,7 +285,7 @@ void TablePlugin::setCache(size_t step,
                            const QueryData& results) {
   // Serialize QueryData and save to database.
   std::string content;
-  if (!FLAGS_disable_caching && serializeQueryDataJSON(results, content)) {
+  if (!FLAGS_disable_caching && serializeQueryDataBinary(results, content)) {
     last_cached_ = step;
     last_interval_ = interval;
     setDatabaseValue(kQueries, "cache." + getName(), content);
@@ -366,6 +463,20 @@ bool QueryContext::hasConstraint(const std::string& column,
   return constraints.at(column).exists(op);
 }
 
+bool QueryContext::isColumnUsed(const std::string& column) const {
+  return !colsUsed || colsUsed->count(column) > 0;
+}
+
+bool QueryContext::isAnyColumnUsed(
+    const std::vector<std::string>& columns) const {
+  for (const auto& column : columns) {
+    if (isColumnUsed(column)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 Status QueryContext::expandConstraints(
     const std::string& column,
     ConstraintOperator op,
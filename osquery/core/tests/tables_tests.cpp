@@ -129,6 +129,37 @@ TEST_F(TablesTests, test_constraint_map) {
   EXPECT_TRUE(cm["path"].existsAndMatches("some"));
 }
 
+TEST_F(TablesTests, test_used_columns) {
+  QueryContext context;
+  // Without a projection from SQLite every column is used.
+  EXPECT_TRUE(context.isColumnUsed("path"));
+  EXPECT_TRUE(context.isAnyColumnUsed({"path", "size"}));
+
+  context.colsUsed = UsedColumns({"path"});
+  EXPECT_TRUE(context.isColumnUsed("path"));
+  EXPECT_FALSE(context.isColumnUsed("size"));
+  EXPECT_TRUE(context.isAnyColumnUsed({"size", "path"}));
+  EXPECT_FALSE(context.isAnyColumnUsed({"size", "mode"}));
+
+  // The used columns are forwarded through plugin requests.
+  PluginRequest request;
+  TablePlugin::setRequestFromContext(context, request);
+  QueryContext forwarded;
+  TablePlugin::setContextFromRequest(request, forwarded);
+  ASSERT_TRUE(forwarded.colsUsed.is_initialized());
+  EXPECT_EQ(*forwarded.colsUsed, UsedColumns({"path"}));
+
+  // An empty set of used columns is distinct from an unknown set.
+  context.colsUsed = UsedColumns();
+  request.clear();
+  TablePlugin::setRequestFromContext(context, request);
+  QueryContext empty;
+  TablePlugin::setContextFromRequest(request, empty);
+  ASSERT_TRUE(empty.colsUsed.is_initialized());
+  EXPECT_TRUE(empty.colsUsed->empty());
+  EXPECT_FALSE(empty.isColumnUsed("path"));
+}
+
 class TestTablePlugin : public TablePlugin {
  public:
   void testSetCache(size_t step, size_t interval) {
@@ -229,4 +229,50 @@ int platformGetPid() {
 int platformGetTid() {
   return static_cast<int>(GetCurrentThreadId());
 }
+
+size_t platformGetProcessCPUTime() {
+  FILETIME create_time, exit_time, kernel_time, user_time;
+  if (!GetProcessTimes(GetCurrentProcess(),
+                       &create_time,
+                       &exit_time,
+                       &kernel_time,
+                       &user_time)) {
+    return 0;
+  }
+
+  ULARGE_INTEGER kernel, user;
+  kernel.LowPart = kernel_time.dwLowDateTime;
+  kernel.HighPart = kernel_time.dwHighDateTime;
+  user.LowPart = user_time.dwLowDateTime;
+  user.HighPart = user_time.dwHighDateTime;
+  // Process times are in 100-nanosecond units.
+  return static_cast<size_t>((kernel.QuadPart + user.QuadPart) / 10);
+}
+
+void platformGetThreadCPUTime(size_t& user_time, size_t& system_time) {
+  user_time = 0;
+  system_time = 0;
+  FILETIME create_time, exit_time, kernel_time, thread_user_time;
+  if (!GetThreadTimes(GetCurrentThread(),
+                      &create_time,
+                      &exit_time,
+                      &kernel_time,
+                      &thread_user_time)) {
+    return;
+  }
+
+  ULARGE_INTEGER kernel, user;
+  kernel.LowPart = kernel_time.dwLowDateTime;
+  kernel.HighPart = kernel_time.dwHighDateTime;
+  user.LowPart = thread_user_time.dwLowDateTime;
+  user.HighPart = thread_user_time.dwHighDateTime;
+  // Thread times are in 100-nanosecond units.
+  user_time = static_cast<size_t>(user.QuadPart / 10);
+  system_time = static_cast<size_t>(kernel.QuadPart / 10);
+}
+
+size_t platformGetHeapAllocated() {
+  // The CRT heap has no allocation counter that avoids a heap walk.
+  return 0;
+}
 }
\ No newline at end of file
@@ -78,6 +78,220 @@ BENCHMARK(DATABASE_serialize_json)
     ->ArgPair(10, 10)
     ->ArgPair(10, 100);
 
+/// Example rows shaped like the processes (0) or file (1) tables.
+QueryData getExampleTableData(size_t table, size_t rows) {
+  QueryData qd;
+  qd.reserve(rows);
+  for (size_t i = 0; i < rows; i++) {
+    auto id = std::to_string(i);
+    if (table == 0) {
+      qd.push_back({{"pid", id},
+                    {"name", "process" + id},
+                    {"path", "/usr/local/bin/process" + id},
+                    {"cmdline", "/usr/local/bin/process" + id + " --flag"},
+                    {"state", "S"},
+                    {"cwd", "/"},
+                    {"root", "/"},
+                    {"uid", "0"},
+                    {"gid", "0"},
+                    {"euid", "0"},
+                    {"egid", "0"},
+                    {"on_disk", "1"},
+                    {"wired_size", "0"},
+                    {"resident_size", "4096" + id},
+                    {"phys_footprint", "8192" + id},
+                    {"user_time", "12" + id},
+                    {"system_time", "3" + id},
+                    {"start_time", "1480000000"},
+                    {"parent", "1"},
+                    {"pgroup", id},
+                    {"nice", "0"}});
+    } else {
+      qd.push_back({{"path", "/usr/share/doc/file" + id + ".txt"},
+                    {"directory", "/usr/share/doc"},
+                    {"filename", "file" + id + ".txt"},
+                    {"inode", "1048576" + id},
+                    {"uid", "0"},
+                    {"gid", "0"},
+                    {"mode", "0644"},
+                    {"device", "0"},
+                    {"size", id + "00"},
+                    {"block_size", "4096"},
+                    {"atime", "1480000000"},
+                    {"mtime", "1480000000"},
+                    {"ctime", "1480000000"},
+                    {"btime", "0"},
+                    {"hard_links", "1"},
+                    {"type", "regular"}});
+    }
+  }
+  return qd;
+}
+
+static void DATABASE_table_serialize_json(benchmark::State& state) {
+  auto qd = getExampleTableData(state.range_x(), state.range_y());
+  size_t bytes = 0;
+  while (state.KeepRunning()) {
+    std::string content;
+    serializeQueryDataJSON(qd, content);
+    bytes = content.size();
+  }
+  state.SetItemsProcessed(state.iterations() * qd.size());
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+
+BENCHMARK(DATABASE_table_serialize_json)->ArgPair(0, 10000)->ArgPair(1, 10000);
+
+static void DATABASE_table_serialize_binary(benchmark::State& state) {
+  auto qd = getExampleTableData(state.range_x(), state.range_y());
+  size_t bytes = 0;
+  while (state.KeepRunning()) {
+    std::string content;
+    serializeQueryDataBinary(qd, content);
+    bytes = content.size();
+  }
+  state.SetItemsProcessed(state.iterations() * qd.size());
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+
+BENCHMARK(DATABASE_table_serialize_binary)
+    ->ArgPair(0, 10000)
+    ->ArgPair(1, 10000);
+
+static void DATABASE_table_deserialize_json(benchmark::State& state) {
+  auto qd = getExampleTableData(state.range_x(), state.range_y());
+  std::string content;
+  serializeQueryDataJSON(qd, content);
+  while (state.KeepRunning()) {
+    QueryData output;
+    deserializeQueryDataJSON(content, output);
+  }
+  state.SetItemsProcessed(state.iterations() * qd.size());
+  state.SetBytesProcessed(state.iterations() * content.size());
+}
+
+BENCHMARK(DATABASE_table_deserialize_json)
+    ->ArgPair(0, 10000)
+    ->ArgPair(1, 10000);
+
+static void DATABASE_table_deserialize_binary(benchmark::State& state) {
+  auto qd = getExampleTableData(state.range_x(), state.range_y());
+  std::string content;
+  serializeQueryDataBinary(qd, content);
+  while (state.KeepRunning()) {
+    QueryData output;
+    deserializeQueryDataBinary(content, output);
+  }
+  state.SetItemsProcessed(state.iterations() * qd.size());
+  state.SetBytesProcessed(state.iterations() * content.size());
+}
+
+BENCHMARK(DATABASE_table_deserialize_binary)
+    ->ArgPair(0, 10000)
+    ->ArgPair(1, 10000);
+
+static void DATABASE_table_view_binary(benchmark::State& state) {
+  auto qd = getExampleTableData(state.range_x(), state.range_y());
+  std::string content;
+  serializeQueryDataBinary(qd, content);
+  while (state.KeepRunning()) {
+    QueryDataView view;
+    view.load(content);
+  }
+  state.SetItemsProcessed(state.iterations() * qd.size());
+  state.SetBytesProcessed(state.iterations() * content.size());
+}
+
+BENCHMARK(DATABASE_table_view_binary)->ArgPair(0, 10000)->ArgPair(1, 10000);
+
+static void DATABASE_table_build_rows(benchmark::State& state) {
+  auto qd = getExampleTableData(state.range_x(), state.range_y());
+  while (state.KeepRunning()) {
+    QueryData output;
+    for (const auto& r : qd) {
+      output.push_back(r);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * qd.size());
+}
+
+BENCHMARK(DATABASE_table_build_rows)->ArgPair(0, 10000)->ArgPair(1, 10000);
+
+static void DATABASE_table_build_compact(benchmark::State& state) {
+  auto qd = getExampleTableData(state.range_x(), state.range_y());
+  while (state.KeepRunning()) {
+    CompactQueryData output;
+    output.reserve(qd.size());
+    for (const auto& r : qd) {
+      output.addRow(r);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * qd.size());
+}
+
+BENCHMARK(DATABASE_table_build_compact)
+    ->ArgPair(0, 10000)
+    ->ArgPair(1, 10000);
+
+static QueryLogItem getExampleQueryLogItem(size_t x, size_t y) {
+  QueryLogItem item;
+  item.name = "benchmark";
+  item.identifier = "benchmark_host";
+  item.time = 1480000000;
+  item.calendar_time = "Thu Nov 24 15:06:40 2016 UTC";
+  item.results.added = getExampleQueryData(x, y);
+  item.results.removed = getExampleQueryData(x, y / 10);
+  item.decorations["host_uuid"] = "00000000-0000-0000-0000-000000000000";
+  return item;
+}
+
+static void DATABASE_log_item_json(benchmark::State& state) {
+  auto item = getExampleQueryLogItem(state.range_x(), state.range_y());
+  while (state.KeepRunning()) {
+    std::string json;
+    serializeQueryLogItemJSON(item, json);
+  }
+}
+
+BENCHMARK(DATABASE_log_item_json)->ArgPair(10, 100)->ArgPair(20, 10000);
+
+static void DATABASE_log_item_json_stream(benchmark::State& state) {
+  auto item = getExampleQueryLogItem(state.range_x(), state.range_y());
+  std::string json;
+  while (state.KeepRunning()) {
+    writeQueryLogItemJSON(item, json);
+  }
+}
+
+BENCHMARK(DATABASE_log_item_json_stream)->ArgPair(10, 100)->ArgPair(20, 10000);
+
+static void DATABASE_log_item_events_json(benchmark::State& state) {
+  auto item = getExampleQueryLogItem(state.range_x(), state.range_y());
+  while (state.KeepRunning()) {
+    std::vector<std::string> items;
+    serializeQueryLogItemAsEventsJSON(item, items);
+  }
+}
+
+BENCHMARK(DATABASE_log_item_events_json)->ArgPair(10, 100)->ArgPair(20, 10000);
+
+static void DATABASE_log_item_events_json_stream(benchmark::State& state) {
+  auto item = getExampleQueryLogItem(state.range_x(), state.range_y());
+  std::string json;
+  while (state.KeepRunning()) {
+    for (const auto& row : item.results.removed) {
+      writeQueryLogEventJSON(item, "removed", row, json);
+    }
+    for (const auto& row : item.results.added) {
+      writeQueryLogEventJSON(item, "added", row, json);
+    }
+  }
+}
+
+BENCHMARK(DATABASE_log_item_events_json_stream)
+    ->ArgPair(10, 100)
+    ->ArgPair(20, 10000);
+
 static void DATABASE_diff(benchmark::State& state) {
   auto qd = getExampleQueryData(state.range_x(), state.range_y());
   while (state.KeepRunning()) {
@@ -87,6 +301,59 @@ static void DATABASE_diff(benchmark::State& state) {
 
 BENCHMARK(DATABASE_diff)->ArgPair(1, 1)->ArgPair(10, 10)->ArgPair(10, 100);
 
+/// Change roughly 1% of the example table rows, the rest are unchanged.
+static QueryData getChangedTableData(const QueryData& qd) {
+  auto changed = qd;
+  for (size_t i = 0; i < changed.size(); i += 100) {
+    changed[i]["size"] = "changed";
+  }
+  return changed;
+}
+
+static void DATABASE_diff_rows(benchmark::State& state) {
+  auto qd = getExampleTableData(1, state.range_x());
+  auto changed = getChangedTableData(qd);
+  while (state.KeepRunning()) {
+    auto d = diff(qd, changed);
+  }
+  state.SetItemsProcessed(state.iterations() * qd.size());
+}
+
+BENCHMARK(DATABASE_diff_rows)->Arg(1000)->Arg(10000)->Arg(100000);
+
+static void DATABASE_diff_stored(benchmark::State& state) {
+  auto qd = getExampleTableData(1, state.range_x());
+  auto changed = getChangedTableData(qd);
+  std::string previous;
+  serializeQueryDataIndexed(qd, previous);
+  while (state.KeepRunning()) {
+    DiffResults dr;
+    diffStoredResults(previous, changed, dr, state.range_y() != 0);
+  }
+  state.SetItemsProcessed(state.iterations() * qd.size());
+}
+
+BENCHMARK(DATABASE_diff_stored)
+    ->ArgPair(1000, 0)
+    ->ArgPair(10000, 0)
+    ->ArgPair(100000, 0)
+    ->ArgPair(100000, 1);
+
+static void DATABASE_diff_stored_json(benchmark::State& state) {
+  auto qd = getExampleTableData(1, state.range_x());
+  auto changed = getChangedTableData(qd);
+  std::string previous;
+  serializeQueryDataJSON(qd, previous);
+  while (state.KeepRunning()) {
+    QueryData previous_qd;
+    deserializeQueryDataJSON(previous, previous_qd);
+    auto d = diff(previous_qd, changed);
+  }
+  state.SetItemsProcessed(state.iterations() * qd.size());
+}
+
+BENCHMARK(DATABASE_diff_stored_json)->Arg(1000)->Arg(10000)->Arg(100000);
+
 static void DATABASE_query_results(benchmark::State& state) {
   auto qd = getExampleQueryData(state.range_x(), state.range_y());
   auto query = getOsqueryScheduledQuery();
@@ -102,6 +369,67 @@ BENCHMARK(DATABASE_query_results)
     ->ArgPair(10, 10)
     ->ArgPair(10, 100);
 
+/// Store results and metadata for a pack of x scheduled queries.
+static void fillQueryPack(size_t x) {
+  auto qd = getExampleQueryData(10, 10);
+  auto query = getOsqueryScheduledQuery();
+  for (size_t i = 0; i < x; i++) {
+    Query("pack_benchmark_" + std::to_string(i), query).addNewResults(qd);
+  }
+}
+
+static void clearQueryPack(size_t x) {
+  for (size_t i = 0; i < x; i++) {
+    auto name = "pack_benchmark_" + std::to_string(i);
+    deleteDatabaseValue(kQueries, name);
+    deleteDatabaseValue(kQueries, kQueryMetadataPrefix + name);
+  }
+}
+
+static void DATABASE_query_metadata(benchmark::State& state) {
+  fillQueryPack(state.range_x());
+  auto query = getOsqueryScheduledQuery();
+  auto dbq = Query("pack_benchmark_" + std::to_string(state.range_x() / 2),
+                   query);
+  while (state.KeepRunning()) {
+    QueryMetadata metadata;
+    dbq.getQueryMetadata(metadata);
+  }
+  clearQueryPack(state.range_x());
+}
+
+BENCHMARK(DATABASE_query_metadata)->Arg(100)->Arg(1000)->Arg(5000);
+
+static void DATABASE_query_names_scan(benchmark::State& state) {
+  // The previous existence check scanned every stored query name.
+  fillQueryPack(state.range_x());
+  auto name = "pack_benchmark_" + std::to_string(state.range_x() / 2);
+  while (state.KeepRunning()) {
+    auto names = Query::getStoredQueryNames();
+    auto found = std::find(names.begin(), names.end(), name);
+  }
+  clearQueryPack(state.range_x());
+}
+
+BENCHMARK(DATABASE_query_names_scan)->Arg(100)->Arg(1000)->Arg(5000);
+
+static void DATABASE_query_pack_results(benchmark::State& state) {
+  // Add unchanged results for every query in the pack, once per iteration.
+  fillQueryPack(state.range_x());
+  auto qd = getExampleQueryData(10, 10);
+  auto query = getOsqueryScheduledQuery();
+  while (state.KeepRunning()) {
+    for (size_t i = 0; i < static_cast<size_t>(state.range_x()); i++) {
+      DiffResults dr;
+      Query("pack_benchmark_" + std::to_string(i), query).addNewResults(qd, dr);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range_x());
+  clearQueryPack(state.range_x());
+}
+
+BENCHMARK(DATABASE_query_pack_results)->Arg(100)->Arg(1000);
+
 static void DATABASE_get(benchmark::State& state) {
   setDatabaseValue(kPersistentSettings, "benchmark", "1");
   while (state.KeepRunning()) {
@@ -159,4 +487,81 @@ static void DATABASE_store_append(benchmark::State& state) {
 }
 
 BENCHMARK(DATABASE_store_append);
+
+static void fillScanKeys(const std::string& prefix, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    setDatabaseValue(kEvents, prefix + std::to_string(i), "value");
+  }
+}
+
+static void clearScanKeys(const std::string& prefix, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    deleteDatabaseValue(kEvents, prefix + std::to_string(i));
+  }
+}
+
+static void DATABASE_scan_prefix(benchmark::State& state) {
+  // Surround the matching namespace with x non-matching keys on each side.
+  fillScanKeys("data.bench.a.", state.range_x());
+  fillScanKeys("data.bench.scan.", state.range_y());
+  fillScanKeys("data.bench.z.", state.range_x());
+
+  while (state.KeepRunning()) {
+    std::vector<std::string> keys;
+    scanDatabaseKeys(kEvents, keys, "data.bench.scan.");
+  }
+
+  clearScanKeys("data.bench.a.", state.range_x());
+  clearScanKeys("data.bench.scan.", state.range_y());
+  clearScanKeys("data.bench.z.", state.range_x());
+}
+
+BENCHMARK(DATABASE_scan_prefix)
+    ->ArgPair(100, 10)
+    ->ArgPair(10000, 10)
+    ->ArgPair(100000, 10)
+    ->ArgPair(10000, 1000);
+
+static void DATABASE_scan_values(benchmark::State& state) {
+  fillScanKeys("data.bench.a.", state.range_x());
+  fillScanKeys("data.bench.scan.", state.range_y());
+  fillScanKeys("data.bench.z.", state.range_x());
+
+  while (state.KeepRunning()) {
+    DatabaseKeyValues values;
+    scanDatabaseValues(kEvents, values, "data.bench.scan.");
+  }
+
+  clearScanKeys("data.bench.a.", state.range_x());
+  clearScanKeys("data.bench.scan.", state.range_y());
+  clearScanKeys("data.bench.z.", state.range_x());
+}
+
+BENCHMARK(DATABASE_scan_values)
+    ->ArgPair(100, 10)
+    ->ArgPair(10000, 10)
+    ->ArgPair(100000, 10)
+    ->ArgPair(10000, 1000);
+
+static void DATABASE_scan_then_get(benchmark::State& state) {
+  // The previous access pattern: scan keys then get each value.
+  fillScanKeys("data.bench.a.", state.range_x());
+  fillScanKeys("data.bench.scan.", state.range_y());
+  fillScanKeys("data.bench.z.", state.range_x());
+
+  while (state.KeepRunning()) {
+    std::vector<std::string> keys;
+    scanDatabaseKeys(kEvents, keys, "data.bench.scan.");
+    for (const auto& key : keys) {
+      std::string value;
+      getDatabaseValue(kEvents, key, value);
+    }
+  }
+
+  clearScanKeys("data.bench.a.", state.range_x());
+  clearScanKeys("data.bench.scan.", state.range_y());
+  clearScanKeys("data.bench.z.", state.range_x());
+}
+
+BENCHMARK(DATABASE_scan_then_get)->ArgPair(10000, 10)->ArgPair(10000, 1000);
 }
@@ -8,6 +8,8 @@
  *
  */
 
+#include <algorithm>
+#include <limits>
 #include <set>
 
 #include <boost/lexical_cast.hpp>
@@ -192,6 +194,580 @@ Status deserializeQueryDataJSON(const std::string& json, QueryData& qd) {
   return deserializeQueryData(tree, qd);
 }
 
+/// The FNV-1a 64-bit offset basis, the initial fingerprint value.
+const uint64_t kFingerprintBasis = 14695981039346656037ULL;
+
+/// Mix a field into an FNV-1a fingerprint, followed by the field's length.
+static inline void mixFingerprint(uint64_t& hash, const std::string& field) {
+  const uint64_t kPrime = 1099511628211ULL;
+  for (const auto& c : field) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * kPrime;
+  }
+  hash = (hash ^ field.size()) * kPrime;
+}
+
+uint64_t getFingerprint(const std::string& content) {
+  auto hash = kFingerprintBasis;
+  mixFingerprint(hash, content);
+  return hash;
+}
+
+uint64_t getRowFingerprint(const Row& r) {
+  // Each field is followed by its length so that adjacent column names and
+  // values cannot be confused.
+  auto hash = kFingerprintBasis;
+  for (const auto& column : r) {
+    mixFingerprint(hash, column.first);
+    mixFingerprint(hash, column.second);
+  }
+  return hash;
+}
+
+uint64_t getQueryDataFingerprint(const QueryData& q) {
+  // The sum of row fingerprints does not depend on the order of rows.
+  uint64_t hash = 0;
+  for (const auto& r : q) {
+    hash += getRowFingerprint(r);
+  }
+  return hash;
+}
+
+/// A row fingerprint and the row's position within its result set.
+using RowFingerprint = std::pair<uint64_t, size_t>;
+
+/// Fingerprint a set of rows, sorted by fingerprint then position.
+static std::vector<RowFingerprint> getFingerprints(const Row* rows,
+                                                   size_t count) {
+  std::vector<RowFingerprint> fingerprints;
+  fingerprints.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    fingerprints.emplace_back(getRowFingerprint(rows[i]), i);
+  }
+  std::sort(fingerprints.begin(), fingerprints.end());
+  return fingerprints;
+}
+
+/// The first byte of binary results, a JSON document never begins with NUL.
+const char kBinaryResultsMagic = '\0';
+
+/// The binary results encoding version, the second byte of the content.
+const char kBinaryResultsVersion = 1;
+
+/// The indexed encoding adds a sorted row fingerprint table before the rows.
+const char kBinaryResultsIndexedVersion = 2;
+
+/// Each fingerprint table entry is a 64-bit fingerprint and 32-bit offset.
+const size_t kFingerprintEntrySize = 12;
+
+/// The parsed header of binary-encoded results.
+struct BinaryResultsHeader {
+  /// Column names referencing the content.
+  std::vector<boost::string_ref> columns;
+
+  /// The number of rows.
+  size_t rows{0};
+
+  /// The fingerprint table, empty unless the content is indexed.
+  boost::string_ref index;
+
+  /// The offset of the first row, fingerprint offsets are relative to this.
+  size_t pos{0};
+};
+
+static inline void putVarint(std::string& out, size_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+static inline bool getVarint(const std::string& in,
+                             size_t& pos,
+                             size_t& value) {
+  value = 0;
+  for (size_t shift = 0; pos < in.size() && shift < 64; shift += 7) {
+    auto byte = static_cast<unsigned char>(in[pos++]);
+    value |= static_cast<size_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Write a little-endian fixed-width integer at an offset of the output.
+static inline void putFixed(std::string& out,
+                            size_t pos,
+                            uint64_t value,
+                            size_t bytes) {
+  for (size_t i = 0; i < bytes; ++i) {
+    out[pos + i] = static_cast<char>(value & 0xFF);
+    value >>= 8;
+  }
+}
+
+static inline uint64_t getFixed(const char* data, size_t bytes) {
+  uint64_t value = 0;
+  for (size_t i = bytes; i > 0; --i) {
+    value = (value << 8) | static_cast<unsigned char>(data[i - 1]);
+  }
+  return value;
+}
+
+static inline bool getBytes(const std::string& in,
+                            size_t& pos,
+                            size_t length,
+                            boost::string_ref& bytes) {
+  if (length > in.size() - pos) {
+    return false;
+  }
+  bytes = boost::string_ref(in.data() + pos, length);
+  pos += length;
+  return true;
+}
+
+/// Parse the binary results header, column names, and fingerprint table.
+static Status getBinaryHeader(const std::string& bin,
+                              BinaryResultsHeader& header) {
+  if (!isBinaryEncoded(bin)) {
+    return Status(1, "Content is not binary encoded");
+  }
+
+  auto version = bin[1];
+  if (version != kBinaryResultsVersion &&
+      version != kBinaryResultsIndexedVersion) {
+    return Status(1, "Unsupported binary results version");
+  }
+
+  size_t pos = 2;
+  size_t count = 0;
+  if (!getVarint(bin, pos, count) || count > bin.size()) {
+    return Status(1, "Invalid binary results column count");
+  }
+
+  header.columns.resize(count);
+  for (auto& column : header.columns) {
+    size_t length = 0;
+    if (!getVarint(bin, pos, length) || !getBytes(bin, pos, length, column)) {
+      return Status(1, "Invalid binary results column name");
+    }
+  }
+
+  if (!getVarint(bin, pos, header.rows)) {
+    return Status(1, "Invalid binary results row count");
+  }
+
+  if (version == kBinaryResultsIndexedVersion) {
+    if (header.rows > (bin.size() - pos) / kFingerprintEntrySize) {
+      return Status(1, "Invalid binary results fingerprint table");
+    }
+    auto length = header.rows * kFingerprintEntrySize;
+    header.index = boost::string_ref(bin.data() + pos, length);
+    pos += length;
+  }
+  header.pos = pos;
+  return Status(0, "OK");
+}
+
+/// Read a single value, an 'absent' value has a NULL data pointer.
+static inline bool getBinaryValue(const std::string& bin,
+                                  size_t& pos,
+                                  boost::string_ref& value) {
+  size_t length = 0;
+  if (!getVarint(bin, pos, length)) {
+    return false;
+  }
+
+  if (length == 0) {
+    value = boost::string_ref();
+    return true;
+  }
+  return getBytes(bin, pos, length - 1, value);
+}
+
+/**
+ * @brief Decode the binary-encoded row starting at pos.
+ *
+ * The row's map is built in column order so every insert is a hinted append.
+ */
+static bool decodeBinaryRow(const std::string& bin,
+                            const ColumnNames& columns,
+                            size_t& pos,
+                            Row& r) {
+  boost::string_ref value;
+  for (const auto& column : columns) {
+    if (!getBinaryValue(bin, pos, value)) {
+      return false;
+    }
+
+    if (value.data() != nullptr) {
+      r.emplace_hint(r.end(), column, value.to_string());
+    }
+  }
+  return true;
+}
+
+/// Copy the column names from a binary results header.
+static ColumnNames getBinaryColumns(const BinaryResultsHeader& header) {
+  ColumnNames columns;
+  columns.reserve(header.columns.size());
+  for (const auto& column : header.columns) {
+    columns.push_back(column.to_string());
+  }
+  return columns;
+}
+
+/// Decode each binary-encoded row and pass it to a handler.
+template <typename Handler>
+static Status decodeBinaryRows(const std::string& bin, Handler handler) {
+  BinaryResultsHeader header;
+  auto status = getBinaryHeader(bin, header);
+  if (!status.ok()) {
+    return status;
+  }
+
+  auto columns = getBinaryColumns(header);
+  auto pos = header.pos;
+  for (size_t i = 0; i < header.rows; ++i) {
+    Row r;
+    if (!decodeBinaryRow(bin, columns, pos, r)) {
+      return Status(1, "Invalid binary results value");
+    }
+    handler(std::move(r));
+  }
+  return Status(0, "OK");
+}
+
+/**
+ * @brief Write binary results given the sorted column names.
+ *
+ * The row writer appends the values of a row, one per name, and the
+ * fingerprint callback returns a row's fingerprint for the indexed encoding.
+ */
+template <typename Names, typename RowWriter, typename RowFingerprinter>
+static Status encodeBinaryResults(const Names& names,
+                                  size_t count,
+                                  bool indexed,
+                                  std::string& bin,
+                                  RowWriter write_row,
+                                  RowFingerprinter fingerprint) {
+  bin.clear();
+  bin.push_back(kBinaryResultsMagic);
+  bin.push_back((indexed) ? kBinaryResultsIndexedVersion
+                          : kBinaryResultsVersion);
+  putVarint(bin, names.size());
+  for (const auto& name : names) {
+    putVarint(bin, name.size());
+    bin.append(name);
+  }
+
+  putVarint(bin, count);
+  // The fingerprint table is filled in after the row offsets are known.
+  auto index_pos = bin.size();
+  if (indexed) {
+    bin.append(count * kFingerprintEntrySize, '\0');
+  }
+
+  auto rows_pos = bin.size();
+  std::vector<size_t> offsets;
+  offsets.reserve((indexed) ? count : 0);
+  for (size_t i = 0; i < count; ++i) {
+    if (indexed) {
+      offsets.push_back(bin.size() - rows_pos);
+    }
+    write_row(i, bin);
+  }
+
+  if (indexed) {
+    if (bin.size() - rows_pos > std::numeric_limits<uint32_t>::max()) {
+      return Status(1, "Results are too large to index");
+    }
+
+    std::vector<RowFingerprint> fingerprints;
+    fingerprints.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+      fingerprints.emplace_back(fingerprint(i), i);
+    }
+    std::sort(fingerprints.begin(), fingerprints.end());
+    for (const auto& entry : fingerprints) {
+      putFixed(bin, index_pos, entry.first, 8);
+      putFixed(bin, index_pos + 8, offsets[entry.second], 4);
+      index_pos += kFingerprintEntrySize;
+    }
+  }
+  return Status(0, "OK");
+}
+
+/// Write the binary results for a contiguous set of rows.
+static Status encodeBinaryRows(const Row* rows,
+                               size_t count,
+                               bool indexed,
+                               std::string& bin) {
+  // Collect the sorted union of column names, most result sets use the same
+  // columns for every row so only compare keys with the last distinct row.
+  std::set<std::string> names;
+  const Row* last = nullptr;
+  for (size_t i = 0; i < count; ++i) {
+    const auto& r = rows[i];
+    if (last != nullptr && last->size() == r.size() &&
+        std::equal(r.begin(),
+                   r.end(),
+                   last->begin(),
+                   [](const Row::value_type& a, const Row::value_type& b) {
+                     return a.first == b.first;
+                   })) {
+      continue;
+    }
+
+    for (const auto& column : r) {
+      names.insert(names.end(), column.first);
+    }
+    last = &r;
+  }
+
+  return encodeBinaryResults(
+      names,
+      count,
+      indexed,
+      bin,
+      [rows, &names](size_t i, std::string& out) {
+        // Both the names and the row are sorted, walk them together.
+        auto it = rows[i].begin();
+        for (const auto& name : names) {
+          if (it != rows[i].end() && it->first == name) {
+            putVarint(out, it->second.size() + 1);
+            out.append(it->second);
+            ++it;
+          } else {
+            putVarint(out, 0);
+          }
+        }
+      },
+      [rows](size_t i) { return getRowFingerprint(rows[i]); });
+}
+
+bool isBinaryEncoded(const std::string& content) {
+  return content.size() >= 2 && content[0] == kBinaryResultsMagic;
+}
+
+Status serializeRowBinary(const Row& r, std::string& bin) {
+  return encodeBinaryRows(&r, 1, false, bin);
+}
+
+Status deserializeRowBinary(const std::string& bin, Row& r) {
+  if (!isBinaryEncoded(bin)) {
+    return deserializeRowJSON(bin, r);
+  }
+
+  return decodeBinaryRows(bin, [&r](Row&& row) { r = std::move(row); });
+}
+
+Status serializeQueryDataBinary(const QueryData& q, std::string& bin) {
+  return encodeBinaryRows(q.data(), q.size(), false, bin);
+}
+
+Status serializeQueryDataIndexed(const QueryData& q, std::string& bin) {
+  return encodeBinaryRows(q.data(), q.size(), true, bin);
+}
+
+Status deserializeQueryDataBinary(const std::string& bin, QueryData& qd) {
+  if (!isBinaryEncoded(bin)) {
+    return deserializeQueryDataJSON(bin, qd);
+  }
+
+  return decodeBinaryRows(
+      bin, [&qd](Row&& row) { qd.push_back(std::move(row)); });
+}
+
+Status QueryDataView::load(const std::string& bin) {
+  columns_.clear();
+  values_.clear();
+  present_.clear();
+  rows_ = 0;
+
+  BinaryResultsHeader header;
+  auto status = getBinaryHeader(bin, header);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // Each value is at least one byte, do not trust the row count for reserve.
+  columns_ = std::move(header.columns);
+  auto pos = header.pos;
+  auto cells = header.rows * columns_.size();
+  if (!columns_.empty() && cells / columns_.size() != header.rows) {
+    return Status(1, "Invalid binary results row count");
+  }
+  values_.reserve(std::min(cells, bin.size() - pos));
+  present_.reserve(std::min(cells, bin.size() - pos));
+
+  boost::string_ref value;
+  for (size_t i = 0; i < cells; ++i) {
+    if (!getBinaryValue(bin, pos, value)) {
+      values_.clear();
+      present_.clear();
+      return Status(1, "Invalid binary results value");
+    }
+    present_.push_back(value.data() != nullptr);
+    values_.push_back(value);
+  }
+  rows_ = header.rows;
+  return Status(0, "OK");
+}
+
+Row QueryDataView::getRow(size_t row) const {
+  Row r;
+  for (size_t i = 0; i < columns_.size(); ++i) {
+    if (has(row, i)) {
+      r.emplace_hint(r.end(), columns_[i].to_string(), get(row, i).to_string());
+    }
+  }
+  return r;
+}
+
+CompactQueryData::CompactQueryData(const std::vector<std::string>& columns) {
+  for (const auto& name : columns) {
+    addColumn(name);
+  }
+}
+
+size_t CompactQueryData::getColumnIndex(const std::string& name) const {
+  auto it = index_.find(name);
+  return (it == index_.end()) ? columns_.size() : it->second;
+}
+
+size_t CompactQueryData::addColumn(const std::string& name) {
+  auto it = index_.find(name);
+  if (it != index_.end()) {
+    return it->second;
+  }
+
+  auto col = columns_.size();
+  if (rows_ > 0) {
+    // Widen each existing row, the new column is absent from all of them.
+    auto width = col + 1;
+    std::vector<std::string> values(rows_ * width);
+    std::vector<CellNumber> numbers(rows_ * width);
+    std::vector<CellType> types(rows_ * width, CellType::NONE);
+    for (size_t row = 0; row < rows_; ++row) {
+      for (size_t i = 0; i < col; ++i) {
+        values[row * width + i] = std::move(values_[row * col + i]);
+        numbers[row * width + i] = numbers_[row * col + i];
+        types[row * width + i] = types_[row * col + i];
+      }
+    }
+    values_ = std::move(values);
+    numbers_ = std::move(numbers);
+    types_ = std::move(types);
+  }
+
+  columns_.push_back(name);
+  index_[name] = col;
+  auto pos = std::lower_bound(sorted_.begin(),
+                              sorted_.end(),
+                              name,
+                              [this](size_t i, const std::string& n) {
+                                return columns_[i] < n;
+                              });
+  sorted_.insert(pos, col);
+  return col;
+}
+
+const std::string& CompactQueryData::get(size_t row, size_t col) const {
+  static const std::string kEmpty;
+  auto cell = type(row, col);
+  if (cell == CellType::NONE) {
+    return kEmpty;
+  }
+
+  auto& value = values_[row * columns_.size() + col];
+  if (value.empty() && cell == CellType::INTEGER) {
+    value = std::to_string(getInteger(row, col));
+  } else if (value.empty() && cell == CellType::DOUBLE) {
+    value = boost::lexical_cast<std::string>(getDouble(row, col));
+  }
+  return value;
+}
+
+size_t CompactQueryData::addRow() {
+  auto size = values_.size() + columns_.size();
+  values_.resize(size);
+  numbers_.resize(size);
+  types_.resize(size, CellType::NONE);
+  return rows_++;
+}
+
+void CompactQueryData::addRow(Row&& r) {
+  // New columns widen the existing rows, add them before appending.
+  for (const auto& column : r) {
+    if (index_.count(column.first) == 0) {
+      addColumn(column.first);
+    }
+  }
+
+  auto row = addRow();
+  for (auto& column : r) {
+    setText(row, index_.at(column.first), std::move(column.second));
+  }
+}
+
+void CompactQueryData::addRow(const Row& r) {
+  addRow(Row(r));
+}
+
+void CompactQueryData::setText(size_t row, size_t col, std::string value) {
+  auto cell = row * columns_.size() + col;
+  values_[cell] = std::move(value);
+  types_[cell] = CellType::TEXT;
+}
+
+void CompactQueryData::setInteger(size_t row, size_t col, long long value) {
+  auto cell = row * columns_.size() + col;
+  values_[cell].clear();
+  numbers_[cell].integer = value;
+  types_[cell] = CellType::INTEGER;
+}
+
+void CompactQueryData::setDouble(size_t row, size_t col, double value) {
+  auto cell = row * columns_.size() + col;
+  values_[cell].clear();
+  numbers_[cell].real = value;
+  types_[cell] = CellType::DOUBLE;
+}
+
+Row CompactQueryData::getRow(size_t row) const {
+  Row r;
+  for (const auto& col : sorted_) {
+    if (has(row, col)) {
+      r.emplace_hint(r.end(), columns_[col], get(row, col));
+    }
+  }
+  return r;
+}
+
+QueryData CompactQueryData::getQueryData() const {
+  QueryData results;
+  results.reserve(rows_);
+  for (size_t row = 0; row < rows_; ++row) {
+    results.push_back(getRow(row));
+  }
+  return results;
+}
+
+void CompactQueryData::clear() {
+  values_.clear();
+  numbers_.clear();
+  types_.clear();
+  rows_ = 0;
+}
+
+void CompactQueryData::reserve(size_t rows) {
+  values_.reserve(rows * columns_.size());
+  numbers_.reserve(rows * columns_.size());
+  types_.reserve(rows * columns_.size());
+}
+
 Status serializeDiffResults(const DiffResults& d, pt::ptree& tree) {
   // Serialize and add "removed" first.
   // A property tree is somewhat ordered, this provides a loose contract to
@@ -248,29 +824,200 @@ Status serializeDiffResultsJSON(const DiffResults& d, std::string& json) {
   return Status(0, "OK");
 }
 
+/**
+ * @brief Merge fingerprint-sorted previous and current results.
+ *
+ * A current row is added when no previous row matches it. Each previous row
+ * is matched at most once, the unmatched rows are removed in fingerprint
+ * order. Only rows with equal fingerprints are passed to the match predicate.
+ */
+template <typename Match>
+static void mergeFingerprints(const std::vector<RowFingerprint>& previous,
+                              const std::vector<RowFingerprint>& current,
+                              Match match,
+                              std::vector<size_t>& removed,
+                              std::vector<bool>& added) {
+  std::vector<bool> matched;
+  size_t i = 0;
+  size_t j = 0;
+  while (i < previous.size() || j < current.size()) {
+    if (j == current.size() ||
+        (i < previous.size() && previous[i].first < current[j].first)) {
+      removed.push_back(previous[i++].second);
+      continue;
+    }
+
+    if (i == previous.size() || current[j].first < previous[i].first) {
+      added[current[j++].second] = true;
+      continue;
+    }
+
+    // Find the runs of equal fingerprints, usually a single row each.
+    auto fingerprint = previous[i].first;
+    auto first = i;
+    auto first_current = j;
+    while (i < previous.size() && previous[i].first == fingerprint) {
+      i++;
+    }
+    while (j < current.size() && current[j].first == fingerprint) {
+      j++;
+    }
+
+    // Previous rows before 'unmatched' are all matched, this keeps runs of
+    // duplicate rows linear.
+    matched.assign(i - first, false);
+    auto unmatched = first;
+    for (auto c = first_current; c < j; c++) {
+      auto row = current[c].second;
+      bool equal = false;
+      for (auto p = unmatched; p < i && !equal; p++) {
+        if (!matched[p - first] && match(previous[p].second, row)) {
+          matched[p - first] = true;
+          equal = true;
+        }
+      }
+
+      while (unmatched < i && matched[unmatched - first]) {
+        unmatched++;
+      }
+
+      // A row equal to an already-matched previous row is not added.
+      for (auto p = first; p < i && !equal; p++) {
+        equal = matched[p - first] && match(previous[p].second, row);
+      }
+
+      if (!equal) {
+        added[row] = true;
+      }
+    }
+
+    for (auto p = first; p < i; p++) {
+      if (!matched[p - first]) {
+        removed.push_back(previous[p].second);
+      }
+    }
+  }
+}
+
 DiffResults diff(const QueryData& old, const QueryData& current) {
   DiffResults r;
-  QueryData overlap;
-
-  for (const auto& i : current) {
-    auto item = std::find(old.begin(), old.end(), i);
-    if (item != old.end()) {
-      overlap.push_back(i);
-    } else {
-      r.added.push_back(i);
+  auto previous = getFingerprints(old.data(), old.size());
+  auto fingerprints = getFingerprints(current.data(), current.size());
+
+  // Both result sets are available, always compare rows to avoid collisions.
+  std::vector<size_t> removed;
+  std::vector<bool> added(current.size(), false);
+  mergeFingerprints(previous,
+                    fingerprints,
+                    [&old, &current](size_t p, size_t c) {
+                      return old[p] == current[c];
+                    },
+                    removed,
+                    added);
+
+  for (size_t i = 0; i < current.size(); i++) {
+    if (added[i]) {
+      r.added.push_back(current[i]);
     }
   }
 
-  std::multiset<Row> overlap_set(overlap.begin(), overlap.end());
-  std::multiset<Row> old_set(old.begin(), old.end());
-  std::set_difference(old_set.begin(),
-                      old_set.end(),
-                      overlap_set.begin(),
-                      overlap_set.end(),
-                      std::back_inserter(r.removed));
+  r.removed.reserve(removed.size());
+  for (const auto& p : removed) {
+    r.removed.push_back(old[p]);
+  }
   return r;
 }
 
+/// Compare a binary-encoded row at pos with a Row, without decoding it.
+static bool isBinaryRowEqual(const std::string& bin,
+                             const std::vector<boost::string_ref>& columns,
+                             size_t pos,
+                             const Row& r) {
+  auto it = r.begin();
+  boost::string_ref value;
+  for (const auto& column : columns) {
+    if (!getBinaryValue(bin, pos, value)) {
+      return false;
+    }
+
+    if (value.data() == nullptr) {
+      continue;
+    }
+
+    if (it == r.end() || column != it->first || value != it->second) {
+      return false;
+    }
+    ++it;
+  }
+  return it == r.end();
+}
+
+Status diffStoredResults(const std::string& previous,
+                         const QueryData& current,
+                         DiffResults& dr,
+                         bool verify) {
+  if (!isBinaryEncoded(previous) ||
+      previous[1] != kBinaryResultsIndexedVersion) {
+    // Legacy or non-indexed results are decoded and compared in full.
+    QueryData previous_qd;
+    auto status = deserializeQueryDataBinary(previous, previous_qd);
+    if (!status.ok()) {
+      return status;
+    }
+    dr = diff(previous_qd, current);
+    return Status(0, "OK");
+  }
+
+  BinaryResultsHeader header;
+  auto status = getBinaryHeader(previous, header);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // The stored fingerprint table is already sorted, previous rows are
+  // referenced by their offset.
+  std::vector<RowFingerprint> fingerprints;
+  fingerprints.reserve(header.rows);
+  for (size_t i = 0; i < header.rows; i++) {
+    auto entry = header.index.data() + i * kFingerprintEntrySize;
+    fingerprints.emplace_back(getFixed(entry, 8),
+                              header.pos + getFixed(entry + 8, 4));
+  }
+
+  std::vector<size_t> removed;
+  std::vector<bool> added(current.size(), false);
+  mergeFingerprints(fingerprints,
+                    getFingerprints(current.data(), current.size()),
+                    [&](size_t offset, size_t c) {
+                      return !verify || isBinaryRowEqual(previous,
+                                                         header.columns,
+                                                         offset,
+                                                         current[c]);
+                    },
+                    removed,
+                    added);
+
+  dr.added.clear();
+  for (size_t i = 0; i < current.size(); i++) {
+    if (added[i]) {
+      dr.added.push_back(current[i]);
+    }
+  }
+
+  // Only the removed rows are decoded from the previous results.
+  dr.removed.clear();
+  dr.removed.reserve(removed.size());
+  auto columns = getBinaryColumns(header);
+  for (auto offset : removed) {
+    Row r;
+    if (!decodeBinaryRow(previous, columns, offset, r)) {
+      return Status(1, "Invalid binary results value");
+    }
+    dr.removed.push_back(std::move(r));
+  }
+  return Status(0, "OK");
+}
+
 inline void addLegacyFieldsAndDecorations(const QueryLogItem& item,
                                           pt::ptree& tree) {
   // Apply legacy fields.
@@ -434,6 +1181,215 @@ Status serializeQueryLogItemAsEventsJSON(const QueryLogItem& i,
   return Status(0, "OK");
 }
 
+/// Characters written without escapes by the property tree JSON writer.
+static inline bool isJSONSafe(unsigned char c) {
+  return c >= 0x20 && c != '"' && c != '/' && c != '\\';
+}
+
+/// Append a quoted JSON string, escaped like the property tree JSON writer.
+static void writeJSONString(const std::string& s, std::string& out) {
+  out.push_back('"');
+  size_t run = 0;
+  for (size_t i = 0; i < s.size(); ++i) {
+    auto c = static_cast<unsigned char>(s[i]);
+    if (isJSONSafe(c)) {
+      continue;
+    }
+
+    // Copy the run of unescaped characters at once.
+    out.append(s, run, i - run);
+    run = i + 1;
+    switch (c) {
+    case '\b':
+      out.append("\\b");
+      break;
+    case '\f':
+      out.append("\\f");
+      break;
+    case '\n':
+      out.append("\\n");
+      break;
+    case '\r':
+      out.append("\\r");
+      break;
+    case '\t':
+      out.append("\\t");
+      break;
+    case '/':
+    case '"':
+    case '\\':
+      out.push_back('\\');
+      out.push_back(static_cast<char>(c));
+      break;
+    default:
+      const char* hex = "0123456789ABCDEF";
+      out.append("\\u00");
+      out.push_back(hex[c >> 4]);
+      out.push_back(hex[c & 0x0F]);
+      break;
+    }
+  }
+  out.append(s, run, std::string::npos);
+  out.push_back('"');
+}
+
+/// Append a "key":"value" pair.
+static inline void writeJSONField(const std::string& key,
+                                  const std::string& value,
+                                  std::string& out) {
+  writeJSONString(key, out);
+  out.push_back(':');
+  writeJSONString(value, out);
+}
+
+/// Append a row as an object, an empty row is written as an empty string.
+static void writeJSONRow(const Row& r, std::string& out) {
+  if (r.empty()) {
+    out.append("\"\"");
+    return;
+  }
+
+  out.push_back('{');
+  for (const auto& column : r) {
+    writeJSONField(column.first, column.second, out);
+    out.push_back(',');
+  }
+  out.back() = '}';
+}
+
+/// Append rows as an array, no rows are written as an empty string.
+static void writeJSONRows(const QueryData& q, std::string& out) {
+  if (q.empty()) {
+    out.append("\"\"");
+    return;
+  }
+
+  out.push_back('[');
+  for (const auto& r : q) {
+    writeJSONRow(r, out);
+    out.push_back(',');
+  }
+  out.back() = ']';
+}
+
+/// Append a top-level field, a top-level decoration replaces the value.
+static void writeJSONLogField(const QueryLogItem& item,
+                              const std::string& key,
+                              const std::string& value,
+                              std::string& out) {
+  if (FLAGS_decorations_top_level) {
+    auto decoration = item.decorations.find(key);
+    if (decoration != item.decorations.end()) {
+      writeJSONField(key, decoration->second, out);
+      return;
+    }
+  }
+  writeJSONField(key, value, out);
+}
+
+/// Append the legacy fields, each is followed by a ','.
+static void writeJSONLegacyFields(const QueryLogItem& item, std::string& out) {
+  writeJSONLogField(item, "name", item.name, out);
+  out.push_back(',');
+  writeJSONLogField(item, "hostIdentifier", item.identifier, out);
+  out.push_back(',');
+  writeJSONLogField(item, "calendarTime", item.calendar_time, out);
+  out.push_back(',');
+  writeJSONLogField(item, "unixTime", std::to_string(item.time), out);
+  out.push_back(',');
+}
+
+/**
+ * @brief Append the decorations, each is followed by a ','.
+ *
+ * Top-level decorations using a reserved key were already written in place
+ * of that field's value, see writeJSONLogField. An event's action is written
+ * in place of a top-level "action" decoration.
+ */
+static void writeJSONDecorations(const QueryLogItem& item,
+                                 const std::set<std::string>& reserved,
+                                 const std::string* action,
+                                 std::string& out) {
+  if (item.decorations.empty()) {
+    return;
+  }
+
+  if (!FLAGS_decorations_top_level) {
+    out.append("\"decorations\":{");
+    for (const auto& decoration : item.decorations) {
+      writeJSONField(decoration.first, decoration.second, out);
+      out.push_back(',');
+    }
+    out.back() = '}';
+    out.push_back(',');
+    return;
+  }
+
+  for (const auto& decoration : item.decorations) {
+    if (action != nullptr && decoration.first == "action") {
+      writeJSONField(decoration.first, *action, out);
+      out.push_back(',');
+    } else if (reserved.count(decoration.first) == 0) {
+      writeJSONField(decoration.first, decoration.second, out);
+      out.push_back(',');
+    }
+  }
+}
+
+void writeQueryLogItemJSON(const QueryLogItem& item, std::string& json) {
+  static const std::set<std::string> kDiffReserved = {
+      "diffResults", "name", "hostIdentifier", "calendarTime", "unixTime"};
+  static const std::set<std::string> kSnapshotReserved = {"snapshot",
+                                                          "action",
+                                                          "name",
+                                                          "hostIdentifier",
+                                                          "calendarTime",
+                                                          "unixTime"};
+
+  json.clear();
+  json.push_back('{');
+  bool snapshot = item.results.added.empty() && item.results.removed.empty();
+  if (!snapshot) {
+    // The "removed" rows are written first, see serializeDiffResults.
+    json.append("\"diffResults\":{\"removed\":");
+    writeJSONRows(item.results.removed, json);
+    json.append(",\"added\":");
+    writeJSONRows(item.results.added, json);
+    json.append("},");
+  } else {
+    json.append("\"snapshot\":");
+    writeJSONRows(item.snapshot_results, json);
+    json.push_back(',');
+    writeJSONLogField(item, "action", "snapshot", json);
+    json.push_back(',');
+  }
+
+  writeJSONLegacyFields(item, json);
+  writeJSONDecorations(
+      item, (snapshot) ? kSnapshotReserved : kDiffReserved, nullptr, json);
+  json.back() = '}';
+}
+
+void writeQueryLogEventJSON(const QueryLogItem& item,
+                            const std::string& action,
+                            const Row& row,
+                            std::string& json) {
+  static const std::set<std::string> kEventReserved = {
+      "columns", "name", "hostIdentifier", "calendarTime", "unixTime"};
+
+  json.clear();
+  json.push_back('{');
+  writeJSONLegacyFields(item, json);
+  writeJSONDecorations(item, kEventReserved, &action, json);
+  json.append("\"columns\":");
+  writeJSONRow(row, json);
+  if (!FLAGS_decorations_top_level || item.decorations.count("action") == 0) {
+    json.push_back(',');
+    writeJSONField("action", action, json);
+  }
+  json.push_back('}');
+}
+
 bool addUniqueRowToQueryData(QueryData& q, const Row& r) {
   if (std::find(q.begin(), q.end(), r) != q.end()) {
     return false;
@@ -479,6 +1435,132 @@ bool DatabasePlugin::checkDB() {
   return result;
 }
 
+Status DatabasePlugin::writeBatch(const std::string& domain,
+                                  const DatabaseBatch& batch) {
+  for (const auto& write : batch.writes()) {
+    auto status = (write.op == DatabaseBatch::Op::PUT)
+                      ? put(domain, write.key, write.value)
+                      : remove(domain, write.key);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  return Status(0, "OK");
+}
+
+Status DatabasePlugin::removeRange(const std::string& domain,
+                                   const std::string& start,
+                                   const std::string& stop) {
+  DatabaseKeyValues results;
+  auto status = scanRange(domain, results, start, stop);
+  if (!status.ok()) {
+    return status;
+  }
+
+  DatabaseBatch batch;
+  for (auto& result : results) {
+    batch.remove(std::move(result.first));
+  }
+  return (batch.empty()) ? Status(0, "OK") : writeBatch(domain, batch);
+}
+
+/**
+ * @brief Flatten a batch into registry request fields.
+ *
+ * Each write N is represented as "op.N", "key.N", and "value.N" alongside a
+ * "count" of writes, so batches can be routed through the extensions API.
+ */
+static void serializeDatabaseBatch(const DatabaseBatch& batch,
+                                   PluginRequest& request) {
+  size_t i = 0;
+  for (const auto& write : batch.writes()) {
+    auto index = std::to_string(i++);
+    request["op." + index] =
+        (write.op == DatabaseBatch::Op::PUT) ? "put" : "remove";
+    request["key." + index] = write.key;
+    request["value." + index] = write.value;
+  }
+  request["count"] = std::to_string(i);
+}
+
+/// Inverse of serializeDatabaseBatch, rebuild a batch from request fields.
+static Status deserializeDatabaseBatch(const PluginRequest& request,
+                                       DatabaseBatch& batch) {
+  if (request.count("count") == 0) {
+    return Status(1, "Database plugin batch action requires a count");
+  }
+
+  auto count = std::stoul(request.at("count"));
+  for (size_t i = 0; i < count; i++) {
+    auto index = std::to_string(i);
+    if (request.count("op." + index) == 0 ||
+        request.count("key." + index) == 0) {
+      return Status(1, "Database plugin batch write is malformed");
+    }
+
+    const auto& op = request.at("op." + index);
+    if (op == "put") {
+      auto value = (request.count("value." + index) > 0)
+                       ? request.at("value." + index)
+                       : "";
+      batch.put(request.at("key." + index), std::move(value));
+    } else if (op == "remove") {
+      batch.remove(request.at("key." + index));
+    } else {
+      return Status(1, "Unknown database plugin batch operation: " + op);
+    }
+  }
+  return Status(0, "OK");
+}
+
+std::string DatabasePlugin::getPrefixUpperBound(const std::string& prefix) {
+  // Increment the last byte that can be incremented and drop the remainder.
+  auto bound = prefix;
+  while (!bound.empty()) {
+    auto& last = bound.back();
+    if (static_cast<unsigned char>(last) != 0xFF) {
+      last = static_cast<char>(static_cast<unsigned char>(last) + 1);
+      return bound;
+    }
+    bound.pop_back();
+  }
+  return bound;
+}
+
+Status DatabasePlugin::scanRange(const std::string& domain,
+                                 DatabaseKeyValues& results,
+                                 const std::string& start,
+                                 const std::string& stop,
+                                 size_t max) const {
+  // Narrow the key scan to the prefix shared by both bounds.
+  std::string prefix;
+  if (!stop.empty()) {
+    auto shared = std::mismatch(start.begin(), start.end(), stop.begin());
+    prefix = start.substr(0, shared.first - start.begin());
+  }
+
+  std::vector<std::string> keys;
+  auto status = scan(domain, keys, prefix);
+  if (!status.ok()) {
+    return status;
+  }
+
+  for (const auto& key : keys) {
+    if (key < start || (!stop.empty() && key >= stop)) {
+      continue;
+    }
+
+    std::string value;
+    if (get(domain, key, value).ok()) {
+      results.push_back(std::make_pair(key, std::move(value)));
+      if (max > 0 && results.size() >= max) {
+        break;
+      }
+    }
+  }
+  return Status(0, "OK");
+}
+
 Status DatabasePlugin::call(const PluginRequest& request,
                             PluginResponse& response) {
   if (request.count("action") == 0) {
@@ -502,6 +1584,17 @@ Status DatabasePlugin::call(const PluginRequest& request,
     return this->put(domain, key, request.at("value"));
   } else if (request.at("action") == "remove") {
     return this->remove(domain, key);
+  } else if (request.at("action") == "remove_range") {
+    auto start = (request.count("start") > 0) ? request.at("start") : "";
+    auto stop = (request.count("stop") > 0) ? request.at("stop") : "";
+    return this->removeRange(domain, start, stop);
+  } else if (request.at("action") == "batch") {
+    DatabaseBatch batch;
+    auto status = deserializeDatabaseBatch(request, batch);
+    if (!status.ok()) {
+      return status;
+    }
+    return this->writeBatch(domain, batch);
   } else if (request.at("action") == "scan") {
     // Accumulate scanned keys into a vector.
     std::vector<std::string> keys;
@@ -515,6 +1608,21 @@ Status DatabasePlugin::call(const PluginRequest& request,
       response.push_back({{"k", k}});
     }
     return status;
+  } else if (request.at("action") == "scan_range") {
+    // Accumulate scanned key/value pairs within [start, stop).
+    DatabaseKeyValues values;
+    size_t max = 0;
+    if (request.count("max") > 0) {
+      max = std::stoul(request.at("max"));
+    }
+    auto start = (request.count("start") > 0) ? request.at("start") : "";
+    auto stop = (request.count("stop") > 0) ? request.at("stop") : "";
+    auto status = this->scanRange(domain, values, start, stop, max);
+    for (auto& kv : values) {
+      response.push_back(
+          {{"k", std::move(kv.first)}, {"v", std::move(kv.second)}});
+    }
+    return status;
   } else if (request.at("action") == "reset") {
     return this->reset();
   }
@@ -589,6 +1697,45 @@ Status deleteDatabaseValue(const std::string& domain, const std::string& key) {
   }
 }
 
+Status deleteDatabaseRange(const std::string& domain,
+                           const std::string& start,
+                           const std::string& stop) {
+  ReadLock lock(kDatabaseReset);
+
+  if (RegistryFactory::get().external()) {
+    // External registries (extensions) do not have databases active.
+    // It is not possible to use an extension-based database.
+    PluginRequest request = {{"action", "remove_range"},
+                             {"domain", domain},
+                             {"start", start},
+                             {"stop", stop}};
+    return Registry::call("database", request);
+  } else {
+    auto plugin = getDatabasePlugin();
+    return plugin->removeRange(domain, start, stop);
+  }
+}
+
+Status writeDatabaseBatch(const std::string& domain,
+                          const DatabaseBatch& batch) {
+  if (batch.empty()) {
+    return Status(0, "OK");
+  }
+
+  ReadLock lock(kDatabaseReset);
+
+  if (RegistryFactory::get().external()) {
+    // External registries (extensions) do not have databases active.
+    // It is not possible to use an extension-based database.
+    PluginRequest request = {{"action", "batch"}, {"domain", domain}};
+    serializeDatabaseBatch(batch, request);
+    return Registry::call("database", request);
+  } else {
+    auto plugin = getDatabasePlugin();
+    return plugin->writeBatch(domain, batch);
+  }
+}
+
 Status scanDatabaseKeys(const std::string& domain,
                         std::vector<std::string>& keys,
                         size_t max) {
@@ -624,6 +1771,47 @@ Status scanDatabaseKeys(const std::string& domain,
   }
 }
 
+Status scanDatabaseValues(const std::string& domain,
+                          DatabaseKeyValues& values,
+                          const std::string& prefix,
+                          size_t max) {
+  return scanDatabaseRange(domain,
+                           values,
+                           prefix,
+                           DatabasePlugin::getPrefixUpperBound(prefix),
+                           max);
+}
+
+Status scanDatabaseRange(const std::string& domain,
+                         DatabaseKeyValues& values,
+                         const std::string& start,
+                         const std::string& stop,
+                         size_t max) {
+  ReadLock lock(kDatabaseReset);
+
+  if (RegistryFactory::get().external()) {
+    // External registries (extensions) do not have databases active.
+    // It is not possible to use an extension-based database.
+    PluginRequest request = {{"action", "scan_range"},
+                             {"domain", domain},
+                             {"start", start},
+                             {"stop", stop},
+                             {"max", std::to_string(max)}};
+    PluginResponse response;
+    auto status = Registry::call("database", request, response);
+
+    for (auto& item : response) {
+      if (item.count("k") > 0 && item.count("v") > 0) {
+        values.push_back(std::make_pair(item.at("k"), item.at("v")));
+      }
+    }
+    return status;
+  } else {
+    auto plugin = getDatabasePlugin();
+    return plugin->scanRange(domain, values, start, stop, max);
+  }
+}
+
 void resetDatabase() {
   WriteLock lock(kDatabaseReset);
 
@@ -647,6 +1835,16 @@ void dumpDatabase() {
       if (!getDatabaseValue(domain, key, value)) {
         continue;
       }
+
+      // Stored results are binary encoded, print them as JSON.
+      QueryData results;
+      if (isBinaryEncoded(value) &&
+          deserializeQueryDataBinary(value, results).ok()) {
+        serializeQueryDataJSON(results, value);
+        if (!value.empty() && value.back() == '\n') {
+          value.pop_back();
+        }
+      }
       fprintf(
           stdout, "%s[%s]: %s\n", domain.c_str(), key.c_str(), value.c_str());
     }
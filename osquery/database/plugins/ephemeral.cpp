@@ -32,12 +32,28 @@ class EphemeralDatabasePlugin : public DatabasePlugin {
   /// Data removal method.
   Status remove(const std::string& domain, const std::string& k) override;
 
+  /// Key range removal method.
+  Status removeRange(const std::string& domain,
+                     const std::string& start,
+                     const std::string& stop) override;
+
+  /// Atomic multi-key write method.
+  Status writeBatch(const std::string& domain,
+                    const DatabaseBatch& batch) override;
+
   /// Key/index lookup method.
   Status scan(const std::string& domain,
               std::vector<std::string>& results,
               const std::string& prefix,
               size_t max = 0) const override;
 
+  /// Key/value range lookup method.
+  Status scanRange(const std::string& domain,
+                   DatabaseKeyValues& results,
+                   const std::string& start,
+                   const std::string& stop,
+                   size_t max = 0) const override;
+
  public:
   /// Database workflow: open and setup.
   Status setUp() override {
@@ -76,6 +92,32 @@ Status EphemeralDatabasePlugin::remove(const std::string& domain,
   return Status(0);
 }
 
+Status EphemeralDatabasePlugin::removeRange(const std::string& domain,
+                                            const std::string& start,
+                                            const std::string& stop) {
+  if (db_.count(domain) == 0 || (!stop.empty() && stop <= start)) {
+    return Status(0);
+  }
+
+  auto& keys = db_.at(domain);
+  auto last = (stop.empty()) ? keys.end() : keys.lower_bound(stop);
+  keys.erase(keys.lower_bound(start), last);
+  return Status(0);
+}
+
+Status EphemeralDatabasePlugin::writeBatch(const std::string& domain,
+                                           const DatabaseBatch& batch) {
+  auto& keys = db_[domain];
+  for (const auto& write : batch.writes()) {
+    if (write.op == DatabaseBatch::Op::PUT) {
+      keys[write.key] = write.value;
+    } else {
+      keys.erase(write.key);
+    }
+  }
+  return Status(0);
+}
+
 Status EphemeralDatabasePlugin::scan(const std::string& domain,
                                      std::vector<std::string>& results,
                                      const std::string& prefix,
@@ -84,13 +126,31 @@ Status EphemeralDatabasePlugin::scan(const std::string& domain,
     return Status(0);
   }
 
-  for (const auto& key : db_.at(domain)) {
-    if (!prefix.empty() &&
-        !(std::mismatch(prefix.begin(), prefix.end(), key.first.begin())
-              .first == prefix.end())) {
-      continue;
+  const auto& keys = db_.at(domain);
+  auto stop = getPrefixUpperBound(prefix);
+  auto end = (stop.empty()) ? keys.end() : keys.lower_bound(stop);
+  for (auto it = keys.lower_bound(prefix); it != end; ++it) {
+    results.push_back(it->first);
+    if (max > 0 && results.size() >= max) {
+      break;
     }
-    results.push_back(key.first);
+  }
+  return Status(0);
+}
+
+Status EphemeralDatabasePlugin::scanRange(const std::string& domain,
+                                          DatabaseKeyValues& results,
+                                          const std::string& start,
+                                          const std::string& stop,
+                                          size_t max) const {
+  if (db_.count(domain) == 0 || (!stop.empty() && stop <= start)) {
+    return Status(0);
+  }
+
+  const auto& keys = db_.at(domain);
+  auto end = (stop.empty()) ? keys.end() : keys.lower_bound(stop);
+  for (auto it = keys.lower_bound(start); it != end; ++it) {
+    results.push_back(*it);
     if (max > 0 && results.size() >= max) {
       break;
     }
@@ -8,6 +8,8 @@
  *
  */
 
+#include <functional>
+#include <memory>
 #include <mutex>
 
 #include <sys/stat.h>
@@ -16,7 +18,10 @@
 
 #include <rocksdb/db.h>
 #include <rocksdb/env.h>
+#include <rocksdb/filter_policy.h>
 #include <rocksdb/options.h>
+#include <rocksdb/slice_transform.h>
+#include <rocksdb/table.h>
 
 #include <osquery/database.h>
 #include <osquery/filesystem.h>
@@ -35,6 +40,56 @@ class GlogRocksDBLogger : public rocksdb::Logger {
   void Logv(const char* format, va_list ap) override;
 };
 
+/**
+ * @brief A prefix extractor that keeps a key up to its Nth delimiter.
+ *
+ * Event keys are namespaced as "type.publisher.subscriber.", the set of keys
+ * sharing that namespace is contiguous, which makes it a valid RocksDB prefix.
+ * Keys with fewer delimiters are outside of the transform's domain and are
+ * only reachable using total-order iteration.
+ */
+class DelimitedPrefixTransform : public rocksdb::SliceTransform {
+ public:
+  DelimitedPrefixTransform(char delimiter, size_t count)
+      : delimiter_(delimiter), count_(count) {}
+
+  const char* Name() const override {
+    return "osquery.DelimitedPrefix";
+  }
+
+  rocksdb::Slice Transform(const rocksdb::Slice& key) const override {
+    return rocksdb::Slice(key.data(), prefixSize(key));
+  }
+
+  bool InDomain(const rocksdb::Slice& key) const override {
+    return prefixSize(key) > 0;
+  }
+
+  bool InRange(const rocksdb::Slice& dst) const override {
+    return prefixSize(dst) == dst.size();
+  }
+
+  bool SameResultWhenAppended(const rocksdb::Slice& prefix) const override {
+    return InRange(prefix);
+  }
+
+ private:
+  /// Return the length of the prefix including the Nth delimiter, or 0.
+  size_t prefixSize(const rocksdb::Slice& key) const {
+    size_t found = 0;
+    for (size_t i = 0; i < key.size(); i++) {
+      if (key[i] == delimiter_ && ++found == count_) {
+        return i + 1;
+      }
+    }
+    return 0;
+  }
+
+ private:
+  char delimiter_;
+  size_t count_;
+};
+
 class RocksDBDatabasePlugin : public DatabasePlugin {
  public:
   /// Data retrieval method.
@@ -50,12 +105,28 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
   /// Data removal method.
   Status remove(const std::string& domain, const std::string& k) override;
 
+  /// Key range removal method, a batch of deletes from a bounded iterator.
+  Status removeRange(const std::string& domain,
+                     const std::string& start,
+                     const std::string& stop) override;
+
+  /// Atomic multi-key write method.
+  Status writeBatch(const std::string& domain,
+                    const DatabaseBatch& batch) override;
+
   /// Key/index lookup method.
   Status scan(const std::string& domain,
               std::vector<std::string>& results,
               const std::string& prefix,
               size_t max = 0) const override;
 
+  /// Key/value range lookup method.
+  Status scanRange(const std::string& domain,
+                   DatabaseKeyValues& results,
+                   const std::string& start,
+                   const std::string& stop,
+                   size_t max = 0) const override;
+
  public:
   /// Database workflow: open and setup.
   Status setUp() override;
@@ -81,6 +152,35 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
   rocksdb::ColumnFamilyHandle* getHandleForColumnFamily(
       const std::string& cf) const;
 
+  /// Build the column family options (prefix extractor, filters) for a domain.
+  rocksdb::ColumnFamilyOptions getDomainOptions(
+      const std::string& domain) const;
+
+  /// Get the prefix extractor configured for a domain, or nullptr.
+  const rocksdb::SliceTransform* getPrefixExtractor(
+      const std::string& domain) const;
+
+  /**
+   * @brief Iterate the keys of a domain within [start, stop).
+   *
+   * The iterator seeks directly to start and stops at the first key that is
+   * not less than stop. If the range is exactly a prefix known to the domain's
+   * prefix extractor the iteration uses the prefix bloom filters.
+   *
+   * @param domain the domain to iterate.
+   * @param start the inclusive lower bound key.
+   * @param stop the exclusive upper bound key, empty if unbounded.
+   * @param max the maximum number of keys to visit (0 = unlimited).
+   * @param predicate called with each key and value, return false to stop.
+   */
+  Status iterate(const std::string& domain,
+                 const std::string& start,
+                 const std::string& stop,
+                 size_t max,
+                 std::function<bool(const rocksdb::Slice& key,
+                                    const rocksdb::Slice& value)> predicate)
+      const;
+
   /**
    * @brief Helper method which can be used to get a raw pointer to the
    * underlying RocksDB database handle
@@ -188,6 +288,12 @@ Status RocksDBDatabasePlugin::setUp() {
       column_families_.push_back(
           rocksdb::ColumnFamilyDescriptor(cf_name, options_));
     }
+
+    // Each domain is accessed using the handle at the domain's index, see
+    // getHandleForColumnFamily, so the domain options are applied there.
+    for (size_t i = 0; i < kDomains.size(); i++) {
+      column_families_[i].options = getDomainOptions(kDomains[i]);
+    }
   }
 
   // Consume the current settings.
@@ -292,6 +398,36 @@ rocksdb::ColumnFamilyHandle* RocksDBDatabasePlugin::getHandleForColumnFamily(
   return nullptr;
 }
 
+rocksdb::ColumnFamilyOptions RocksDBDatabasePlugin::getDomainOptions(
+    const std::string& domain) const {
+  rocksdb::ColumnFamilyOptions options(options_);
+
+  // Whole-key bloom filters allow point lookups of missing keys, such as a new
+  // event record bin, to skip reading data blocks.
+  rocksdb::BlockBasedTableOptions table_options;
+  table_options.filter_policy.reset(rocksdb::NewBloomFilterPolicy(10, false));
+  table_options.whole_key_filtering = true;
+  options.table_factory.reset(
+      rocksdb::NewBlockBasedTableFactory(table_options));
+
+  if (domain == kEvents) {
+    // Event keys are "type.publisher.subscriber.", scans are per-subscriber.
+    options.prefix_extractor =
+        std::make_shared<DelimitedPrefixTransform>('.', 3);
+  }
+  return options;
+}
+
+const rocksdb::SliceTransform* RocksDBDatabasePlugin::getPrefixExtractor(
+    const std::string& domain) const {
+  for (size_t i = 0; i < kDomains.size() && i < column_families_.size(); i++) {
+    if (kDomains[i] == domain) {
+      return column_families_[i].options.prefix_extractor.get();
+    }
+  }
+  return nullptr;
+}
+
 Status RocksDBDatabasePlugin::get(const std::string& domain,
                                   const std::string& key,
                                   std::string& value) const {
@@ -357,10 +493,78 @@ Status RocksDBDatabasePlugin::remove(const std::string& domain,
   return Status(s.code(), s.ToString());
 }
 
-Status RocksDBDatabasePlugin::scan(const std::string& domain,
-                                   std::vector<std::string>& results,
-                                   const std::string& prefix,
-                                   size_t max) const {
+Status RocksDBDatabasePlugin::removeRange(const std::string& domain,
+                                          const std::string& start,
+                                          const std::string& stop) {
+  if (read_only_) {
+    return Status(0, "Database in readonly mode");
+  }
+
+  auto cfh = getHandleForColumnFamily(domain);
+  if (cfh == nullptr) {
+    return Status(1, "Could not get column family for " + domain);
+  }
+
+  // Collect deletes from an iterator bounded by the range, without values.
+  rocksdb::WriteBatch write_batch;
+  auto status = iterate(
+      domain,
+      start,
+      stop,
+      0,
+      [&write_batch, cfh](const rocksdb::Slice& key,
+                          const rocksdb::Slice& /* value */) {
+        write_batch.Delete(cfh, key);
+        return true;
+      });
+  if (!status.ok() || write_batch.Count() == 0) {
+    return status;
+  }
+
+  auto options = rocksdb::WriteOptions();
+  if (kEvents != domain) {
+    options.sync = true;
+  }
+  auto s = getDB()->Write(options, &write_batch);
+  return Status(s.code(), s.ToString());
+}
+
+Status RocksDBDatabasePlugin::writeBatch(const std::string& domain,
+                                         const DatabaseBatch& batch) {
+  if (read_only_) {
+    return Status(0, "Database in readonly mode");
+  }
+
+  auto cfh = getHandleForColumnFamily(domain);
+  if (cfh == nullptr) {
+    return Status(1, "Could not get column family for " + domain);
+  }
+
+  rocksdb::WriteBatch write_batch;
+  for (const auto& write : batch.writes()) {
+    if (write.op == DatabaseBatch::Op::PUT) {
+      write_batch.Put(cfh, write.key, write.value);
+    } else {
+      write_batch.Delete(cfh, write.key);
+    }
+  }
+
+  // The batch is committed, and synced if required, once for all writes.
+  auto options = rocksdb::WriteOptions();
+  if (kEvents != domain) {
+    options.sync = true;
+  }
+  auto s = getDB()->Write(options, &write_batch);
+  return Status(s.code(), s.ToString());
+}
+
+Status RocksDBDatabasePlugin::iterate(
+    const std::string& domain,
+    const std::string& start,
+    const std::string& stop,
+    size_t max,
+    std::function<bool(const rocksdb::Slice& key, const rocksdb::Slice& value)>
+        predicate) const {
   if (getDB() == nullptr) {
     return Status(1, "Database not opened");
   }
@@ -369,25 +573,81 @@ Status RocksDBDatabasePlugin::scan(const std::string& domain,
   if (cfh == nullptr) {
     return Status(1, "Could not get column family for " + domain);
   }
+
   auto options = rocksdb::ReadOptions();
   options.verify_checksums = false;
   options.fill_cache = false;
-  auto it = getDB()->NewIterator(options, cfh);
+
+  // The upper bound lets RocksDB stop reading blocks past the range.
+  rocksdb::Slice upper_bound(stop);
+  if (!stop.empty()) {
+    options.iterate_upper_bound = &upper_bound;
+  }
+
+  // Only use prefix seeking if the range is exactly an extracted prefix.
+  // Otherwise iterate in total-order, which is still bounded by the range.
+  auto extractor = getPrefixExtractor(domain);
+  if (extractor != nullptr && extractor->InDomain(start) &&
+      extractor->Transform(start).size() == start.size() &&
+      stop == getPrefixUpperBound(start)) {
+    options.prefix_same_as_start = true;
+  } else {
+    options.total_order_seek = true;
+  }
+
+  std::unique_ptr<rocksdb::Iterator> it(getDB()->NewIterator(options, cfh));
   if (it == nullptr) {
     return Status(1, "Could not get iterator for " + domain);
   }
 
+  rocksdb::Slice stop_key(stop);
   size_t count = 0;
-  for (it->SeekToFirst(); it->Valid(); it->Next()) {
-    auto key = it->key().ToString();
-    if (key.find(prefix) == 0) {
-      results.push_back(std::move(key));
-      if (max > 0 && ++count >= max) {
-        break;
-      }
+  for (it->Seek(start); it->Valid(); it->Next()) {
+    if (!stop.empty() && it->key().compare(stop_key) >= 0) {
+      break;
+    }
+    if (!predicate(it->key(), it->value())) {
+      break;
+    }
+    if (max > 0 && ++count >= max) {
+      break;
     }
   }
-  delete it;
+
+  if (!it->status().ok()) {
+    return Status(1, it->status().ToString());
+  }
   return Status(0, "OK");
 }
+
+Status RocksDBDatabasePlugin::scan(const std::string& domain,
+                                   std::vector<std::string>& results,
+                                   const std::string& prefix,
+                                   size_t max) const {
+  return iterate(
+      domain,
+      prefix,
+      getPrefixUpperBound(prefix),
+      max,
+      [&results](const rocksdb::Slice& key, const rocksdb::Slice& /* v */) {
+        results.push_back(key.ToString());
+        return true;
+      });
+}
+
+Status RocksDBDatabasePlugin::scanRange(const std::string& domain,
+                                        DatabaseKeyValues& results,
+                                        const std::string& start,
+                                        const std::string& stop,
+                                        size_t max) const {
+  return iterate(
+      domain,
+      start,
+      stop,
+      max,
+      [&results](const rocksdb::Slice& key, const rocksdb::Slice& value) {
+        results.push_back(std::make_pair(key.ToString(), value.ToString()));
+        return true;
+      });
+}
 }
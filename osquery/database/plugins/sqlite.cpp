@@ -49,12 +49,28 @@ class SQLiteDatabasePlugin : public DatabasePlugin {
   /// Data removal method.
   Status remove(const std::string& domain, const std::string& k) override;
 
+  /// Key range removal method, a single delete over the primary key.
+  Status removeRange(const std::string& domain,
+                     const std::string& start,
+                     const std::string& stop) override;
+
+  /// Atomic multi-key write method.
+  Status writeBatch(const std::string& domain,
+                    const DatabaseBatch& batch) override;
+
   /// Key/index lookup method.
   Status scan(const std::string& domain,
               std::vector<std::string>& results,
               const std::string& prefix,
               size_t max = 0) const override;
 
+  /// Key/value range lookup method.
+  Status scanRange(const std::string& domain,
+                   DatabaseKeyValues& results,
+                   const std::string& start,
+                   const std::string& stop,
+                   size_t max = 0) const override;
+
  public:
   /// Database workflow: open and setup.
   Status setUp() override;
@@ -72,12 +88,33 @@ class SQLiteDatabasePlugin : public DatabasePlugin {
  private:
   void close();
 
+  /**
+   * @brief Step through the keys, and optionally values, within a range.
+   *
+   * The range is expressed as bound parameters on the primary key so the
+   * lookup is an index range scan rather than a LIKE over every key.
+   */
+  Status iterate(const std::string& domain,
+                 const std::string& start,
+                 const std::string& stop,
+                 size_t max,
+                 bool values,
+                 DatabaseKeyValues& results) const;
+
  private:
   /// The long-lived sqlite3 database.
   sqlite3* db_{nullptr};
 
   /// Deconstruction mutex.
   Mutex close_mutex_;
+
+  /**
+   * @brief Writes share the single connection with batch transactions.
+   *
+   * Every write holds this lock so none can land inside a batch, where a
+   * rollback would discard it.
+   */
+  Mutex transaction_mutex_;
 };
 
 /// Backing-storage provider for osquery internal/core.
@@ -174,23 +211,44 @@ static int getData(void* argument, int argc, char* argv[], char* column[]) {
   return 0;
 }
 
+/**
+ * @brief Bind a value as a blob.
+ *
+ * Stored results and events use a binary encoding that may contain NUL
+ * bytes, so values are never bound or read as C strings.
+ */
+static inline int bindValue(sqlite3_stmt* stmt,
+                            int index,
+                            const std::string& value) {
+  return sqlite3_bind_blob(
+      stmt, index, value.data(), static_cast<int>(value.size()), SQLITE_STATIC);
+}
+
+/// Read a value column, see bindValue.
+static inline std::string getValue(sqlite3_stmt* stmt, int column) {
+  auto data = static_cast<const char*>(sqlite3_column_blob(stmt, column));
+  auto size = sqlite3_column_bytes(stmt, column);
+  return (data != nullptr) ? std::string(data, size) : "";
+}
+
 Status SQLiteDatabasePlugin::get(const std::string& domain,
                                  const std::string& key,
                                  std::string& value) const {
-  QueryData results;
-  char* err = nullptr;
-  std::string q = "select value from " + domain + " where key = '" + key + "';";
-  sqlite3_exec(db_, q.c_str(), getData, &results, &err);
-  if (err != nullptr) {
-    sqlite3_free(err);
+  sqlite3_stmt* stmt = nullptr;
+  std::string q = "select value from " + domain + " where key = ?1;";
+  if (sqlite3_prepare_v2(db_, q.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return Status(1, "Cannot read from domain: " + domain);
   }
 
+  sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_STATIC);
   // Only assign value if the query found a result.
-  if (results.size() > 0) {
-    value = std::move(results[0]["value"]);
-    return Status(0);
+  auto found = (sqlite3_step(stmt) == SQLITE_ROW);
+  if (found) {
+    value = getValue(stmt, 0);
   }
-  return Status(1);
+  sqlite3_finalize(stmt);
+  return Status((found) ? 0 : 1);
 }
 
 static void tryVacuum(sqlite3* db) {
@@ -215,12 +273,13 @@ Status SQLiteDatabasePlugin::put(const std::string& domain,
     return Status(0, "Database in readonly mode");
   }
 
+  WriteLock lock(transaction_mutex_);
   sqlite3_stmt* stmt = nullptr;
   std::string q = "insert or replace into " + domain + " values (?1, ?2);";
   sqlite3_prepare_v2(db_, q.c_str(), -1, &stmt, nullptr);
 
   sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_STATIC);
-  sqlite3_bind_text(stmt, 2, value.c_str(), -1, SQLITE_STATIC);
+  bindValue(stmt, 2, value);
   auto rc = sqlite3_step(stmt);
   if (rc != SQLITE_DONE) {
     return Status(1);
@@ -239,6 +298,7 @@ Status SQLiteDatabasePlugin::remove(const std::string& domain,
     return Status(0, "Database in readonly mode");
   }
 
+  WriteLock lock(transaction_mutex_);
   sqlite3_stmt* stmt = nullptr;
   std::string q = "delete from " + domain + " where key IN (?1);";
   sqlite3_prepare_v2(db_, q.c_str(), -1, &stmt, nullptr);
@@ -256,28 +316,151 @@ Status SQLiteDatabasePlugin::remove(const std::string& domain,
   return Status(0);
 }
 
-Status SQLiteDatabasePlugin::scan(const std::string& domain,
-                                  std::vector<std::string>& results,
-                                  const std::string& prefix,
-                                  size_t max) const {
-  QueryData _results;
-  char* err = nullptr;
+Status SQLiteDatabasePlugin::removeRange(const std::string& domain,
+                                         const std::string& start,
+                                         const std::string& stop) {
+  if (read_only_) {
+    return Status(0, "Database in readonly mode");
+  }
 
-  std::string q =
-      "select key from " + domain + " where key LIKE '" + prefix + "%'";
+  WriteLock lock(transaction_mutex_);
+  sqlite3_stmt* stmt = nullptr;
+  std::string q = "delete from " + domain + " where key >= ?1";
+  if (!stop.empty()) {
+    q += " and key < ?2";
+  }
+  q += ";";
+  sqlite3_prepare_v2(db_, q.c_str(), -1, &stmt, nullptr);
+
+  sqlite3_bind_text(stmt, 1, start.c_str(), -1, SQLITE_STATIC);
+  if (!stop.empty()) {
+    sqlite3_bind_text(stmt, 2, stop.c_str(), -1, SQLITE_STATIC);
+  }
+  auto rc = sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  if (rc != SQLITE_DONE) {
+    return Status(1);
+  }
+  return Status(0);
+}
+
+Status SQLiteDatabasePlugin::writeBatch(const std::string& domain,
+                                        const DatabaseBatch& batch) {
+  if (read_only_) {
+    return Status(0, "Database in readonly mode");
+  }
+
+  WriteLock lock(transaction_mutex_);
+  sqlite3_stmt* put_stmt = nullptr;
+  sqlite3_stmt* remove_stmt = nullptr;
+  std::string put_q = "insert or replace into " + domain + " values (?1, ?2);";
+  std::string remove_q = "delete from " + domain + " where key IN (?1);";
+  if (sqlite3_prepare_v2(db_, put_q.c_str(), -1, &put_stmt, nullptr) !=
+          SQLITE_OK ||
+      sqlite3_prepare_v2(db_, remove_q.c_str(), -1, &remove_stmt, nullptr) !=
+          SQLITE_OK) {
+    sqlite3_finalize(put_stmt);
+    sqlite3_finalize(remove_stmt);
+    return Status(1, "Cannot prepare batch for domain: " + domain);
+  }
+
+  // Each statement is reset and re-bound for every write in the batch.
+  if (sqlite3_exec(db_, "begin transaction;", nullptr, nullptr, nullptr) !=
+      SQLITE_OK) {
+    sqlite3_finalize(put_stmt);
+    sqlite3_finalize(remove_stmt);
+    return Status(1, "Cannot begin batch for domain: " + domain);
+  }
+
+  bool success = true;
+  for (const auto& write : batch.writes()) {
+    auto stmt = (write.op == DatabaseBatch::Op::PUT) ? put_stmt : remove_stmt;
+    sqlite3_reset(stmt);
+    sqlite3_bind_text(stmt, 1, write.key.c_str(), -1, SQLITE_STATIC);
+    if (write.op == DatabaseBatch::Op::PUT) {
+      bindValue(stmt, 2, write.value);
+    }
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+      success = false;
+      break;
+    }
+  }
+
+  sqlite3_finalize(put_stmt);
+  sqlite3_finalize(remove_stmt);
+  if (!success) {
+    sqlite3_exec(db_, "rollback transaction;", nullptr, nullptr, nullptr);
+    return Status(1, "Cannot apply batch to domain: " + domain);
+  }
+
+  if (sqlite3_exec(db_, "commit transaction;", nullptr, nullptr, nullptr) !=
+      SQLITE_OK) {
+    // A failed commit may leave the transaction open, none of it is applied.
+    sqlite3_exec(db_, "rollback transaction;", nullptr, nullptr, nullptr);
+    return Status(1, "Cannot commit batch to domain: " + domain);
+  }
+  return Status(0);
+}
+
+Status SQLiteDatabasePlugin::iterate(const std::string& domain,
+                                     const std::string& start,
+                                     const std::string& stop,
+                                     size_t max,
+                                     bool values,
+                                     DatabaseKeyValues& results) const {
+  if (db_ == nullptr) {
+    return Status(1, "Database not opened");
+  }
+
+  std::string q = (values) ? "select key, value from " : "select key from ";
+  q += domain + " where key >= ?1";
+  if (!stop.empty()) {
+    q += " and key < ?2";
+  }
+  q += " order by key";
   if (max > 0) {
     q += " limit " + std::to_string(max);
   }
-  sqlite3_exec(db_, q.c_str(), getData, &_results, &err);
-  if (err != nullptr) {
-    sqlite3_free(err);
+
+  sqlite3_stmt* stmt = nullptr;
+  if (sqlite3_prepare_v2(db_, q.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return Status(1, "Cannot scan domain: " + domain);
   }
 
-  // Only assign value if the query found a result.
-  for (auto& r : _results) {
-    results.push_back(std::move(r["key"]));
+  sqlite3_bind_text(stmt, 1, start.c_str(), -1, SQLITE_STATIC);
+  if (!stop.empty()) {
+    sqlite3_bind_text(stmt, 2, stop.c_str(), -1, SQLITE_STATIC);
+  }
+
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    auto key = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+    results.push_back(std::make_pair((key != nullptr) ? key : "",
+                                     (values) ? getValue(stmt, 1) : ""));
   }
 
+  sqlite3_finalize(stmt);
   return Status(0, "OK");
 }
+
+Status SQLiteDatabasePlugin::scan(const std::string& domain,
+                                  std::vector<std::string>& results,
+                                  const std::string& prefix,
+                                  size_t max) const {
+  DatabaseKeyValues keys;
+  auto status =
+      iterate(domain, prefix, getPrefixUpperBound(prefix), max, false, keys);
+  for (auto& key : keys) {
+    results.push_back(std::move(key.first));
+  }
+  return status;
+}
+
+Status SQLiteDatabasePlugin::scanRange(const std::string& domain,
+                                       DatabaseKeyValues& results,
+                                       const std::string& start,
+                                       const std::string& stop,
+                                       size_t max) const {
+  return iterate(domain, start, stop, max, true, results);
+}
 }
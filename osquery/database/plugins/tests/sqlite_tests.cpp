@@ -8,6 +8,8 @@
  *
  */
 
+#include <sqlite3.h>
+
 #include "osquery/database/tests/plugin_tests.h"
 
 namespace osquery {
@@ -21,4 +23,61 @@ class SQLiteDatabasePluginTests : public DatabasePluginTests {
 
 // Define the default set of database plugin operation tests.
 CREATE_DATABASE_TESTS(SQLiteDatabasePluginTests);
+
+TEST_F(SQLiteDatabasePluginTests, test_binary_values) {
+  auto plugin = std::dynamic_pointer_cast<DatabasePlugin>(
+      RegistryFactory::get().plugin("database", "sqlite"));
+
+  // Binary encoded results begin with, and may contain, NUL bytes.
+  Row r = {{"path", "/bin/sh"}, {"size", std::string("1\0 2", 4)}};
+  std::string content;
+  ASSERT_TRUE(serializeRowBinary(r, content));
+  ASSERT_TRUE(isBinaryEncoded(content));
+  EXPECT_TRUE(plugin->put(kEvents, "test_binary.1", content).ok());
+
+  DatabaseBatch batch;
+  batch.put("test_binary.2", content);
+  EXPECT_TRUE(plugin->writeBatch(kEvents, batch).ok());
+
+  std::string value;
+  EXPECT_TRUE(plugin->get(kEvents, "test_binary.1", value).ok());
+  EXPECT_EQ(value, content);
+
+  Row decoded;
+  EXPECT_TRUE(deserializeRowBinary(value, decoded));
+  EXPECT_EQ(decoded, r);
+
+  DatabaseKeyValues values;
+  plugin->scanRange(kEvents, values, "test_binary.", "test_binary/");
+  ASSERT_EQ(values.size(), 2U);
+  EXPECT_EQ(values[0].second, content);
+  EXPECT_EQ(values[1].second, content);
+}
+
+TEST_F(SQLiteDatabasePluginTests, test_write_batch_busy) {
+  auto plugin = std::dynamic_pointer_cast<DatabasePlugin>(
+      RegistryFactory::get().plugin("database", "sqlite"));
+
+  // A reader on another connection holds a shared lock until it ends.
+  sqlite3* reader = nullptr;
+  ASSERT_EQ(sqlite3_open(path_.c_str(), &reader), SQLITE_OK);
+  sqlite3_exec(reader,
+               "begin transaction; select count(*) from events;",
+               nullptr,
+               nullptr,
+               nullptr);
+
+  // The batch cannot commit, it is reported and rolled back.
+  DatabaseBatch batch;
+  batch.put("test_batch_busy", "1");
+  EXPECT_FALSE(plugin->writeBatch(kEvents, batch).ok());
+
+  sqlite3_exec(reader, "commit transaction;", nullptr, nullptr, nullptr);
+  sqlite3_close(reader);
+
+  std::string value;
+  EXPECT_FALSE(plugin->get(kEvents, "test_batch_busy", value).ok());
+  EXPECT_TRUE(plugin->writeBatch(kEvents, batch).ok());
+  EXPECT_TRUE(plugin->get(kEvents, "test_batch_busy", value).ok());
+}
 }
@@ -10,12 +10,22 @@
 
 #include <algorithm>
 
+#include <boost/lexical_cast.hpp>
+
+#include <osquery/flags.h>
 #include <osquery/logger.h>
+#include <osquery/system.h>
 
+#include "osquery/core/conversions.h"
 #include "osquery/database/query.h"
 
 namespace osquery {
 
+FLAG(bool,
+     schedule_verify_differentials,
+     false,
+     "Compare full rows when scheduled query result fingerprints match");
+
 Status Query::getPreviousQueryResults(QueryData& results) {
   std::string raw;
   auto status = getDatabaseValue(kQueries, name_, raw);
@@ -23,7 +33,7 @@ Status Query::getPreviousQueryResults(QueryData& results) {
     return status;
   }
 
-  status = deserializeQueryDataJSON(raw, results);
+  status = deserializeQueryDataBinary(raw, results);
   if (!status.ok()) {
     return status;
   }
@@ -36,20 +46,66 @@ std::vector<std::string> Query::getStoredQueryNames() {
   return results;
 }
 
-bool Query::isQueryNameInDatabase() {
-  auto names = Query::getStoredQueryNames();
-  return std::find(names.begin(), names.end(), name_) != names.end();
+const std::string kQueryMetadataPrefix = "meta.";
+
+/// Serialize query metadata as a list of decimal fields, see QueryMetadata.
+static std::string serializeQueryMetadata(const QueryMetadata& metadata) {
+  return std::to_string(metadata.query_hash) + "," +
+         std::to_string(metadata.last_executed) + "," +
+         std::to_string(metadata.rows) + "," +
+         std::to_string(metadata.added) + "," +
+         std::to_string(metadata.removed) + "," +
+         std::to_string(metadata.results_fingerprint);
 }
 
-static inline void saveQuery(const std::string& name,
-                             const std::string& query) {
-  setDatabaseValue(kQueries, "query." + name, query);
+static Status deserializeQueryMetadata(const std::string& content,
+                                       QueryMetadata& metadata) {
+  auto fields = split(content, ",");
+  if (fields.size() != 6) {
+    return Status(1, "Invalid query metadata");
+  }
+
+  try {
+    metadata.query_hash = boost::lexical_cast<uint64_t>(fields[0]);
+    metadata.last_executed = boost::lexical_cast<size_t>(fields[1]);
+    metadata.rows = boost::lexical_cast<size_t>(fields[2]);
+    metadata.added = boost::lexical_cast<size_t>(fields[3]);
+    metadata.removed = boost::lexical_cast<size_t>(fields[4]);
+    metadata.results_fingerprint = boost::lexical_cast<uint64_t>(fields[5]);
+  } catch (const boost::bad_lexical_cast& /* e */) {
+    return Status(1, "Invalid query metadata");
+  }
+  return Status(0, "OK");
 }
 
-bool Query::isNewQuery() {
+Status Query::getQueryMetadata(QueryMetadata& metadata) {
+  std::string content;
+  if (getDatabaseValue(kQueries, kQueryMetadataPrefix + name_, content)) {
+    return deserializeQueryMetadata(content, metadata);
+  }
+
+  // Results stored by a previous version include the query text separately.
+  auto status = getDatabaseValue(kQueries, name_, content);
+  if (!status.ok()) {
+    return status;
+  }
+
   std::string query;
   getDatabaseValue(kQueries, "query." + name_, query);
-  return (query != query_.query);
+  metadata = QueryMetadata();
+  metadata.query_hash = getFingerprint(query);
+  return Status(0, "OK");
+}
+
+bool Query::isQueryNameInDatabase() {
+  QueryMetadata metadata;
+  return getQueryMetadata(metadata).ok();
+}
+
+bool Query::isNewQuery() {
+  QueryMetadata metadata;
+  getQueryMetadata(metadata);
+  return (metadata.query_hash != getFingerprint(query_.query));
 }
 
 Status Query::addNewResults(const QueryData& qd) {
@@ -62,50 +118,79 @@ Status Query::addNewResults(const QueryData& current_qd,
                             bool calculate_diff) {
   // The current results are 'fresh' when not calculating a differential.
   bool fresh_results = !calculate_diff;
-  if (!isQueryNameInDatabase()) {
+  // A single lookup describes the stored results, if any exist.
+  QueryMetadata metadata;
+  bool exists = getQueryMetadata(metadata).ok();
+  auto query_hash = getFingerprint(query_.query);
+  if (!exists) {
     // This is the first encounter of the scheduled query.
     fresh_results = true;
     LOG(INFO) << "Storing initial results for new scheduled query: " << name_;
-    saveQuery(name_, query_.query);
-  } else if (isNewQuery()) {
+  } else if (metadata.query_hash != query_hash) {
     // This query is 'new' in that the previous results may be invalid.
     LOG(INFO) << "Scheduled query has been updated: " + name_;
-    saveQuery(name_, query_.query);
   }
 
   // Use a 'target' avoid copying the query data when serializing and saving.
   // If a differential is requested and needed the target remains the original
   // query data, otherwise the content is moved to the differential's added set.
   const auto* target_gd = &current_qd;
+  auto results_fingerprint = getQueryDataFingerprint(current_qd);
   if (!fresh_results && calculate_diff) {
-    // Get the rows from the last run of this query name.
-    QueryData previous_qd;
-    auto status = getPreviousQueryResults(previous_qd);
-    if (!status.ok()) {
-      return status;
+    if (!FLAGS_schedule_verify_differentials && metadata.last_executed > 0 &&
+        metadata.rows == current_qd.size() &&
+        metadata.results_fingerprint == results_fingerprint) {
+      // The results are unchanged, the previous results are not read.
+      dr.added.clear();
+      dr.removed.clear();
+    } else {
+      // Get the stored results from the last run of this query name.
+      std::string previous;
+      if (!getDatabaseValue(kQueries, name_, previous).ok()) {
+        // The results were removed, but not the metadata, start again.
+        dr.added = current_qd;
+        dr.removed.clear();
+      } else {
+        // Calculate the differential between previous and current results.
+        auto status = diffStoredResults(
+            previous, current_qd, dr, FLAGS_schedule_verify_differentials);
+        if (!status.ok()) {
+          return status;
+        }
+      }
     }
-
-    // Calculate the differential between previous and current query results.
-    dr = diff(previous_qd, current_qd);
     fresh_results = (!dr.added.empty() || !dr.removed.empty());
   } else {
     dr.added = std::move(current_qd);
     target_gd = &dr.added;
   }
 
+  // The metadata and results are written together, a reader will never see
+  // results without the matching metadata.
+  DatabaseBatch batch;
   if (fresh_results) {
     // Replace the "previous" query data with the current.
-    std::string json;
-    auto status = serializeQueryDataJSON(*target_gd, json);
+    std::string content;
+    auto status = serializeQueryDataIndexed(*target_gd, content);
     if (!status.ok()) {
       return status;
     }
 
-    status = setDatabaseValue(kQueries, name_, json);
-    if (!status.ok()) {
-      return status;
-    }
+    batch.put(name_, std::move(content));
   }
-  return Status(0, "OK");
+
+  if (exists && metadata.last_executed == 0) {
+    // The legacy query text is replaced by the metadata.
+    batch.remove("query." + name_);
+  }
+
+  metadata.query_hash = query_hash;
+  metadata.last_executed = getUnixTime();
+  metadata.rows = current_qd.size();
+  metadata.added = dr.added.size();
+  metadata.removed = dr.removed.size();
+  metadata.results_fingerprint = results_fingerprint;
+  batch.put(kQueryMetadataPrefix + name_, serializeQueryMetadata(metadata));
+  return writeDatabaseBatch(kQueries, batch);
 }
 }
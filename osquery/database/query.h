@@ -22,6 +22,36 @@ namespace osquery {
 /// Error message used when a query name isn't found in the database
 extern const std::string kQueryNameNotFoundError;
 
+/// The key prefix, within the queries domain, of each query's metadata.
+extern const std::string kQueryMetadataPrefix;
+
+/**
+ * @brief Metadata about the stored results of a scheduled query.
+ *
+ * The metadata is stored as a single value and read with one lookup, it
+ * answers whether a query has stored results, and if the query text changed,
+ * without scanning the queries domain.
+ */
+struct QueryMetadata {
+  /// A fingerprint of the query text that produced the stored results.
+  uint64_t query_hash{0};
+
+  /// The last time results were added, as UNIX time.
+  size_t last_executed{0};
+
+  /// The number of rows in the stored results.
+  size_t rows{0};
+
+  /// The number of added rows from the last differential.
+  size_t added{0};
+
+  /// The number of removed rows from the last differential.
+  size_t removed{0};
+
+  /// An order-independent fingerprint of the stored results.
+  uint64_t results_fingerprint{0};
+};
+
 /**
  * @brief Interact with the historical on-disk storage for a given query.
  */
@@ -61,6 +91,18 @@ class Query {
    */
   static std::vector<std::string> getStoredQueryNames();
 
+  /**
+   * @brief Get the metadata for this query's stored results.
+   *
+   * Results stored without metadata, by a previous version, are described
+   * using the legacy query text. Only the query hash is set in that case.
+   *
+   * @param metadata the output query metadata.
+   *
+   * @return success if the query has stored results.
+   */
+  Status getQueryMetadata(QueryMetadata& metadata);
+
   /**
    * @brief Check if a given scheduled query exists in the database.
    *
@@ -72,4 +72,55 @@ TEST_F(DatabaseTests, test_delete_values) {
   EXPECT_FALSE(s.ok());
   EXPECT_TRUE(value.empty());
 }
+
+TEST_F(DatabaseTests, test_write_batch) {
+  setDatabaseValue(kLogs, "batch_remove", "0");
+
+  DatabaseBatch batch;
+  batch.put("batch_1", "1");
+  batch.put("batch_2", "2");
+  batch.remove("batch_remove");
+  EXPECT_EQ(batch.size(), 3U);
+
+  auto s = writeDatabaseBatch(kLogs, batch);
+  EXPECT_TRUE(s.ok());
+
+  std::string value;
+  getDatabaseValue(kLogs, "batch_1", value);
+  EXPECT_EQ(value, "1");
+  getDatabaseValue(kLogs, "batch_2", value);
+  EXPECT_EQ(value, "2");
+
+  value.clear();
+  s = getDatabaseValue(kLogs, "batch_remove", value);
+  EXPECT_FALSE(s.ok());
+
+  // An empty batch is a no-op.
+  EXPECT_TRUE(writeDatabaseBatch(kLogs, DatabaseBatch()));
+}
+
+TEST_F(DatabaseTests, test_write_batch_call) {
+  // Extensions route batches through the registry as flattened writes.
+  PluginRequest request = {{"action", "batch"},
+                           {"domain", kLogs},
+                           {"count", "2"},
+                           {"op.0", "put"},
+                           {"key.0", "batch_call"},
+                           {"value.0", "1"},
+                           {"op.1", "put"},
+                           {"key.1", "batch_call"},
+                           {"value.1", "2"}};
+  auto s = Registry::call("database", request);
+  EXPECT_TRUE(s.ok());
+
+  // Writes are applied in order.
+  std::string value;
+  getDatabaseValue(kLogs, "batch_call", value);
+  EXPECT_EQ(value, "2");
+
+  // A batch without a count is rejected.
+  request = {{"action", "batch"}, {"domain", kLogs}};
+  s = Registry::call("database", request);
+  EXPECT_FALSE(s.ok());
+}
 }
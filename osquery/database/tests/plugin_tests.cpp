@@ -102,4 +102,107 @@ void DatabasePluginTests::testScanLimit() {
   EXPECT_EQ(s.getMessage(), "OK");
   EXPECT_EQ(keys.size(), 2U);
 }
+
+void DatabasePluginTests::testScanPrefix() {
+  getPlugin()->put(kEvents, "data.test.prefix.1", "a");
+  getPlugin()->put(kEvents, "data.test.prefix.2", "b");
+  getPlugin()->put(kEvents, "data.test.prefix_other.1", "c");
+  getPlugin()->put(kEvents, "data.test.prefiy.1", "d");
+
+  // Only keys beginning with the exact prefix are returned, in order.
+  std::vector<std::string> keys;
+  auto s = getPlugin()->scan(kEvents, keys, "data.test.prefix.");
+  EXPECT_TRUE(s.ok());
+  std::vector<std::string> expected = {"data.test.prefix.1",
+                                       "data.test.prefix.2"};
+  EXPECT_EQ(keys, expected);
+
+  // A prefix that is not a complete namespace is still bounded.
+  keys.clear();
+  s = getPlugin()->scan(kEvents, keys, "data.test.prefix");
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(keys.size(), 3U);
+
+  EXPECT_EQ(DatabasePlugin::getPrefixUpperBound("abc"), "abd");
+  EXPECT_EQ(DatabasePlugin::getPrefixUpperBound("a\xFF"), "b");
+  EXPECT_EQ(DatabasePlugin::getPrefixUpperBound(""), "");
+}
+
+void DatabasePluginTests::testScanRange() {
+  getPlugin()->put(kQueries, "test_range_1", "one");
+  getPlugin()->put(kQueries, "test_range_2", "two");
+  getPlugin()->put(kQueries, "test_range_3", "three");
+  getPlugin()->put(kQueries, "test_rangf", "four");
+
+  // Values are returned alongside keys in a single pass.
+  DatabaseKeyValues values;
+  auto s = getPlugin()->scanRange(
+      kQueries, values, "test_range_", "test_range_3");
+  EXPECT_TRUE(s.ok());
+  DatabaseKeyValues expected = {{"test_range_1", "one"},
+                                {"test_range_2", "two"}};
+  EXPECT_EQ(values, expected);
+
+  // The limit applies to the range.
+  values.clear();
+  s = getPlugin()->scanRange(kQueries, values, "test_range_2", "", 2);
+  EXPECT_TRUE(s.ok());
+  expected = {{"test_range_2", "two"}, {"test_range_3", "three"}};
+  EXPECT_EQ(values, expected);
+}
+
+void DatabasePluginTests::testWriteBatch() {
+  getPlugin()->put(kEvents, "test_batch_remove", "0");
+
+  DatabaseBatch batch;
+  batch.put("test_batch_1", "1");
+  batch.put("test_batch_2", "0");
+  batch.put("test_batch_2", "2");
+  batch.remove("test_batch_remove");
+  auto s = getPlugin()->writeBatch(kEvents, batch);
+  EXPECT_TRUE(s.ok());
+
+  std::string value;
+  getPlugin()->get(kEvents, "test_batch_1", value);
+  EXPECT_EQ(value, "1");
+  getPlugin()->get(kEvents, "test_batch_2", value);
+  EXPECT_EQ(value, "2");
+
+  std::vector<std::string> keys;
+  getPlugin()->scan(kEvents, keys, "test_batch_remove");
+  EXPECT_TRUE(keys.empty());
+}
+
+void DatabasePluginTests::testRemoveRange() {
+  getPlugin()->put(kEvents, "data.test.range.1", "1");
+  getPlugin()->put(kEvents, "data.test.range.2", "2");
+  getPlugin()->put(kEvents, "data.test.range.3", "3");
+  getPlugin()->put(kEvents, "data.test.range.4", "4");
+  getPlugin()->put(kEvents, "data.test.rangf", "5");
+
+  // The stop key is exclusive.
+  auto s = getPlugin()->removeRange(
+      kEvents, "data.test.range.2", "data.test.range.4");
+  EXPECT_TRUE(s.ok());
+
+  std::vector<std::string> keys;
+  getPlugin()->scan(kEvents, keys, "data.test.range.");
+  ASSERT_EQ(2U, keys.size());
+  EXPECT_EQ("data.test.range.1", keys[0]);
+  EXPECT_EQ("data.test.range.4", keys[1]);
+
+  // Remove every key with a prefix.
+  auto prefix = std::string("data.test.range.");
+  s = getPlugin()->removeRange(
+      kEvents, prefix, DatabasePlugin::getPrefixUpperBound(prefix));
+  EXPECT_TRUE(s.ok());
+  keys.clear();
+  getPlugin()->scan(kEvents, keys, prefix);
+  EXPECT_TRUE(keys.empty());
+
+  // Keys outside of the range are not removed.
+  std::string value;
+  getPlugin()->get(kEvents, "data.test.rangf", value);
+  EXPECT_EQ("5", value);
+}
 }
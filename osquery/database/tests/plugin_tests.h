@@ -41,6 +41,18 @@
   }                                                                            \
   TEST_F(n, test_scan_limit) {                                                 \
     testScanLimit();                                                           \
+  }                                                                            \
+  TEST_F(n, test_scan_prefix) {                                                \
+    testScanPrefix();                                                          \
+  }                                                                            \
+  TEST_F(n, test_scan_range) {                                                 \
+    testScanRange();                                                           \
+  }                                                                            \
+  TEST_F(n, test_write_batch) {                                                \
+    testWriteBatch();                                                          \
+  }                                                                            \
+  TEST_F(n, test_remove_range) {                                               \
+    testRemoveRange();                                                         \
   }
 
 namespace osquery {
@@ -106,5 +118,9 @@ class DatabasePluginTests : public testing::Test {
   void testDelete();
   void testScan();
   void testScanLimit();
+  void testScanPrefix();
+  void testScanRange();
+  void testWriteBatch();
+  void testRemoveRange();
 };
 }
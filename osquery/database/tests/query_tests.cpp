@@ -116,6 +116,67 @@ TEST_F(QueryTests, test_query_name_updated) {
   EXPECT_FALSE(cf2.isNewQuery());
 }
 
+TEST_F(QueryTests, test_query_metadata) {
+  auto query = getOsqueryScheduledQuery();
+  auto cf = Query("metadata_query", query);
+  QueryMetadata metadata;
+  EXPECT_FALSE(cf.getQueryMetadata(metadata).ok());
+
+  auto results = getTestDBExpectedResults();
+  DiffResults dr;
+  EXPECT_TRUE(cf.addNewResults(results, dr).ok());
+  EXPECT_TRUE(cf.getQueryMetadata(metadata).ok());
+  EXPECT_EQ(metadata.query_hash, getFingerprint(query.query));
+  EXPECT_GT(metadata.last_executed, 0U);
+  EXPECT_EQ(metadata.rows, results.size());
+  EXPECT_EQ(metadata.added, results.size());
+  EXPECT_EQ(metadata.removed, 0U);
+  EXPECT_EQ(metadata.results_fingerprint, getQueryDataFingerprint(results));
+
+  // Unchanged results do not produce a differential.
+  DiffResults unchanged;
+  EXPECT_TRUE(cf.addNewResults(results, unchanged).ok());
+  EXPECT_TRUE(unchanged.added.empty());
+  EXPECT_TRUE(unchanged.removed.empty());
+  EXPECT_TRUE(cf.getQueryMetadata(metadata).ok());
+  EXPECT_EQ(metadata.added, 0U);
+
+  // Results removed without their metadata are stored again when changed.
+  deleteDatabaseValue(kQueries, "metadata_query");
+  results.push_back({{"username", "new_user"}, {"age", "1"}});
+  EXPECT_TRUE(cf.addNewResults(results, dr).ok());
+  EXPECT_EQ(dr.added, results);
+  QueryData previous_qd;
+  EXPECT_TRUE(cf.getPreviousQueryResults(previous_qd).ok());
+  EXPECT_EQ(previous_qd, results);
+}
+
+TEST_F(QueryTests, test_query_metadata_legacy) {
+  // Results stored by a previous version include the query text separately.
+  auto query = getOsqueryScheduledQuery();
+  auto encoded_qd = getSerializedQueryDataJSON();
+  setDatabaseValue(kQueries, "legacy_query", encoded_qd.first);
+  setDatabaseValue(kQueries, "query.legacy_query", query.query);
+
+  auto cf = Query("legacy_query", query);
+  EXPECT_TRUE(cf.isQueryNameInDatabase());
+  EXPECT_FALSE(cf.isNewQuery());
+
+  // The differential is calculated from the legacy results.
+  DiffResults dr;
+  EXPECT_TRUE(cf.addNewResults(encoded_qd.second, dr).ok());
+  EXPECT_TRUE(dr.added.empty());
+  EXPECT_TRUE(dr.removed.empty());
+
+  // The legacy query text is replaced by the metadata.
+  std::string content;
+  EXPECT_FALSE(getDatabaseValue(kQueries, "query.legacy_query", content).ok());
+  QueryMetadata metadata;
+  EXPECT_TRUE(cf.getQueryMetadata(metadata).ok());
+  EXPECT_GT(metadata.last_executed, 0U);
+  EXPECT_FALSE(cf.isNewQuery());
+}
+
 TEST_F(QueryTests, test_get_stored_query_names) {
   auto query = getOsqueryScheduledQuery();
   auto cf = Query("foobar", query);
@@ -15,6 +15,7 @@
 #include <gtest/gtest.h>
 
 #include <osquery/database.h>
+#include <osquery/flags.h>
 #include <osquery/logger.h>
 
 #include "osquery/tests/test_util.h"
@@ -23,6 +24,8 @@ namespace pt = boost::property_tree;
 
 namespace osquery {
 
+DECLARE_bool(decorations_top_level);
+
 class ResultsTests : public testing::Test {};
 
 TEST_F(ResultsTests, test_simple_diff) {
@@ -99,6 +102,226 @@ TEST_F(ResultsTests, test_deserialize_query_data_json) {
   EXPECT_EQ(output, results.second);
 }
 
+TEST_F(ResultsTests, test_serialize_row_binary) {
+  auto results = getSerializedRow();
+  std::string bin;
+  auto s = serializeRowBinary(results.second, bin);
+  EXPECT_TRUE(s.ok());
+  EXPECT_TRUE(isBinaryEncoded(bin));
+
+  Row output;
+  s = deserializeRowBinary(bin, output);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(output, results.second);
+
+  // Legacy JSON content is still accepted.
+  std::string json;
+  serializeRowJSON(results.second, json);
+  EXPECT_FALSE(isBinaryEncoded(json));
+  output.clear();
+  s = deserializeRowBinary(json, output);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(output, results.second);
+}
+
+TEST_F(ResultsTests, test_serialize_query_data_binary) {
+  auto results = getSerializedQueryDataJSON();
+  // Include a row with a missing column and a row with an empty value.
+  results.second.push_back({{"name", "missing_meaning"}});
+  results.second.push_back({{"meaning_of_life", ""}, {"name", ""}});
+
+  std::string bin;
+  auto s = serializeQueryDataBinary(results.second, bin);
+  EXPECT_TRUE(s.ok());
+
+  QueryData output;
+  s = deserializeQueryDataBinary(bin, output);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(output, results.second);
+
+  // The JSON content in the pair is legacy-encoded.
+  output.clear();
+  s = deserializeQueryDataBinary(results.first, output);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(output.size(), results.second.size() - 2);
+
+  // An empty result set is not the same as empty content.
+  s = serializeQueryDataBinary({}, bin);
+  EXPECT_TRUE(s.ok());
+  output.clear();
+  EXPECT_TRUE(deserializeQueryDataBinary(bin, output).ok());
+  EXPECT_TRUE(output.empty());
+}
+
+TEST_F(ResultsTests, test_deserialize_query_data_binary_invalid) {
+  QueryData qd = {{{"name", "osquery"}, {"version", "2.0"}}};
+  std::string bin;
+  serializeQueryDataBinary(qd, bin);
+
+  // Every truncation of the content is an error.
+  QueryData output;
+  for (size_t i = 2; i < bin.size(); i++) {
+    EXPECT_FALSE(deserializeQueryDataBinary(bin.substr(0, i), output).ok());
+  }
+
+  // An unknown encoding version is an error.
+  bin[1] = 0x7F;
+  EXPECT_FALSE(deserializeQueryDataBinary(bin, output).ok());
+}
+
+TEST_F(ResultsTests, test_query_data_view) {
+  QueryData qd = {
+      {{"name", "osquery"}, {"version", "2.0"}},
+      {{"name", "sqlite"}},
+  };
+  std::string bin;
+  serializeQueryDataBinary(qd, bin);
+
+  QueryDataView view;
+  auto s = view.load(bin);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(view.rows(), 2U);
+  ASSERT_EQ(view.columns().size(), 2U);
+  EXPECT_EQ(view.columns()[0], "name");
+  EXPECT_EQ(view.columns()[1], "version");
+
+  EXPECT_EQ(view.get(0, 0), "osquery");
+  EXPECT_EQ(view.get(0, 1), "2.0");
+  EXPECT_EQ(view.get(1, 0), "sqlite");
+  EXPECT_FALSE(view.has(1, 1));
+  EXPECT_EQ(view.getRow(1), qd[1]);
+
+  // Values reference the binary content.
+  EXPECT_GE(view.get(0, 0).data(), bin.data());
+  EXPECT_LT(view.get(0, 0).data(), bin.data() + bin.size());
+
+  // The view does not parse legacy JSON.
+  std::string json;
+  serializeQueryDataJSON(qd, json);
+  EXPECT_FALSE(view.load(json).ok());
+  EXPECT_EQ(view.rows(), 0U);
+}
+
+TEST_F(ResultsTests, test_compact_query_data) {
+  // Columns are added in table order, not name order.
+  CompactQueryData compact({"version", "name"});
+  EXPECT_EQ(compact.getColumnIndex("name"), 1U);
+  EXPECT_EQ(compact.getColumnIndex("missing"), 2U);
+
+  QueryData qd = {
+      {{"name", "osquery"}, {"version", "2.0"}},
+      {{"name", "sqlite"}},
+      {{"name", ""}, {"license", "BSD"}},
+  };
+  for (const auto& r : qd) {
+    compact.addRow(r);
+  }
+
+  // The new column widened the earlier rows.
+  ASSERT_EQ(compact.rows(), 3U);
+  ASSERT_EQ(compact.columns().size(), 3U);
+  EXPECT_EQ(compact.get(0, 0), "2.0");
+  EXPECT_FALSE(compact.has(1, 0));
+  EXPECT_EQ(compact.get(1, 0), "");
+  EXPECT_TRUE(compact.has(2, 1));
+  EXPECT_FALSE(compact.has(0, 2));
+  EXPECT_EQ(compact.get(2, 2), "BSD");
+  EXPECT_EQ(compact.getQueryData(), qd);
+
+  // Native numbers are formatted when read as text.
+  auto row = compact.addRow();
+  compact.setInteger(row, compact.getColumnIndex("version"), -42);
+  compact.setDouble(row, compact.getColumnIndex("name"), 0.5);
+  EXPECT_EQ(compact.type(row, 0), CellType::INTEGER);
+  EXPECT_EQ(compact.getInteger(row, 0), -42);
+  EXPECT_EQ(compact.type(row, 1), CellType::DOUBLE);
+  EXPECT_FALSE(compact.has(row, 2));
+  Row expected_row = {{"name", "0.5"}, {"version", "-42"}};
+  EXPECT_EQ(compact.getRow(row), expected_row);
+
+  // Clearing keeps the schema.
+  compact.clear();
+  EXPECT_EQ(compact.rows(), 0U);
+  EXPECT_EQ(compact.columns().size(), 4U);
+}
+
+TEST_F(ResultsTests, test_diff_duplicate_rows) {
+  Row r1 = {{"name", "bash"}};
+  Row r2 = {{"name", "zsh"}};
+
+  // A removed duplicate row is reported once per removed copy.
+  auto results = diff({r1, r1, r2}, {r1, r2});
+  EXPECT_TRUE(results.added.empty());
+  EXPECT_EQ(results.removed, QueryData({r1}));
+
+  // A row that exists in the previous results is not added again.
+  results = diff({r1}, {r1, r1, r2});
+  EXPECT_EQ(results.added, QueryData({r2}));
+  EXPECT_TRUE(results.removed.empty());
+}
+
+TEST_F(ResultsTests, test_diff_stored_results) {
+  auto old_qd = getTestDBExpectedResults();
+  for (const auto& result : getTestDBResultStream()) {
+    auto expected = diff(old_qd, result.second);
+
+    // Indexed, non-indexed, and legacy JSON previous results are supported.
+    std::string indexed;
+    EXPECT_TRUE(serializeQueryDataIndexed(old_qd, indexed).ok());
+    std::string binary;
+    serializeQueryDataBinary(old_qd, binary);
+    std::string json;
+    serializeQueryDataJSON(old_qd, json);
+
+    for (const auto& previous : {indexed, binary, json}) {
+      for (const auto verify : {false, true}) {
+        DiffResults dr;
+        auto s = diffStoredResults(previous, result.second, dr, verify);
+        EXPECT_TRUE(s.ok());
+        EXPECT_EQ(expected, dr);
+      }
+    }
+
+    // Indexed results keep the original row order.
+    QueryData output;
+    EXPECT_TRUE(deserializeQueryDataBinary(indexed, output).ok());
+    EXPECT_EQ(old_qd, output);
+    old_qd = result.second;
+  }
+}
+
+TEST_F(ResultsTests, test_diff_stored_results_verify) {
+  Row r1 = {{"path", "/bin/ls"}};
+  Row r2 = {{"path", "/bin/cat"}};
+
+  std::string previous;
+  serializeQueryDataIndexed({r1}, previous);
+
+  // Simulate a collision by replacing the stored fingerprint of r1 with r2's.
+  auto fingerprint = getRowFingerprint(r1);
+  auto replacement = getRowFingerprint(r2);
+  std::string from;
+  std::string to;
+  for (size_t i = 0; i < 8; i++) {
+    from.push_back(static_cast<char>((fingerprint >> (i * 8)) & 0xFF));
+    to.push_back(static_cast<char>((replacement >> (i * 8)) & 0xFF));
+  }
+  auto pos = previous.find(from);
+  ASSERT_NE(pos, std::string::npos);
+  previous.replace(pos, 8, to);
+
+  // Without verification the rows are considered equal.
+  DiffResults dr;
+  EXPECT_TRUE(diffStoredResults(previous, {r2}, dr, false).ok());
+  EXPECT_TRUE(dr.added.empty());
+  EXPECT_TRUE(dr.removed.empty());
+
+  // Verification compares the full rows.
+  EXPECT_TRUE(diffStoredResults(previous, {r2}, dr, true).ok());
+  EXPECT_EQ(dr.added, QueryData({r2}));
+  EXPECT_EQ(dr.removed, QueryData({r1}));
+}
+
 TEST_F(ResultsTests, test_serialize_diff_results) {
   auto results = getSerializedDiffResults();
   pt::ptree tree;
@@ -146,6 +369,70 @@ TEST_F(ResultsTests, test_deserialize_query_log_item_json) {
   EXPECT_EQ(output, results.second);
 }
 
+TEST_F(ResultsTests, test_write_query_log_item_json) {
+  auto results = getSerializedQueryLogItemJSON();
+  // Include values that require escaping and an empty set of removed rows.
+  results.second.results.added.push_back(
+      {{"path", "/tmp/\"quoted\"\\\n\t\x01"}, {"name", "caf\xc3\xa9"}});
+  results.second.results.removed.clear();
+  results.second.decorations["load_average"] = "1.0";
+
+  for (const auto top_level : {false, true}) {
+    FLAGS_decorations_top_level = top_level;
+    std::string expected;
+    serializeQueryLogItemJSON(results.second, expected);
+    expected.pop_back();
+
+    std::string json;
+    writeQueryLogItemJSON(results.second, json);
+    EXPECT_EQ(expected, json);
+
+    // A top-level decoration replaces a reserved field.
+    if (top_level) {
+      results.second.decorations["name"] = "decorated";
+      serializeQueryLogItemJSON(results.second, expected);
+      expected.pop_back();
+      writeQueryLogItemJSON(results.second, json);
+      EXPECT_EQ(expected, json);
+      results.second.decorations.erase("name");
+    }
+  }
+  FLAGS_decorations_top_level = false;
+
+  // Snapshots use the same writer.
+  QueryLogItem snapshot;
+  snapshot.name = "snapshot";
+  snapshot.snapshot_results = results.second.results.added;
+  std::string expected;
+  serializeQueryLogItemJSON(snapshot, expected);
+  expected.pop_back();
+
+  std::string json;
+  writeQueryLogItemJSON(snapshot, json);
+  EXPECT_EQ(expected, json);
+}
+
+TEST_F(ResultsTests, test_write_query_log_event_json) {
+  auto results = getSerializedQueryLogItem();
+  results.second.decorations["load_average"] = "1.0";
+
+  std::vector<std::string> expected;
+  auto s = serializeQueryLogItemAsEventsJSON(results.second, expected);
+  EXPECT_TRUE(s.ok());
+
+  std::vector<std::string> events;
+  std::string json;
+  for (const auto& row : results.second.results.removed) {
+    writeQueryLogEventJSON(results.second, "removed", row, json);
+    events.push_back(json + "\n");
+  }
+  for (const auto& row : results.second.results.added) {
+    writeQueryLogEventJSON(results.second, "added", row, json);
+    events.push_back(json + "\n");
+  }
+  EXPECT_EQ(expected, events);
+}
+
 TEST_F(ResultsTests, test_adding_duplicate_rows_to_query_data) {
   Row r1, r2, r3;
   r1["foo"] = "bar";
@@ -794,6 +794,10 @@ static int shell_exec(
     osquery::RecursiveLock lock(osquery::kAttachMutex);
 
     rc = sqlite3_prepare_v2(db, zSql, -1, &pStmt, &zLeftover);
+    while (SQLITE_OK != rc && osquery::attachLazyTable(db)) {
+      /* The statement referenced a table that was not attached yet. */
+      rc = sqlite3_prepare_v2(db, zSql, -1, &pStmt, &zLeftover);
+    }
     if (SQLITE_OK != rc) {
       if (pzErrMsg) {
         *pzErrMsg = save_err_msg(db);
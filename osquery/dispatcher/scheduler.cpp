@@ -22,6 +22,7 @@
 #include "osquery/database/query.h"
 #include "osquery/dispatcher/scheduler.h"
 #include "osquery/sql/sqlite_util.h"
+#include "osquery/sql/virtual_table.h"
 
 namespace osquery {
 
@@ -34,37 +35,76 @@ FLAG(uint64,
      7200,
      "Interval in seconds to reload database arenas");
 
+FLAG(uint64,
+     schedule_max_workers,
+     0,
+     "Execute scheduled queries on this many threads, 0 executes them in turn");
+
+FLAG(uint64,
+     schedule_cpu_budget,
+     0,
+     "Percent of one CPU the process may use before scheduler workers pause");
+
+FLAG(string,
+     schedule_missed,
+     "once",
+     "Missed query deadlines: once (run late once), all (catch up), skip");
+
 /// Used to bypass (optimize-out) the set-differential of query results.
 DECLARE_bool(events_optimize);
 
 SQLInternal monitor(const std::string& name, const ScheduledQuery& query) {
-  // Snapshot the performance and times for the worker before running.
-  auto pid = std::to_string(PlatformProcess::getCurrentProcess()->pid());
-  auto r0 = SQL::selectAllFrom("processes", "pid", EQUALS, pid);
-  auto t0 = getUnixTime();
+  // Sample this thread's CPU time, the allocator, and a monotonic clock.
+  // Queries may execute on scheduler workers; thread CPU time is not shared.
+  size_t user0 = 0, system0 = 0;
+  platformGetThreadCPUTime(user0, system0);
+  auto heap0 = platformGetHeapAllocated();
+  auto t0 = std::chrono::steady_clock::now();
   Config::getInstance().recordQueryStart(name);
+
+  QueryResourceUsage usage;
+  TableUsageCollector collector;
   SQLInternal sql(query.query);
-  // Snapshot the performance after, and compare.
-  auto t1 = getUnixTime();
-  auto r1 = SQL::selectAllFrom("processes", "pid", EQUALS, pid);
-  if (r0.size() > 0 && r1.size() > 0) {
-    // Calculate a size as the expected byte output of results.
-    // This does not dedup result differentials and is not aware of snapshots.
-    size_t size = 0;
-    for (const auto& row : sql.rows()) {
-      for (const auto& column : row) {
-        size += column.first.size();
-        size += column.second.size();
-      }
+
+  // Sample again after, and compare.
+  auto t1 = std::chrono::steady_clock::now();
+  auto heap1 = platformGetHeapAllocated();
+  size_t user1 = 0, system1 = 0;
+  platformGetThreadCPUTime(user1, system1);
+
+  usage.wall_time_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+  usage.user_time = (user1 > user0) ? user1 - user0 : 0;
+  usage.system_time = (system1 > system0) ? system1 - system0 : 0;
+  usage.heap_delta =
+      static_cast<long long int>(heap1) - static_cast<long long int>(heap0);
+  usage.tables = collector.getUsage();
+
+  // Calculate a size as the expected byte output of results.
+  // This does not dedup result differentials and is not aware of snapshots.
+  size_t size = 0;
+  for (const auto& row : sql.rows()) {
+    for (const auto& column : row) {
+      size += column.first.size();
+      size += column.second.size();
     }
-    // Always called while processes table is working.
-    Config::getInstance().recordQueryPerformance(
-        name, t1 - t0, size, r0[0], r1[0]);
   }
+  Config::getInstance().recordQueryPerformance(
+      name, usage, size, sql.cached());
   return sql;
 }
 
-inline void launchQuery(const std::string& name, const ScheduledQuery& query) {
+void launchQuery(size_t step,
+                 const std::string& name,
+                 const ScheduledQuery& query) {
+  // Record how long after its scheduled second the query began.
+  auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                 std::chrono::system_clock::now().time_since_epoch())
+                 .count();
+  auto due = static_cast<long long>(step) * 1000;
+  Config::getInstance().recordQueryLag(
+      name, (now > due) ? static_cast<size_t>(now - due) : 0);
+
   // Execute the scheduled query and create a named query object.
   LOG(INFO) << "Executing scheduled query " << name << ": " << query.query;
   runDecorators(DECORATE_ALWAYS);
@@ -142,33 +182,285 @@ inline void launchQuery(const std::string& name, const ScheduledQuery& query) {
   }
 }
 
+void ScheduleQueue::refresh(size_t now) {
+  auto& config = Config::getInstance();
+  auto generation = config.getScheduleGeneration();
+  if (loaded_ && generation == generation_) {
+    return;
+  }
+
+  std::vector<ScheduleEntry> entries;
+  config.allScheduledQueries([&entries](const std::shared_ptr<Pack>& pack,
+                                        const std::string& name,
+                                        const ScheduledQuery& query) {
+    if (query.splayed_interval > 0) {
+      ScheduleEntry entry;
+      entry.pack = pack;
+      entry.name = name;
+      entry.query = query;
+      entries.push_back(std::move(entry));
+    }
+  });
+  load(std::move(entries), now);
+  generation_ = generation;
+}
+
+void ScheduleQueue::load(std::vector<ScheduleEntry> entries, size_t now) {
+  entries_ = std::move(entries);
+  deadlines_ = decltype(deadlines_)();
+  for (size_t i = 0; i < entries_.size(); i++) {
+    auto interval = entries_[i].query.splayed_interval;
+    if (interval > 0) {
+      // The first multiple of the interval at or after now.
+      deadlines_.push(
+          std::make_pair((now + interval - 1) / interval * interval, i));
+    }
+  }
+  loaded_ = true;
+}
+
+void ScheduleQueue::pop(
+    size_t now,
+    size_t tolerance,
+    std::function<void(size_t step, const ScheduleEntry& entry)> predicate) {
+  // Collect every due deadline first, a catch-up deadline may still be due.
+  std::vector<Deadline> due;
+  while (!deadlines_.empty() && deadlines_.top().first <= now) {
+    due.push_back(deadlines_.top());
+    deadlines_.pop();
+  }
+
+  for (const auto& deadline : due) {
+    const auto& entry = entries_[deadline.second];
+    auto interval = entry.query.splayed_interval;
+    // The most recent deadline at or before now.
+    auto latest = now - (now % interval);
+
+    auto step = latest;
+    bool run = true;
+    if (FLAGS_schedule_missed == "all") {
+      // Execute every missed deadline in order, one for each tick.
+      step = deadline.first;
+    } else if (FLAGS_schedule_missed == "skip") {
+      run = (now - latest <= tolerance);
+    }
+
+    deadlines_.push(std::make_pair(step + interval, deadline.second));
+    if (run) {
+      predicate(step, entry);
+    }
+  }
+}
+
+ScheduleWorkerPool::ScheduleWorkerPool(size_t workers, size_t cpu_budget)
+    : cpu_budget_(cpu_budget) {
+  for (size_t i = 0; i < workers; i++) {
+    threads_.emplace_back([this]() { work(); });
+  }
+}
+
+ScheduleWorkerPool::~ScheduleWorkerPool() {
+  stop();
+}
+
+bool ScheduleWorkerPool::dispatch(size_t step,
+                                  const std::string& name,
+                                  const ScheduledQuery& query) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_ || pending_.count(name) > 0) {
+      return false;
+    }
+
+    Task task;
+    task.step = step;
+    task.name = name;
+    task.query = query;
+    pending_.insert(name);
+    queue_.push_back(std::move(task));
+  }
+  cv_.notify_one();
+  return true;
+}
+
+std::deque<ScheduleWorkerPool::Task>::iterator
+ScheduleWorkerPool::findRunnable() {
+  for (auto it = queue_.begin(); it != queue_.end(); ++it) {
+    auto limit = it->query.pack_concurrency;
+    auto running = pack_running_.find(it->query.pack);
+    if (limit == 0 || running == pack_running_.end() ||
+        running->second < limit) {
+      return it;
+    }
+  }
+  return queue_.end();
+}
+
+void ScheduleWorkerPool::work() {
+  while (true) {
+    Task task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      auto next = queue_.end();
+      cv_.wait(lock, [this, &next]() {
+        if (stopping_) {
+          return true;
+        }
+        next = (over_budget_) ? queue_.end() : findRunnable();
+        return next != queue_.end();
+      });
+
+      if (stopping_) {
+        return;
+      }
+      task = std::move(*next);
+      queue_.erase(next);
+      running_++;
+      pack_running_[task.query.pack]++;
+    }
+
+    // The table cache interval and step are set for this thread.
+    TablePlugin::kCacheInterval = task.query.splayed_interval;
+    TablePlugin::kCacheStep = task.step;
+    launchQuery(task.step, task.name, task.query);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_--;
+      pack_running_[task.query.pack]--;
+      pending_.erase(task.name);
+    }
+    // A finished query may allow another from its pack, or end a wait.
+    cv_.notify_all();
+  }
+}
+
+void ScheduleWorkerPool::tick() {
+  auto now = std::chrono::steady_clock::now();
+  auto cpu = platformGetProcessCPUTime();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (cpu_budget_ > 0 && last_tick_.time_since_epoch().count() > 0) {
+      auto wall = std::chrono::duration_cast<std::chrono::microseconds>(
+                      now - last_tick_)
+                      .count();
+      if (wall > 0) {
+        over_budget_ = ((cpu - last_cpu_) * 100 >
+                        cpu_budget_ * static_cast<size_t>(wall));
+      }
+    }
+    last_cpu_ = cpu;
+    last_tick_ = now;
+  }
+  cv_.notify_all();
+}
+
+void ScheduleWorkerPool::wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // The budget is not sampled while waiting, do not hold queries back.
+  over_budget_ = false;
+  cv_.notify_all();
+  cv_.wait(lock,
+           [this]() { return stopping_ || (queue_.empty() && running_ == 0); });
+}
+
+void ScheduleWorkerPool::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    queue_.clear();
+  }
+  cv_.notify_all();
+
+  // Executing queries cannot be interrupted, wait for them to finish.
+  for (auto& thread : threads_) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+  threads_.clear();
+}
+
 void SchedulerRunner::start() {
-  // Start the counter at the second.
-  auto i = osquery::getUnixTime();
-  for (; (timeout_ == 0) || (i <= timeout_); ++i) {
-    Config::getInstance().scheduledQueries(
-        ([&i](const std::string& name, const ScheduledQuery& query) {
-          if (query.splayed_interval > 0 && i % query.splayed_interval == 0) {
-            TablePlugin::kCacheInterval = query.splayed_interval;
-            TablePlugin::kCacheStep = i;
-            launchQuery(name, query);
-          }
-        }));
-    // Configuration decorators run on 60 second intervals only.
-    if ((i % 60) == 0) {
-      runDecorators(DECORATE_INTERVAL, i);
-    }
-    if (FLAGS_schedule_reload > 0 && (i % FLAGS_schedule_reload) == 0) {
-      SQLiteDBManager::resetPrimary();
-      resetDatabase();
-    }
-
-    // Put the thread into an interruptible sleep without a config instance.
-    pauseMilli(interval_ * 1000);
+  std::unique_ptr<ScheduleWorkerPool> workers;
+  if (FLAGS_schedule_max_workers > 0) {
+    workers = std::make_unique<ScheduleWorkerPool>(FLAGS_schedule_max_workers,
+                                                   FLAGS_schedule_cpu_budget);
+  }
+
+  // Execute, or hand to a worker, each due query that is still scheduled.
+  auto launch = [&workers](size_t step, const ScheduleEntry& entry) {
+    if (!Config::getInstance().isScheduled(entry.pack, entry.name)) {
+      return;
+    }
+
+    if (workers != nullptr) {
+      if (!workers->dispatch(step, entry.name, entry.query)) {
+        VLOG(1) << "Skipping scheduled query " << entry.name
+                << ": the previous execution has not finished";
+      }
+      return;
+    }
+    TablePlugin::kCacheInterval = entry.query.splayed_interval;
+    TablePlugin::kCacheStep = step;
+    launchQuery(step, entry.name, entry.query);
+  };
+
+  ScheduleQueue schedule;
+  // The previous tick, the first tick is the current second.
+  size_t last = getUnixTime() - 1;
+  while (true) {
+    auto now = getUnixTime();
+    if (timeout_ > 0 && now > timeout_) {
+      break;
+    }
+
+    // A tick may wake early if the system clock moved backward.
+    if (now > last) {
+      if (workers != nullptr) {
+        workers->tick();
+      }
+
+      schedule.refresh(now);
+      schedule.pop(now, interval_, launch);
+
+      // Configuration decorators run on 60 second intervals only.
+      if (now / 60 != last / 60) {
+        runDecorators(DECORATE_INTERVAL, now);
+      }
+      if (FLAGS_schedule_reload > 0 &&
+          now / FLAGS_schedule_reload != last / FLAGS_schedule_reload) {
+        if (workers != nullptr) {
+          // Executing queries hold database and SQLite resources.
+          workers->wait();
+        }
+        SQLiteDBManager::resetPrimary();
+        resetDatabase();
+      }
+      last = now;
+    }
+
+    // Sleep until the next tick on the wall clock, so the time spent
+    // executing queries does not delay later ticks.
+    auto current = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                       .count();
+    auto next = static_cast<long long>(now + interval_) * 1000;
+    if (next > current) {
+      pauseMilli(static_cast<size_t>(next - current));
+    }
     if (interrupted()) {
       break;
     }
   }
+
+  if (workers != nullptr) {
+    if (!interrupted()) {
+      // The schedule timeout was reached, let dispatched queries finish.
+      workers->wait();
+    }
+    workers->stop();
+  }
 }
 
 void startScheduler() {
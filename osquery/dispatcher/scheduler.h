@@ -10,14 +10,177 @@
 
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <map>
+#include <mutex>
+#include <queue>
+#include <set>
+#include <thread>
+#include <vector>
 
 #include <osquery/dispatcher.h>
+#include <osquery/packs.h>
 
 #include "osquery/sql/sqlite_util.h"
 
 namespace osquery {
 
+/// A scheduled query tracked by the ScheduleQueue.
+struct ScheduleEntry {
+  /// The owning pack, used to check discovery when the query is due.
+  std::shared_ptr<Pack> pack;
+
+  /// The unique name of the scheduled query.
+  std::string name;
+
+  /// A copy of the query taken when the schedule was loaded.
+  ScheduledQuery query;
+};
+
+/**
+ * @brief The next-run deadlines of every scheduled query.
+ *
+ * Deadlines are UNIX times in seconds aligned to each query's splayed
+ * interval, so execution time never accumulates as drift. They are kept in a
+ * min-heap that is rebuilt only when the configured packs change, so a tick
+ * costs O(log n) for each due query rather than a scan of the schedule.
+ *
+ * --schedule_missed selects what happens when a tick is late by more than a
+ * query's interval, for example after the host was suspended.
+ */
+class ScheduleQueue : private boost::noncopyable {
+ public:
+  /// Reload the entries from the config if its packs changed.
+  void refresh(size_t now);
+
+  /**
+   * @brief Replace the entries and compute their first deadlines.
+   *
+   * @param entries Every scheduled query.
+   * @param now Deadlines at or after this time are scheduled.
+   */
+  void load(std::vector<ScheduleEntry> entries, size_t now);
+
+  /**
+   * @brief Call a predicate for each query due at or before now.
+   *
+   * Each due query is rescheduled at its next deadline before the next call.
+   *
+   * @param now The UNIX time in seconds of this tick.
+   * @param tolerance The seconds a deadline may be late under the skip policy.
+   * @param predicate Called with the due step and the scheduled query.
+   */
+  void pop(size_t now,
+           size_t tolerance,
+           std::function<void(size_t step, const ScheduleEntry& entry)>
+               predicate);
+
+  /// The number of scheduled queries.
+  size_t size() const {
+    return entries_.size();
+  }
+
+ private:
+  /// A deadline and the index of its entry.
+  using Deadline = std::pair<size_t, size_t>;
+
+  std::vector<ScheduleEntry> entries_;
+
+  /// The earliest deadline is on top.
+  std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>>
+      deadlines_;
+
+  /// The config schedule generation the entries were loaded from.
+  size_t generation_{0};
+  bool loaded_{false};
+};
+
+/**
+ * @brief Run due scheduled queries on a bounded set of worker threads.
+ *
+ * A slow query no longer delays every other query due in the same second.
+ * A query is never queued or executed twice at once; if it is still pending
+ * when it is due again that run is skipped. A pack may limit how many of its
+ * queries execute at once, and a process CPU budget, as a percent of one CPU,
+ * holds back new executions while the process is over budget.
+ */
+class ScheduleWorkerPool : private boost::noncopyable {
+ public:
+  ScheduleWorkerPool(size_t workers, size_t cpu_budget);
+  ~ScheduleWorkerPool();
+
+  /**
+   * @brief Queue a due query for a worker.
+   *
+   * @param step The UNIX time in seconds the query was due.
+   * @param name The unique name of the scheduled query.
+   * @param query The scheduled query.
+   * @return false if the query is already queued or executing.
+   */
+  bool dispatch(size_t step,
+                const std::string& name,
+                const ScheduledQuery& query);
+
+  /// Sample process CPU usage since the last tick and apply the budget.
+  void tick();
+
+  /// Block until no query is queued or executing.
+  void wait();
+
+  /// Drop queued queries and join the workers after they finish.
+  void stop();
+
+ private:
+  /// A query waiting for a worker.
+  struct Task {
+    size_t step{0};
+    std::string name;
+    ScheduledQuery query;
+  };
+
+  /// Worker thread entry point.
+  void work();
+
+  /// Find the first queued query whose pack is below its limit.
+  std::deque<Task>::iterator findRunnable();
+
+ private:
+  /// Queued queries in due order.
+  std::deque<Task> queue_;
+
+  /// Names of queued and executing queries.
+  std::set<std::string> pending_;
+
+  /// Number of executing queries for each pack.
+  std::map<std::string, size_t> pack_running_;
+
+  /// Number of executing queries.
+  size_t running_{0};
+
+  /// Percent of one CPU the process may use, 0 for no limit.
+  size_t cpu_budget_{0};
+
+  /// True while the process used more CPU than the budget in the last tick.
+  bool over_budget_{false};
+
+  /// The process CPU and wall time in microseconds at the last tick.
+  size_t last_cpu_{0};
+  std::chrono::steady_clock::time_point last_tick_;
+
+  /// Set when the pool is stopping.
+  bool stopping_{false};
+
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+
+ private:
+  FRIEND_TEST(SchedulerTests, test_worker_pool);
+};
+
 /// A Dispatcher service thread that watches an ExtensionManagerHandler.
 class SchedulerRunner : public InternalRunnable {
  public:
@@ -44,6 +207,17 @@ class SchedulerRunner : public InternalRunnable {
 
 SQLInternal monitor(const std::string& name, const ScheduledQuery& query);
 
+/**
+ * @brief Execute a scheduled query and log its results.
+ *
+ * @param step The UNIX time in seconds the query was due.
+ * @param name The unique name of the scheduled query.
+ * @param query The scheduled query.
+ */
+void launchQuery(size_t step,
+                 const std::string& name,
+                 const ScheduledQuery& query);
+
 /// Start querying according to the config's schedule
 void startScheduler();
 
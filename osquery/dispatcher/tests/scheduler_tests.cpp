@@ -21,6 +21,7 @@ namespace osquery {
 
 DECLARE_bool(disable_logging);
 DECLARE_uint64(schedule_reload);
+DECLARE_string(schedule_missed);
 
 class SchedulerTests : public testing::Test {
   void SetUp() override {
@@ -63,6 +64,13 @@ TEST_F(SchedulerTests, test_monitor) {
   // performance stats are tracked independently.
   EXPECT_EQ(perf.executions, 1U);
   EXPECT_GT(perf.output_size, 0U);
+  EXPECT_GT(perf.wall_time_ns, 0U);
+
+  // The rows read from each table are recorded.
+  ASSERT_EQ(perf.tables.count("time"), 1U);
+  EXPECT_EQ(perf.tables["time"].scans, 1U);
+  EXPECT_EQ(perf.tables["time"].rows, 1U);
+  EXPECT_GT(perf.tables["time"].bytes, 0U);
 
   // A bit more testing, potentially redundant, check the database results.
   // Since we are only monitoring, no 'actual' results are stored.
@@ -76,6 +84,114 @@ TEST_F(SchedulerTests, test_monitor) {
   EXPECT_FALSE(timestamp.empty());
 }
 
+TEST_F(SchedulerTests, test_worker_pool) {
+  ScheduledQuery query;
+  query.interval = 10;
+  query.splayed_interval = 10;
+  query.query = "select * from time";
+  query.pack = "workers";
+  query.pack_concurrency = 1;
+
+  {
+    // Without workers the queue can be inspected.
+    ScheduleWorkerPool pool(0, 0);
+    EXPECT_TRUE(pool.dispatch(10, "worker_query_1", query));
+    // A query cannot be dispatched while it is still pending.
+    EXPECT_FALSE(pool.dispatch(20, "worker_query_1", query));
+    EXPECT_TRUE(pool.dispatch(10, "worker_query_2", query));
+    EXPECT_EQ(pool.findRunnable(), pool.queue_.begin());
+
+    // The pack's concurrency is exhausted.
+    pool.pack_running_["workers"] = 1;
+    EXPECT_EQ(pool.findRunnable(), pool.queue_.end());
+
+    // Packs without a concurrency are not limited.
+    pool.queue_.back().query.pack_concurrency = 0;
+    EXPECT_EQ(pool.findRunnable(), pool.queue_.end() - 1);
+    pool.pack_running_["workers"] = 0;
+  }
+
+  auto step = static_cast<size_t>(getUnixTime());
+  ScheduleWorkerPool pool(2, 0);
+  EXPECT_TRUE(pool.dispatch(step, "worker_query_1", query));
+  EXPECT_TRUE(pool.dispatch(step, "worker_query_2", query));
+  pool.wait();
+
+  for (const auto& name : {"worker_query_1", "worker_query_2"}) {
+    QueryPerformance perf;
+    Config::getInstance().getPerformanceStats(
+        name, ([&perf](const QueryPerformance& r) { perf = r; }));
+    EXPECT_EQ(perf.executions, 1U);
+    EXPECT_EQ(perf.lag, perf.max_lag);
+  }
+
+  // Once finished the query may be dispatched again.
+  EXPECT_TRUE(pool.dispatch(step + 10, "worker_query_1", query));
+  pool.stop();
+  EXPECT_FALSE(pool.dispatch(step + 20, "worker_query_2", query));
+}
+
+TEST_F(SchedulerTests, test_schedule_queue) {
+  auto backup_missed = FLAGS_schedule_missed;
+
+  std::vector<ScheduleEntry> entries(2);
+  entries[0].name = "every_ten";
+  entries[0].query.splayed_interval = 10;
+  entries[1].name = "every_fifteen";
+  entries[1].query.splayed_interval = 15;
+
+  std::vector<std::pair<size_t, std::string>> due;
+  auto record = ([&due](size_t step, const ScheduleEntry& entry) {
+    due.push_back(std::make_pair(step, entry.name));
+  });
+
+  // Deadlines are aligned to each interval, not to the first tick.
+  ScheduleQueue schedule;
+  schedule.load(entries, 101);
+  EXPECT_EQ(schedule.size(), 2U);
+  for (size_t now = 101; now <= 120; now++) {
+    schedule.pop(now, 1, record);
+  }
+  ASSERT_EQ(due.size(), 4U);
+  EXPECT_EQ(due[0], std::make_pair(size_t(105), std::string("every_fifteen")));
+  EXPECT_EQ(due[1], std::make_pair(size_t(110), std::string("every_ten")));
+  EXPECT_EQ(due[2], std::make_pair(size_t(120), std::string("every_ten")));
+  EXPECT_EQ(due[3], std::make_pair(size_t(120), std::string("every_fifteen")));
+
+  // A late tick executes a query once, for its most recent deadline.
+  FLAGS_schedule_missed = "once";
+  due.clear();
+  schedule.load(entries, 100);
+  schedule.pop(135, 1, record);
+  ASSERT_EQ(due.size(), 2U);
+  EXPECT_EQ(due[0], std::make_pair(size_t(130), std::string("every_ten")));
+  EXPECT_EQ(due[1], std::make_pair(size_t(135), std::string("every_fifteen")));
+
+  // Or executes each missed deadline, one for each tick.
+  FLAGS_schedule_missed = "all";
+  due.clear();
+  schedule.load({entries[0]}, 100);
+  schedule.pop(125, 1, record);
+  schedule.pop(126, 1, record);
+  schedule.pop(127, 1, record);
+  schedule.pop(128, 1, record);
+  ASSERT_EQ(due.size(), 3U);
+  EXPECT_EQ(due[0].first, 100U);
+  EXPECT_EQ(due[1].first, 110U);
+  EXPECT_EQ(due[2].first, 120U);
+
+  // Or skips deadlines missed by more than the tolerance.
+  FLAGS_schedule_missed = "skip";
+  due.clear();
+  schedule.load({entries[0]}, 100);
+  schedule.pop(105, 1, record);
+  schedule.pop(111, 1, record);
+  ASSERT_EQ(due.size(), 1U);
+  EXPECT_EQ(due[0].first, 110U);
+
+  FLAGS_schedule_missed = backup_missed;
+}
+
 TEST_F(SchedulerTests, test_config_results_purge) {
   // Set a query time for now (time is only important relative to a week ago).
   auto query_time = osquery::getUnixTime();
@@ -62,12 +62,14 @@ class BenchmarkEventSubscriber
     auto et = expire_time_;
     expire_events_ = true;
     expire_time_ = -1;
-    getIndexes(0, 0);
+    expireEvents();
     expire_events_ = ee;
     expire_time_ = et;
   }
 
   void benchmarkGet(int low, int high) { auto results = get(low, high); }
+
+  void benchmarkEventID() { auto eid = getEventID(); }
 };
 
 static void EVENTS_subscribe_fire(benchmark::State& state) {
@@ -109,11 +111,54 @@ static void EVENTS_add_events(benchmark::State& state) {
   while (state.KeepRunning()) {
     sub->benchmarkAdd(i++);
   }
+  // Report adds per second.
+  state.SetItemsProcessed(state.iterations());
   sub->clearRows();
 }
 
 BENCHMARK(EVENTS_add_events);
 
+static void EVENTS_event_id(benchmark::State& state) {
+  auto sub = std::make_shared<BenchmarkEventSubscriber>();
+
+  while (state.KeepRunning()) {
+    sub->benchmarkEventID();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(EVENTS_event_id);
+
+static void EVENTS_event_id_database(benchmark::State& state) {
+  // The previous allocator read and wrote the counter for every event.
+  while (state.KeepRunning()) {
+    std::string value;
+    getDatabaseValue(kEvents, "eid.benchmark_database", value);
+    auto eid = (value.empty()) ? 1 : std::stoull(value) + 1;
+    setDatabaseValue(kEvents, "eid.benchmark_database", std::to_string(eid));
+  }
+  state.SetItemsProcessed(state.iterations());
+  deleteDatabaseValue(kEvents, "eid.benchmark_database");
+}
+
+BENCHMARK(EVENTS_event_id_database);
+
+static void EVENTS_add_events_bin(benchmark::State& state) {
+  auto sub = std::make_shared<BenchmarkEventSubscriber>();
+
+  // Fill a single second of events, each add is a single key write.
+  for (int i = 0; i < state.range_x(); i++) {
+    sub->benchmarkAdd(1);
+  }
+
+  while (state.KeepRunning()) {
+    sub->benchmarkAdd(1);
+  }
+  sub->clearRows();
+}
+
+BENCHMARK(EVENTS_add_events_bin)->Arg(100)->Arg(10000);
+
 static void EVENTS_retrieve_events(benchmark::State& state) {
   auto sub = std::make_shared<BenchmarkEventSubscriber>();
 
@@ -133,4 +178,21 @@ BENCHMARK(EVENTS_retrieve_events)
     ->ArgPair(0, 50)
     ->ArgPair(0, 100)
     ->ArgPair(0, 1000);
+
+static void EVENTS_expire_events(benchmark::State& state) {
+  auto sub = std::make_shared<BenchmarkEventSubscriber>();
+
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    for (int i = 0; i < state.range_x(); i++) {
+      sub->benchmarkAdd(i + 1);
+    }
+    state.ResumeTiming();
+
+    // Expiration is a single range removal.
+    sub->clearRows();
+  }
+}
+
+BENCHMARK(EVENTS_expire_events)->Arg(1000)->Arg(10000);
 }
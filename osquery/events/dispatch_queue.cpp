@@ -0,0 +1,214 @@
+/*
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include <chrono>
+
+#include "osquery/events/dispatch_queue.h"
+
+namespace osquery {
+
+/// The delivery thread re-checks the ring at least this often.
+const std::chrono::milliseconds kDispatchQueueWait(100);
+
+EventDispatchQueue::EventDispatchQueue(size_t capacity, bool block)
+    : block_(block) {
+  size_t size = 2;
+  while (size < capacity) {
+    size <<= 1;
+  }
+
+  cells_.reset(new Cell[size]);
+  mask_ = size - 1;
+  for (size_t i = 0; i < size; i++) {
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  thread_ = std::thread([this]() { work(); });
+}
+
+EventDispatchQueue::~EventDispatchQueue() {
+  stop();
+}
+
+bool EventDispatchQueue::tryPush(Item& item) {
+  Cell* cell = nullptr;
+  auto pos = enqueue_.load(std::memory_order_relaxed);
+  while (true) {
+    cell = &cells_[pos & mask_];
+    auto sequence = cell->sequence.load(std::memory_order_acquire);
+    auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+    if (diff == 0) {
+      // The slot is free, claim it.
+      if (enqueue_.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // The slot still holds an item from the previous lap.
+      return false;
+    } else {
+      pos = enqueue_.load(std::memory_order_relaxed);
+    }
+  }
+
+  cell->item = std::move(item);
+  cell->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+bool EventDispatchQueue::tryPop(Item& item) {
+  Cell* cell = nullptr;
+  auto pos = dequeue_.load(std::memory_order_relaxed);
+  while (true) {
+    cell = &cells_[pos & mask_];
+    auto sequence = cell->sequence.load(std::memory_order_acquire);
+    auto diff =
+        static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+    if (diff == 0) {
+      // Publishers may pop to drop the oldest item, so the claim is shared.
+      if (dequeue_.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = dequeue_.load(std::memory_order_relaxed);
+    }
+  }
+
+  item = std::move(cell->item);
+  cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+  return true;
+}
+
+bool EventDispatchQueue::push(const SubscriptionRef& subscription,
+                              const EventContextRef& ec) {
+  // Counted before the stopping check so stop can wait for this push.
+  pushers_++;
+  Item item;
+  item.subscription = subscription;
+  item.ec = ec;
+  bool queued = !stopping_ && enqueue(item);
+  if (--pushers_ == 0 && stopping_) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    space_cv_.notify_all();
+  }
+  return queued;
+}
+
+bool EventDispatchQueue::enqueue(Item& item) {
+  while (!tryPush(item)) {
+    if (stopping_) {
+      return false;
+    }
+
+    if (block_) {
+      // Sleep until the delivery thread takes an item.
+      wake();
+      std::unique_lock<std::mutex> lock(mutex_);
+      space_waiters_++;
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (depth() > mask_ && !stopping_) {
+        space_cv_.wait_for(lock, kDispatchQueueWait);
+      }
+      space_waiters_--;
+      continue;
+    }
+
+    // Make room by dropping the oldest event.
+    Item oldest;
+    if (tryPop(oldest)) {
+      drops_++;
+    }
+  }
+
+  wake();
+  return true;
+}
+
+void EventDispatchQueue::deliver(Item& item) {
+  item.subscription->callback(item.ec, item.subscription->context);
+  delivered_++;
+}
+
+void EventDispatchQueue::wake() {
+  // Pairs with the fence in work, either the push is seen or the waiter is.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiting_.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cv_.notify_one();
+  }
+}
+
+void EventDispatchQueue::wakePublishers() {
+  // Pairs with the fence in enqueue, either the pop is seen or the waiter is.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (space_waiters_.load(std::memory_order_relaxed) > 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    space_cv_.notify_all();
+  }
+}
+
+void EventDispatchQueue::work() {
+  while (true) {
+    Item item;
+    if (tryPop(item)) {
+      if (block_) {
+        wakePublishers();
+      }
+      deliver(item);
+      continue;
+    }
+
+    if (stopping_) {
+      // The ring is drained, stop delivers any late pushes.
+      break;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    waiting_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (depth() == 0 && !stopping_) {
+      cv_.wait_for(lock, kDispatchQueueWait);
+    }
+    waiting_.store(false, std::memory_order_relaxed);
+  }
+}
+
+void EventDispatchQueue::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    cv_.notify_one();
+    space_cv_.notify_all();
+  }
+
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+
+  {
+    // A push that passed the stopping check may land after the last pop.
+    std::unique_lock<std::mutex> lock(mutex_);
+    space_cv_.wait(lock, [this]() { return pushers_ == 0; });
+  }
+
+  Item item;
+  while (tryPop(item)) {
+    deliver(item);
+  }
+}
+
+size_t EventDispatchQueue::depth() const {
+  auto dequeue = dequeue_.load(std::memory_order_relaxed);
+  auto enqueue = enqueue_.load(std::memory_order_relaxed);
+  return (enqueue > dequeue) ? enqueue - dequeue : 0;
+}
+}
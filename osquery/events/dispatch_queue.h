@@ -0,0 +1,138 @@
+/*
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/events.h>
+
+namespace osquery {
+
+/**
+ * @brief A bounded queue of fired events delivered on a subscriber thread.
+ *
+ * Publishers push matching events and return to their run loop, while a
+ * thread owned by the queue calls the subscriber's callbacks. A slow
+ * subscriber, for example one writing each event to the backing store, no
+ * longer holds the publisher away from its OS event source.
+ *
+ * The ring is lock-free for any number of publishing threads and the single
+ * delivering thread. The delivering thread sleeps only when the ring is
+ * empty. When the ring is full the oldest event is dropped and counted, or,
+ * if the queue blocks, the publisher sleeps until an event is taken.
+ */
+class EventDispatchQueue : private boost::noncopyable {
+ public:
+  /**
+   * @brief Create a queue and start its delivery thread.
+   *
+   * @param capacity The maximum queued events, rounded up to a power of 2.
+   * @param block Wait for space instead of dropping the oldest event.
+   */
+  EventDispatchQueue(size_t capacity, bool block);
+  ~EventDispatchQueue();
+
+  /**
+   * @brief Queue an event for a subscription's callback.
+   *
+   * @return false if the queue is stopping, the caller may deliver inline.
+   */
+  bool push(const SubscriptionRef& subscription, const EventContextRef& ec);
+
+  /**
+   * @brief Reject new events, join the delivery thread, and deliver the rest.
+   *
+   * Pushes that were accepted before stopping are delivered on the calling
+   * thread if the delivery thread has already exited.
+   */
+  void stop();
+
+  /// The number of events waiting for delivery.
+  size_t depth() const;
+
+  /// The number of events dropped because the queue was full.
+  size_t drops() const {
+    return drops_;
+  }
+
+  /// The number of events delivered to callbacks.
+  size_t delivered() const {
+    return delivered_;
+  }
+
+ private:
+  /// A queued event.
+  struct Item {
+    SubscriptionRef subscription;
+    EventContextRef ec;
+  };
+
+  /// A ring slot, the sequence tells producers and the consumer its state.
+  struct Cell {
+    std::atomic<size_t> sequence{0};
+    Item item;
+  };
+
+  /// Claim a free slot and store an item, false if the ring is full.
+  bool tryPush(Item& item);
+
+  /// Take the oldest item, false if the ring is empty.
+  bool tryPop(Item& item);
+
+  /// Store an item, waiting for or making space, false if stopping.
+  bool enqueue(Item& item);
+
+  /// Call the item's subscription callback.
+  void deliver(Item& item);
+
+  /// Wake publishers waiting for space if there are any.
+  void wakePublishers();
+
+  /// Wake the delivery thread if it is waiting.
+  void wake();
+
+  /// Delivery thread entry point.
+  void work();
+
+ private:
+  std::unique_ptr<Cell[]> cells_;
+  size_t mask_{0};
+  bool block_{false};
+
+  /// Positions of the next push and pop, kept on separate cache lines.
+  alignas(64) std::atomic<size_t> enqueue_{0};
+  alignas(64) std::atomic<size_t> dequeue_{0};
+
+  std::atomic<size_t> drops_{0};
+  std::atomic<size_t> delivered_{0};
+
+  std::atomic<bool> stopping_{false};
+  std::atomic<bool> waiting_{false};
+
+  /// Publishers inside push, stop waits for them before the final drain.
+  std::atomic<size_t> pushers_{0};
+
+  /// Blocking publishers waiting for the delivery thread to take an item.
+  std::atomic<size_t> space_waiters_{0};
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::condition_variable space_cv_;
+  std::thread thread_;
+};
+}
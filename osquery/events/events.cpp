@@ -10,6 +10,7 @@
 
 #include <chrono>
 #include <exception>
+#include <limits>
 #include <thread>
 
 #include <boost/algorithm/string.hpp>
@@ -24,6 +25,7 @@
 #include <osquery/system.h>
 
 #include "osquery/core/conversions.h"
+#include "osquery/events/dispatch_queue.h"
 
 namespace osquery {
 
@@ -33,6 +35,18 @@ CREATE_REGISTRY(EventSubscriberPlugin, "event_subscriber");
 /// Checkpoint interval to inspect max event buffering.
 #define EVENTS_CHECKPOINT 256
 
+/// Interval of EventIDs mapped to their event time, to enforce events_max.
+#define EVENTS_ID_MARKER 16
+
+/// Number of EventIDs reserved in the backing store at a time.
+#define EVENTS_ID_BLOCK 10000
+
+/// Width of a formatted EventID or time, enough digits for any 64-bit value.
+#define EVENTS_ID_WIDTH 20
+
+/// Number of events moved from the previous storage layout in a single batch.
+#define EVENTS_MIGRATE_BATCH 1024
+
 FLAG(bool, disable_events, false, "Disable osquery publish/subscribe system");
 
 FLAG(bool,
@@ -51,6 +65,60 @@ FLAG(uint64,
 // overriding in subclasses
 FLAG(uint64, events_max, 1000, "Maximum number of events per type to buffer");
 
+// Access this flag through EventSubscriberPlugin::getEventsQueueSize to allow
+// for overriding in subclasses
+FLAG(uint64,
+     events_queue_size,
+     0,
+     "Events queued for each subscriber thread, 0 calls subscribers inline");
+
+FLAG(string,
+     events_queue_overflow,
+     "drop_oldest",
+     "When a subscriber queue is full: drop_oldest or block the publisher");
+
+/**
+ * @brief Format an EventID or time as a fixed-width, zero-padded decimal.
+ *
+ * The byte order of formatted values matches their numeric order, so event
+ * keys are scanned in time, then EventID, order. Decimal is used because IDs
+ * are parsed as numbers by the optimization checks.
+ */
+static inline std::string toSortable(uint64_t value) {
+  std::string formatted(EVENTS_ID_WIDTH, '0');
+  for (size_t i = EVENTS_ID_WIDTH; i > 0 && value > 0; value /= 10) {
+    formatted[--i] = static_cast<char>('0' + value % 10);
+  }
+  return formatted;
+}
+
+/// The key of an event's data: "timeline.<ns>.<time>.<eid>".
+static inline std::string getEventKey(const std::string& prefix,
+                                      EventTime time,
+                                      const std::string& eid) {
+  return prefix + toSortable(time) + "." + eid;
+}
+
+/// The first event key after every event at or before a time.
+static inline std::string getTimelineBound(const std::string& prefix,
+                                           EventTime time) {
+  if (time == std::numeric_limits<EventTime>::max()) {
+    return DatabasePlugin::getPrefixUpperBound(prefix);
+  }
+  return prefix + toSortable(time + 1);
+}
+
+/// Read the last reserved EventID for a subscriber namespace.
+static inline size_t getReservedEventID(const std::string& ns) {
+  std::string content;
+  getDatabaseValue(kEvents, "eid." + ns, content);
+  long long reserved = 0;
+  if (content.empty() || !safeStrtoll(content, 10, reserved) || reserved < 0) {
+    return 0;
+  }
+  return static_cast<size_t>(reserved);
+}
+
 static inline EventTime timeFromRecord(const std::string& record) {
   // Convert a stored index "as string bytes" to a time value.
   long long afinite;
@@ -60,12 +128,44 @@ static inline EventTime timeFromRecord(const std::string& record) {
   return afinite;
 }
 
+/// The last EventID that may have been used, according to the markers.
+static inline size_t getMarkedEventID(const std::string& ns, size_t reserved) {
+  // Only IDs within the last reservation may be unused, read its markers.
+  auto prefix = "markers." + ns + ".";
+  auto first = (reserved > EVENTS_ID_BLOCK) ? reserved - EVENTS_ID_BLOCK : 0;
+  DatabaseKeyValues markers;
+  scanDatabaseRange(kEvents,
+                    markers,
+                    prefix + toSortable(first + 1),
+                    DatabasePlugin::getPrefixUpperBound(prefix));
+  if (markers.empty()) {
+    return std::numeric_limits<size_t>::max();
+  }
+
+  // The next marker would have been written with the interval's last ID.
+  auto marked = timeFromRecord(markers.back().first.substr(prefix.size()));
+  return static_cast<size_t>(marked) + EVENTS_ID_MARKER - 1;
+}
+
+/// The scheduled query reading events on this thread, if any.
+static inline std::string getOptimizeQueryName() {
+  auto query_name = Config::getExecutingQuery();
+  if (query_name.empty()) {
+    // The query may have been recorded by another thread or process.
+    getDatabaseValue(kPersistentSettings, kExecutingQuery, query_name);
+    if (query_name.find('\n') != std::string::npos) {
+      // Several queries are executing, none is known to be on this thread.
+      query_name.clear();
+    }
+  }
+  return query_name;
+}
+
 static inline void getOptimizeData(EventTime& o_time,
                                    size_t& o_eid,
                                    const std::string& publisher) {
   // Read the optimization time for the current executing query.
-  std::string query_name;
-  getDatabaseValue(kPersistentSettings, kExecutingQuery, query_name);
+  auto query_name = getOptimizeQueryName();
   if (query_name.empty()) {
     // Fallback when daemons disable query monitoring.
     query_name = publisher;
@@ -92,15 +192,16 @@ static inline void setOptimizeData(EventTime time,
                                    size_t eid,
                                    const std::string& publisher) {
   // Store the optimization time and eid.
-  std::string query_name;
-  getDatabaseValue(kPersistentSettings, kExecutingQuery, query_name);
+  auto query_name = getOptimizeQueryName();
   if (query_name.empty()) {
     // Fallback when daemons disable query monitoring.
     query_name = publisher;
   }
 
-  setDatabaseValue(kEvents, "optimize." + query_name, std::to_string(time));
-  setDatabaseValue(kEvents, "optimize_eid." + query_name, std::to_string(eid));
+  DatabaseBatch batch;
+  batch.put("optimize." + query_name, std::to_string(time));
+  batch.put("optimize_eid." + query_name, std::to_string(eid));
+  writeDatabaseBatch(kEvents, batch);
 }
 
 QueryData EventSubscriberPlugin::genTable(QueryContext& context) {
@@ -156,254 +257,160 @@ void EventPublisherPlugin::fire(const EventContextRef& ec, EventTime time) {
     }
   }
 
-  WriteLock lock(subscription_lock_);
-  for (const auto& subscription : subscriptions_) {
-    auto es = EventFactory::getEventSubscriber(subscription->subscriber_name);
-    if (es != nullptr && es->state() == EventState::EVENT_RUNNING) {
-      fireCallback(subscription, ec);
-    }
+  // A blocking queue may wait for space, do not hold the subscriptions lock
+  // while the event is delivered.
+  SubscriptionVector subscriptions;
+  {
+    WriteLock lock(subscription_lock_);
+    subscriptions = subscriptions_;
   }
-}
-
-std::vector<std::string> EventSubscriberPlugin::getIndexes(EventTime start,
-                                                           EventTime stop) {
-  auto index_key = "indexes." + dbNamespace();
-  std::vector<std::string> indexes;
 
-  EventTime l_start = (start > 0) ? start / 60 : 0;
-  EventTime r_stop = (stop > 0) ? stop / 60 + 1 : 0;
-
-  std::string content;
-  getDatabaseValue(kEvents, index_key + ".60", content);
-  if (content.empty()) {
-    return indexes;
-  }
-
-  std::vector<std::string> bins, expirations;
-  boost::split(bins, content, boost::is_any_of(","));
-  for (const auto& bin : bins) {
-    auto step = timeFromRecord(bin);
-    auto step_start = step * 60;
-    auto step_stop = (step + 1) * 60;
-    if (step_stop < expire_time_) {
-      expirations.push_back(bin);
-    } else if (step_start < expire_time_) {
-      expireRecords("60", bin, false);
+  for (const auto& subscription : subscriptions) {
+    auto es = EventFactory::getEventSubscriber(subscription->subscriber_name);
+    if (es == nullptr || es->state() != EventState::EVENT_RUNNING ||
+        !shouldFireCallback(subscription, ec)) {
+      continue;
     }
 
-    if (step >= l_start && (r_stop == 0 || step < r_stop)) {
-      indexes.push_back("60." + bin);
+    // Subscribers with a dispatch queue handle the event on their thread.
+    auto queue = std::atomic_load(&es->dispatch_queue_);
+    if (queue == nullptr || !queue->push(subscription, ec)) {
+      subscription->callback(ec, subscription->context);
     }
   }
-
-  // Rewrite the index lists and delete each expired item.
-  if (!expirations.empty()) {
-    expireIndexes("60", bins, expirations);
-  }
-
-  // Return indexes in binning order.
-  std::sort(indexes.begin(),
-            indexes.end(),
-            [](const std::string& left, const std::string& right) {
-              auto n1 = timeFromRecord(left.substr(left.find(".") + 1));
-              auto n2 = timeFromRecord(right.substr(right.find(".") + 1));
-              return n1 < n2;
-            });
-
-  // Update the new time that events expire to now - expiry.
-  return indexes;
 }
 
-void EventSubscriberPlugin::expireRecords(const std::string& list_type,
-                                          const std::string& index,
-                                          bool all) {
-  auto record_key = "records." + dbNamespace();
-  auto data_key = "data." + dbNamespace();
-
-  // If the expirations is not removing all records, rewrite the persisting.
-  std::vector<std::string> persisting_records;
-  // Request all records within this list-size + bin offset.
-  auto expired_records = getRecords({list_type + "." + index});
-  for (const auto& record : expired_records) {
-    if (all || record.second <= expire_time_) {
-      deleteDatabaseValue(kEvents, data_key + "." + record.first);
-    } else {
-      persisting_records.push_back(record.first + ":" +
-                                   std::to_string(record.second));
-    }
-  }
-
-  // Either drop or overwrite the record list.
-  if (all) {
-    deleteDatabaseValue(kEvents, record_key + "." + list_type + "." + index);
-  } else if (persisting_records.size() < expired_records.size()) {
-    auto new_records = boost::algorithm::join(persisting_records, ",");
-    setDatabaseValue(
-        kEvents, record_key + "." + list_type + "." + index, new_records);
-  }
+size_t EventSubscriberPlugin::queueDepth() const {
+  auto queue = std::atomic_load(&dispatch_queue_);
+  return (queue != nullptr) ? queue->depth() : 0;
 }
 
-void EventSubscriberPlugin::expireIndexes(
-    const std::string& list_type,
-    const std::vector<std::string>& indexes,
-    const std::vector<std::string>& expirations) {
-  auto index_key = "indexes." + dbNamespace();
-
-  // Construct a mutable list of persisting indexes to rewrite as records.
-  std::vector<std::string> persisting_indexes = indexes;
-  // Remove the records using the list of expired indexes.
-  for (const auto& bin : expirations) {
-    expireRecords(list_type, bin, true);
-    persisting_indexes.erase(
-        std::remove(persisting_indexes.begin(), persisting_indexes.end(), bin),
-        persisting_indexes.end());
-  }
-
-  // Update the list of indexes with the non-expired indexes.
-  auto new_indexes = boost::algorithm::join(persisting_indexes, ",");
-  setDatabaseValue(kEvents, index_key + "." + list_type, new_indexes);
+size_t EventSubscriberPlugin::queueDrops() const {
+  auto queue = std::atomic_load(&dispatch_queue_);
+  return (queue != nullptr) ? queue->drops() : 0;
 }
 
-void EventSubscriberPlugin::expireCheck(bool cleanup) {
-  auto data_key = "data." + dbNamespace();
-  auto eid_key = "eid." + dbNamespace();
-  // Min key will be the last surviving key.
-  size_t min_key = 0;
+void EventSubscriberPlugin::expireEvents() {
+  // Events are ordered by time, remove every event at or before the expiry.
+  auto prefix = "timeline." + dbNamespace() + ".";
+  deleteDatabaseRange(kEvents, prefix, getTimelineBound(prefix, expire_time_));
+}
 
-  {
-    auto limit = getEventsMax();
+void EventSubscriberPlugin::migrateEvents() {
+  // Most starts have nothing to move, look for one key in each legacy list.
+  std::vector<std::string> legacy_prefixes;
+  for (const auto& legacy : {"data.", "records.", "indexes."}) {
+    auto legacy_prefix = legacy + dbNamespace() + ".";
     std::vector<std::string> keys;
-    scanDatabaseKeys(kEvents, keys, data_key);
-    if (keys.size() <= limit) {
-      return;
-    }
-
-    // There is an overflow of events buffered for this subscriber.
-    LOG(WARNING) << "Expiring events for subscriber: " << getName()
-                 << " (limit " << limit << ")";
-    VLOG(1) << "Subscriber events " << getName() << " exceeded limit " << limit
-            << " by: " << keys.size() - limit;
-    // Inspect the N-FLAGS_events_max -th event's value and expire before the
-    // time within the content.
-    std::string last_key;
-    getDatabaseValue(kEvents, eid_key, last_key);
-    // The EID is the next-index.
-    // EID - events_max is the most last-recent event to keep.
-    min_key = boost::lexical_cast<size_t>(last_key) - getEventsMax();
-
-    if (cleanup) {
-      // Scan each of the keys in keys, if their ID portion is < min_key.
-      // Nix them, this requires lots of conversions, use with care.
-      for (const auto& key : keys) {
-        if (std::stoul(key.substr(key.rfind('.') + 1)) < min_key) {
-          deleteDatabaseValue(kEvents, key);
-        }
-      }
+    scanDatabaseKeys(kEvents, keys, legacy_prefix, 1);
+    if (!keys.empty()) {
+      legacy_prefixes.push_back(std::move(legacy_prefix));
     }
   }
 
-  // Convert the key index into a time using the content.
-  // The last-recent event is fetched and the corresponding time is used as
-  // the expiration time for the subscriber.
-  std::string content;
-  getDatabaseValue(kEvents, data_key + "." + std::to_string(min_key), content);
-
-  // Decode the value into a row structure to extract the time.
-  Row r;
-  if (!deserializeRowJSON(content, r) || r.count("time") == 0) {
+  if (legacy_prefixes.empty()) {
     return;
   }
 
-  // The last time will become the implicit expiration time.
-  size_t last_time = boost::lexical_cast<size_t>(r.at("time"));
-  if (last_time > 0) {
-    expire_time_ = last_time;
-  }
-
-  // Finally, attempt an index query to trigger expirations.
-  // In this case the result set is not used.
-  getIndexes(expire_time_, 0);
-}
-
-std::vector<EventRecord> EventSubscriberPlugin::getRecords(
-    const std::vector<std::string>& indexes) {
-  auto record_key = "records." + dbNamespace();
+  // Previous versions stored each event as "data.<ns>.<eid>", the row's time
+  // column is its event time.
+  auto data_prefix = "data." + dbNamespace() + ".";
+  auto data_stop = DatabasePlugin::getPrefixUpperBound(data_prefix);
+  auto prefix = "timeline." + dbNamespace() + ".";
+  size_t migrated = 0;
+  while (true) {
+    DatabaseKeyValues events;
+    scanDatabaseRange(
+        kEvents, events, data_prefix, data_stop, EVENTS_MIGRATE_BATCH);
+    if (events.empty()) {
+      break;
+    }
 
-  std::vector<EventRecord> records;
-  for (const auto& index : indexes) {
-    std::vector<std::string> bin_records;
-    {
-      std::string record_value;
-      getDatabaseValue(kEvents, record_key + "." + index, record_value);
-      if (record_value.empty()) {
-        // There are actually no events in this bin, interesting error case.
+    // Each event is moved within a batch, so it is never stored twice.
+    DatabaseBatch batch;
+    for (auto& event : events) {
+      batch.remove(event.first);
+      Row r;
+      long long eid = 0;
+      if (!deserializeRowBinary(event.second, r).ok() ||
+          !safeStrtoll(event.first.substr(data_prefix.size()), 10, eid) ||
+          eid < 0) {
         continue;
       }
 
-      // Each list is tokenized into a record=event_id:time.
-      boost::split(bin_records, record_value, boost::is_any_of(",:"));
+      std::string data;
+      if (serializeRowBinary(r, data).ok()) {
+        auto key = getEventKey(
+            prefix, timeFromRecord(r["time"]), toSortable(eid));
+        batch.put(std::move(key), std::move(data));
+        migrated++;
+      }
     }
 
-    auto bin_it = bin_records.begin();
-    // Iterate over every 2 items: EID:TIME.
-    for (; bin_it != bin_records.end(); bin_it++) {
-      const auto& eid = *bin_it;
-      EventTime et = timeFromRecord(*(++bin_it));
-      if (FLAGS_events_optimize && et <= optimize_time_ + 1) {
-        // There is an optimization collision, check for colliding IDs.
-        auto eidr = timeFromRecord(eid);
-        if (eidr <= optimize_eid_) {
-          continue;
-        }
-      }
-      records.push_back(std::make_pair(eid, et));
+    if (!writeDatabaseBatch(kEvents, batch).ok()) {
+      LOG(WARNING) << "Cannot move events for subscriber: " << getName();
+      break;
     }
   }
 
-  return records;
-}
+  if (migrated > 0) {
+    VLOG(1) << "Moved " << migrated << " events for subscriber: " << getName();
+  }
 
-Status EventSubscriberPlugin::recordEvent(EventID& eid, EventTime et) {
-  std::string time_value = boost::lexical_cast<std::string>(et);
+  // The record and index lists are not used, remove them and any data that
+  // could not be moved.
+  for (const auto& legacy_prefix : legacy_prefixes) {
+    deleteDatabaseRange(kEvents,
+                        legacy_prefix,
+                        DatabasePlugin::getPrefixUpperBound(legacy_prefix));
+  }
+}
 
-  // The record is identified by the event type then module name.
-  std::string index_key = "indexes." + dbNamespace();
-  std::string record_key = "records." + dbNamespace();
-  // The list key includes the list type (bin size) and the list ID (bin).
-  std::string list_id;
+void EventSubscriberPlugin::expireCheck() {
+  if (!eid_loaded_) {
+    // The last EventID is not known until the first event is added.
+    return;
+  }
 
-  // The list_id is the MOST-Specific key ID, the bin for this list.
-  // If the event time was 13 and the time_list is 5 seconds, lid = 2.
-  list_id = boost::lexical_cast<std::string>(et / 60);
+  auto limit = getEventsMax();
+  size_t last_eid = last_eid_;
+  if (last_eid <= limit) {
+    return;
+  }
 
-  WriteLock lock(event_record_lock_);
-  // Append the record (eid, unix_time) to the list bin.
-  std::string record_value;
-  getDatabaseValue(kEvents, record_key + ".60." + list_id, record_value);
+  // EID - events_max is the most last-recent event to keep.
+  size_t min_key = last_eid - limit;
 
-  if (record_value.length() == 0) {
-    // This is a new list_id for list_key, append the ID to the indirect
-    // lookup for this list_key.
-    std::string index_value;
-    getDatabaseValue(kEvents, index_key + ".60", index_value);
-    if (index_value.length() == 0) {
-      // A new index.
-      index_value = list_id;
-    } else {
-      index_value += "," + list_id;
-    }
-    setDatabaseValue(kEvents, index_key + ".60", index_value);
-    record_value = eid + ":" + time_value;
-  } else {
-    // Tokenize a record using ',' and the EID/time using ':'.
-    record_value += "," + eid + ":" + time_value;
+  // Markers map every EVENTS_ID_MARKER-th EventID to its event time and are
+  // keyed by EventID. Only the markers of overflowing events are read, and
+  // they are removed below, so each marker is read once.
+  auto marker_prefix = "markers." + dbNamespace() + ".";
+  DatabaseKeyValues markers;
+  scanDatabaseRange(
+      kEvents, markers, marker_prefix, marker_prefix + toSortable(min_key + 1));
+  if (markers.empty()) {
+    return;
   }
-  auto status =
-      setDatabaseValue(kEvents, record_key + ".60." + list_id, record_value);
-  if (!status.ok()) {
-    LOG(ERROR) << "Could not put Event Record key: " << record_key;
+
+  std::string expire_key;
+  auto prefix = "timeline." + dbNamespace() + ".";
+  for (const auto& marker : markers) {
+    // Expire events older than this marker's event, and the event itself.
+    // Times are not ordered by EventID, use the most-recent marked event.
+    auto eid = marker.first.substr(marker_prefix.size());
+    auto key = getEventKey(prefix, timeFromRecord(marker.second), eid);
+    expire_key = std::max(expire_key, key);
   }
-  return Status(0, "OK");
+
+  const auto& last_marker = markers.back().first;
+  deleteDatabaseRange(
+      kEvents, marker_prefix, DatabasePlugin::getPrefixUpperBound(last_marker));
+
+  // There is an overflow of events buffered for this subscriber.
+  LOG(WARNING) << "Expiring events for subscriber: " << getName() << " (limit "
+               << limit << ")";
+  deleteDatabaseRange(
+      kEvents, prefix, DatabasePlugin::getPrefixUpperBound(expire_key));
 }
 
 size_t EventSubscriberPlugin::getEventsExpiry() {
@@ -414,74 +421,93 @@ size_t EventSubscriberPlugin::getEventsMax() {
   return FLAGS_events_max;
 }
 
-EventID EventSubscriberPlugin::getEventID() {
-  Status status;
-  // First get an event ID from the meta key.
-  std::string eid_key = "eid." + dbNamespace();
-  std::string last_eid_value;
-  std::string eid_value;
+size_t EventSubscriberPlugin::getEventsQueueSize() {
+  return FLAGS_events_queue_size;
+}
 
-  {
+bool EventSubscriberPlugin::getEventsQueueBlocks() {
+  return FLAGS_events_queue_overflow == "block";
+}
+
+EventID EventSubscriberPlugin::getEventID() {
+  if (!eid_loaded_) {
     WriteLock lock(event_id_lock_);
-    status = getDatabaseValue(kEvents, eid_key, last_eid_value);
-    if (!status.ok() || last_eid_value.empty()) {
-      last_eid_value = "0";
+    if (!eid_loaded_) {
+      // IDs within the last reservation may have been used before a restart or
+      // crash. A marker is written with every EVENTS_ID_MARKER-th event, so
+      // IDs after the most-recent marker's interval were not used.
+      reserved_eid_ = getReservedEventID(dbNamespace());
+      last_eid_ = std::min(reserved_eid_.load(),
+                           getMarkedEventID(dbNamespace(), reserved_eid_));
+      eid_loaded_ = true;
     }
-
-    last_eid_ = boost::lexical_cast<size_t>(last_eid_value) + 1;
-    eid_value = boost::lexical_cast<std::string>(last_eid_);
-    status = setDatabaseValue(kEvents, eid_key, eid_value);
   }
 
-  if (!status.ok()) {
-    return "0";
+  size_t eid = ++last_eid_;
+  if (eid > reserved_eid_) {
+    // Persist the next block of IDs before any ID within it is returned.
+    WriteLock lock(event_id_lock_);
+    if (eid > reserved_eid_) {
+      size_t reserved = eid + EVENTS_ID_BLOCK - 1;
+      auto status = setDatabaseValue(
+          kEvents, "eid." + dbNamespace(), std::to_string(reserved));
+      if (status.ok()) {
+        reserved_eid_ = reserved;
+      } else {
+        // The next allocation will attempt the reservation again.
+        LOG(ERROR) << "Cannot reserve EventIDs for subscriber: " << getName();
+      }
+    }
   }
 
-  return eid_value;
+  return toSortable(eid);
 }
 
 QueryData EventSubscriberPlugin::get(EventTime start, EventTime stop) {
   QueryData results;
 
-  // Get the records for this time range.
-  auto indexes = getIndexes(start, stop);
-  auto records = getRecords(indexes);
-
-  std::string events_key = "data." + dbNamespace();
-  std::vector<std::string> mapped_records;
-  for (const auto& record : records) {
-    if (record.second >= start && (record.second <= stop || stop == 0)) {
-      mapped_records.push_back(events_key + "." + record.first);
-    }
-  }
-
-  if (FLAGS_events_optimize && !records.empty()) {
-    // If records were returned save the ordered-last as the optimization EID.
-    unsigned long int eidr = 0;
-    if (safeStrtoul(records.back().first, 10, eidr)) {
-      optimize_eid_ = static_cast<size_t>(eidr);
+  // Apply the time-based expiration before selecting events.
+  if (expire_events_ && expire_time_ > 0) {
+    expireEvents();
+  }
+
+  // Events are keyed by time then EventID, the range is a single iterator.
+  auto prefix = "timeline." + dbNamespace() + ".";
+  auto range_stop = (stop == 0) ? DatabasePlugin::getPrefixUpperBound(prefix)
+                                : getTimelineBound(prefix, stop);
+  DatabaseKeyValues events;
+  scanDatabaseRange(kEvents, events, prefix + toSortable(start), range_stop);
+
+  size_t last_eid = 0;
+  for (const auto& event : events) {
+    // The key suffix is "time.eid", both fixed-width.
+    auto eid = static_cast<size_t>(
+        timeFromRecord(event.first.substr(event.first.rfind('.') + 1)));
+    if (FLAGS_events_optimize) {
+      auto et =
+          timeFromRecord(event.first.substr(prefix.size(), EVENTS_ID_WIDTH));
+      if (et <= optimize_time_ + 1 && eid <= optimize_eid_) {
+        // There is an optimization collision, the event was already returned.
+        continue;
+      }
     }
-  }
+    last_eid = std::max(last_eid, eid);
 
-  // Select mapped_records using event_ids as keys.
-  std::string data_value;
-  for (const auto& record : mapped_records) {
     Row r;
-    auto status = getDatabaseValue(kEvents, record, data_value);
-    if (data_value.length() == 0) {
-      // There is no record here, interesting error case.
-      continue;
-    }
-    status = deserializeRowJSON(data_value, r);
-    data_value.clear();
+    auto status = deserializeRowBinary(event.second, r);
     if (status.ok()) {
       results.push_back(std::move(r));
     }
   }
 
+  if (FLAGS_events_optimize && last_eid > 0) {
+    // If events were returned save the most-recent as the optimization EID.
+    optimize_eid_ = last_eid;
+  }
+
   if (getEventsExpiry() > 0) {
     // Set the expire time to NOW - "configured lifetime".
-    // Index retrieval will apply the constraints checking and auto-expire.
+    // The next selection will apply the constraints checking and auto-expire.
     expire_time_ = getUnixTime() - getEventsExpiry();
   }
 
@@ -493,8 +519,6 @@ QueryData EventSubscriberPlugin::get(EventTime start, EventTime stop) {
 }
 
 Status EventSubscriberPlugin::add(Row& r, EventTime event_time) {
-  // Get and increment the EID for this module.
-  EventID eid = getEventID();
   // Without encouraging a missing event time, do not support a 0-time.
   if (event_time == 0) {
     event_time = getUnixTime();
@@ -503,30 +527,45 @@ Status EventSubscriberPlugin::add(Row& r, EventTime event_time) {
   r["time"] = std::to_string(event_time);
   // Serialize and store the row data, for query-time retrieval.
   std::string data;
-  auto status = serializeRowJSON(r, data);
+  auto status = serializeRowBinary(r, data);
   if (!status.ok()) {
     return status;
   }
-  // Then remove the newline.
-  if (data.size() > 0 && data.back() == '\n') {
-    data.pop_back();
+
+  // Logger plugins may request events to be forwarded directly as JSON.
+  // If no active logger is marked 'usesLogEvent' then this is a no-op.
+  if (EventFactory::hasForwarders()) {
+    std::string json;
+    if (serializeRowJSON(r, json).ok()) {
+      // Then remove the newline.
+      if (!json.empty() && json.back() == '\n') {
+        json.pop_back();
+      }
+      EventFactory::forwardEvent(json);
+    }
   }
 
+  // Get and increment the EID for this module.
+  EventID eid = getEventID();
+  auto eid_value = static_cast<size_t>(timeFromRecord(eid));
+
+  // Store the event data keyed by the event time, then EID.
+  DatabaseBatch batch;
+  auto prefix = "timeline." + dbNamespace() + ".";
+  batch.put(getEventKey(prefix, event_time, eid), std::move(data));
+  if (eid_value % EVENTS_ID_MARKER == 0) {
+    // Periodically map the EID to its time, see expireCheck.
+    batch.put("markers." + dbNamespace() + "." + eid,
+              std::to_string(event_time));
+  }
+  status = writeDatabaseBatch(kEvents, batch);
+
   // Use the last EventID and a checkpoint bucket size to periodically apply
   // buffer eviction. Eviction occurs if the total count exceeds events_max.
-  if (last_eid_ % EVENTS_CHECKPOINT == 0) {
+  if (eid_value % EVENTS_CHECKPOINT == 0) {
     expireCheck();
   }
 
-  // Logger plugins may request events to be forwarded directly.
-  // If no active logger is marked 'usesLogEvent' then this is a no-op.
-  EventFactory::forwardEvent(data);
-
-  // Store the event data.
-  std::string event_key = "data." + dbNamespace() + "." + eid;
-  status = setDatabaseValue(kEvents, event_key, data);
-  // Record the event in the indexing bins, using the index time.
-  recordEvent(eid, event_time);
   event_count_++;
   return status;
 }
@@ -589,6 +628,10 @@ void EventFactory::addForwarder(const std::string& logger) {
   getInstance().loggers_.push_back(logger);
 }
 
+bool EventFactory::hasForwarders() {
+  return !getInstance().loggers_.empty();
+}
+
 void EventFactory::forwardEvent(const std::string& event) {
   for (const auto& logger : getInstance().loggers_) {
     Registry::call("logger", logger, {{"event", event}});
@@ -701,6 +744,15 @@ Status EventFactory::registerEventPublisher(const PluginRef& pub) {
   return Status(0, "OK");
 }
 
+void EventFactory::stopDispatchQueue(const EventSubscriberRef& sub) {
+  // Publishers that still hold the queue fall back to inline callbacks.
+  auto queue = std::atomic_exchange(&sub->dispatch_queue_,
+                                    std::shared_ptr<EventDispatchQueue>());
+  if (queue != nullptr) {
+    queue->stop();
+  }
+}
+
 Status EventFactory::registerEventSubscriber(const PluginRef& sub) {
   // Try to downcast the plugin to an event subscriber.
   EventSubscriberRef specialized_sub;
@@ -742,6 +794,7 @@ Status EventFactory::registerEventSubscriber(const PluginRef& sub) {
   }
 
   if (specialized_sub->state() != EventState::EVENT_NONE) {
+    stopDispatchQueue(specialized_sub);
     specialized_sub->tearDown();
   }
 
@@ -754,9 +807,16 @@ Status EventFactory::registerEventSubscriber(const PluginRef& sub) {
 
   // Let the subscriber initialize any Subscriptions.
   if (!FLAGS_disable_events && !specialized_sub->disabled) {
-    specialized_sub->expireCheck(true);
+    specialized_sub->migrateEvents();
     status = specialized_sub->init();
     specialized_sub->state(EventState::EVENT_RUNNING);
+    auto queue_size = specialized_sub->getEventsQueueSize();
+    if (queue_size > 0) {
+      auto blocks = specialized_sub->getEventsQueueBlocks();
+      std::atomic_store(
+          &specialized_sub->dispatch_queue_,
+          std::make_shared<EventDispatchQueue>(queue_size, blocks));
+    }
   } else {
     specialized_sub->state(EventState::EVENT_PAUSED);
   }
@@ -891,6 +951,14 @@ void EventFactory::end(bool join) {
     }
   }
 
+  // Publishers have stopped, deliver the events left in subscriber queues.
+  for (const auto& subscriber : ef.subscriberNames()) {
+    auto sub = getEventSubscriber(subscriber);
+    if (sub != nullptr) {
+      stopDispatchQueue(sub);
+    }
+  }
+
   {
     WriteLock lock(getInstance().factory_lock_);
     // A small cool off helps OS API event publisher flushing.
@@ -8,6 +8,9 @@
  *
  */
 
+#include <algorithm>
+#include <chrono>
+
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
 #include <boost/filesystem.hpp>
@@ -37,6 +40,24 @@ FLAG(bool,
      false,
      "Allow the audit publisher to change auditing configuration");
 
+/// The kernel queues this many records for the publisher before dropping.
+FLAG(uint64,
+     audit_backlog_limit,
+     1024,
+     "The kernel audit backlog limit when osquery controls audit");
+
+/// Size the netlink socket so bursts are not dropped before they are read.
+FLAG(uint64,
+     audit_receive_buffer,
+     0,
+     "Bytes of the audit netlink receive buffer, 0 uses the system default");
+
+/// Receive several records for each system call.
+FLAG(uint64,
+     audit_batch_size,
+     32,
+     "The maximum number of audit records read with each receive");
+
 REGISTER(AuditEventPublisher, "event_publisher", "audit");
 
 enum AuditStatus {
@@ -47,6 +68,193 @@ enum AuditStatus {
 
 static const int kAuditMTimeout = 4000;
 
+/// The run loop requests the audit status, to detect a loss of control.
+static const std::chrono::seconds kAuditStatusInterval(2);
+
+/// Per-type record rates are measured over windows of this many seconds.
+static const size_t kAuditRateWindow = 60;
+
+const size_t AuditRecord::npos;
+
+/// The interned field keys, other keys are kept as UNKNOWN.
+static const std::vector<std::pair<boost::string_ref, AuditFieldKey>>
+    kAuditFieldKeys = {
+        {"argc", AuditFieldKey::ARGC},
+        {"syscall", AuditFieldKey::SYSCALL},
+        {"success", AuditFieldKey::SUCCESS},
+        {"exit", AuditFieldKey::EXIT},
+        {"item", AuditFieldKey::ITEM},
+        {"pid", AuditFieldKey::PID},
+        {"ppid", AuditFieldKey::PPID},
+        {"uid", AuditFieldKey::UID},
+        {"euid", AuditFieldKey::EUID},
+        {"gid", AuditFieldKey::GID},
+        {"egid", AuditFieldKey::EGID},
+        {"exe", AuditFieldKey::EXE},
+        {"comm", AuditFieldKey::COMM},
+        {"mode", AuditFieldKey::MODE},
+        {"ouid", AuditFieldKey::OUID},
+        {"ogid", AuditFieldKey::OGID},
+        {"dev", AuditFieldKey::DEV},
+        {"inode", AuditFieldKey::INODE},
+        {"saddr", AuditFieldKey::SADDR},
+        {"msg", AuditFieldKey::MSG},
+        {"addr", AuditFieldKey::ADDR},
+        {"terminal", AuditFieldKey::TERMINAL},
+};
+
+static inline bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+/// Parse an unsigned decimal without copying, false if it is not a number.
+static bool parseAuditNumber(boost::string_ref s, size_t& value) {
+  if (s.empty()) {
+    return false;
+  }
+
+  value = 0;
+  for (const auto& c : s) {
+    if (!isDigit(c)) {
+      return false;
+    }
+    value = value * 10 + (c - '0');
+  }
+  return true;
+}
+
+static AuditFieldKey getAuditFieldKey(boost::string_ref key) {
+  if (key.size() > 1 && key[0] == 'a' && isDigit(key[1])) {
+    size_t argument = 0;
+    auto bracket = key.find('[');
+    if (bracket == boost::string_ref::npos) {
+      return parseAuditNumber(key.substr(1), argument)
+                 ? AuditFieldKey::ARGN
+                 : AuditFieldKey::UNKNOWN;
+    }
+
+    // The kernel splits long arguments into pieces, "aN[i]".
+    size_t piece = 0;
+    if (key.back() == ']' &&
+        parseAuditNumber(key.substr(1, bracket - 1), argument) &&
+        parseAuditNumber(key.substr(bracket + 1, key.size() - bracket - 2),
+                         piece)) {
+      return AuditFieldKey::ARGN_PART;
+    }
+    return AuditFieldKey::UNKNOWN;
+  }
+
+  for (const auto& known : kAuditFieldKeys) {
+    if (known.first.size() == key.size() && known.first == key) {
+      return known.second;
+    }
+  }
+  return AuditFieldKey::UNKNOWN;
+}
+
+static inline int getHexValue(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  } else if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  } else if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  return -1;
+}
+
+std::string decodeAuditValue(boost::string_ref s) {
+  if (s.size() > 1 && s[0] == '"') {
+    return s.substr(1, s.size() - 2).to_string();
+  }
+
+  // Values that are not hex are returned as they are.
+  if (s.size() % 2 != 0) {
+    return s.to_string();
+  }
+
+  std::string decoded(s.size() / 2, '\0');
+  for (size_t i = 0; i < decoded.size(); i++) {
+    auto high = getHexValue(s[i * 2]);
+    auto low = getHexValue(s[i * 2 + 1]);
+    if (high < 0 || low < 0) {
+      return s.to_string();
+    }
+    decoded[i] = static_cast<char>((high << 4) | low);
+  }
+  return decoded;
+}
+
+void AuditRecord::parse(boost::string_ref message) {
+  // Netlink payloads may be padded with NUL bytes.
+  auto end = message.find('\0');
+  if (end != boost::string_ref::npos) {
+    message = message.substr(0, end);
+  }
+
+  message_.assign(message.data(), message.size());
+  fields_.clear();
+  std::fill(std::begin(index_), std::end(index_), 0);
+
+  // There are several ways of representing value data (enclosed strings, etc).
+  size_t i = 0;
+  const size_t size = message_.size();
+  while (i < size) {
+    // Multiple space tokens are supported.
+    if (message_[i] == ' ') {
+      i++;
+      continue;
+    }
+
+    Field field;
+    field.key_offset = static_cast<uint32_t>(i);
+    while (i < size && message_[i] != '=' && message_[i] != ' ') {
+      i++;
+    }
+    field.key_size = static_cast<uint32_t>(i - field.key_offset);
+
+    field.value_offset = static_cast<uint32_t>(i);
+    if (i < size && message_[i] == '=') {
+      field.value_offset = static_cast<uint32_t>(++i);
+      // An enclosure may contain spaces and ends after the closing quote.
+      bool found_enclose = false;
+      while (i < size) {
+        auto c = message_[i++];
+        if (found_enclose && c == '"') {
+          break;
+        } else if (!found_enclose && c == ' ') {
+          i--;
+          break;
+        } else if (c == '"') {
+          found_enclose = true;
+        }
+      }
+    }
+    field.value_size = static_cast<uint32_t>(i - field.value_offset);
+
+    if (field.key_size == 0) {
+      // A value without a key is dropped.
+      continue;
+    }
+
+    field.id = getAuditFieldKey(view(field.key_offset, field.key_size));
+    auto& index = index_[static_cast<size_t>(field.id)];
+    if (field.id != AuditFieldKey::UNKNOWN && index == 0) {
+      index = static_cast<uint32_t>(fields_.size() + 1);
+    }
+    fields_.push_back(field);
+  }
+}
+
+size_t AuditRecord::find(boost::string_ref key) const {
+  for (size_t i = 0; i < fields_.size(); i++) {
+    if (fields_[i].key_size == key.size() && this->key(i) == key) {
+      return i;
+    }
+  }
+  return npos;
+}
+
 void AuditAssembler::start(size_t capacity,
                            std::vector<size_t> types,
                            AuditUpdate update) {
@@ -63,7 +271,7 @@ void AuditAssembler::start(size_t capacity,
 
 boost::optional<AuditFields> AuditAssembler::add(Auid id,
                                                  size_t type,
-                                                 const AuditFields& fields) {
+                                                 const AuditRecord& fields) {
   auto it = m_.find(id);
   if (it == m_.end()) {
     // A new audit ID.
@@ -150,6 +358,27 @@ Status AuditEventPublisher::setUp() {
     return Status(1, "Could not open audit subsystem");
   }
 
+  if (FLAGS_audit_receive_buffer > 0) {
+    // The forced option allows root to exceed the net.core.rmem_max limit.
+    int size = static_cast<int>(FLAGS_audit_receive_buffer);
+    if (setsockopt(handle_, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) <
+            0 &&
+        setsockopt(handle_, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) < 0) {
+      VLOG(1) << "Cannot set the audit receive buffer: " << errno;
+    }
+  }
+
+  int receive_buffer = 0;
+  socklen_t receive_buffer_size = sizeof(receive_buffer);
+  if (getsockopt(handle_,
+                 SOL_SOCKET,
+                 SO_RCVBUF,
+                 &receive_buffer,
+                 &receive_buffer_size) == 0) {
+    receive_buffer_ = static_cast<size_t>(receive_buffer);
+  }
+  ring_.resize(FLAGS_audit_batch_size);
+
   // The setup can try to enable auditing.
   if (FLAGS_audit_allow_config) {
     audit_set_enabled(handle_, AUDIT_ENABLED);
@@ -179,7 +408,7 @@ Status AuditEventPublisher::setUp() {
     // This is normally controlled through the audit config, but we must
     // enforce sane minimums: -b 8192 -e 100
     audit_set_backlog_wait_time(handle_, 1);
-    audit_set_backlog_limit(handle_, 1024);
+    audit_set_backlog_limit(handle_, FLAGS_audit_backlog_limit);
     audit_set_failure(handle_, AUDIT_FAIL_SILENT);
 
     // Request only the highest priority of audit status messages.
@@ -192,9 +421,6 @@ void AuditEventPublisher::configure() {
   // Able to issue libaudit API calls.
   struct AuditRuleInternal rule;
 
-  // Before reply data is ever filled in, assure an empty message.
-  memset(&reply_, 0, sizeof(struct audit_reply));
-
   if (handle_ <= 0 || FLAGS_disable_audit || immutable_) {
     // No configuration or rule manipulation needed.
     // The publisher run loop may still receive audit metadata events.
@@ -282,68 +508,27 @@ bool handleAuditReply(const struct audit_reply& reply,
                       AuditEventContextRef& ec) {
   // Build an event context around this reply.
   ec->type = reply.type;
+  ec->syscall = 0;
   // Tokenize the message.
   boost::string_ref message_view(reply.message, reply.len);
   auto preamble_end = message_view.find("): ");
-  if (preamble_end == std::string::npos) {
+  if (preamble_end == std::string::npos || preamble_end < 21) {
     return false;
   }
 
-  safeStrtoul(std::string(message_view.substr(6, 10)), 10, ec->time);
-  safeStrtoul(
-      std::string(message_view.substr(21, preamble_end - 21)), 10, ec->auid);
-  boost::string_ref field_view(message_view.substr(preamble_end + 3));
-
-  // The linear search will construct series of key value pairs.
-  std::string key, value;
-  key.reserve(20);
-  value.reserve(256);
-
-  // There are several ways of representing value data (enclosed strings, etc).
-  bool found_assignment{false}, found_enclose{false};
-  for (const auto& c : field_view) {
-    // Iterate over each character in the audit message.
-    if ((found_enclose && c == '"') || (!found_enclose && c == ' ')) {
-      if (c == '"') {
-        value += c;
-      }
-      // This is a terminating sequence, the end of an enclosure or space tok.
-      if (!key.empty()) {
-        // Multiple space tokens are supported.
-        ec->fields.emplace(std::make_pair(std::move(key), std::move(value)));
-      }
-      found_enclose = false;
-      found_assignment = false;
-      key.clear();
-      value.clear();
-    } else if (!found_assignment && c == ' ') {
-      // A field tokenizer.
-    } else if (found_assignment) {
-      // Enclosure sequences appear immediately following assignment.
-      if (c == '"') {
-        found_enclose = true;
-      }
-      value += c;
-    } else if (c == '=') {
-      found_assignment = true;
-    } else {
-      key += c;
-    }
+  if (!parseAuditNumber(message_view.substr(6, 10), ec->time)) {
+    ec->time = 0;
   }
-
-  // Last step, if there was no trailing tokenizer.
-  if (!key.empty()) {
-    ec->fields.emplace(std::make_pair(std::move(key), std::move(value)));
+  if (!parseAuditNumber(message_view.substr(21, preamble_end - 21),
+                        ec->auid)) {
+    ec->auid = 0;
   }
+  ec->fields.parse(message_view.substr(preamble_end + 3));
 
   // There is a special field for syscalls.
-  if (ec->fields.count("syscall") == 1) {
-    const auto& syscall_string = ec->fields.at("syscall").c_str();
-    long long syscall{0};
-    if (!safeStrtoll(syscall_string, 10, syscall)) {
-      syscall = 0;
-    }
-    ec->syscall = syscall;
+  size_t syscall = 0;
+  if (parseAuditNumber(ec->fields.get(AuditFieldKey::SYSCALL), syscall)) {
+    ec->syscall = static_cast<int>(syscall);
   }
 
   return true;
@@ -394,7 +579,33 @@ static inline bool adjust_reply(struct audit_reply* rep, int len) {
   return true;
 }
 
-static inline bool safe_audit_get_reply(int fd, struct audit_reply* rep) {
+void AuditReplyRing::resize(size_t size) {
+  size = std::max(size, static_cast<size_t>(1));
+  // Before reply data is ever filled in, assure empty messages.
+  struct audit_reply empty_reply;
+  memset(&empty_reply, 0, sizeof(empty_reply));
+  replies.assign(size, empty_reply);
+
+  struct mmsghdr empty_header;
+  memset(&empty_header, 0, sizeof(empty_header));
+  headers.assign(size, empty_header);
+  iovecs.resize(size);
+  addresses.resize(size);
+  for (size_t i = 0; i < size; i++) {
+    iovecs[i].iov_base = &replies[i].msg;
+    iovecs[i].iov_len = sizeof(replies[i].msg);
+    headers[i].msg_hdr.msg_name = &addresses[i];
+    headers[i].msg_hdr.msg_iov = &iovecs[i];
+    headers[i].msg_hdr.msg_iovlen = 1;
+  }
+}
+
+/**
+ * @brief Wait briefly for audit replies and receive as many as the ring holds.
+ *
+ * @return The number of replies received, 0 if there were none, or -errno.
+ */
+static inline int safe_audit_get_replies(int fd, AuditReplyRing& ring) {
   if (fd < 0) {
     return -EBADF;
   }
@@ -406,138 +617,213 @@ static inline bool safe_audit_get_reply(int fd, struct audit_reply* rep) {
   FD_SET(fd, &readSet);
 
   if (select(fd + 1, &readSet, nullptr, nullptr, &timeout) < 0) {
-    return -1;
+    return -errno;
   }
 
   if (!FD_ISSET(fd, &readSet)) {
-    return -1;
+    return 0;
   }
 
-  struct sockaddr_nl nladdr;
-  socklen_t nladdrlen = sizeof(nladdr);
-
-  int len = recvfrom(fd,
-                     &rep->msg,
-                     sizeof(rep->msg),
-                     0,
-                     (struct sockaddr*)&nladdr,
-                     &nladdrlen);
-  if (len < 0) {
-    return -errno;
+  for (auto& header : ring.headers) {
+    header.msg_hdr.msg_namelen = sizeof(struct sockaddr_nl);
+    header.msg_len = 0;
   }
 
-  if (nladdrlen != sizeof(nladdr)) {
-    return -EPROTO;
+  int count = recvmmsg(fd,
+                       ring.headers.data(),
+                       static_cast<unsigned int>(ring.headers.size()),
+                       MSG_DONTWAIT,
+                       nullptr);
+  if (count < 0) {
+    return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -errno;
   }
+  return count;
+}
+
+void AuditEventPublisher::handleReply(const struct audit_reply& reply) {
+  bool handle_reply = false;
 
-  if (nladdr.nl_pid) {
-    return -EINVAL;
+  switch (reply.type) {
+  case NLMSG_NOOP:
+  case NLMSG_DONE:
+  case NLMSG_ERROR:
+    // Not handled, request another reply.
+    break;
+  case AUDIT_LIST_RULES:
+    // Build rules cache.
+    handleListRules();
+    break;
+  case AUDIT_SECCOMP:
+    break;
+  case AUDIT_GET:
+    // Make a copy of the status reply and store as the most-recent.
+    if (reply.status != nullptr) {
+      WriteLock lock(status_mutex_);
+      memcpy(&status_, reply.status, sizeof(struct audit_status));
+    }
+    break;
+  case AUDIT_FIRST_USER_MSG... AUDIT_LAST_USER_MSG:
+    handle_reply = true;
+    break;
+  case (AUDIT_GET + 1)...(AUDIT_LIST_RULES - 1):
+  case (AUDIT_LIST_RULES + 1)...(AUDIT_FIRST_USER_MSG - 1):
+    // Not interested in handling meta-commands and actions.
+    break;
+  case AUDIT_DAEMON_START... AUDIT_DAEMON_CONFIG: // 1200 - 1203
+  case AUDIT_CONFIG_CHANGE:
+    handleAuditConfigChange(reply);
+    break;
+  case AUDIT_SYSCALL: // 1300
+    // A monitored syscall was issued, most likely part of a multi-record.
+    handle_reply = true;
+    break;
+  case AUDIT_CWD: // 1307
+  case AUDIT_PATH: // 1302
+  case AUDIT_EXECVE: // // 1309 (execve arguments).
+    handle_reply = true;
+  case AUDIT_EOE: // 1320 (multi-record event).
+    break;
+  default:
+    // All other cases, pass to reply.
+    handle_reply = true;
   }
 
-  if (!adjust_reply(rep, len)) {
-    return -errno;
+  // Replies are 'handled' as potential events for several audit types.
+  if (handle_reply) {
+    // Reuse the last context and its buffers if no subscriber holds it.
+    if (spare_ == nullptr || !spare_.unique()) {
+      spare_ = createEventContext();
+    }
+    spare_->EventContext::time = 0;
+
+    // Build the event context from the reply type and parse the message.
+    if (handleAuditReply(reply, spare_)) {
+      fire(spare_);
+    }
   }
-  return len;
 }
 
-Status AuditEventPublisher::run() {
-  if (!FLAGS_disable_audit && (count_ == 0 || count_++ % 10 == 0)) {
-    // Request an update to the audit status.
-    // This will also fill in the status on first run.
-    audit_request_status(handle_);
+void AuditEventPublisher::rollRateWindow(size_t now) {
+  if (now < window_start_ + kAuditRateWindow) {
+    return;
   }
 
-  auto inspectReply = ([this]() {
-    bool handle_reply = false;
+  // The last window is empty if no record was seen during it.
+  if (now >= window_start_ + 2 * kAuditRateWindow) {
+    last_window_records_.clear();
+  } else {
+    last_window_records_ = std::move(window_records_);
+  }
+  window_records_.clear();
+  window_start_ = now - (now % kAuditRateWindow);
+}
 
-    switch (reply_.type) {
-    case NLMSG_NOOP:
-    case NLMSG_DONE:
-    case NLMSG_ERROR:
-      // Not handled, request another reply.
-      break;
-    case AUDIT_LIST_RULES:
-      // Build rules cache.
-      handleListRules();
-      break;
-    case AUDIT_SECCOMP:
-      break;
-    case AUDIT_GET:
-      // Make a copy of the status reply and store as the most-recent.
-      if (reply_.status != nullptr) {
-        memcpy(&status_, reply_.status, sizeof(struct audit_status));
-      }
-      break;
-    case AUDIT_FIRST_USER_MSG... AUDIT_LAST_USER_MSG:
-      handle_reply = true;
-      break;
-    case (AUDIT_GET + 1)...(AUDIT_LIST_RULES - 1):
-    case (AUDIT_LIST_RULES + 1)...(AUDIT_FIRST_USER_MSG - 1):
-      // Not interested in handling meta-commands and actions.
-      break;
-    case AUDIT_DAEMON_START... AUDIT_DAEMON_CONFIG: // 1200 - 1203
-    case AUDIT_CONFIG_CHANGE:
-      handleAuditConfigChange(reply_);
-      break;
-    case AUDIT_SYSCALL: // 1300
-      // A monitored syscall was issued, most likely part of a multi-record.
-      handle_reply = true;
-      break;
-    case AUDIT_CWD: // 1307
-    case AUDIT_PATH: // 1302
-    case AUDIT_EXECVE: // // 1309 (execve arguments).
-      handle_reply = true;
-    case AUDIT_EOE: // 1320 (multi-record event).
-      break;
-    default:
-      // All other cases, pass to reply.
-      handle_reply = true;
-    }
+void AuditEventPublisher::countRecord(int type, size_t now) {
+  WriteLock lock(status_mutex_);
+  rollRateWindow(now);
+  records_++;
+  type_records_[type]++;
+  window_records_[type]++;
+}
+
+AuditPublisherStatus AuditEventPublisher::getStatus() {
+  AuditPublisherStatus status;
+  WriteLock lock(status_mutex_);
+  rollRateWindow(getUnixTime());
+  memcpy(&status.status, &status_, sizeof(struct audit_status));
+  status.control = control_;
+  status.receive_buffer = receive_buffer_;
+  status.records = records_;
+  status.batches = batches_;
+  status.overflows = overflows_;
+  status.type_records = type_records_;
+  for (const auto& type : last_window_records_) {
+    status.type_rates[type.first] =
+        static_cast<double>(type.second) / kAuditRateWindow;
+  }
+  return status;
+}
 
-    // Replies are 'handled' as potential events for several audit types.
-    if (handle_reply) {
-      auto ec = createEventContext();
-      // Build the event context from the reply type and parse the message.
-      if (handleAuditReply(reply_, ec)) {
-        fire(ec);
+Status AuditEventPublisher::run() {
+  // Replies are read until the publisher ends. Returning applies the run
+  // loop's cool down, during which bursts must fit in the kernel backlog.
+  auto next_status = std::chrono::steady_clock::now();
+  bool status_requested = false;
+  while (!isEnding()) {
+    auto steady_now = std::chrono::steady_clock::now();
+    if (steady_now >= next_status) {
+      // Another process may have gained control over the audit sink, check
+      // the status received since the last request, then request an update.
+      // This will also fill in the status on the first request.
+      if (status_requested) {
+        updateControl();
+      }
+      if (!FLAGS_disable_audit) {
+        audit_request_status(handle_);
+        status_requested = true;
       }
+      next_status = steady_now + kAuditStatusInterval;
     }
-  });
-
-  // Reset the reply data.
-  bool result = false;
-  do {
-    // Request a reply in a non-blocking mode.
-    // This allows the publisher's run loop to periodically request an audit
-    // status update. These updates can check for other processes attempting to
-    // gain control over the audit sink.
-    // This non-blocking also allows faster receipt of multi-message events.
-    result = safe_audit_get_reply(handle_, &reply_);
-
-    if (result) {
-      inspectReply();
+
+    // Wait briefly for replies, this allows the status to be requested
+    // periodically and allows faster receipt of multi-message events.
+    int count = safe_audit_get_replies(handle_, ring_);
+    if (count == -ENOBUFS) {
+      // The kernel dropped records because the receive buffer was full.
+      WriteLock lock(status_mutex_);
+      overflows_++;
+      continue;
+    } else if (count == 0 || count == -EINTR) {
+      // A timeout, the ring holds no new replies.
+      continue;
+    } else if (count < 0) {
+      // The handle failed, retry after the cool down.
+      break;
     }
-  } while (result && !isEnding());
-
-  if (static_cast<pid_t>(status_.pid) != getpid()) {
-    if (control_ && status_.pid != 0) {
-      VLOG(1) << "Audit control lost to pid: " << status_.pid;
-      // This process has lost control of audit.
-      // The initial request for control was made during setup.
-      control_ = false;
+
+    {
+      WriteLock lock(status_mutex_);
+      batches_++;
     }
 
-    if (FLAGS_audit_persist && !FLAGS_disable_audit && !immutable_) {
-      VLOG(1) << "Persisting audit control";
-      audit_set_pid(handle_, getpid(), WAIT_NO);
-      control_ = true;
+    auto now = getUnixTime();
+    for (int i = 0; i < count; i++) {
+      auto& header = ring_.headers[i];
+      auto& reply = ring_.replies[i];
+      if (header.msg_hdr.msg_namelen != sizeof(struct sockaddr_nl) ||
+          ring_.addresses[i].nl_pid != 0 ||
+          !adjust_reply(&reply, static_cast<int>(header.msg_len))) {
+        // Only replies from the kernel are accepted.
+        continue;
+      }
+
+      countRecord(reply.type, now);
+      handleReply(reply);
     }
   }
 
-  // Only apply a cool down if the reply request failed.
   return Status(0, "OK");
 }
 
+void AuditEventPublisher::updateControl() {
+  if (static_cast<pid_t>(status_.pid) == getpid()) {
+    return;
+  }
+
+  if (control_ && status_.pid != 0) {
+    VLOG(1) << "Audit control lost to pid: " << status_.pid;
+    // This process has lost control of audit.
+    // The initial request for control was made during setup.
+    control_ = false;
+  }
+
+  if (FLAGS_audit_persist && !FLAGS_disable_audit && !immutable_) {
+    VLOG(1) << "Persisting audit control";
+    audit_set_pid(handle_, getpid(), WAIT_NO);
+    control_ = true;
+  }
+}
+
 bool AuditEventPublisher::shouldFire(const AuditSubscriptionContextRef& sc,
                                      const AuditEventContextRef& ec) const {
   // User messages allow a catch all configuration.
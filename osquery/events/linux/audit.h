@@ -11,12 +11,13 @@
 #pragma once
 
 #include <libaudit.h>
+#include <sys/socket.h>
 
 #include <map>
 #include <set>
 #include <vector>
 
-#include <boost/algorithm/hex.hpp>
+#include <boost/utility/string_ref.hpp>
 
 #include <osquery/events.h>
 
@@ -68,6 +69,133 @@ using Auid = size_t;
 /// Alias the field container so we can replace and improve with refactors.
 using AuditFields = std::map<std::string, std::string>;
 
+/// Interned names of the audit fields read by the audit subscribers.
+enum class AuditFieldKey : uint8_t {
+  UNKNOWN = 0,
+  /// Any execve argument or syscall argument, a0, a1, ... aN.
+  ARGN,
+  /// A piece of a long execve argument, aN[0], aN[1], ...
+  ARGN_PART,
+  ARGC,
+  SYSCALL,
+  SUCCESS,
+  EXIT,
+  ITEM,
+  PID,
+  PPID,
+  UID,
+  EUID,
+  GID,
+  EGID,
+  EXE,
+  COMM,
+  MODE,
+  OUID,
+  OGID,
+  DEV,
+  INODE,
+  SADDR,
+  MSG,
+  ADDR,
+  TERMINAL,
+  /// The number of interned keys, not a key.
+  COUNT,
+};
+
+/**
+ * @brief The fields of a single audit message in a flat array.
+ *
+ * The message text is copied once into the record and each field is kept as
+ * offsets into that copy, so parsing does not allocate per field. Known keys
+ * are interned when parsed and found without comparing strings. Values are
+ * kept raw, quoted or hex-encoded, and only decoded when a subscriber asks.
+ *
+ * Parsing into the same record again reuses its buffers. Once a record is
+ * fired within an event context it is shared by every subscriber and must
+ * not be changed.
+ */
+class AuditRecord {
+ public:
+  /// Returned by find when a field is missing.
+  static const size_t npos = static_cast<size_t>(-1);
+
+  /// Tokenize the key=value section of an audit message.
+  void parse(boost::string_ref message);
+
+  /// The number of fields, including duplicate keys.
+  size_t size() const {
+    return fields_.size();
+  }
+
+  bool empty() const {
+    return fields_.empty();
+  }
+
+  /// The interned key of the i-th field.
+  AuditFieldKey id(size_t i) const {
+    return fields_[i].id;
+  }
+
+  /// The key of the i-th field.
+  boost::string_ref key(size_t i) const {
+    return view(fields_[i].key_offset, fields_[i].key_size);
+  }
+
+  /// The raw value of the i-th field.
+  boost::string_ref value(size_t i) const {
+    return view(fields_[i].value_offset, fields_[i].value_size);
+  }
+
+  /// The index of the first field with an interned key, or npos.
+  size_t find(AuditFieldKey id) const {
+    auto index = index_[static_cast<size_t>(id)];
+    return (index == 0) ? npos : index - 1;
+  }
+
+  /// The index of the first field with this key, or npos.
+  size_t find(boost::string_ref key) const;
+
+  /// Check if a field exists.
+  template <typename K>
+  bool has(K key) const {
+    return find(key) != npos;
+  }
+
+  /// The raw value of a field or the missing value if it does not exist.
+  template <typename K>
+  boost::string_ref get(K key, boost::string_ref missing = "") const {
+    auto i = find(key);
+    return (i == npos) ? missing : value(i);
+  }
+
+  /// The decoded value of a field or an empty string.
+  template <typename K>
+  std::string decode(K key) const;
+
+ private:
+  boost::string_ref view(uint32_t offset, uint32_t size) const {
+    return boost::string_ref(message_.data() + offset, size);
+  }
+
+ private:
+  struct Field {
+    AuditFieldKey id{AuditFieldKey::UNKNOWN};
+    uint32_t key_offset{0};
+    uint32_t key_size{0};
+    uint32_t value_offset{0};
+    uint32_t value_size{0};
+  };
+
+  /// A copy of the message, fields are offsets into this buffer.
+  std::string message_;
+
+  /// All fields in message order.
+  std::vector<Field> fields_;
+
+  /// Index + 1 of the first field for each interned key, 0 when missing.
+  uint32_t index_[static_cast<size_t>(AuditFieldKey::COUNT)]{};
+};
+
 /**
  * @brief The message callback method used within AuditAssembler.
  *
@@ -82,8 +210,8 @@ using AuditFields = std::map<std::string, std::string>;
  * @return true if the message was parsed correctly, false if the multi-message
  *   encountered an error and should be removed.
  */
-using AuditUpdate =
-    std::function<bool(size_t type, const AuditFields& fields, AuditFields& r)>;
+using AuditUpdate = std::function<bool(
+    size_t type, const AuditRecord& fields, AuditFields& r)>;
 
 /**
  * @brief A multi-message assembler based on expectations of message-type sets.
@@ -107,7 +235,7 @@ class AuditAssembler : private boost::noncopyable {
   /// Add a message from audit.
   boost::optional<AuditFields> add(Auid id,
                                    size_t type,
-                                   const AuditFields& fields);
+                                   const AuditRecord& fields);
 
   /// Allow the publisher to explicit-set fields.
   void set(Auid id, const std::string& key, const std::string& value) {
@@ -147,15 +275,12 @@ class AuditAssembler : private boost::noncopyable {
 };
 
 /// Handle quote and hex-encoded audit field content.
-inline std::string decodeAuditValue(const std::string& s) {
-  if (s.size() > 1 && s[0] == '"') {
-    return s.substr(1, s.size() - 2);
-  }
-  try {
-    return boost::algorithm::unhex(s);
-  } catch (const boost::algorithm::hex_decode_error& e) {
-    return s;
-  }
+std::string decodeAuditValue(boost::string_ref s);
+
+template <typename K>
+std::string AuditRecord::decode(K key) const {
+  auto i = find(key);
+  return (i == npos) ? "" : decodeAuditValue(value(i));
 }
 
 struct AuditSubscriptionContext : public SubscriptionContext {
@@ -197,9 +322,10 @@ struct AuditEventContext : public EventContext {
    * @brief The audit message tokenized into fields.
    *
    * If the field contained a space in the value the data will be hex encoded.
-   * It is the responsibility of the subscription callback/handler to parse.
+   * It is the responsibility of the subscription callback/handler to decode.
+   * The record is shared by every subscriber, callbacks only read it.
    */
-  AuditFields fields;
+  AuditRecord fields;
 
   /// Each message will contain the audit ID.
   size_t auid{0};
@@ -211,6 +337,44 @@ struct AuditEventContext : public EventContext {
 using AuditEventContextRef = std::shared_ptr<AuditEventContext>;
 using AuditSubscriptionContextRef = std::shared_ptr<AuditSubscriptionContext>;
 
+/// Buffers for receiving a batch of netlink replies with one recvmmsg call.
+struct AuditReplyRing {
+  std::vector<struct audit_reply> replies;
+  std::vector<struct mmsghdr> headers;
+  std::vector<struct iovec> iovecs;
+  std::vector<struct sockaddr_nl> addresses;
+
+  /// Allocate buffers for a number of replies, at least 1.
+  void resize(size_t size);
+};
+
+/// The kernel audit status and the publisher's receive counters.
+struct AuditPublisherStatus {
+  /// The last (most current) status reply.
+  struct audit_status status;
+
+  /// Is this process in control of the audit subsystem.
+  bool control{false};
+
+  /// The netlink socket receive buffer size in bytes.
+  size_t receive_buffer{0};
+
+  /// Records received since the publisher started.
+  size_t records{0};
+
+  /// Receive calls that returned records.
+  size_t batches{0};
+
+  /// Receives that failed because the socket buffer overflowed.
+  size_t overflows{0};
+
+  /// Records received for each audit type since the publisher started.
+  std::map<int, size_t> type_records;
+
+  /// Records per second for each audit type in the last rate window.
+  std::map<int, double> type_rates;
+};
+
 class AuditEventPublisher
     : public EventPublisher<AuditSubscriptionContext, AuditEventContext> {
   DECLARE_PUBLISHER("audit");
@@ -242,7 +406,7 @@ class AuditEventPublisher
   /// Remove audit rules and close the handle.
   void tearDown() override;
 
-  /// Poll for replies to the netlink handle in a non-blocking mode.
+  /// Receive replies from the netlink handle until the publisher ends.
   Status run() override;
 
  public:
@@ -252,10 +416,25 @@ class AuditEventPublisher
     tearDown();
   }
 
+  /// Copy the audit status and receive counters.
+  AuditPublisherStatus getStatus();
+
  private:
   /// Maintain a list of audit rule data for displaying or deleting.
   void handleListRules();
 
+  /// Inspect a single reply and fire events for record types.
+  void handleReply(const struct audit_reply& reply);
+
+  /// Reclaim, or note the loss of, audit control using the last status.
+  void updateControl();
+
+  /// Count a received record by type.
+  void countRecord(int type, size_t now);
+
+  /// Start a new rate window if the current one ended, call with the lock.
+  void rollRateWindow(size_t now);
+
   /// Apply normal subscription to event matching logic.
   bool shouldFire(const AuditSubscriptionContextRef& mc,
                   const AuditEventContextRef& ec) const override;
@@ -275,23 +454,38 @@ class AuditEventPublisher
    */
   struct audit_status status_;
 
-  /**
-   * @brief A counter of non-blocking netlink reads that contained no data.
-   *
-   * After several iterations of no data, the audit run loop will request a
-   * status. It is possible another user land daemon requested control of the
-   * audit subsystem. The kernel thread will only emit to a single handle.
-   */
-  size_t count_{0};
-
   /// Is this process in control of the audit subsystem.
-  bool control_{false};
+  std::atomic<bool> control_{false};
+
+  /// Buffers for the replies received with each batch.
+  AuditReplyRing ring_;
 
-  /// The last (most recent) audit reply.
-  struct audit_reply reply_;
+  /// The last fired context, parsed into again once subscribers release it.
+  AuditEventContextRef spare_{nullptr};
 
   /// Track all rule data added by the publisher.
   std::vector<struct AuditRuleInternal> transient_rules_;
+
+  /// The netlink socket receive buffer size in bytes.
+  size_t receive_buffer_{0};
+
+  /// Receive counters, read by the audit_status tables.
+  size_t records_{0};
+  size_t batches_{0};
+  size_t overflows_{0};
+  std::map<int, size_t> type_records_;
+
+  /// Per-type records in the current and last complete rate windows.
+  std::map<int, size_t> window_records_;
+  std::map<int, size_t> last_window_records_;
+  size_t window_start_{0};
+
+  /// Protects the status copy and receive counters.
+  Mutex status_mutex_;
+
+ private:
+  FRIEND_TEST(AuditTests, test_audit_status);
+  FRIEND_TEST(AuditTests, test_run_timeout);
 };
 
 /**
@@ -19,7 +19,7 @@
 namespace osquery {
 
 /// This is a poor interface.
-extern bool ProcessUpdate(size_t, const AuditFields&, AuditFields&);
+extern bool ProcessUpdate(size_t, const AuditRecord&, AuditFields&);
 
 const std::vector<std::string> kBenchmarkMessages = {
     "audit(1480751147.912:48372): arch=c000003e syscall=59 success=yes exit=0 "
@@ -68,6 +68,59 @@ static void AUDIT_handleReply(benchmark::State& state) {
 
 BENCHMARK(AUDIT_handleReply);
 
+static void AUDIT_handleReply_reuse(benchmark::State& state) {
+  auto reply = getMockReply(kBenchmarkMessages[0]);
+  auto ec = std::make_shared<AuditEventContext>();
+
+  while (state.KeepRunning()) {
+    // The publisher parses into the last context once it is released.
+    handleAuditReply(reply, ec);
+  }
+
+  free((void*)reply.message);
+}
+
+BENCHMARK(AUDIT_handleReply_reuse);
+
+static void AUDIT_record_parse(benchmark::State& state) {
+  const auto& message = kBenchmarkMessages[state.range_x()];
+  auto fields = message.substr(message.find("): ") + 3);
+  AuditRecord record;
+
+  while (state.KeepRunning()) {
+    record.parse(fields);
+    benchmark::DoNotOptimize(record.get(AuditFieldKey::PID));
+  }
+}
+
+BENCHMARK(AUDIT_record_parse)->Arg(0)->Arg(1)->Arg(5);
+
+static void AUDIT_record_lookup(benchmark::State& state) {
+  const auto& message = kBenchmarkMessages[0];
+  AuditRecord record;
+  record.parse(message.substr(message.find("): ") + 3));
+
+  while (state.KeepRunning()) {
+    // Interned keys are indexed, other keys are compared.
+    benchmark::DoNotOptimize(record.get(AuditFieldKey::EXE));
+    benchmark::DoNotOptimize(record.get("fsgid"));
+  }
+}
+
+BENCHMARK(AUDIT_record_lookup);
+
+static void AUDIT_decodeValue(benchmark::State& state) {
+  const auto& message = kBenchmarkMessages[5];
+  AuditRecord record;
+  record.parse(message.substr(message.find("): ") + 3));
+
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(record.decode("proctitle"));
+  }
+}
+
+BENCHMARK(AUDIT_decodeValue);
+
 static void AUDIT_assembler(benchmark::State& state) {
   AuditAssembler asmb;
   asmb.start(
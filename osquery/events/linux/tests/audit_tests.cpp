@@ -9,10 +9,18 @@
  */
 
 #include <stdio.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+#include <atomic>
+#include <thread>
 
 #include <gtest/gtest.h>
 
 #include <osquery/events.h>
+#include <osquery/filesystem.h>
+#include <osquery/flags.h>
 #include <osquery/tables.h>
 
 #include "osquery/events/linux/audit.h"
@@ -20,6 +28,8 @@
 
 namespace osquery {
 
+DECLARE_bool(disable_audit);
+
 /// Internal audit publisher testable methods.
 extern bool handleAuditReply(const struct audit_reply& reply,
                              AuditEventContextRef& ec);
@@ -27,6 +37,11 @@ extern bool handleAuditReply(const struct audit_reply& reply,
 /// Internal audit subscriber (socket events) testable methods.
 extern void parseSockAddr(const std::string& saddr, Row& r);
 
+/// Internal audit subscriber (process events) testable methods.
+extern bool ProcessUpdate(size_t type,
+                          const AuditRecord& fields,
+                          AuditFields& r);
+
 class AuditTests : public testing::Test {
  protected:
   void SetUp() override {
@@ -60,11 +75,77 @@ TEST_F(AuditTests, test_handle_reply) {
   EXPECT_EQ(1440542781U, ec->time);
   EXPECT_EQ(403030U, ec->auid);
   EXPECT_EQ(ec->fields.size(), 4U);
-  EXPECT_EQ(ec->fields.count("argc"), 1U);
-  EXPECT_EQ(ec->fields["argc"], "3");
-  EXPECT_EQ(ec->fields["a0"], "\"H=1 \"");
-  EXPECT_EQ(ec->fields["a1"], "\"/bin/sh\"");
-  EXPECT_EQ(ec->fields["a2"], "c");
+  EXPECT_TRUE(ec->fields.has("argc"));
+  EXPECT_EQ(ec->fields.get("argc"), "3");
+  EXPECT_EQ(ec->fields.get("a0"), "\"H=1 \"");
+  EXPECT_EQ(ec->fields.get("a1"), "\"/bin/sh\"");
+  EXPECT_EQ(ec->fields.get("a2"), "c");
+}
+
+TEST_F(AuditTests, test_audit_record) {
+  AuditRecord record;
+  record.parse(
+      "syscall=59 success=yes  exe=\"/usr/bin/git\" a0=\"a b\" a1=6C73 "
+      "key=(null) flag pid=1 pid=2");
+  ASSERT_EQ(record.size(), 9U);
+
+  // Known keys are interned, fields keep the message order.
+  EXPECT_EQ(record.id(0), AuditFieldKey::SYSCALL);
+  EXPECT_EQ(record.key(3), "a0");
+  EXPECT_EQ(record.id(3), AuditFieldKey::ARGN);
+  EXPECT_EQ(record.id(4), AuditFieldKey::ARGN);
+  EXPECT_EQ(record.id(5), AuditFieldKey::UNKNOWN);
+  EXPECT_EQ(record.find(AuditFieldKey::SUCCESS), record.find("success"));
+
+  // Values are raw until decoded.
+  EXPECT_EQ(record.get(AuditFieldKey::EXE), "\"/usr/bin/git\"");
+  EXPECT_EQ(record.decode(AuditFieldKey::EXE), "/usr/bin/git");
+  EXPECT_EQ(record.value(3), "\"a b\"");
+  EXPECT_EQ(decodeAuditValue(record.value(4)), "ls");
+
+  // A key without an assignment has an empty value, the first key wins.
+  EXPECT_TRUE(record.has("flag"));
+  EXPECT_EQ(record.get("flag"), "");
+  EXPECT_EQ(record.get(AuditFieldKey::PID), "1");
+  EXPECT_FALSE(record.has(AuditFieldKey::PPID));
+  EXPECT_EQ(record.get(AuditFieldKey::PPID, "0"), "0");
+  EXPECT_EQ(record.decode(AuditFieldKey::PPID), "");
+
+  // Parsing again reuses the record.
+  record.parse("ppid=3");
+  EXPECT_EQ(record.size(), 1U);
+  EXPECT_FALSE(record.has(AuditFieldKey::PID));
+  EXPECT_EQ(record.get(AuditFieldKey::PPID), "3");
+
+  // A copy does not refer to the original buffer.
+  auto copy = record;
+  record.parse("ppid=4");
+  EXPECT_EQ(copy.get(AuditFieldKey::PPID), "3");
+
+  // Long arguments are split into pieces after their length.
+  record.parse("a1_len=6 a1[0]=6C73 a1[1]=\"-l\" a1[x]=0 a[0]=0");
+  ASSERT_EQ(record.size(), 5U);
+  EXPECT_EQ(record.id(0), AuditFieldKey::UNKNOWN);
+  EXPECT_EQ(record.id(1), AuditFieldKey::ARGN_PART);
+  EXPECT_EQ(record.id(2), AuditFieldKey::ARGN_PART);
+  EXPECT_EQ(record.id(3), AuditFieldKey::UNKNOWN);
+  EXPECT_EQ(record.id(4), AuditFieldKey::UNKNOWN);
+}
+
+TEST_F(AuditTests, test_process_split_arguments) {
+  AuditRecord fields;
+  AuditFields r;
+  fields.parse("pid=1 comm=\"ls\"");
+  ProcessUpdate(AUDIT_SYSCALL, fields, r);
+
+  // The pieces of a split argument are joined, and may continue in a
+  // following EXECVE record.
+  fields.parse("argc=3 a0=\"ls\" a1_len=7 a1[0]=2D2D636F");
+  ProcessUpdate(AUDIT_EXECVE, fields, r);
+  fields.parse("a1[1]=\"lor\" a2=\"/\"");
+  ProcessUpdate(AUDIT_EXECVE, fields, r);
+  EXPECT_EQ(r["cmdline"], "ls --color /");
+  EXPECT_EQ(r["cmdline_size"], "12");
 }
 
 TEST_F(AuditTests, test_audit_value_decode) {
@@ -79,14 +160,15 @@ TEST_F(AuditTests, test_audit_value_decode) {
   // When the hex fails to decode the input value is returned as the result.
   auto decoded_fail = decodeAuditValue("7");
   EXPECT_EQ(decoded_fail, "7");
+  EXPECT_EQ(decodeAuditValue("7Z"), "7Z");
 }
 
 size_t kAuditCounter{0};
 
-bool SimpleUpdate(size_t t, const AuditFields& f, AuditFields& m) {
+bool SimpleUpdate(size_t t, const AuditRecord& f, AuditFields& m) {
   kAuditCounter++;
-  for (const auto& i : f) {
-    m[i.first] = i.second;
+  for (size_t i = 0; i < f.size(); i++) {
+    m[f.key(i).to_string()] = f.value(i).to_string();
   }
   return true;
 }
@@ -98,7 +180,8 @@ TEST_F(AuditTests, test_audit_assembler) {
   std::vector<size_t> expected_types{1, 2, 3};
   asmb.start(3, expected_types, nullptr);
 
-  AuditFields expected_fields{{"1", "1"}};
+  AuditRecord expected_fields;
+  expected_fields.parse("1=1");
   asmb.add(100U, 1, expected_fields);
 
   EXPECT_EQ(3U, asmb.capacity_);
@@ -108,7 +191,7 @@ TEST_F(AuditTests, test_audit_assembler) {
   // This will be empty since there is no update method.
   EXPECT_TRUE(asmb.m_[100].empty());
 
-  expected_fields = {{"2", "2"}};
+  expected_fields.parse("2=2");
   asmb.add(100U, 1, expected_fields);
 
   // Again empty.
@@ -151,7 +234,123 @@ TEST_F(AuditTests, test_audit_assembler) {
   EXPECT_FALSE(asmb.add(1, 2, expected_fields).is_initialized());
   auto fields = asmb.add(1, 3, expected_fields);
   EXPECT_TRUE(fields.is_initialized());
-  EXPECT_EQ(*fields, expected_fields);
+  EXPECT_EQ(*fields, AuditFields({{"2", "2"}}));
+}
+
+TEST_F(AuditTests, test_process_file_times) {
+  auto path = kTestWorkingDirectory + "audit-exec";
+  ASSERT_TRUE(writeTextFile(path, "#!/bin/sh").ok());
+  struct stat file_stat;
+  ASSERT_EQ(stat(path.c_str(), &file_stat), 0);
+
+  AuditRecord fields;
+  fields.parse("pid=1 exe=\"" + path + "\"");
+  AuditFields r;
+  ProcessUpdate(AUDIT_SYSCALL, fields, r);
+  EXPECT_EQ(r["path"], path);
+  EXPECT_EQ(r.count("mtime"), 0U);
+
+  // The PATH record includes the executed file's device and inode. The
+  // audit device may not match stat's, such as on btrfs subvolumes.
+  std::string dev = (major(file_stat.st_dev) == 0xfe) ? "fd:fd" : "fe:fe";
+  fields.parse("item=0 mode=0100755 ouid=1 ogid=2 inode=" +
+               std::to_string(file_stat.st_ino) + " dev=" + dev);
+  ProcessUpdate(AUDIT_PATH, fields, r);
+  EXPECT_EQ(r["mode"], "0100755");
+  EXPECT_EQ(r["owner_uid"], "1");
+  EXPECT_EQ(r["mtime"], std::to_string(file_stat.st_mtime));
+  EXPECT_EQ(r["ctime"], std::to_string(file_stat.st_ctime));
+
+  // Later PATH records describe the loader and do not change the row.
+  AuditRecord loader;
+  loader.parse("item=1 mode=0100644 ouid=0 ogid=0 inode=1 dev=" + dev);
+  auto expected = r;
+  ProcessUpdate(AUDIT_PATH, loader, r);
+  EXPECT_EQ(r, expected);
+
+  // Times cached for the audit device and inode do not need the file.
+  AuditFields cached = {{"path", path + "-missing"}};
+  ProcessUpdate(AUDIT_PATH, fields, cached);
+  EXPECT_EQ(cached["mtime"], r["mtime"]);
+
+  fields.parse("item=0");
+  AuditFields missing = {{"path", path + "-missing"}};
+  ProcessUpdate(AUDIT_PATH, fields, missing);
+  EXPECT_EQ(missing.count("mtime"), 0U);
+
+  // A PATH record without an item describes the executed file.
+  fields.parse("mode=0100700");
+  ProcessUpdate(AUDIT_PATH, fields, missing);
+  EXPECT_EQ(missing["mode"], "0100700");
+}
+
+TEST_F(AuditTests, test_audit_status) {
+  AuditReplyRing ring;
+  ring.resize(0);
+  EXPECT_EQ(ring.headers.size(), 1U);
+
+  // Each header receives into its own reply.
+  ring.resize(4);
+  ASSERT_EQ(ring.headers.size(), 4U);
+  EXPECT_EQ(ring.headers[3].msg_hdr.msg_iov->iov_base, &ring.replies[3].msg);
+  EXPECT_EQ(ring.headers[3].msg_hdr.msg_name, &ring.addresses[3]);
+
+  // Records counted during the last complete window have a rate.
+  auto now = getUnixTime();
+  auto last_window = now - (now % 60) - 60;
+  AuditEventPublisher publisher;
+  publisher.countRecord(AUDIT_SYSCALL, last_window);
+  publisher.countRecord(AUDIT_SYSCALL, last_window + 59);
+  publisher.countRecord(AUDIT_PATH, now);
+
+  auto status = publisher.getStatus();
+  EXPECT_EQ(status.records, 3U);
+  EXPECT_EQ(status.type_records[AUDIT_SYSCALL], 2U);
+  EXPECT_EQ(status.type_records[AUDIT_PATH], 1U);
+  EXPECT_DOUBLE_EQ(status.type_rates[AUDIT_SYSCALL], 2.0 / 60);
+  EXPECT_EQ(status.type_rates.count(AUDIT_PATH), 0U);
+}
+
+TEST_F(AuditTests, test_run_timeout) {
+  // A socket without replies, every wait for a reply times out.
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds), 0);
+
+  auto disable_audit = FLAGS_disable_audit;
+  FLAGS_disable_audit = true;
+  AuditEventPublisher publisher;
+  publisher.handle_ = fds[0];
+
+  // The ring holds a kernel reply received before the timeouts.
+  publisher.ring_.resize(1);
+  auto& reply = publisher.ring_.replies[0];
+  reply.msg.nlh.nlmsg_type = AUDIT_USER;
+  reply.msg.nlh.nlmsg_len = NLMSG_LENGTH(0);
+  publisher.ring_.headers[0].msg_len = NLMSG_LENGTH(0);
+  publisher.ring_.headers[0].msg_hdr.msg_namelen = sizeof(struct sockaddr_nl);
+  publisher.ring_.addresses[0].nl_pid = 0;
+
+  std::atomic<bool> returned{false};
+  std::thread runner([&publisher, &returned]() {
+    publisher.run();
+    returned = true;
+  });
+
+  // Timeouts neither end the loop nor inspect the stale reply again.
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_FALSE(returned);
+  auto status = publisher.getStatus();
+  EXPECT_EQ(status.records, 0U);
+  EXPECT_EQ(status.batches, 0U);
+
+  publisher.isEnding(true);
+  runner.join();
+  EXPECT_TRUE(returned);
+
+  publisher.handle_ = 0;
+  close(fds[0]);
+  close(fds[1]);
+  FLAGS_disable_audit = disable_audit;
 }
 
 TEST_F(AuditTests, test_parse_sock_addr) {
@@ -76,9 +76,19 @@ TEST_F(EventsDatabaseTests, test_event_module_id) {
 
   // Not normally available outside of EventSubscriber->Add().
   auto event_id1 = sub->getEventID();
-  EXPECT_EQ(event_id1, "1");
+  EXPECT_EQ(event_id1, "00000000000000000001");
   auto event_id2 = sub->getEventID();
-  EXPECT_EQ(event_id2, "2");
+  EXPECT_EQ(event_id2, "00000000000000000002");
+
+  // A block of IDs is reserved, a restarted subscriber continues after it.
+  std::string reserved;
+  getDatabaseValue(kEvents, "eid." + sub->dbNamespace(), reserved);
+  EXPECT_EQ(reserved, "10000");
+
+  auto restarted = std::make_shared<DBFakeEventSubscriber>();
+  auto event_id3 = restarted->getEventID();
+  EXPECT_EQ(event_id3, "00000000000000010001");
+  EXPECT_LT(event_id2, event_id3);
 }
 
 TEST_F(EventsDatabaseTests, test_event_add) {
@@ -89,38 +99,31 @@ TEST_F(EventsDatabaseTests, test_event_add) {
 
 TEST_F(EventsDatabaseTests, test_record_indexing) {
   auto sub = std::make_shared<DBFakeEventSubscriber>();
-  auto status = sub->testAdd(2);
+  auto status = sub->testAdd(61);
+  status = sub->testAdd(2);
   status = sub->testAdd(11);
-  status = sub->testAdd(61);
-  status = sub->testAdd((1 * 3600) + 1);
-  status = sub->testAdd((2 * 3600) + 1);
 
-  // An "all" range, will pick up everything in the largest index.
-  auto indexes = sub->getIndexes(0, 3 * 3600);
-  auto output = boost::algorithm::join(indexes, ", ");
-  EXPECT_EQ("60.0, 60.1, 60.60, 60.120", output);
-
-  // Restrict range to "most specific", which is an index by 10.
-  indexes = sub->getIndexes(0, 5);
-  output = boost::algorithm::join(indexes, ", ");
-  // The order 10, 0th index include results with t = [0, 10).
-  EXPECT_EQ("60.0", output);
-
-  // Add specific indexes to the upper bound.
-  status = sub->testAdd((2 * 3600) + 11);
-  status = sub->testAdd((2 * 3600) + 61);
-  indexes = sub->getIndexes(2 * 3600, (2 * 3600) + 62);
-  output = boost::algorithm::join(indexes, ", ");
-  EXPECT_EQ("60.120, 60.121", output);
-
-  // Request specific lower and upper bounding.
-  indexes = sub->getIndexes(2, (2 * 3600) + 62);
-  output = boost::algorithm::join(indexes, ", ");
-  EXPECT_EQ("60.0, 60.1, 60.60, 60.120, 60.121", output);
+  // Event data is keyed by time, then EventID, regardless of the add order.
+  std::vector<std::string> keys;
+  scanDatabaseKeys(kEvents, keys, "timeline." + sub->dbNamespace() + ".");
+  ASSERT_EQ(3U, keys.size());
+  auto prefix = "timeline." + sub->dbNamespace() + ".";
+  EXPECT_EQ(prefix + "00000000000000000002.00000000000000000002", keys[0]);
+  EXPECT_EQ(prefix + "00000000000000000011.00000000000000000003", keys[1]);
+  EXPECT_EQ(prefix + "00000000000000000061.00000000000000000001", keys[2]);
+
+  // Events are returned in time order.
+  sub->doNotExpire();
+  auto results = sub->get(0, 0);
+  ASSERT_EQ(3U, results.size());
+  EXPECT_EQ("2", results[0]["time"]);
+  EXPECT_EQ("11", results[1]["time"]);
+  EXPECT_EQ("61", results[2]["time"]);
 }
 
 TEST_F(EventsDatabaseTests, test_record_range) {
   auto sub = std::make_shared<DBFakeEventSubscriber>();
+  sub->doNotExpire();
   auto status = sub->testAdd(1);
   status = sub->testAdd(2);
   status = sub->testAdd(11);
@@ -128,43 +131,35 @@ TEST_F(EventsDatabaseTests, test_record_range) {
   status = sub->testAdd((1 * 3600) + 1);
   status = sub->testAdd((2 * 3600) + 1);
 
-  // Search within a specific record range.
-  auto indexes = sub->getIndexes(0, 10);
-  EXPECT_EQ(1U, indexes.size());
-  auto records = sub->getRecords(indexes);
-  // This will return 3 results, ::get filters records by an absolute range.
-  EXPECT_EQ(3U, records.size()); // 1, 2, 11
+  // Search within a specific time range, both bounds are inclusive.
+  auto results = sub->get(0, 10);
+  EXPECT_EQ(2U, results.size()); // 1, 2
+  results = sub->get(0, 11);
+  EXPECT_EQ(3U, results.size()); // 1, 2, 11
 
   // Search within a large bound.
-  indexes = sub->getIndexes(3, 3601);
-  // This will include the 0-10 bucket meaning 1, 2 will show up.
-  records = sub->getRecords(indexes);
-  EXPECT_EQ(5U, records.size()); // 1, 2, 11, 61, 3601
+  results = sub->get(3, 3601);
+  EXPECT_EQ(3U, results.size()); // 11, 61, 3601
 
   // Get all of the records.
-  indexes = sub->getIndexes(0, 3 * 3600);
-  records = sub->getRecords(indexes);
-  EXPECT_EQ(6U, records.size()); // 1, 2, 11, 61, 3601, 7201
+  results = sub->get(0, 3 * 3600);
+  EXPECT_EQ(6U, results.size()); // 1, 2, 11, 61, 3601, 7201
 
   // stop = 0 is an alias for everything.
-  indexes = sub->getIndexes(0, 0);
-  records = sub->getRecords(indexes);
-  EXPECT_EQ(6U, records.size());
+  results = sub->get(0, 0);
+  EXPECT_EQ(6U, results.size());
 
   for (size_t j = 0; j < 30; j++) {
-    // 110 is 10 below an index (60.2).
     sub->testAdd(110 + static_cast<int>(j));
   }
 
-  indexes = sub->getIndexes(110, 0);
-  auto output = boost::algorithm::join(indexes, ", ");
-  EXPECT_EQ("60.1, 60.2, 60.60, 60.120", output);
-  records = sub->getRecords(indexes);
-  EXPECT_EQ(33U, records.size()); // (61) 110 - 139 + 3601, 7201
+  results = sub->get(110, 0);
+  EXPECT_EQ(32U, results.size()); // 110 - 139, 3601, 7201
 }
 
 TEST_F(EventsDatabaseTests, test_record_expiration) {
   auto sub = std::make_shared<DBFakeEventSubscriber>();
+  sub->doNotExpire();
   auto status = sub->testAdd(1);
   status = sub->testAdd(2);
   status = sub->testAdd(11);
@@ -173,34 +168,30 @@ TEST_F(EventsDatabaseTests, test_record_expiration) {
   status = sub->testAdd((2 * 3600) + 1);
 
   // No expiration
-  auto indexes = sub->getIndexes(0, 5000);
-  auto records = sub->getRecords(indexes);
-  EXPECT_EQ(5U, records.size()); // 1, 2, 11, 61, 3601
+  auto results = sub->get(0, 5000);
+  EXPECT_EQ(5U, results.size()); // 1, 2, 11, 61, 3601
 
-  sub->expire_events_ = true;
+  // Events at or before the expire time are removed.
   sub->expire_time_ = 10;
-  indexes = sub->getIndexes(0, 5000);
-  records = sub->getRecords(indexes);
-  EXPECT_EQ(3U, records.size()); // 11, 61, 3601
-
-  indexes = sub->getIndexes(0, 5000);
-  records = sub->getRecords(indexes);
-  EXPECT_EQ(3U, records.size()); // 11, 61, 3601
+  sub->expireEvents();
+  results = sub->get(0, 5000);
+  EXPECT_EQ(3U, results.size()); // 11, 61, 3601
 
-  indexes = sub->getIndexes(0, 5000);
-  records = sub->getRecords(indexes);
-  EXPECT_EQ(3U, records.size()); // 11, 61, 3601
-
-  indexes = sub->getIndexes(0, 5000);
-  records = sub->getRecords(indexes);
-  EXPECT_EQ(3U, records.size()); // 11, 61, 3601
+  sub->expire_time_ = 11;
+  sub->expireEvents();
+  results = sub->get(0, 5000);
+  EXPECT_EQ(2U, results.size()); // 61, 3601
 
   // Check that get/deletes did not act on cache.
   // This implies that RocksDB is flushing the requested delete records.
   sub->expire_time_ = 0;
-  indexes = sub->getIndexes(0, 5000);
-  records = sub->getRecords(indexes);
-  EXPECT_EQ(3U, records.size()); // 11, 61, 3601
+  sub->expireEvents();
+  results = sub->get(0, 5000);
+  EXPECT_EQ(2U, results.size()); // 61, 3601
+
+  std::vector<std::string> keys;
+  scanDatabaseKeys(kEvents, keys, "timeline." + sub->dbNamespace() + ".");
+  EXPECT_EQ(3U, keys.size()); // 61, 3601, 7201
 }
 
 TEST_F(EventsDatabaseTests, test_gentable) {
@@ -225,9 +216,8 @@ TEST_F(EventsDatabaseTests, test_gentable) {
 
   std::vector<std::string> keys;
   scanDatabaseKeys("events", keys);
-  // 9 data records, 1 eid counter, 3 indexes, 15 index records.
-  // Depending on the moment, an additional 3 indexs may be introduced.
-  EXPECT_LE(16U, keys.size());
+  // 9 data records, 1 eid reservation.
+  EXPECT_EQ(10U, keys.size());
 
   // Perform a "select" equivalent.
   QueryContext context;
@@ -247,9 +237,10 @@ TEST_F(EventsDatabaseTests, test_gentable) {
   results = sub->genTable(context);
   EXPECT_EQ(3U, results.size());
 
+  // The expired events were removed, 3 data records, 1 eid reservation.
   keys.clear();
   scanDatabaseKeys("events", keys);
-  EXPECT_LE(6U, keys.size());
+  EXPECT_EQ(4U, keys.size());
 }
 
 TEST_F(EventsDatabaseTests, test_optimize) {
@@ -293,6 +284,39 @@ TEST_F(EventsDatabaseTests, test_optimize) {
   kToolType = default_type;
 }
 
+TEST_F(EventsDatabaseTests, test_migrate_events) {
+  auto sub = std::make_shared<DBFakeEventSubscriber>();
+  auto ns = sub->dbNamespace();
+
+  // Events buffered using the previous data, records, and indexes layout.
+  Row r = {{"testing", "legacy"}, {"time", "30"}};
+  std::string content;
+  serializeRowJSON(r, content);
+  setDatabaseValue(kEvents, "data." + ns + ".1", content);
+  r["time"] = "20";
+  serializeRowJSON(r, content);
+  setDatabaseValue(kEvents, "data." + ns + ".2", content);
+  setDatabaseValue(kEvents, "records." + ns + ".60.0", "1:30,2:20");
+  setDatabaseValue(kEvents, "indexes." + ns + ".60", "0");
+  setDatabaseValue(kEvents, "eid." + ns, "2");
+
+  sub->migrateEvents();
+  std::vector<std::string> keys;
+  scanDatabaseKeys(kEvents, keys, "data." + ns + ".");
+  scanDatabaseKeys(kEvents, keys, "records." + ns + ".");
+  scanDatabaseKeys(kEvents, keys, "indexes." + ns + ".");
+  EXPECT_TRUE(keys.empty());
+
+  // The events are kept, in time order, and new IDs follow the legacy IDs.
+  sub->doNotExpire();
+  auto results = sub->get(0, 0);
+  ASSERT_EQ(results.size(), 2U);
+  EXPECT_EQ(results[0]["time"], "20");
+  EXPECT_EQ(results[1]["time"], "30");
+  EXPECT_EQ(results[1]["testing"], "legacy");
+  EXPECT_EQ(sub->getEventID(), "00000000000000000003");
+}
+
 TEST_F(EventsDatabaseTests, test_expire_check) {
   auto sub = std::make_shared<DBFakeEventSubscriber>();
   // Set the max number of buffered events to something reasonably small.
@@ -327,16 +351,16 @@ TEST_F(EventsDatabaseTests, test_expire_check) {
         sub->testAdd(t++);
       }
 
-      // Records hold the event_id + time indexes.
-      // Data hosts the event_id + JSON content.
-      auto record_key = "records." + sub->dbNamespace();
-      auto data_key = "data." + sub->dbNamespace();
+      // Markers hold the event_id to time mapping.
+      // Data hosts the time + event_id to JSON content.
+      auto marker_key = "markers." + sub->dbNamespace();
+      auto data_key = "timeline." + sub->dbNamespace();
 
-      std::vector<std::string> records, datas;
-      scanDatabaseKeys(kEvents, records, record_key);
+      std::vector<std::string> markers, datas;
+      scanDatabaseKeys(kEvents, markers, marker_key);
       scanDatabaseKeys(kEvents, datas, data_key);
 
-      EXPECT_LT(records.size(), 20U);
+      EXPECT_LT(markers.size(), 20U);
       EXPECT_LT(datas.size(), 60U);
     }
   }
@@ -8,16 +8,28 @@
  *
  */
 
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
 #include <boost/filesystem/operations.hpp>
 
 #include <gtest/gtest.h>
 
 #include <osquery/config.h>
 #include <osquery/events.h>
+#include <osquery/flags.h>
 #include <osquery/tables.h>
 
+#include "osquery/events/dispatch_queue.h"
+
 namespace osquery {
 
+DECLARE_uint64(events_queue_size);
+DECLARE_string(events_queue_overflow);
+
 class EventsTests : public ::testing::Test {
  public:
   void SetUp() override {
@@ -410,6 +422,186 @@ TEST_F(EventsTests, test_fire_event) {
   EXPECT_EQ(kBellHathTolled, 4);
 }
 
+TEST_F(EventsTests, test_fire_event_queued) {
+  auto pub = std::make_shared<BasicEventPublisher>();
+  EventFactory::registerEventPublisher(pub);
+
+  // Subscribers registered with a queue size receive events on a thread.
+  auto backup_size = FLAGS_events_queue_size;
+  FLAGS_events_queue_size = 8;
+  auto sub = std::make_shared<FakeEventSubscriber>();
+  EventFactory::registerEventSubscriber(sub);
+  FLAGS_events_queue_size = backup_size;
+
+  auto subscription = Subscription::create("FakeSubscriber");
+  subscription->callback = TestTheeCallback;
+  EventFactory::addSubscription("publisher", subscription);
+  pub->configure();
+
+  auto tolled = kBellHathTolled;
+  auto ec = pub->createEventContext();
+  pub->fire(ec, 0);
+  pub->fire(ec, 0);
+
+  // Ending the factory delivers the queued events.
+  EventFactory::end(true);
+  EXPECT_EQ(kBellHathTolled, tolled + 2);
+  EXPECT_EQ(sub->queueDepth(), 0U);
+  EXPECT_EQ(sub->queueDrops(), 0U);
+}
+
+TEST_F(EventsTests, test_fire_event_blocked) {
+  auto pub = std::make_shared<BasicEventPublisher>();
+  EventFactory::registerEventPublisher(pub);
+
+  auto backup_size = FLAGS_events_queue_size;
+  auto backup_overflow = FLAGS_events_queue_overflow;
+  FLAGS_events_queue_size = 2;
+  FLAGS_events_queue_overflow = "block";
+  auto sub = std::make_shared<FakeEventSubscriber>();
+  EventFactory::registerEventSubscriber(sub);
+  FLAGS_events_queue_size = backup_size;
+  FLAGS_events_queue_overflow = backup_overflow;
+
+  std::promise<void> release;
+  auto released = release.get_future().share();
+  auto subscription = Subscription::create("FakeSubscriber");
+  subscription->callback = ([released](const EventContextRef& ec,
+                                       const SubscriptionContextRef& sc) {
+    released.wait();
+    return Status(0);
+  });
+  EventFactory::addSubscription("publisher", subscription);
+  pub->configure();
+
+  // Subscriptions may still change while the publisher waits for space.
+  auto checked = std::async(std::launch::async, [&pub, &release]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto added = std::async(std::launch::async, [&pub]() {
+      return pub->addSubscription(Subscription::create("FakeSubscriber"));
+    });
+    auto status = added.wait_for(std::chrono::seconds(1));
+    release.set_value();
+    added.wait();
+    return status == std::future_status::ready;
+  });
+
+  // The publisher waits once the subscriber's queue is full.
+  auto ec = pub->createEventContext();
+  for (size_t i = 0; i < 4; i++) {
+    pub->fire(ec, 0);
+  }
+  EXPECT_TRUE(checked.get());
+  EventFactory::end(true);
+}
+
+TEST_F(EventsTests, test_dispatch_queue) {
+  auto ec = std::make_shared<EventContext>();
+  auto subscription = Subscription::create("FakeSubscriber");
+  std::atomic<size_t> delivered{0};
+  subscription->callback = ([&delivered](const EventContextRef& ec,
+                                         const SubscriptionContextRef& sc) {
+    delivered++;
+    return Status(0);
+  });
+
+  {
+    EventDispatchQueue queue(16, false);
+    for (size_t i = 0; i < 100; i++) {
+      EXPECT_TRUE(queue.push(subscription, ec));
+    }
+    queue.stop();
+    EXPECT_EQ(queue.depth(), 0U);
+    EXPECT_EQ(queue.delivered(), delivered);
+    EXPECT_EQ(queue.delivered() + queue.drops(), 100U);
+
+    // A stopped queue asks the publisher to call the subscriber.
+    EXPECT_FALSE(queue.push(subscription, ec));
+  }
+
+  // While the subscriber is busy a full queue drops the oldest events.
+  std::promise<void> release;
+  auto released = release.get_future().share();
+  subscription->callback = ([released](const EventContextRef& ec,
+                                       const SubscriptionContextRef& sc) {
+    released.wait();
+    return Status(0);
+  });
+
+  EventDispatchQueue queue(2, false);
+  for (size_t i = 0; i < 5; i++) {
+    EXPECT_TRUE(queue.push(subscription, ec));
+  }
+  // At most one event is in the callback and two are queued.
+  EXPECT_GE(queue.drops(), 2U);
+
+  release.set_value();
+  queue.stop();
+  EXPECT_EQ(queue.delivered() + queue.drops(), 5U);
+}
+
+TEST_F(EventsTests, test_dispatch_queue_block) {
+  auto ec = std::make_shared<EventContext>();
+  auto subscription = Subscription::create("FakeSubscriber");
+  std::promise<void> release;
+  auto released = release.get_future().share();
+  subscription->callback = ([released](const EventContextRef& ec,
+                                       const SubscriptionContextRef& sc) {
+    released.wait();
+    return Status(0);
+  });
+
+  // A blocking queue holds the publisher until the subscriber takes events.
+  EventDispatchQueue queue(2, true);
+  std::atomic<size_t> pushed{0};
+  std::thread publisher([&queue, &pushed, &subscription, &ec]() {
+    for (size_t i = 0; i < 5; i++) {
+      if (queue.push(subscription, ec)) {
+        pushed++;
+      }
+    }
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_LT(pushed, 5U);
+
+  release.set_value();
+  publisher.join();
+  queue.stop();
+  EXPECT_EQ(pushed, 5U);
+  EXPECT_EQ(queue.delivered(), 5U);
+  EXPECT_EQ(queue.drops(), 0U);
+}
+
+TEST_F(EventsTests, test_dispatch_queue_stop) {
+  auto ec = std::make_shared<EventContext>();
+  auto subscription = Subscription::create("FakeSubscriber");
+  subscription->callback = ([](const EventContextRef& ec,
+                               const SubscriptionContextRef& sc) {
+    return Status(0);
+  });
+
+  // Every event accepted while stopping is delivered.
+  EventDispatchQueue queue(1024, false);
+  std::atomic<size_t> pushed{0};
+  std::vector<std::thread> publishers;
+  for (size_t i = 0; i < 4; i++) {
+    publishers.emplace_back([&queue, &pushed, &subscription, &ec]() {
+      while (queue.push(subscription, ec)) {
+        pushed++;
+      }
+    });
+  }
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  queue.stop();
+  for (auto& publisher : publishers) {
+    publisher.join();
+  }
+  EXPECT_EQ(queue.depth(), 0U);
+  EXPECT_EQ(queue.delivered() + queue.drops(), pushed);
+}
+
 class SubFakeEventSubscriber : public FakeEventSubscriber {
  public:
   SubFakeEventSubscriber() {
@@ -28,6 +28,7 @@
 #include <boost/filesystem.hpp>
 #include <boost/optional.hpp>
 
+#include <osquery/filesystem.h>
 #include <osquery/status.h>
 
 namespace fs = boost::filesystem;
@@ -273,6 +274,23 @@ bool platformChmod(const std::string& path, mode_t perms);
  */
 std::vector<std::string> platformGlob(const std::string& find_path);
 
+/**
+ * @brief List everything below a set of directories in one traversal.
+ *
+ * This resolves the recursive part of a '%%' pattern. Each directory is read
+ * once, where each level of a recursive glob would read the tree again.
+ *
+ * @param roots Directories to walk, each ending with a separator.
+ * @param depth The number of levels below the roots to list.
+ * @param limits Report files, folders, or both.
+ * @param threads The number of threads sharing the walk.
+ * @return Entries below the roots, folders end with a separator.
+ */
+std::vector<std::string> platformWalk(const std::vector<std::string>& roots,
+                                      size_t depth,
+                                      GlobLimits limits,
+                                      size_t threads);
+
 /**
  * @brief Checks to see if the current user has the permissions to perform a
  *        specified operation on a file.
@@ -8,6 +8,7 @@
  *
  */
 
+#include <algorithm>
 #include <sstream>
 
 #include <fcntl.h>
@@ -47,6 +48,11 @@ HIDDEN_FLAG(bool, allow_unsafe, false, "Allow unsafe executable permissions");
 /// Disable forensics (atime/mtime preserving) file reads.
 HIDDEN_FLAG(bool, disable_forensic, true, "Disable atime/mtime preservation");
 
+FLAG(uint64,
+     glob_walk_threads,
+     4,
+     "Threads used to list directories below recursive (%%) patterns");
+
 static const size_t kMaxRecursiveGlobs = 64;
 
 Status writeTextFile(const fs::path& path,
@@ -244,42 +250,54 @@ Status remove(const fs::path& path) {
   return Status(status_code, "N/A");
 }
 
+/// Check if a glob result is a folder, glob marks them with a separator.
+static inline bool isGlobFolder(const std::string& found) {
+  return found.back() == '/' || found.back() == '\\';
+}
+
 static void genGlobs(std::string path,
                      std::vector<std::string>& results,
                      GlobLimits limits) {
   // Use our helped escape/replace for wildcards.
   replaceGlobWildcards(path, limits);
 
-  // Generate a glob set and recurse for double star.
-  size_t glob_index = 0;
-  while (++glob_index < kMaxRecursiveGlobs) {
-    auto glob_results = platformGlob(path);
+  // The first level of a double star is a normal glob.
+  auto glob_results = platformGlob(path);
 
-    for (auto const& result_path : glob_results) {
-      results.push_back(result_path);
+  // Allow a trailing slash after the double wild indicator.
+  size_t wild = path.rfind("**");
+  bool recursive = !(wild > path.size() || wild < path.size() - 3);
+
+  // Folders found at the first level are walked once for the deeper levels.
+  std::vector<std::string> roots;
+  for (auto& found : glob_results) {
+    if (found.empty()) {
+      continue;
     }
 
-    // The end state is a non-recursive ending or empty set of matches.
-    size_t wild = path.rfind("**");
-    // Allow a trailing slash after the double wild indicator.
-    if (glob_results.size() == 0 || wild > path.size() ||
-        wild < path.size() - 3) {
-      break;
+    bool folder = isGlobFolder(found);
+    if (recursive && folder) {
+      roots.push_back(found);
     }
-    path += "/**";
-  }
-
-  // Prune results based on settings/requested glob limitations.
-  auto end = std::remove_if(
-      results.begin(), results.end(), [limits](const std::string& found) {
-        return !(((found[found.length() - 1] == '/' ||
-                   found[found.length() - 1] == '\\') &&
-                  limits & GLOB_FOLDERS) ||
-                 ((found[found.length() - 1] != '/' &&
-                   found[found.length() - 1] != '\\') &&
-                  limits & GLOB_FILES));
-      });
-  results.erase(end, results.end());
+
+    // Prune results based on settings/requested glob limitations.
+    if ((folder && (limits & GLOB_FOLDERS)) ||
+        (!folder && (limits & GLOB_FILES))) {
+      results.push_back(std::move(found));
+    }
+  }
+
+  if (!roots.empty()) {
+    // Sort the walked entries, the walk order depends on thread scheduling.
+    auto walked = platformWalk(roots,
+                               kMaxRecursiveGlobs - 2,
+                               limits,
+                               static_cast<size_t>(FLAGS_glob_walk_threads));
+    std::sort(walked.begin(), walked.end());
+    results.insert(results.end(),
+                   std::make_move_iterator(walked.begin()),
+                   std::make_move_iterator(walked.end()));
+  }
 }
 
 Status resolveFilePattern(const fs::path& fs_path,
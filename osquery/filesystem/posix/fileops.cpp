@@ -8,6 +8,7 @@
  *
  */
 
+#include <dirent.h>
 #include <glob.h>
 #include <pwd.h>
 #include <stdio.h>
@@ -18,6 +19,18 @@
 #include <sys/time.h>
 #include <sys/types.h>
 
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include <boost/noncopyable.hpp>
 #include <boost/optional.hpp>
 
 #include <osquery/filesystem.h>
@@ -300,6 +313,215 @@ std::vector<std::string> platformGlob(const std::string& find_path) {
   return results;
 }
 
+namespace {
+
+/// A directory waiting to be listed, the path ends with a '/'.
+struct WalkDirectory {
+  std::string path;
+  size_t depth{0};
+};
+
+/**
+ * @brief List directory trees with a pool of threads.
+ *
+ * Each thread lists directories from the back of its own queue and queues
+ * the subdirectories it finds there. An idle thread steals from the front of
+ * another thread's queue, which holds the directories closest to the roots
+ * and most likely to have large trees below them.
+ *
+ * Entry types come from the directory listing, only symlinks and entries of
+ * an unknown type are stat-ed.
+ */
+class DirectoryWalker : private boost::noncopyable {
+ public:
+  DirectoryWalker(size_t threads, size_t depth, GlobLimits limits)
+      : depth_(depth), limits_(limits), queues_(std::max(threads, size_t(1))) {
+  }
+
+  std::vector<std::string> walk(const std::vector<std::string>& roots) {
+    for (size_t i = 0; i < roots.size(); i++) {
+      WalkDirectory root;
+      root.path = roots[i];
+      auto& queue = queues_[i % queues_.size()];
+      queue.directories.push_back(std::move(root));
+    }
+    pending_ = roots.size();
+
+    std::vector<std::vector<std::string>> results(queues_.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < queues_.size(); i++) {
+      threads.emplace_back([this, i, &results]() { work(i, results[i]); });
+    }
+    work(0, results[0]);
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    for (size_t i = 1; i < results.size(); i++) {
+      results[0].insert(results[0].end(),
+                        std::make_move_iterator(results[i].begin()),
+                        std::make_move_iterator(results[i].end()));
+    }
+    return std::move(results[0]);
+  }
+
+ private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<WalkDirectory> directories;
+  };
+
+  /// Take a directory from this thread's queue or steal one.
+  bool next(size_t id, WalkDirectory& directory) {
+    {
+      auto& queue = queues_[id];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (!queue.directories.empty()) {
+        directory = std::move(queue.directories.back());
+        queue.directories.pop_back();
+        return true;
+      }
+    }
+
+    for (size_t i = 1; i < queues_.size(); i++) {
+      auto& queue = queues_[(id + i) % queues_.size()];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (!queue.directories.empty()) {
+        directory = std::move(queue.directories.front());
+        queue.directories.pop_front();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void work(size_t id, std::vector<std::string>& results) {
+    std::vector<WalkDirectory> children;
+    WalkDirectory directory;
+    while (pending_ > 0) {
+      if (!next(id, directory)) {
+        // Other threads are listing the remaining directories.
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        continue;
+      }
+
+      children.clear();
+      list(directory, children, results);
+      if (!children.empty()) {
+        pending_ += children.size();
+        auto& queue = queues_[id];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        for (auto& child : children) {
+          queue.directories.push_back(std::move(child));
+        }
+      }
+      pending_--;
+    }
+  }
+
+  /// Add a directory entry, queue subdirectories that are within the depth.
+  void add(const WalkDirectory& directory,
+           int fd,
+           const char* name,
+           unsigned char type,
+           std::vector<WalkDirectory>& children,
+           std::vector<std::string>& results) {
+    // Like glob, wildcards do not match hidden entries.
+    if (name[0] == '.') {
+      return;
+    }
+
+    bool is_directory = (type == DT_DIR);
+    if (type == DT_LNK || type == DT_UNKNOWN) {
+      // Links to directories are followed.
+      struct stat entry;
+      is_directory =
+          (fstatat(fd, name, &entry, 0) == 0 && S_ISDIR(entry.st_mode));
+    }
+
+    if (!is_directory) {
+      if (limits_ & GLOB_FILES) {
+        results.push_back(directory.path + name);
+      }
+      return;
+    }
+
+    auto path = directory.path + name + '/';
+    if (directory.depth + 1 < depth_) {
+      WalkDirectory child;
+      child.path = path;
+      child.depth = directory.depth + 1;
+      children.push_back(std::move(child));
+    }
+
+    if (limits_ & GLOB_FOLDERS) {
+      results.push_back(std::move(path));
+    }
+  }
+
+  void list(const WalkDirectory& directory,
+            std::vector<WalkDirectory>& children,
+            std::vector<std::string>& results) {
+    int fd = openat(AT_FDCWD,
+                    directory.path.c_str(),
+                    O_RDONLY | O_DIRECTORY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+      return;
+    }
+
+#if defined(__linux__)
+    // Read many entries, with their types, for each system call.
+    alignas(struct dirent64) char buffer[32 * 1024];
+    while (true) {
+      auto size = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+      if (size <= 0) {
+        break;
+      }
+
+      for (long offset = 0; offset < size;) {
+        auto entry = reinterpret_cast<struct dirent64*>(buffer + offset);
+        add(directory, fd, entry->d_name, entry->d_type, children, results);
+        offset += entry->d_reclen;
+      }
+    }
+    close(fd);
+#else
+    auto dir = fdopendir(fd);
+    if (dir == nullptr) {
+      close(fd);
+      return;
+    }
+
+    struct dirent* entry = nullptr;
+    while ((entry = readdir(dir)) != nullptr) {
+      add(directory, fd, entry->d_name, entry->d_type, children, results);
+    }
+    closedir(dir);
+#endif
+  }
+
+ private:
+  size_t depth_{0};
+  GlobLimits limits_{GLOB_ALL};
+  std::vector<Queue> queues_;
+
+  /// Directories queued or being listed.
+  std::atomic<size_t> pending_{0};
+};
+}
+
+std::vector<std::string> platformWalk(const std::vector<std::string>& roots,
+                                      size_t depth,
+                                      GlobLimits limits,
+                                      size_t threads) {
+  if (roots.empty() || depth == 0) {
+    return {};
+  }
+
+  DirectoryWalker walker(threads, depth, limits);
+  return walker.walk(roots);
+}
+
 int platformAccess(const std::string& path, mode_t mode) {
   return ::access(path.c_str(), mode);
 }
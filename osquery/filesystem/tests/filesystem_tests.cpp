@@ -23,6 +23,7 @@
 #include <osquery/system.h>
 
 #include "osquery/core/process.h"
+#include "osquery/filesystem/fileops.h"
 #include "osquery/tests/test_util.h"
 
 namespace fs = boost::filesystem;
@@ -32,6 +33,7 @@ namespace osquery {
 
 DECLARE_uint64(read_max);
 DECLARE_uint64(read_user_max);
+DECLARE_uint64(glob_walk_threads);
 
 #ifdef WIN32
 auto raw_drive = getEnvVar("SystemDrive");
@@ -269,6 +271,33 @@ TEST_F(FilesystemTests, test_wildcard_double_folders) {
                            .string()));
 }
 
+TEST_F(FilesystemTests, test_walk) {
+  auto root = fs::path(kFakeDirectory + "/deep11/").make_preferred().string();
+  auto results = platformWalk({root}, 1, GLOB_ALL, 4);
+  EXPECT_EQ(results.size(), 3U);
+  EXPECT_TRUE(contains(
+      results,
+      fs::path(kFakeDirectory + "/deep11/deep2/").make_preferred().string()));
+
+  // Each level below the roots is listed once.
+  results = platformWalk({root}, 2, GLOB_ALL, 4);
+  EXPECT_EQ(results.size(), 5U);
+  results = platformWalk({root}, 64, GLOB_FOLDERS, 4);
+  EXPECT_EQ(results.size(), 2U);
+  results = platformWalk({root}, 64, GLOB_FILES, 1);
+  EXPECT_EQ(results.size(), 4U);
+
+  // A single thread walks the same entries as the pool.
+  auto threads = FLAGS_glob_walk_threads;
+  std::vector<std::string> pooled;
+  resolveFilePattern(kFakeDirectory + "/%%", pooled);
+  FLAGS_glob_walk_threads = 1;
+  std::vector<std::string> single;
+  resolveFilePattern(kFakeDirectory + "/%%", single);
+  FLAGS_glob_walk_threads = threads;
+  EXPECT_EQ(pooled, single);
+}
+
 TEST_F(FilesystemTests, test_wildcard_end_last_component) {
   std::vector<std::string> results;
   auto status = resolveFilePattern(kFakeDirectory + "/%11/%sh", results);
@@ -1213,6 +1213,33 @@ boost::optional<std::string> getHomeDirectory() {
   }
 }
 
+std::vector<std::string> platformWalk(const std::vector<std::string>& roots,
+                                      size_t depth,
+                                      GlobLimits limits,
+                                      size_t threads) {
+  // Directories are listed level by level on the calling thread.
+  std::vector<std::string> results;
+  auto level = roots;
+  for (size_t i = 0; i < depth && !level.empty(); i++) {
+    std::vector<std::string> next_level;
+    for (const auto& directory : level) {
+      for (auto& found : platformGlob(directory + "*")) {
+        bool folder = (found.back() == '/' || found.back() == '\\');
+        if (folder) {
+          next_level.push_back(found);
+        }
+
+        if ((folder && (limits & GLOB_FOLDERS)) ||
+            (!folder && (limits & GLOB_FILES))) {
+          results.push_back(std::move(found));
+        }
+      }
+    }
+    level = std::move(next_level);
+  }
+  return results;
+}
+
 int platformAccess(const std::string& path, mode_t mode) {
   auto status = hasAccess(path, mode);
   if (status.ok()) {
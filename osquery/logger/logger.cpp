@@ -496,24 +496,23 @@ Status logQueryLogItem(const QueryLogItem& results,
     return Status(0, "Logging disabled");
   }
 
-  std::vector<std::string> json_items;
-  Status status;
-  if (FLAGS_log_result_events) {
-    status = serializeQueryLogItemAsEventsJSON(results, json_items);
-  } else {
-    std::string json;
-    status = serializeQueryLogItemJSON(results, json);
-    json_items.push_back(json);
+  // Log lines are streamed into a single buffer, reused for each event.
+  std::string json;
+  if (!FLAGS_log_result_events) {
+    writeQueryLogItemJSON(results, json);
+    return logString(json, "event", receiver);
   }
-  if (!status.ok()) {
-    return status;
+
+  // Write "removed" rows first, the same order as the serialized results.
+  Status status;
+  for (const auto& row : results.results.removed) {
+    writeQueryLogEventJSON(results, "removed", row, json);
+    status = logString(json, "event", receiver);
   }
 
-  for (auto& json : json_items) {
-    if (!json.empty() && json.back() == '\n') {
-      json.pop_back();
-      status = logString(json, "event", receiver);
-    }
+  for (const auto& row : results.results.added) {
+    writeQueryLogEventJSON(results, "added", row, json);
+    status = logString(json, "event", receiver);
   }
   return status;
 }
@@ -524,12 +523,7 @@ Status logSnapshotQuery(const QueryLogItem& item) {
   }
 
   std::string json;
-  if (!serializeQueryLogItemJSON(item, json)) {
-    return Status(1, "Could not serialize snapshot");
-  }
-  if (!json.empty() && json.back() == '\n') {
-    json.pop_back();
-  }
+  writeQueryLogItemJSON(item, json);
   return Registry::call("logger", {{"snapshot", json}});
 }
 
@@ -51,19 +51,17 @@ Status BufferedLogForwarder::setUp() {
 }
 
 void BufferedLogForwarder::check() {
-  // Get a list of all the buffered log items, with a max of 1024 lines.
-  std::vector<std::string> indexes;
-  auto status = scanDatabaseKeys(kLogs, indexes, index_name_, max_log_lines_);
+  // Get all the buffered log items and lines, with a max of 1024 lines.
+  DatabaseKeyValues lines;
+  auto status = scanDatabaseValues(kLogs, lines, index_name_, max_log_lines_);
 
   // For each index, accumulate the log line into the result or status set.
-  std::vector<std::string> results, statuses;
-  iterate(indexes, ([&results, &statuses, this](std::string& index) {
-            std::string value;
-            auto& target = isResultIndex(index) ? results : statuses;
-            if (getDatabaseValue(kLogs, index, value)) {
-              target.push_back(std::move(value));
-            }
-          }));
+  std::vector<std::string> indexes, results, statuses;
+  for (auto& line : lines) {
+    auto& target = isResultIndex(line.first) ? results : statuses;
+    target.push_back(std::move(line.second));
+    indexes.push_back(std::move(line.first));
+  }
 
   // If any results/statuses were found in the flushed buffer, send.
   if (results.size() > 0) {
@@ -143,6 +143,25 @@ static void SQL_virtual_table_internal_long(benchmark::State& state) {
 
 BENCHMARK(SQL_virtual_table_internal_long);
 
+static void SQL_virtual_table_internal_long_cached(benchmark::State& state) {
+  auto tables = RegistryFactory::get().registry("table");
+  tables->add("long_benchmark", std::make_shared<BenchmarkLongTablePlugin>());
+
+  PluginResponse res;
+  Registry::call("table", "long_benchmark", {{"action", "columns"}}, res);
+
+  // Attach a sample virtual table.
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("long_benchmark", columnDefinition(res), dbc);
+
+  while (state.KeepRunning()) {
+    QueryData results;
+    queryInternal("select * from long_benchmark", {}, results, dbc);
+  }
+}
+
+BENCHMARK(SQL_virtual_table_internal_long_cached);
+
 class BenchmarkWideTablePlugin : public TablePlugin {
  private:
   TableColumns columns() const override {
@@ -159,7 +178,10 @@ class BenchmarkWideTablePlugin : public TablePlugin {
     for (int k = 0; k < 50; k++) {
       Row r;
       for (int i = 0; i < 20; i++) {
-        r["test_" + std::to_string(i)] = "0";
+        auto column = "test_" + std::to_string(i);
+        if (ctx.isColumnUsed(column)) {
+          r[column] = "0";
+        }
       }
       results.push_back(r);
     }
@@ -186,6 +208,113 @@ static void SQL_virtual_table_internal_wide(benchmark::State& state) {
 
 BENCHMARK(SQL_virtual_table_internal_wide);
 
+static void SQL_virtual_table_internal_wide_projection(
+    benchmark::State& state) {
+  auto tables = RegistryFactory::get().registry("table");
+  tables->add("wide_benchmark", std::make_shared<BenchmarkWideTablePlugin>());
+
+  PluginResponse res;
+  Registry::call("table", "wide_benchmark", {{"action", "columns"}}, res);
+
+  // Attach a sample virtual table.
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("wide_benchmark", columnDefinition(res), dbc);
+
+  // Only the projected column is generated.
+  while (state.KeepRunning()) {
+    QueryData results;
+    queryInternal("select test_0 from wide_benchmark", results, dbc->db());
+  }
+}
+
+BENCHMARK(SQL_virtual_table_internal_wide_projection);
+
+static void SQL_virtual_table_processes(benchmark::State& state) {
+  PluginResponse res;
+  Registry::call("table", "processes", {{"action", "columns"}}, res);
+
+  // Attach the host's processes table.
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("processes", columnDefinition(res), dbc);
+
+  // The pid projection skips the status, cmdline, and link reads per process.
+  std::string query = (state.range_x() == 0) ? "select pid from processes"
+                                              : "select * from processes";
+  while (state.KeepRunning()) {
+    QueryData results;
+    queryInternal(query, results, dbc->db());
+  }
+}
+
+// Argument 0 selects only the pid, 1 selects every column.
+BENCHMARK(SQL_virtual_table_processes)->Arg(0)->Arg(1);
+
+/// A numeric-heavy table, like processes or process_memory_map.
+class BenchmarkNumericTablePlugin : public TablePlugin {
+ public:
+  explicit BenchmarkNumericTablePlugin(bool typed) : typed_(typed) {}
+
+ private:
+  TableColumns columns() const override {
+    TableColumns cols;
+    for (int i = 0; i < 20; i++) {
+      cols.push_back(std::make_tuple(
+          "test_" + std::to_string(i), BIGINT_TYPE, ColumnOptions::DEFAULT));
+    }
+    return cols;
+  }
+
+  bool usesGenerator() const override {
+    return true;
+  }
+
+  void generator(RowYield& yield, QueryContext& ctx) override {
+    for (long long k = 0; k < 1000; k++) {
+      TableRow r;
+      for (int i = 0; i < 20; i++) {
+        auto column = "test_" + std::to_string(i);
+        if (typed_) {
+          r.setInteger(column, k * i);
+        } else {
+          r[column] = BIGINT(k * i);
+        }
+      }
+      yield(r);
+    }
+  }
+
+  bool typed_{false};
+};
+
+static void SQL_virtual_table_numeric(benchmark::State& state) {
+  auto name = "numeric_benchmark_" + std::to_string(state.range_x());
+  auto tables = RegistryFactory::get().registry("table");
+  tables->add(name,
+              std::make_shared<BenchmarkNumericTablePlugin>(state.range_x()));
+
+  PluginResponse res;
+  Registry::call("table", name, {{"action", "columns"}}, res);
+
+  // Attach a sample virtual table.
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal(name, columnDefinition(res), dbc);
+
+  // Sum every cell so each is read as a number.
+  std::string query = "select sum(test_0 + test_1 + test_2 + test_3 + test_4 + "
+                      "test_5 + test_6 + test_7 + test_8 + test_9 + test_10 + "
+                      "test_11 + test_12 + test_13 + test_14 + test_15 + "
+                      "test_16 + test_17 + test_18 + test_19) from " +
+                      name;
+  while (state.KeepRunning()) {
+    QueryData results;
+    queryInternal(query, results, dbc->db());
+  }
+  state.SetItemsProcessed(state.iterations() * 1000 * 20);
+}
+
+// Argument 0 emits text cells, 1 emits native integers.
+BENCHMARK(SQL_virtual_table_numeric)->Arg(0)->Arg(1);
+
 static void SQL_select_metadata(benchmark::State& state) {
   auto dbc = SQLiteDBManager::get();
   while (state.KeepRunning()) {
@@ -197,6 +326,30 @@ static void SQL_select_metadata(benchmark::State& state) {
 
 BENCHMARK(SQL_select_metadata);
 
+static void SQL_select_metadata_cached(benchmark::State& state) {
+  auto dbc = SQLiteDBManager::get();
+  while (state.KeepRunning()) {
+    QueryData results;
+    queryInternal("select count(*) from sqlite_temp_master;", {}, results, dbc);
+  }
+}
+
+BENCHMARK(SQL_select_metadata_cached);
+
+static void SQL_select_bound_parameters(benchmark::State& state) {
+  auto dbc = SQLiteDBManager::get();
+  size_t i = 0;
+  while (state.KeepRunning()) {
+    QueryData results;
+    queryInternal("select name from sqlite_temp_master where name = ?",
+                  {std::to_string(i++)},
+                  results,
+                  dbc);
+  }
+}
+
+BENCHMARK(SQL_select_bound_parameters);
+
 static void SQL_select_basic(benchmark::State& state) {
   // Profile executing a query against an internal, already attached table.
   while (state.KeepRunning()) {
@@ -22,7 +22,9 @@ FLAG(int32, value_max, 512, "Maximum returned row value size");
 
 CREATE_LAZY_REGISTRY(SQLPlugin, "sql");
 
-SQL::SQL(const std::string& q) {
+SQL::SQL(const std::string& q) : SQL(q, {}) {}
+
+SQL::SQL(const std::string& q, const QueryParameters& params) {
   TableColumns table_columns;
   q_ = q;
   status_ = getQueryColumns(q_, table_columns);
@@ -30,7 +32,7 @@ SQL::SQL(const std::string& q) {
     for (auto c : table_columns) {
       columns_.push_back(std::get<0>(c));
     }
-    status_ = query(q_, results_);
+    status_ = query(q_, params, results_);
   }
 }
 
@@ -123,7 +125,16 @@ Status SQLPlugin::call(const PluginRequest& request, PluginResponse& response) {
   }
 
   if (request.at("action") == "query") {
-    return this->query(request.at("query"), response);
+    // Bound parameters are included as "param_0", "param_1", and so on.
+    QueryParameters params;
+    for (auto it = request.find("param_0"); it != request.end();
+         it = request.find("param_" + std::to_string(params.size()))) {
+      params.push_back(it->second);
+    }
+    if (params.empty()) {
+      return this->query(request.at("query"), response);
+    }
+    return this->queryWithParameters(request.at("query"), params, response);
   } else if (request.at("action") == "columns") {
     TableColumns columns;
     auto status = this->getQueryColumns(request.at("query"), columns);
@@ -137,7 +148,9 @@ Status SQLPlugin::call(const PluginRequest& request, PluginResponse& response) {
     return status;
   } else if (request.at("action") == "attach") {
     // Attach a virtual table name using an optional included definition.
-    return this->attach(request.at("table"));
+    auto definition =
+        (request.count("definition") > 0) ? request.at("definition") : "";
+    return this->attach(request.at("table"), definition);
   } else if (request.at("action") == "detach") {
     this->detach(request.at("table"));
     return Status(0, "OK");
@@ -150,6 +163,16 @@ Status query(const std::string& q, QueryData& results) {
       "sql", "sql", {{"action", "query"}, {"query", q}}, results);
 }
 
+Status query(const std::string& q,
+             const QueryParameters& params,
+             QueryData& results) {
+  PluginRequest request = {{"action", "query"}, {"query", q}};
+  for (size_t i = 0; i < params.size(); i++) {
+    request["param_" + std::to_string(i)] = params[i];
+  }
+  return Registry::call("sql", "sql", request, results);
+}
+
 Status getQueryColumns(const std::string& q, TableColumns& columns) {
   PluginResponse response;
   auto status = Registry::call(
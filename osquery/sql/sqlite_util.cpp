@@ -8,6 +8,10 @@
  *
  */
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+
 #include <osquery/core.h>
 #include <osquery/flags.h>
 #include <osquery/logger.h>
@@ -25,6 +29,15 @@ FLAG(string,
 
 FLAG(string, nullvalue, "", "Set string for NULL values, default ''");
 
+FLAG(uint64,
+     sql_pool_size,
+     4,
+     "Maximum warm SQLite connections kept for queries when the primary is "
+     "busy");
+
+/// The maximum number of prepared statements cached by a database instance.
+const size_t kMaxCachedStatements = 256;
+
 using OpReg = QueryPlanner::Opcode::Register;
 
 using SQLiteDBInstanceRef = std::shared_ptr<SQLiteDBInstance>;
@@ -112,12 +125,18 @@ class SQLiteSQLPlugin : public SQLPlugin {
   /// Execute SQL and store results.
   Status query(const std::string& q, QueryData& results) const override;
 
+  /// Execute SQL with bound parameters and store results.
+  Status queryWithParameters(const std::string& q,
+                             const QueryParameters& params,
+                             QueryData& results) const override;
+
   /// Introspect, explain, the suspected types selected in an SQL statement.
   Status getQueryColumns(const std::string& q,
                          TableColumns& columns) const override;
 
   /// Create a SQLite module and attach (CREATE).
-  Status attach(const std::string& name) override;
+  Status attach(const std::string& name,
+                const std::string& definition) override;
 
   /// Detach a virtual table (DROP).
   void detach(const std::string& name) override;
@@ -137,8 +156,14 @@ std::string getStringForSQLiteReturnCode(int code) {
 }
 
 Status SQLiteSQLPlugin::query(const std::string& q, QueryData& results) const {
+  return queryWithParameters(q, {}, results);
+}
+
+Status SQLiteSQLPlugin::queryWithParameters(const std::string& q,
+                                            const QueryParameters& params,
+                                            QueryData& results) const {
   auto dbc = SQLiteDBManager::get();
-  auto result = queryInternal(q, results, dbc->db());
+  auto result = queryInternal(q, params, results, dbc);
   dbc->clearAffectedTables();
   return result;
 }
@@ -146,12 +171,14 @@ Status SQLiteSQLPlugin::query(const std::string& q, QueryData& results) const {
 Status SQLiteSQLPlugin::getQueryColumns(const std::string& q,
                                         TableColumns& columns) const {
   auto dbc = SQLiteDBManager::get();
-  return getQueryColumnsInternal(q, columns, dbc->db());
+  return getQueryColumnsInternal(q, columns, dbc);
 }
 
-SQLInternal::SQLInternal(const std::string& q) {
+SQLInternal::SQLInternal(const std::string& q) : SQLInternal(q, {}) {}
+
+SQLInternal::SQLInternal(const std::string& q, const QueryParameters& params) {
   auto dbc = SQLiteDBManager::get();
-  status_ = queryInternal(q, results_, dbc->db());
+  status_ = queryInternal(q, params, results_, dbc, &cached_);
 
   // One of the advantages of using SQLInternal (aside from the Registry-bypass)
   // is the ability to "deep-inspect" the table attributes and actions.
@@ -160,20 +187,27 @@ SQLInternal::SQLInternal(const std::string& q) {
   dbc->clearAffectedTables();
 }
 
-Status SQLiteSQLPlugin::attach(const std::string& name) {
-  PluginResponse response;
-  auto status =
-      Registry::call("table", name, {{"action", "columns"}}, response);
-  if (!status.ok()) {
-    return status;
+Status SQLiteSQLPlugin::attach(const std::string& name,
+                               const std::string& definition) {
+  auto statement = definition;
+  if (statement.empty()) {
+    PluginResponse response;
+    auto status =
+        Registry::call("table", name, {{"action", "columns"}}, response);
+    if (!status.ok()) {
+      return status;
+    }
+    statement = columnDefinition(response);
   }
 
-  auto statement = columnDefinition(response);
   // Attach requests occurring via the plugin/registry APIs must act on the
   // primary database. To allow this, getConnection can explicitly request the
   // primary instance and avoid the contention decisions.
   auto dbc = SQLiteDBManager::getConnection(true);
-  return attachTableInternal(name, statement, dbc);
+  auto status = attachTableInternal(name, statement, dbc);
+  // Pooled connections were opened without the new table.
+  SQLiteDBManager::invalidatePool();
+  return status;
 }
 
 void SQLiteSQLPlugin::detach(const std::string& name) {
@@ -181,7 +215,10 @@ void SQLiteSQLPlugin::detach(const std::string& name) {
   if (!dbc->isPrimary()) {
     return;
   }
+  // Cached statements may reference the table, finalize them before the drop.
+  dbc->clearStatements();
   detachTableInternal(name, dbc->db());
+  SQLiteDBManager::invalidatePool();
 }
 
 SQLiteDBInstance::SQLiteDBInstance(sqlite3*& db, Mutex& mtx)
@@ -189,12 +226,29 @@ SQLiteDBInstance::SQLiteDBInstance(sqlite3*& db, Mutex& mtx)
   if (lock_.owns_lock()) {
     primary_ = true;
   } else {
+    // The manager provides a pooled connection instead.
     db_ = nullptr;
-    VLOG(1) << "DBManager contention: opening transient SQLite database";
-    init();
   }
 }
 
+/**
+ * @brief Prepare a statement, attaching each local table it references.
+ *
+ * A statement fails to prepare on the first table that is not attached yet.
+ * That table is attached and the same text is prepared again.
+ */
+static int prepareWithLazyTables(sqlite3* db,
+                                 const char* sql,
+                                 int bytes,
+                                 sqlite3_stmt** stmt,
+                                 const char** tail) {
+  int rc = SQLITE_OK;
+  do {
+    rc = sqlite3_prepare_v2(db, sql, bytes, stmt, tail);
+  } while (rc != SQLITE_OK && attachLazyTable(db));
+  return rc;
+}
+
 static inline void openOptimized(sqlite3*& db) {
   sqlite3_open(":memory:", &db);
 
@@ -244,7 +298,6 @@ void SQLiteDBInstance::clearAffectedTables() {
   }
 
   for (const auto& table : affected_tables_) {
-    table.second->constraints.clear();
     table.second->cache.clear();
   }
   // Since the affected tables are cleared, there are no more affected tables.
@@ -252,8 +305,111 @@ void SQLiteDBInstance::clearAffectedTables() {
   affected_tables_.clear();
 }
 
+Status SQLiteDBInstance::prepareStatement(const std::string& q,
+                                          sqlite3_stmt*& stmt,
+                                          bool& cached) {
+  if (isPrimary() && !managed_) {
+    // Statements are cached by the DB manager's primary 'connection'.
+    return SQLiteDBManager::getConnection(true)->prepareStatement(
+        q, stmt, cached);
+  }
+
+  stmt = nullptr;
+  cached = false;
+  {
+    WriteLock lock(statements_mutex_);
+    auto it = statements_.find(q);
+    if (it != statements_.end()) {
+      // Check out the statement, it is not shared while in use.
+      stmt = it->second.stmt;
+      statements_.erase(it);
+      statements_in_use_.insert(stmt);
+      cached = true;
+      return Status(0, "OK");
+    }
+  }
+
+  const char* tail = nullptr;
+  auto rc = prepareWithLazyTables(
+      db_, q.c_str(), static_cast<int>(q.size() + 1), &stmt, &tail);
+  if (rc != SQLITE_OK) {
+    if (stmt != nullptr) {
+      sqlite3_finalize(stmt);
+      stmt = nullptr;
+    }
+    return Status(1, sqlite3_errmsg(db_));
+  }
+
+  // Only cache queries made of a single statement.
+  if (tail != nullptr) {
+    for (; *tail != 0; tail++) {
+      if (!isspace(*tail)) {
+        sqlite3_finalize(stmt);
+        stmt = nullptr;
+        break;
+      }
+    }
+  }
+
+  if (stmt != nullptr) {
+    WriteLock lock(statements_mutex_);
+    statements_in_use_.insert(stmt);
+  }
+  return Status(0, "OK");
+}
+
+void SQLiteDBInstance::releaseStatement(const std::string& q,
+                                        sqlite3_stmt* stmt) {
+  if (isPrimary() && !managed_) {
+    SQLiteDBManager::getConnection(true)->releaseStatement(q, stmt);
+    return;
+  }
+
+  WriteLock lock(statements_mutex_);
+  if (statements_in_use_.erase(stmt) == 0 || statements_.count(q) > 0) {
+    // The cache was cleared while the statement was checked out.
+    sqlite3_finalize(stmt);
+    return;
+  }
+
+  if (statements_.size() >= kMaxCachedStatements) {
+    auto lru = statements_.begin();
+    for (auto it = statements_.begin(); it != statements_.end(); ++it) {
+      if (it->second.used < lru->second.used) {
+        lru = it;
+      }
+    }
+    sqlite3_finalize(lru->second.stmt);
+    statements_.erase(lru);
+  }
+
+  auto& entry = statements_[q];
+  entry.stmt = stmt;
+  entry.used = ++statement_ticks_;
+}
+
+void SQLiteDBInstance::clearStatements() {
+  if (isPrimary() && !managed_) {
+    SQLiteDBManager::getConnection(true)->clearStatements();
+    return;
+  }
+  finalizeStatements();
+}
+
+void SQLiteDBInstance::finalizeStatements() {
+  WriteLock lock(statements_mutex_);
+  for (const auto& statement : statements_) {
+    sqlite3_finalize(statement.second.stmt);
+  }
+  statements_.clear();
+  // Checked out statements are finalized when they are released.
+  statements_in_use_.clear();
+}
+
 SQLiteDBInstance::~SQLiteDBInstance() {
+  finalizeStatements();
   if (!isPrimary() && db_ != nullptr) {
+    detachLazyTables(db_);
     sqlite3_close(db_);
   } else {
     db_ = nullptr;
@@ -273,11 +429,19 @@ bool SQLiteDBManager::isDisabled(const std::string& table_name) {
 void SQLiteDBManager::resetPrimary() {
   auto& self = instance();
 
+  // Pooled connections are also reopened to release their memory.
+  invalidatePool();
+
   WriteLock connection_lock(self.mutex_);
+  if (self.connection_ != nullptr) {
+    // The connection may be referenced elsewhere, but the database is closed.
+    self.connection_->finalizeStatements();
+  }
   self.connection_.reset();
 
   {
     WriteLock create_lock(self.create_mutex_);
+    detachLazyTables(self.db_);
     sqlite3_close(self.db_);
     self.db_ = nullptr;
   }
@@ -313,13 +477,92 @@ SQLiteDBInstanceRef SQLiteDBManager::getConnection(bool primary) {
 
   // Create a 'database connection' for the managed database instance.
   auto instance = std::make_shared<SQLiteDBInstance>(self.db_, self.mutex_);
-  if (!instance->isPrimary()) {
-    attachVirtualTables(instance);
+  if (instance->isPrimary()) {
+    return instance;
   }
-  return instance;
+
+  // The primary is busy, do not block other callers while attaching tables.
+  lock.unlock();
+  return self.acquirePooled();
+}
+
+SQLiteDBInstanceRef SQLiteDBManager::acquirePooled() {
+  auto start = std::chrono::steady_clock::now();
+  SQLiteDBInstanceRef pooled;
+  size_t generation = 0;
+  {
+    WriteLock lock(pool_mutex_);
+    generation = pool_generation_;
+    if (!pool_.empty()) {
+      pooled = std::move(pool_.back());
+      pool_.pop_back();
+    }
+  }
+
+  bool reused = (pooled != nullptr);
+  if (!reused) {
+    VLOG(1) << "DBManager contention: opening transient SQLite database";
+    pooled = std::make_shared<SQLiteDBInstance>();
+    attachVirtualTables(pooled);
+  }
+
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+  {
+    WriteLock lock(pool_mutex_);
+    pool_stats_.acquired++;
+    pool_stats_.reused += (reused) ? 1 : 0;
+    pool_stats_.created += (reused) ? 0 : 1;
+    pool_stats_.wait_time += elapsed;
+    pool_stats_.max_wait_time =
+        std::max(pool_stats_.max_wait_time, static_cast<size_t>(elapsed));
+  }
+
+  // The caller's reference returns the connection to the pool when released.
+  return SQLiteDBInstanceRef(
+      pooled.get(), [pooled, generation](SQLiteDBInstance* /* instance */) {
+        instance().releasePooled(pooled, generation);
+      });
+}
+
+void SQLiteDBManager::releasePooled(const SQLiteDBInstanceRef& instance,
+                                    size_t generation) {
+  instance->clearAffectedTables();
+
+  WriteLock lock(pool_mutex_);
+  if (generation != pool_generation_) {
+    // A table was attached or detached while the connection was in use.
+    pool_stats_.invalidated++;
+  } else if (pool_.size() < FLAGS_sql_pool_size) {
+    pool_.push_back(instance);
+  }
+}
+
+void SQLiteDBManager::invalidatePool() {
+  auto& self = instance();
+  std::vector<SQLiteDBInstanceRef> pool;
+  {
+    WriteLock lock(self.pool_mutex_);
+    self.pool_generation_++;
+    self.pool_stats_.invalidated += self.pool_.size();
+    pool.swap(self.pool_);
+  }
+  // Connections are closed without holding the pool lock.
+}
+
+SQLiteDBPoolStats SQLiteDBManager::getPoolStats() {
+  auto& self = instance();
+  WriteLock lock(self.pool_mutex_);
+  auto stats = self.pool_stats_;
+  stats.idle = self.pool_.size();
+  return stats;
 }
 
 SQLiteDBManager::~SQLiteDBManager() {
+  if (connection_ != nullptr) {
+    connection_->finalizeStatements();
+  }
   connection_ = nullptr;
   if (db_ != nullptr) {
     sqlite3_close(db_);
@@ -328,14 +571,7 @@ SQLiteDBManager::~SQLiteDBManager() {
 }
 
 QueryPlanner::QueryPlanner(const std::string& query, sqlite3* db) {
-  QueryData plan;
-  queryInternal("EXPLAIN QUERY PLAN " + query, plan, db);
   queryInternal("EXPLAIN " + query, program_, db);
-
-  for (const auto& row : plan) {
-    auto details = osquery::split(row.at("detail"));
-    tables_.push_back(details[2]);
-  }
 }
 
 Status QueryPlanner::applyTypes(TableColumns& columns) {
@@ -396,32 +632,135 @@ int queryDataCallback(void* argument, int argc, char* argv[], char* column[]) {
   return 0;
 }
 
-Status queryInternal(const std::string& q, QueryData& results, sqlite3* db) {
-  char* err = nullptr;
-  sqlite3_exec(db, q.c_str(), queryDataCallback, &results, &err);
-  sqlite3_db_release_memory(db);
-  if (err != nullptr) {
-    auto error_string = std::string(err);
-    sqlite3_free(err);
-    return Status(1, "Error running query: " + error_string);
+/// Step a prepared statement, accumulating each result row.
+static Status stepStatement(sqlite3_stmt* stmt,
+                            QueryData& results,
+                            sqlite3* db) {
+  // Column names are constant for the life of the statement.
+  auto count = sqlite3_column_count(stmt);
+  std::vector<std::string> columns;
+  columns.reserve(count);
+  for (int i = 0; i < count; i++) {
+    auto name = sqlite3_column_name(stmt, i);
+    columns.push_back((name != nullptr) ? name : "");
+    if (std::count(columns.begin(), columns.end(), columns.back()) > 1) {
+      // Found a column name collision in the result.
+      VLOG(1) << "Detected overloaded column name " << columns.back()
+              << " in query result consider using aliases";
+    }
+  }
+
+  int rc = SQLITE_OK;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    Row r;
+    for (int i = 0; i < count; i++) {
+      switch (sqlite3_column_type(stmt, i)) {
+      case SQLITE_INTEGER:
+        r[columns[i]] = std::to_string(sqlite3_column_int64(stmt, i));
+        break;
+      case SQLITE_NULL:
+        r[columns[i]] = FLAGS_nullvalue;
+        break;
+      default: {
+        // Floats use SQLite's own formatting, text and blobs are copied.
+        auto value = sqlite3_column_text(stmt, i);
+        r[columns[i]] = std::string(reinterpret_cast<const char*>(value),
+                                    sqlite3_column_bytes(stmt, i));
+        break;
+      }
+      }
+    }
+    results.push_back(std::move(r));
+  }
+
+  if (rc != SQLITE_DONE) {
+    return Status(1, "Error running query: " + std::string(sqlite3_errmsg(db)));
   }
   return Status(0, "OK");
 }
 
-Status getQueryColumnsInternal(const std::string& q,
-                               TableColumns& columns,
-                               sqlite3* db) {
-  // Turn the query into a prepared statement
-  sqlite3_stmt* stmt{nullptr};
-  auto rc = sqlite3_prepare_v2(
-      db, q.c_str(), static_cast<int>(q.length() + 1), &stmt, nullptr);
-  if (rc != SQLITE_OK || stmt == nullptr) {
-    if (stmt != nullptr) {
-      sqlite3_finalize(stmt);
+Status queryInternal(const std::string& q, QueryData& results, sqlite3* db) {
+  Status status(0, "OK");
+  // A query may contain several statements, run each in order.
+  const char* tail = q.c_str();
+  while (tail != nullptr && *tail != 0) {
+    sqlite3_stmt* stmt = nullptr;
+    auto rc = prepareWithLazyTables(db, tail, -1, &stmt, &tail);
+    if (rc != SQLITE_OK) {
+      if (stmt != nullptr) {
+        sqlite3_finalize(stmt);
+      }
+      status =
+          Status(1, "Error running query: " + std::string(sqlite3_errmsg(db)));
+      break;
     }
-    return Status(1, sqlite3_errmsg(db));
+
+    if (stmt == nullptr) {
+      // The remaining text was whitespace or a comment.
+      continue;
+    }
+
+    status = stepStatement(stmt, results, db);
+    sqlite3_finalize(stmt);
+    if (!status.ok()) {
+      break;
+    }
+  }
+
+  sqlite3_db_release_memory(db);
+  return status;
+}
+
+Status queryInternal(const std::string& q,
+                     const QueryParameters& params,
+                     QueryData& results,
+                     const SQLiteDBInstanceRef& instance,
+                     bool* cached) {
+  sqlite3_stmt* stmt = nullptr;
+  bool hit = false;
+  auto status = instance->prepareStatement(q, stmt, hit);
+  if (cached != nullptr) {
+    *cached = hit;
+  }
+
+  if (!status.ok()) {
+    return Status(1, "Error running query: " + status.getMessage());
+  } else if (stmt == nullptr) {
+    // The query is not cacheable, it may include multiple statements.
+    if (!params.empty()) {
+      return Status(1, "Bound parameters require a single statement");
+    }
+    return queryInternal(q, results, instance->db());
+  }
+
+  auto db = instance->db();
+  if (static_cast<size_t>(sqlite3_bind_parameter_count(stmt)) !=
+      params.size()) {
+    status = Status(1, "Query expects a different number of parameters");
+  } else {
+    for (size_t i = 0; i < params.size(); i++) {
+      // The parameters outlive the statement step, bindings are cleared below.
+      sqlite3_bind_text(stmt,
+                        static_cast<int>(i + 1),
+                        params[i].c_str(),
+                        static_cast<int>(params[i].size()),
+                        SQLITE_STATIC);
+    }
+    status = stepStatement(stmt, results, db);
   }
 
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+  instance->releaseStatement(q, stmt);
+  sqlite3_db_release_memory(db);
+  return status;
+}
+
+/// Read the column names and types from a prepared statement.
+static Status readStatementColumns(const std::string& q,
+                                   sqlite3_stmt* stmt,
+                                   TableColumns& columns,
+                                   sqlite3* db) {
   // Get column count
   auto num_columns = sqlite3_column_count(stmt);
   TableColumns results;
@@ -457,8 +796,43 @@ Status getQueryColumnsInternal(const std::string& q,
   if (status.ok()) {
     columns = std::move(results);
   }
+  return status;
+}
+
+Status getQueryColumnsInternal(const std::string& q,
+                               TableColumns& columns,
+                               sqlite3* db) {
+  // Turn the query into a prepared statement
+  sqlite3_stmt* stmt{nullptr};
+  auto rc = prepareWithLazyTables(
+      db, q.c_str(), static_cast<int>(q.length() + 1), &stmt, nullptr);
+  if (rc != SQLITE_OK || stmt == nullptr) {
+    if (stmt != nullptr) {
+      sqlite3_finalize(stmt);
+    }
+    return Status(1, sqlite3_errmsg(db));
+  }
 
+  auto status = readStatementColumns(q, stmt, columns, db);
   sqlite3_finalize(stmt);
   return status;
 }
+
+Status getQueryColumnsInternal(const std::string& q,
+                               TableColumns& columns,
+                               const SQLiteDBInstanceRef& instance) {
+  // The statement is cached and reused when the query is executed.
+  sqlite3_stmt* stmt{nullptr};
+  bool cached = false;
+  auto status = instance->prepareStatement(q, stmt, cached);
+  if (!status.ok()) {
+    return status;
+  } else if (stmt == nullptr) {
+    return getQueryColumnsInternal(q, columns, instance->db());
+  }
+
+  status = readStatementColumns(q, stmt, columns, instance->db());
+  instance->releaseStatement(q, stmt);
+  return status;
+}
 }
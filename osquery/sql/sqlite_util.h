@@ -14,6 +14,7 @@
 #include <map>
 #include <mutex>
 #include <unordered_set>
+#include <vector>
 
 #include <sqlite3.h>
 
@@ -27,6 +28,30 @@ namespace osquery {
 
 class SQLiteDBManager;
 
+/// Usage of the pool of connections given out when the primary is busy.
+struct SQLiteDBPoolStats {
+  /// Number of warm connections waiting to be reused.
+  size_t idle{0};
+
+  /// Number of connections given out from the pool.
+  size_t acquired{0};
+
+  /// Number of acquired connections that were already warm.
+  size_t reused{0};
+
+  /// Number of connections opened, with every virtual table attached.
+  size_t created{0};
+
+  /// Number of warm connections closed after a table attach or detach.
+  size_t invalidated{0};
+
+  /// Total microseconds spent acquiring connections.
+  size_t wait_time{0};
+
+  /// The longest microseconds spent acquiring one connection.
+  size_t max_wait_time{0};
+};
+
 /**
  * @brief An RAII wrapper around an `sqlite3` object.
  *
@@ -68,10 +93,36 @@ class SQLiteDBInstance : private boost::noncopyable {
   /// Clear per-query state of a table affected by the use of this instance.
   void clearAffectedTables();
 
+  /**
+   * @brief Check out a prepared statement for a query from the cache.
+   *
+   * A cached statement is reused if the same query text was executed before
+   * on this instance, otherwise the query is prepared. A query containing
+   * more than one statement is not cached and the output statement is null.
+   * Every non-null statement must be returned using releaseStatement.
+   *
+   * @param q The query text, used as the cache key.
+   * @param stmt The output prepared statement.
+   * @param cached The output, true if the statement came from the cache.
+   * @return Failure if the query cannot be prepared.
+   */
+  Status prepareStatement(const std::string& q,
+                          sqlite3_stmt*& stmt,
+                          bool& cached);
+
+  /// Return a reset statement to the cache after use.
+  void releaseStatement(const std::string& q, sqlite3_stmt* stmt);
+
+  /// Finalize all cached statements, the schema or connection has changed.
+  void clearStatements();
+
  private:
   /// Handle the primary/forwarding requests for table attribute accesses.
   TableAttributes getAttributes() const;
 
+  /// Finalize the statements cached by this instance, without forwarding.
+  void finalizeStatements();
+
  private:
   /// An opaque constructor only used by the DBManager.
   explicit SQLiteDBInstance(sqlite3* db)
@@ -93,12 +144,32 @@ class SQLiteDBInstance : private boost::noncopyable {
   /// Vector of tables that need their constraints cleared after execution.
   std::map<std::string, VirtualTableContent*> affected_tables_;
 
+  /// A cached prepared statement and the last time it was checked out.
+  struct CachedStatement {
+    sqlite3_stmt* stmt{nullptr};
+    size_t used{0};
+  };
+
+  /// Prepared statements keyed by query text, not including checked out.
+  std::map<std::string, CachedStatement> statements_;
+
+  /// Checked out statements that may be returned to the cache.
+  std::unordered_set<sqlite3_stmt*> statements_in_use_;
+
+  /// A monotonic counter used to evict the least recently used statement.
+  size_t statement_ticks_{0};
+
+  /// Protect the statement cache from attach/detach requests.
+  Mutex statements_mutex_;
+
  private:
   friend class SQLiteDBManager;
   friend class SQLInternal;
 
  private:
   FRIEND_TEST(SQLiteUtilTests, test_affected_tables);
+  FRIEND_TEST(SQLiteUtilTests, test_statement_cache);
+  FRIEND_TEST(SQLiteUtilTests, test_statement_cache_clear);
 };
 
 using SQLiteDBInstanceRef = std::shared_ptr<SQLiteDBInstance>;
@@ -161,6 +232,18 @@ class SQLiteDBManager : private boost::noncopyable {
    */
   static bool isDisabled(const std::string& table_name);
 
+  /**
+   * @brief Close the warm connections in the pool.
+   *
+   * Pooled connections have every virtual table attached when they are
+   * opened. They must be closed when a table is attached or detached.
+   * Connections in use are closed when they are released.
+   */
+  static void invalidatePool();
+
+  /// Copy the pool usage counters.
+  static SQLiteDBPoolStats getPoolStats();
+
  protected:
   SQLiteDBManager();
   virtual ~SQLiteDBManager();
@@ -191,6 +274,25 @@ class SQLiteDBManager : private boost::noncopyable {
   /// Request a connection, optionally request the primary connection.
   static SQLiteDBInstanceRef getConnection(bool primary = false);
 
+  /// Check out a warm connection, or open one, when the primary is busy.
+  SQLiteDBInstanceRef acquirePooled();
+
+  /// Return a checked out connection to the pool, or close it.
+  void releasePooled(const SQLiteDBInstanceRef& instance, size_t generation);
+
+ private:
+  /// Warm connections, not in use, with all virtual tables attached.
+  std::vector<SQLiteDBInstanceRef> pool_;
+
+  /// Incremented when pooled connections are invalidated.
+  size_t pool_generation_{0};
+
+  /// Pool usage counters.
+  SQLiteDBPoolStats pool_stats_;
+
+  /// Protect the pool, a connection is opened without holding it.
+  Mutex pool_mutex_;
+
  private:
   friend class SQLiteDBInstance;
   friend class SQLiteSQLPlugin;
@@ -199,8 +301,8 @@ class SQLiteDBManager : private boost::noncopyable {
 /**
  * @brief A barebones query planner based on SQLite explain statement results.
  *
- * The query planner issues two EXPLAIN queries to the internal SQLite instance
- * to determine a table scan plan and execution program.
+ * The query planner issues an EXPLAIN query to the internal SQLite instance
+ * to determine the execution program.
  *
  * It is mildly expensive to run a query planner since most data is TEXT type
  * and requires string tokenization and lexical casting. Only run a planner
@@ -255,8 +357,6 @@ class QueryPlanner : private boost::noncopyable {
  private:
   /// The results of EXPLAIN q.
   QueryData program_;
-  /// The order of tables scanned.
-  std::vector<std::string> tables_;
 };
 
 /// Specific SQLite opcodes that change column/expression type.
@@ -277,6 +377,26 @@ extern const std::map<std::string, QueryPlanner::Opcode> kSQLOpcodes;
  */
 Status queryInternal(const std::string& q, QueryData& results, sqlite3* db);
 
+/**
+ * @brief SQLite Internal: Execute a query using an instance's statement cache.
+ *
+ * The query is prepared once per instance and reused on later executions.
+ * Each parameter is bound, as text, to the matching '?' in the query.
+ *
+ * @param q the query to execute
+ * @param params the values bound to the query's parameters
+ * @param results The QueryData struct to emit row on query success.
+ * @param instance the SQLite3 database instance owning the statement cache
+ * @param cached optional output, true if a cached statement was reused
+ *
+ * @return A status indicating SQL query results.
+ */
+Status queryInternal(const std::string& q,
+                     const QueryParameters& params,
+                     QueryData& results,
+                     const SQLiteDBInstanceRef& instance,
+                     bool* cached = nullptr);
+
 /**
  * @brief SQLite Intern: Analyze a query, providing information about the
  * result columns
@@ -296,6 +416,11 @@ Status getQueryColumnsInternal(const std::string& q,
                                TableColumns& columns,
                                sqlite3* db);
 
+/// See getQueryColumnsInternal, but prepare using the instance's cache.
+Status getQueryColumnsInternal(const std::string& q,
+                               TableColumns& columns,
+                               const SQLiteDBInstanceRef& instance);
+
 /**
  * @brief SQLInternal: SQL, but backed by internal calls.
  */
@@ -308,6 +433,14 @@ class SQLInternal : public SQL {
    */
   explicit SQLInternal(const std::string& q);
 
+  /**
+   * @brief Instantiate an instance of the class with bound parameters.
+   *
+   * @param q An osquery SQL query containing '?' parameters.
+   * @param params The values bound, in order, to the query's parameters.
+   */
+  SQLInternal(const std::string& q, const QueryParameters& params);
+
  public:
   /**
    * @brief Check if the SQL query's results use event-based tables.
@@ -324,9 +457,17 @@ class SQLInternal : public SQL {
     return event_based_;
   }
 
+  /// Check if the query reused a cached prepared statement.
+  bool cached() const {
+    return cached_;
+  }
+
  private:
   /// Before completing the execution, store a check for EVENT_BASED.
   bool event_based_{false};
+
+  /// Set if the prepared statement was found in the connection's cache.
+  bool cached_{false};
 };
 
 /**
@@ -0,0 +1,219 @@
+/*
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include <algorithm>
+
+#include <osquery/flags.h>
+#include <osquery/logger.h>
+
+#include "osquery/core/conversions.h"
+#include "osquery/sql/table_cache.h"
+
+namespace osquery {
+
+FLAG(string,
+     table_cache_ttls,
+     "",
+     "Comma-delimited table:seconds lifetimes of in-process table results");
+
+FLAG(uint64,
+     table_cache_max_size,
+     16 * 1024 * 1024,
+     "Approximate bytes of table results held in memory");
+
+DECLARE_bool(disable_caching);
+
+/// Append a string with its length, so keys cannot collide.
+static inline void appendKeyPart(std::string& key, const std::string& part) {
+  key += std::to_string(part.size());
+  key += ':';
+  key += part;
+}
+
+/// Estimate the memory held by a result set.
+static size_t getResultsSize(const QueryData& results) {
+  size_t size = sizeof(QueryData);
+  for (const auto& row : results) {
+    size += sizeof(Row);
+    for (const auto& column : row) {
+      size += 2 * sizeof(std::string) + column.first.size() +
+              column.second.size();
+    }
+  }
+  return size;
+}
+
+void TableCache::updateTTLs() {
+  if (FLAGS_table_cache_ttls == ttls_flag_) {
+    return;
+  }
+
+  ttls_flag_ = FLAGS_table_cache_ttls;
+  ttls_.clear();
+  for (const auto& item : split(ttls_flag_, ",")) {
+    auto pair = split(item, ":");
+    long long ttl = 0;
+    if (pair.size() != 2 || !safeStrtoll(pair[1], 10, ttl) || ttl < 0) {
+      LOG(WARNING) << "Invalid table cache lifetime: " << item;
+      continue;
+    }
+    ttls_[pair[0]] = static_cast<size_t>(ttl);
+  }
+}
+
+size_t TableCache::getTTL(const std::string& table) {
+  if (FLAGS_disable_caching) {
+    return 0;
+  }
+
+  WriteLock lock(mutex_);
+  updateTTLs();
+  auto ttl = ttls_.find(table);
+  return (ttl == ttls_.end()) ? 0 : ttl->second;
+}
+
+std::string TableCache::getKey(const QueryContext& context) {
+  std::string key;
+  // The constraint map is already ordered by column name.
+  for (const auto& column : context.constraints) {
+    if (!column.second.exists()) {
+      continue;
+    }
+
+    std::vector<std::pair<unsigned char, std::string>> constraints;
+    for (const auto& constraint : column.second.getAll()) {
+      constraints.push_back(std::make_pair(constraint.op, constraint.expr));
+    }
+    std::sort(constraints.begin(), constraints.end());
+
+    appendKeyPart(key, column.first);
+    key += std::to_string(constraints.size());
+    for (const auto& constraint : constraints) {
+      key += ',' + std::to_string(constraint.first);
+      appendKeyPart(key, constraint.second);
+    }
+    key += ';';
+  }
+
+  // Unknown used columns mean every column was generated.
+  key += '|';
+  if (context.colsUsed) {
+    std::vector<std::string> columns(context.colsUsed->begin(),
+                                     context.colsUsed->end());
+    std::sort(columns.begin(), columns.end());
+    for (const auto& column : columns) {
+      appendKeyPart(key, column);
+    }
+  } else {
+    key += '*';
+  }
+  return key;
+}
+
+bool TableCache::lookup(const std::string& table,
+                        const std::string& key,
+                        QueryData& results,
+                        size_t now) {
+  WriteLock lock(mutex_);
+  auto& stats = stats_[table];
+  auto id = table + '\0' + key;
+  auto entry = entries_.find(id);
+  if (entry == entries_.end()) {
+    stats.misses++;
+    return false;
+  }
+
+  if (now >= entry->second.expires) {
+    remove(id);
+    stats.misses++;
+    return false;
+  }
+
+  lru_.splice(lru_.begin(), lru_, entry->second.lru);
+  results = entry->second.results;
+  stats.hits++;
+  return true;
+}
+
+void TableCache::store(const std::string& table,
+                       const std::string& key,
+                       const QueryData& results,
+                       size_t now) {
+  auto ttl = getTTL(table);
+  auto size = getResultsSize(results) + table.size() + key.size();
+  if (ttl == 0 || size > FLAGS_table_cache_max_size) {
+    return;
+  }
+
+  WriteLock lock(mutex_);
+  auto id = table + '\0' + key;
+  if (entries_.count(id) > 0) {
+    remove(id);
+  }
+
+  // Evict the least recently used results until the new entry fits.
+  while (!lru_.empty() && size_ + size > FLAGS_table_cache_max_size) {
+    auto evicted = lru_.back();
+    stats_[entries_.at(evicted).table].evictions++;
+    remove(evicted);
+  }
+
+  lru_.push_front(id);
+  auto& entry = entries_[id];
+  entry.table = table;
+  entry.results = results;
+  entry.expires = now + ttl;
+  entry.size = size;
+  entry.lru = lru_.begin();
+
+  auto& stats = stats_[table];
+  stats.entries++;
+  stats.size += size;
+  size_ += size;
+}
+
+void TableCache::remove(const std::string& id) {
+  auto entry = entries_.find(id);
+  if (entry == entries_.end()) {
+    return;
+  }
+
+  auto& stats = stats_[entry->second.table];
+  stats.entries--;
+  stats.size -= entry->second.size;
+  size_ -= entry->second.size;
+  lru_.erase(entry->second.lru);
+  entries_.erase(entry);
+}
+
+std::map<std::string, TableCacheStats> TableCache::getStats() {
+  WriteLock lock(mutex_);
+  updateTTLs();
+  // Include configured tables that have not been scanned.
+  for (const auto& ttl : ttls_) {
+    stats_.insert(std::make_pair(ttl.first, TableCacheStats()));
+  }
+
+  auto stats = stats_;
+  for (auto& table : stats) {
+    auto ttl = ttls_.find(table.first);
+    table.second.ttl = (ttl == ttls_.end()) ? 0 : ttl->second;
+  }
+  return stats;
+}
+
+void TableCache::clear() {
+  WriteLock lock(mutex_);
+  entries_.clear();
+  lru_.clear();
+  stats_.clear();
+  size_ = 0;
+}
+}
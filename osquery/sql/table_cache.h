@@ -0,0 +1,142 @@
+/*
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core.h>
+#include <osquery/system.h>
+#include <osquery/tables.h>
+
+namespace osquery {
+
+/// Hit and miss counters and current usage of one table's cached results.
+struct TableCacheStats {
+  /// The configured result lifetime in seconds.
+  size_t ttl{0};
+
+  /// Number of scans answered from the cache.
+  size_t hits{0};
+
+  /// Number of scans that generated results.
+  size_t misses{0};
+
+  /// Number of entries removed to stay within the memory budget.
+  size_t evictions{0};
+
+  /// Number of cached constraint sets.
+  size_t entries{0};
+
+  /// Approximate bytes held by the cached results.
+  size_t size{0};
+};
+
+/**
+ * @brief An in-process cache of table results.
+ *
+ * Results are keyed by the table name, the set of constraints, and the
+ * columns SQLite reported as used. Several queries within a schedule tick
+ * that scan the same table, with the same constraints, generate it once.
+ *
+ * A table is cached only when --table_cache_ttls gives it a lifetime.
+ * The cache as a whole is bounded by --table_cache_max_size and the least
+ * recently used results are evicted first. --disable_caching disables it.
+ *
+ * This is independent of the schedule results cache used by TablePlugin's
+ * cacheable attribute, which stores whole-table results in the database.
+ */
+class TableCache : private boost::noncopyable {
+ public:
+  static TableCache& get() {
+    static TableCache instance;
+    return instance;
+  }
+
+  /// The lifetime in seconds for a table's results, 0 if it is not cached.
+  size_t getTTL(const std::string& table);
+
+  /**
+   * @brief Build a cache key from a query's context.
+   *
+   * Constraints are ordered by column, operator, and expression so the same
+   * predicate written in a different order shares an entry.
+   */
+  static std::string getKey(const QueryContext& context);
+
+  /**
+   * @brief Copy fresh results for a table and key.
+   *
+   * @return true and fill results if the entry exists and has not expired.
+   */
+  bool lookup(const std::string& table,
+              const std::string& key,
+              QueryData& results,
+              size_t now = getUnixTime());
+
+  /// Save results for a table and key, they expire after the table's TTL.
+  void store(const std::string& table,
+             const std::string& key,
+             const QueryData& results,
+             size_t now = getUnixTime());
+
+  /// Copy the counters for every table that has been cached.
+  std::map<std::string, TableCacheStats> getStats();
+
+  /// Remove every entry and reset the counters.
+  void clear();
+
+ private:
+  TableCache() = default;
+
+  /// Parse --table_cache_ttls if it changed since the last call.
+  void updateTTLs();
+
+  /// Remove an entry and account for its size.
+  void remove(const std::string& id);
+
+ private:
+  /// Cached results of one table scan.
+  struct Entry {
+    std::string table;
+    QueryData results;
+    size_t expires{0};
+    size_t size{0};
+    std::list<std::string>::iterator lru;
+  };
+
+  /// Entries keyed by the table name and the context key.
+  std::unordered_map<std::string, Entry> entries_;
+
+  /// Entry keys, most recently used first.
+  std::list<std::string> lru_;
+
+  /// Counters for each table.
+  std::map<std::string, TableCacheStats> stats_;
+
+  /// The parsed lifetimes and the flag value they were parsed from.
+  std::map<std::string, size_t> ttls_;
+  std::string ttls_flag_;
+
+  /// Total approximate size of all entries.
+  size_t size_{0};
+
+  /// Queries may run concurrently from extensions and distributed requests.
+  Mutex mutex_;
+
+ private:
+  FRIEND_TEST(TableCacheTests, test_eviction);
+};
+}
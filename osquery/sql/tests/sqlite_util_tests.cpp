@@ -64,6 +64,48 @@ TEST_F(SQLiteUtilTests, test_sqlite_instance) {
   EXPECT_EQ(internal_db, SQLiteDBManager::get()->db());
 }
 
+TEST_F(SQLiteUtilTests, test_connection_pool) {
+  SQLiteDBManager::invalidatePool();
+  auto before = SQLiteDBManager::getPoolStats();
+  EXPECT_EQ(before.idle, 0U);
+
+  auto primary = SQLiteDBManager::get();
+  ASSERT_TRUE(primary->isPrimary());
+  sqlite3* pooled_db = nullptr;
+  {
+    // A busy primary hands out a connection with every table attached.
+    auto dbc = SQLiteDBManager::get();
+    EXPECT_FALSE(dbc->isPrimary());
+    pooled_db = dbc->db();
+    QueryData results;
+    EXPECT_TRUE(queryInternal("SELECT * FROM time", results, dbc->db()));
+    EXPECT_EQ(results.size(), 1U);
+  }
+  EXPECT_EQ(SQLiteDBManager::getPoolStats().idle, 1U);
+
+  {
+    // The released connection is reused.
+    auto dbc = SQLiteDBManager::get();
+    EXPECT_EQ(dbc->db(), pooled_db);
+    EXPECT_EQ(SQLiteDBManager::getPoolStats().idle, 0U);
+  }
+
+  auto after = SQLiteDBManager::getPoolStats();
+  EXPECT_EQ(after.acquired - before.acquired, 2U);
+  EXPECT_EQ(after.reused - before.reused, 1U);
+  EXPECT_EQ(after.created - before.created, 1U);
+  EXPECT_GE(after.wait_time, after.max_wait_time);
+
+  // Connections in the pool, or in use, are closed after an invalidation.
+  {
+    auto dbc = SQLiteDBManager::get();
+    SQLiteDBManager::invalidatePool();
+  }
+  EXPECT_EQ(SQLiteDBManager::getPoolStats().idle, 0U);
+  EXPECT_EQ(SQLiteDBManager::getPoolStats().invalidated - after.invalidated,
+            1U);
+}
+
 TEST_F(SQLiteUtilTests, test_reset) {
   auto internal_db = SQLiteDBManager::get()->db();
   ASSERT_NE(nullptr, internal_db);
@@ -139,6 +181,96 @@ TEST_F(SQLiteUtilTests, test_affected_tables) {
   EXPECT_EQ(dbc->affected_tables_.size(), 0U);
 }
 
+TEST_F(SQLiteUtilTests, test_statement_cache) {
+  auto dbc = getTestDBC();
+  QueryData results;
+  bool cached = true;
+  auto status = queryInternal(kTestQuery, {}, results, dbc, &cached);
+  ASSERT_TRUE(status.ok());
+  EXPECT_FALSE(cached);
+  EXPECT_EQ(results, getTestDBExpectedResults());
+  EXPECT_EQ(dbc->statements_.size(), 1U);
+
+  // The second execution reuses the prepared statement.
+  results.clear();
+  status = queryInternal(kTestQuery, {}, results, dbc, &cached);
+  ASSERT_TRUE(status.ok());
+  EXPECT_TRUE(cached);
+  EXPECT_EQ(results, getTestDBExpectedResults());
+  EXPECT_EQ(dbc->statements_.size(), 1U);
+  EXPECT_TRUE(dbc->statements_in_use_.empty());
+
+  // Queries with multiple statements are not cached.
+  results.clear();
+  status = queryInternal("select 1 as a; select 2 as a", {}, results, dbc);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(results, QueryData({{{"a", "1"}}, {{"a", "2"}}}));
+  EXPECT_EQ(dbc->statements_.size(), 1U);
+
+  // Errors are reported from the prepare step.
+  status = queryInternal("select * from not_a_table", {}, results, dbc);
+  EXPECT_FALSE(status.ok());
+  EXPECT_EQ(dbc->statements_.size(), 1U);
+}
+
+TEST_F(SQLiteUtilTests, test_statement_cache_constraints) {
+  auto dbc = getTestDBC();
+  std::string query = "select path from file where path = ?";
+  for (const auto& path : {"/", ".", "/"}) {
+    // Each execution of the cached plan must apply its constraints.
+    QueryData results;
+    auto status = queryInternal(query, {path}, results, dbc);
+    ASSERT_TRUE(status.ok());
+    ASSERT_EQ(results.size(), 1U);
+    EXPECT_EQ(results[0].at("path"), path);
+    dbc->clearAffectedTables();
+  }
+}
+
+TEST_F(SQLiteUtilTests, test_statement_cache_clear) {
+  auto dbc = getTestDBC();
+  sqlite3_stmt* stmt = nullptr;
+  bool cached = true;
+  auto status = dbc->prepareStatement(kTestQuery, stmt, cached);
+  ASSERT_TRUE(status.ok());
+  ASSERT_NE(stmt, nullptr);
+  EXPECT_FALSE(cached);
+
+  // A statement checked out while the cache is cleared is not cached.
+  dbc->clearStatements();
+  dbc->releaseStatement(kTestQuery, stmt);
+  EXPECT_TRUE(dbc->statements_.empty());
+
+  status = dbc->prepareStatement(kTestQuery, stmt, cached);
+  ASSERT_TRUE(status.ok());
+  EXPECT_FALSE(cached);
+  dbc->releaseStatement(kTestQuery, stmt);
+  EXPECT_EQ(dbc->statements_.size(), 1U);
+
+  dbc->clearStatements();
+  EXPECT_TRUE(dbc->statements_.empty());
+}
+
+TEST_F(SQLiteUtilTests, test_bound_parameters) {
+  SQLInternal sql("select ? as a, ? as b", {"1", "two"});
+  ASSERT_TRUE(sql.ok());
+  EXPECT_EQ(sql.rows(), QueryData({{{"a", "1"}, {"b", "two"}}}));
+
+  // Values are bound, never interpolated.
+  SQLInternal quoted("select ? as a", {"'; drop table time; --"});
+  ASSERT_TRUE(quoted.ok());
+  EXPECT_EQ(quoted.rows()[0].at("a"), "'; drop table time; --");
+
+  // The number of parameters must match the query.
+  SQLInternal missing("select ? as a, ? as b", {"1"});
+  EXPECT_FALSE(missing.ok());
+
+  // The public API forwards parameters through the SQL plugin.
+  auto public_sql = SQL("select ? as a", {"value"});
+  ASSERT_TRUE(public_sql.ok());
+  EXPECT_EQ(public_sql.rows(), QueryData({{{"a", "value"}}}));
+}
+
 TEST_F(SQLiteUtilTests, test_table_attributes_event_based) {
   {
     SQLInternal sql_internal("select * from process_events");
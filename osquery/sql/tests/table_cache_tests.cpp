@@ -0,0 +1,170 @@
+/*
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <osquery/core.h>
+#include <osquery/flags.h>
+#include <osquery/registry.h>
+#include <osquery/sql.h>
+
+#include "osquery/sql/table_cache.h"
+#include "osquery/sql/virtual_table.h"
+
+namespace osquery {
+
+DECLARE_string(table_cache_ttls);
+DECLARE_uint64(table_cache_max_size);
+
+class TableCacheTests : public testing::Test {
+ protected:
+  void SetUp() override {
+    ttls_ = FLAGS_table_cache_ttls;
+    max_size_ = FLAGS_table_cache_max_size;
+    TableCache::get().clear();
+  }
+
+  void TearDown() override {
+    FLAGS_table_cache_ttls = ttls_;
+    FLAGS_table_cache_max_size = max_size_;
+    TableCache::get().clear();
+  }
+
+ private:
+  std::string ttls_;
+  size_t max_size_{0};
+};
+
+TEST_F(TableCacheTests, test_key) {
+  QueryContext first;
+  first.constraints["a"].add(Constraint(EQUALS, "1"));
+  first.constraints["a"].add(Constraint(EQUALS, "2"));
+  first.constraints["b"];
+
+  // The same predicates in a different order share a key.
+  QueryContext second;
+  second.constraints["a"].add(Constraint(EQUALS, "2"));
+  second.constraints["a"].add(Constraint(EQUALS, "1"));
+  EXPECT_EQ(TableCache::getKey(first), TableCache::getKey(second));
+
+  second.constraints["a"].add(Constraint(LIKE, "1"));
+  EXPECT_NE(TableCache::getKey(first), TableCache::getKey(second));
+
+  // Results generated for fewer columns are not reused for all columns.
+  QueryContext used;
+  used.constraints["a"].add(Constraint(EQUALS, "1"));
+  used.constraints["a"].add(Constraint(EQUALS, "2"));
+  used.colsUsed = UsedColumns({"a"});
+  EXPECT_NE(TableCache::getKey(first), TableCache::getKey(used));
+}
+
+TEST_F(TableCacheTests, test_lookup) {
+  auto& cache = TableCache::get();
+  FLAGS_table_cache_ttls = "cached:10,invalid";
+  EXPECT_EQ(cache.getTTL("cached"), 10U);
+  EXPECT_EQ(cache.getTTL("other"), 0U);
+
+  QueryData results = {{{"a", "1"}}};
+  QueryData cached;
+  EXPECT_FALSE(cache.lookup("cached", "key", cached, 100));
+  cache.store("cached", "key", results, 100);
+  EXPECT_TRUE(cache.lookup("cached", "key", cached, 109));
+  EXPECT_EQ(cached, results);
+  EXPECT_FALSE(cache.lookup("cached", "other", cached, 109));
+
+  // Tables without a lifetime are not stored.
+  cache.store("other", "key", results, 100);
+  EXPECT_FALSE(cache.lookup("other", "key", cached, 100));
+
+  // Expired results are removed.
+  EXPECT_FALSE(cache.lookup("cached", "key", cached, 110));
+
+  auto stats = cache.getStats();
+  EXPECT_EQ(stats["cached"].ttl, 10U);
+  EXPECT_EQ(stats["cached"].hits, 1U);
+  EXPECT_EQ(stats["cached"].misses, 3U);
+  EXPECT_EQ(stats["cached"].entries, 0U);
+  EXPECT_EQ(stats["cached"].size, 0U);
+  EXPECT_EQ(stats["other"].ttl, 0U);
+}
+
+TEST_F(TableCacheTests, test_eviction) {
+  auto& cache = TableCache::get();
+  FLAGS_table_cache_ttls = "cached:10";
+
+  QueryData results = {{{"a", std::string(100, 'a')}}};
+  cache.store("cached", "first", results, 0);
+  FLAGS_table_cache_max_size = cache.size_ + cache.size_ / 2;
+
+  // The least recently used results are evicted to fit new results.
+  QueryData cached;
+  cache.store("cached", "second", results, 0);
+  EXPECT_FALSE(cache.lookup("cached", "first", cached, 0));
+  EXPECT_TRUE(cache.lookup("cached", "second", cached, 0));
+
+  auto stats = cache.getStats();
+  EXPECT_EQ(stats["cached"].evictions, 1U);
+  EXPECT_EQ(stats["cached"].entries, 1U);
+  EXPECT_EQ(stats["cached"].size, cache.size_);
+
+  // Results larger than the budget are not stored.
+  results[0]["a"] = std::string(FLAGS_table_cache_max_size, 'a');
+  cache.store("cached", "large", results, 0);
+  EXPECT_FALSE(cache.lookup("cached", "large", cached, 0));
+  EXPECT_TRUE(cache.lookup("cached", "second", cached, 0));
+}
+
+class countingTablePlugin : public TablePlugin {
+ public:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("value", INTEGER_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+  QueryData generate(QueryContext& context) override {
+    generated++;
+    return {{{"value", "1"}}, {{"value", "2"}}};
+  }
+
+  size_t generated{0};
+};
+
+TEST_F(TableCacheTests, test_virtual_table) {
+  auto tables = RegistryFactory::get().registry("table");
+  auto counting = std::make_shared<countingTablePlugin>();
+  tables->add("counting", counting);
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("counting", columnDefinition(counting->columns()), dbc);
+
+  // Without a lifetime every scan generates.
+  QueryData results;
+  queryInternal("SELECT * FROM counting", results, dbc->db());
+  queryInternal("SELECT * FROM counting", results, dbc->db());
+  EXPECT_EQ(counting->generated, 2U);
+
+  FLAGS_table_cache_ttls = "counting:60";
+  results.clear();
+  queryInternal("SELECT * FROM counting", results, dbc->db());
+  queryInternal("SELECT * FROM counting", results, dbc->db());
+  EXPECT_EQ(counting->generated, 3U);
+  ASSERT_EQ(results.size(), 4U);
+  EXPECT_EQ(results[3]["value"], "2");
+
+  // A different constraint set generates again.
+  queryInternal("SELECT * FROM counting WHERE value = 1", results, dbc->db());
+  EXPECT_EQ(counting->generated, 4U);
+
+  auto stats = TableCache::get().getStats();
+  EXPECT_EQ(stats["counting"].hits, 1U);
+  EXPECT_EQ(stats["counting"].misses, 2U);
+  EXPECT_EQ(stats["counting"].entries, 2U);
+}
+}
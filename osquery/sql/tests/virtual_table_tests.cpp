@@ -11,6 +11,7 @@
 #include <gtest/gtest.h>
 
 #include <osquery/core.h>
+#include <osquery/flags.h>
 #include <osquery/logger.h>
 #include <osquery/registry.h>
 #include <osquery/sql.h>
@@ -19,6 +20,8 @@
 
 namespace osquery {
 
+DECLARE_bool(lazy_table_attach);
+
 class VirtualTableTests : public testing::Test {};
 
 // sample plugin used on tests
@@ -372,6 +375,45 @@ TEST_F(VirtualTableTests, test_null_values) {
   }
 }
 
+class missingTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("name", TEXT_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("size", BIGINT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+ public:
+  QueryData generate(QueryContext&) override {
+    return {
+        {{"name", "a"}, {"size", "1"}},
+        {{"name", ""}},
+    };
+  }
+
+ private:
+  FRIEND_TEST(VirtualTableTests, test_missing_values);
+};
+
+TEST_F(VirtualTableTests, test_missing_values) {
+  auto tables = RegistryFactory::get().registry("table");
+  auto missing = std::make_shared<missingTablePlugin>();
+  tables->add("missing", missing);
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("missing", missing->columnDefinition(), dbc);
+
+  // Columns missing from a row are NULL, an empty value is not.
+  QueryData results;
+  auto status = queryInternal(
+      "SELECT name FROM missing WHERE size IS NULL AND name IS NOT NULL",
+      results,
+      dbc->db());
+  EXPECT_TRUE(status.ok());
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(results[0]["name"], "");
+}
+
 class cacheTablePlugin : public TablePlugin {
  private:
   TableColumns columns() const override {
@@ -556,4 +598,307 @@ TEST_F(VirtualTableTests, test_indexing_costs) {
   EXPECT_EQ(10U, i->scans);
   EXPECT_EQ(10U, j->scans);
 }
+
+class colsUsedTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("a", TEXT_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("b", TEXT_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("c", TEXT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+ public:
+  QueryData generate(QueryContext& context) override {
+    used = context.colsUsed;
+    Row r;
+    for (const auto& column : {"a", "b", "c"}) {
+      if (context.isColumnUsed(column)) {
+        r[column] = column;
+      }
+    }
+    return {r};
+  }
+
+  boost::optional<UsedColumns> used;
+
+ private:
+  FRIEND_TEST(VirtualTableTests, test_used_columns);
+};
+
+TEST_F(VirtualTableTests, test_used_columns) {
+  auto tables = RegistryFactory::get().registry("table");
+  auto cols = std::make_shared<colsUsedTablePlugin>();
+  tables->add("cols_used", cols);
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("cols_used", cols->columnDefinition(), dbc);
+
+  // Only the projected column is requested from the generator.
+  QueryData results;
+  queryInternal("SELECT a FROM cols_used;", results, dbc->db());
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(results[0]["a"], "a");
+  ASSERT_TRUE(cols->used.is_initialized());
+  EXPECT_EQ(*cols->used, UsedColumns({"a"}));
+
+  // Columns used within predicates are also requested.
+  results.clear();
+  queryInternal(
+      "SELECT a FROM cols_used WHERE c = 'c';", results, dbc->db());
+  ASSERT_EQ(results.size(), 1U);
+  ASSERT_TRUE(cols->used.is_initialized());
+  EXPECT_EQ(*cols->used, UsedColumns({"a", "c"}));
+
+  // Counting rows does not need any column values.
+  results.clear();
+  queryInternal("SELECT count(*) AS n FROM cols_used;", results, dbc->db());
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(results[0]["n"], "1");
+  ASSERT_TRUE(cols->used.is_initialized());
+  EXPECT_TRUE(cols->used->empty());
+
+  // A star projection requests every column.
+  results.clear();
+  queryInternal("SELECT * FROM cols_used;", results, dbc->db());
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(results[0]["b"], "b");
+  ASSERT_TRUE(cols->used.is_initialized());
+  EXPECT_EQ(*cols->used, UsedColumns({"a", "b", "c"}));
+}
+
+class generatorTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("i", INTEGER_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+ public:
+  bool usesGenerator() const override {
+    return true;
+  }
+
+  void generator(RowYield& yield, QueryContext& context) override {
+    // Count the scans that were unwound before generating every row.
+    struct Scan {
+      explicit Scan(generatorTablePlugin* p) : plugin(p) {}
+      ~Scan() {
+        if (!complete) {
+          plugin->cancelled++;
+        }
+      }
+      generatorTablePlugin* plugin;
+      bool complete{false};
+    } scan(this);
+
+    for (size_t i = 0; i < 100; i++) {
+      generated++;
+      Row r = {{"i", INTEGER(i)}};
+      yield(r);
+    }
+    scan.complete = true;
+  }
+
+  size_t generated{0};
+  size_t cancelled{0};
+
+ private:
+  FRIEND_TEST(VirtualTableTests, test_table_generator);
+};
+
+TEST_F(VirtualTableTests, test_table_generator) {
+  auto tables = RegistryFactory::get().registry("table");
+  auto gen = std::make_shared<generatorTablePlugin>();
+  tables->add("generator", gen);
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("generator", gen->columnDefinition(), dbc);
+
+  QueryData results;
+  auto status = queryInternal("SELECT i FROM generator;", results, dbc->db());
+  EXPECT_TRUE(status.ok());
+  ASSERT_EQ(results.size(), 100U);
+  EXPECT_EQ(results[99]["i"], "99");
+  EXPECT_EQ(gen->generated, 100U);
+  EXPECT_EQ(gen->cancelled, 0U);
+
+  // A LIMIT stops the scan and closing the cursor cancels the generator.
+  gen->generated = 0;
+  results.clear();
+  status =
+      queryInternal("SELECT i FROM generator LIMIT 2;", results, dbc->db());
+  EXPECT_TRUE(status.ok());
+  ASSERT_EQ(results.size(), 2U);
+  EXPECT_EQ(results[1]["i"], "1");
+  EXPECT_LE(gen->generated, 3U);
+  EXPECT_EQ(gen->cancelled, 1U);
+
+  // Generator tables remain available to callers of generate.
+  PluginResponse response;
+  status =
+      Registry::call("table", "generator", {{"action", "generate"}}, response);
+  EXPECT_TRUE(status.ok());
+  EXPECT_EQ(response.size(), 100U);
+}
+
+class typedTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("i", BIGINT_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("d", DOUBLE_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("t", TEXT_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("b", BLOB_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("s", INTEGER_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+ public:
+  bool usesGenerator() const override {
+    return true;
+  }
+
+  void generator(RowYield& yield, QueryContext& context) override {
+    TableRow r;
+    r.setInteger("i", 1LL << 40);
+    r.setDouble("d", 0.5);
+    // Numbers in text columns are formatted.
+    r.setInteger("t", 7);
+    r["b"] = std::string("a\0b", 3);
+    // Text in numeric columns is parsed, once.
+    r["s"] = "0x10";
+    yield(r);
+
+    // A Row of text cells is accepted, values that do not parse are NULL.
+    Row text = {{"i", "2"}, {"d", "1.5"}, {"s", "invalid"}};
+    yield(text);
+  }
+
+ private:
+  FRIEND_TEST(VirtualTableTests, test_typed_cells);
+};
+
+TEST_F(VirtualTableTests, test_typed_cells) {
+  auto tables = RegistryFactory::get().registry("table");
+  auto typed = std::make_shared<typedTablePlugin>();
+  tables->add("typed", typed);
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("typed", typed->columnDefinition(), dbc);
+
+  QueryData results;
+  auto status = queryInternal(
+      "SELECT i, typeof(i) AS ti, d, typeof(d) AS td, t, typeof(t) AS tt, "
+      "length(b) AS lb, typeof(b) AS tb, s, typeof(s) AS ts FROM typed;",
+      results,
+      dbc->db());
+  EXPECT_TRUE(status.ok());
+  ASSERT_EQ(results.size(), 2U);
+  EXPECT_EQ(results[0]["i"], "1099511627776");
+  EXPECT_EQ(results[0]["ti"], "integer");
+  EXPECT_EQ(results[0]["d"], "0.5");
+  EXPECT_EQ(results[0]["td"], "real");
+  EXPECT_EQ(results[0]["t"], "7");
+  EXPECT_EQ(results[0]["tt"], "text");
+  EXPECT_EQ(results[0]["lb"], "3");
+  EXPECT_EQ(results[0]["tb"], "blob");
+  EXPECT_EQ(results[0]["s"], "16");
+  EXPECT_EQ(results[0]["ts"], "integer");
+
+  EXPECT_EQ(results[1]["i"], "2");
+  EXPECT_EQ(results[1]["ti"], "integer");
+  EXPECT_EQ(results[1]["td"], "real");
+  EXPECT_EQ(results[1]["ts"], "null");
+
+  // The same cells are available to callers of generate, as text.
+  PluginResponse response;
+  status =
+      Registry::call("table", "typed", {{"action", "generate"}}, response);
+  EXPECT_TRUE(status.ok());
+  ASSERT_EQ(response.size(), 2U);
+  EXPECT_EQ(response[0]["i"], "1099511627776");
+  EXPECT_EQ(response[0]["d"], "0.5");
+  EXPECT_EQ(response[0]["t"], "7");
+}
+
+/// The schema of the lazy table, as if it was generated from a spec.
+static const TableSchema kLazySchema = {
+    {std::make_tuple("value", TEXT_TYPE, ColumnOptions::DEFAULT)},
+    {"lazy_alias"},
+    {},
+    TableAttributes::NONE,
+};
+
+class lazyTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    columns_calls++;
+    return kLazySchema.columns;
+  }
+
+  std::vector<std::string> aliases() const override {
+    return kLazySchema.aliases;
+  }
+
+  QueryData generate(QueryContext& context) override {
+    return {{{"value", "lazy"}}};
+  }
+
+ public:
+  /// Number of times the table was asked for its columns.
+  static size_t columns_calls;
+};
+
+size_t lazyTablePlugin::columns_calls{0};
+
+TEST_F(VirtualTableTests, test_lazy_attach) {
+  auto lazy_table_attach = FLAGS_lazy_table_attach;
+  auto tables = RegistryFactory::get().registry("table");
+  tables->add("lazy", std::make_shared<lazyTablePlugin>());
+  registerTableSchema("lazy", kLazySchema);
+
+  // Local tables are not created until a statement references them.
+  FLAGS_lazy_table_attach = true;
+  lazyTablePlugin::columns_calls = 0;
+  auto dbc = SQLiteDBManager::getUnique();
+  QueryData results;
+  queryInternal("SELECT name FROM sqlite_temp_master WHERE name LIKE 'lazy%'",
+                results,
+                dbc->db());
+  EXPECT_TRUE(results.empty());
+
+  auto status = queryInternal("SELECT value FROM lazy", results, dbc->db());
+  EXPECT_TRUE(status.ok());
+  status = queryInternal("SELECT value FROM lazy_alias", results, dbc->db());
+  EXPECT_TRUE(status.ok());
+  QueryData expected = {{{"value", "lazy"}}, {{"value", "lazy"}}};
+  EXPECT_EQ(results, expected);
+
+  // The table was connected using its generated schema.
+  EXPECT_EQ(lazyTablePlugin::columns_calls, 0U);
+
+  // Cached statements are prepared after the table is attached.
+  results.clear();
+  status = queryInternal("SELECT value FROM lazy", {}, results, dbc);
+  EXPECT_TRUE(status.ok());
+  EXPECT_EQ(results.size(), 1U);
+
+  // Unknown tables still fail to prepare.
+  status = queryInternal("SELECT * FROM lazy_missing", results, dbc->db());
+  EXPECT_FALSE(status.ok());
+
+  // Eager attaching creates the table and the alias view.
+  FLAGS_lazy_table_attach = false;
+  dbc = SQLiteDBManager::getUnique();
+  results.clear();
+  queryInternal(
+      "SELECT name FROM sqlite_temp_master WHERE name = 'lazy'; "
+      "SELECT name FROM sqlite_master WHERE name = 'lazy_alias'",
+      results,
+      dbc->db());
+  EXPECT_EQ(results.size(), 2U);
+
+  FLAGS_lazy_table_attach = lazy_table_attach;
+  tables->remove("lazy");
+}
 }
@@ -8,13 +8,16 @@
  *
  */
 
+#include <algorithm>
 #include <atomic>
+#include <cstring>
 
 #include <osquery/core.h>
 #include <osquery/flags.h>
 #include <osquery/logger.h>
 #include <osquery/system.h>
 
+#include "osquery/sql/table_cache.h"
 #include "osquery/sql/virtual_table.h"
 
 namespace osquery {
@@ -23,10 +26,73 @@ FLAG(bool, enable_foreign, false, "Enable no-op foreign virtual tables");
 
 SHELL_FLAG(bool, planner, false, "Enable osquery runtime planner output");
 
+FLAG(bool,
+     lazy_table_attach,
+     true,
+     "Attach virtual tables when a query first references them");
+
 DECLARE_bool(disable_events);
 
 RecursiveMutex kAttachMutex;
 
+/// The modules registered on a connection with lazily attached tables.
+struct LazyConnection {
+  /// The connection instance, the client data of each module.
+  SQLiteDBInstance* instance{nullptr};
+
+  /// Table names and aliases registered as modules.
+  std::set<std::string> modules;
+};
+
+/// Connections with lazily attached tables, protected by kAttachMutex.
+static std::map<sqlite3*, LazyConnection> kLazyConnections;
+
+/// The SQLite error of a statement referencing a missing table.
+const std::string kNoSuchTable{"no such table: "};
+
+/**
+ * @brief Look up the schema of a lazily attached table.
+ *
+ * @param module The module name, a table name or an alias.
+ * @param name The output table name.
+ * @param response The output columns response.
+ * @return true if the table schema was generated from its spec.
+ */
+static bool getLazySchema(const std::string& module,
+                          std::string& name,
+                          PluginResponse& response) {
+  auto schema = getTableSchema(module, name);
+  if (schema == nullptr) {
+    return false;
+  }
+  response = getTableRouteInfo(*schema);
+  return true;
+}
+
+/// The innermost usage collector of each thread.
+static thread_local TableUsageCollector* kTableUsageCollector{nullptr};
+
+TableUsageCollector::TableUsageCollector() : previous_(kTableUsageCollector) {
+  kTableUsageCollector = this;
+}
+
+TableUsageCollector::~TableUsageCollector() {
+  kTableUsageCollector = previous_;
+}
+
+void TableUsageCollector::record(const std::string& table,
+                                 size_t rows,
+                                 size_t bytes) {
+  if (kTableUsageCollector == nullptr) {
+    return;
+  }
+
+  auto& usage = kTableUsageCollector->usage_[table];
+  usage.scans++;
+  usage.rows += rows;
+  usage.bytes += bytes;
+}
+
 namespace tables {
 namespace sqlite {
 
@@ -93,15 +159,109 @@ int xOpen(sqlite3_vtab* tab, sqlite3_vtab_cursor** ppCursor) {
   return rc;
 }
 
+/// Record a cursor's last scan with the thread's usage collector.
+static void recordCursorUsage(BaseCursor* pCur) {
+  if (pCur->scanned) {
+    const auto* pVtab = (VirtualTable*)pCur->base.pVtab;
+    TableUsageCollector::record(
+        pVtab->content->name, pCur->generated_rows, pCur->generated_bytes);
+  }
+  pCur->scanned = false;
+  pCur->generated_rows = 0;
+  pCur->generated_bytes = 0;
+}
+
 int xClose(sqlite3_vtab_cursor* cur) {
   BaseCursor* pCur = (BaseCursor*)cur;
   plan("Closing cursor (" + std::to_string(pCur->id) + ")");
+  recordCursorUsage(pCur);
   delete pCur;
   return SQLITE_OK;
 }
 
+/**
+ * @brief Append a generated row to a cursor's data.
+ *
+ * Text cells of numeric columns are parsed here, once, instead of on every
+ * xColumn read. A cell that cannot be parsed stays text and is read as NULL.
+ *
+ * @return The approximate bytes of the row's cells.
+ */
+static size_t addCursorRow(CompactQueryData& data,
+                           const TableColumns& columns,
+                           TableRow& generated) {
+  auto row = data.addRow();
+  size_t bytes = 0;
+  for (auto& cell : generated.text()) {
+    auto col = data.addColumn(cell.first);
+    auto type = (col < columns.size()) ? std::get<1>(columns[col]) : TEXT_TYPE;
+    auto& value = cell.second;
+    bytes += value.size();
+    if (type == INTEGER_TYPE || type == BIGINT_TYPE ||
+        type == UNSIGNED_BIGINT_TYPE) {
+      long long number;
+      if (safeStrtoll(value, 0, number)) {
+        data.setInteger(row, col, number);
+        continue;
+      }
+    } else if (type == DOUBLE_TYPE) {
+      char* end = nullptr;
+      double number = strtod(value.c_str(), &end);
+      if (end != nullptr && end != value.c_str() && *end == '\0') {
+        data.setDouble(row, col, number);
+        continue;
+      }
+    }
+    data.setText(row, col, std::move(value));
+  }
+
+  for (const auto& number : generated.numbers()) {
+    auto col = data.addColumn(number.column);
+    if (number.type == INTEGER_TYPE) {
+      data.setInteger(row, col, number.integer);
+    } else {
+      data.setDouble(row, col, number.real);
+    }
+    bytes += sizeof(long long);
+  }
+  return bytes;
+}
+
+/**
+ * @brief Resume a cursor's generator and keep the row it yields.
+ *
+ * Exceptions thrown by the table's generator are logged and reported to
+ * SQLite as an error, ending the scan.
+ */
+static int pullRow(BaseCursor* pCur, bool resume) {
+  const auto* pVtab = (VirtualTable*)pCur->base.pVtab;
+  auto& generator = *pCur->generator;
+  try {
+    if (resume) {
+      generator();
+    }
+    pCur->data.clear();
+    if (generator) {
+      // Only the current row is kept, at position 0.
+      pCur->generated_bytes +=
+          addCursorRow(pCur->data, pVtab->content->columns, generator.get());
+      pCur->generated_rows++;
+    }
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "Error generating rows: " << e.what();
+    pCur->generator.reset();
+    return SQLITE_ERROR;
+  }
+  return SQLITE_OK;
+}
+
 int xEof(sqlite3_vtab_cursor* cur) {
   BaseCursor* pCur = (BaseCursor*)cur;
+  if (pCur->generator != nullptr) {
+    // A generator scan is finished when the generator completes.
+    return !(*pCur->generator);
+  }
+
   if (pCur->row >= pCur->n) {
     // If the requested row exceeds the size of the row set then all rows
     // have been visited, clear the data container.
@@ -120,6 +280,9 @@ int xDestroy(sqlite3_vtab* p) {
 int xNext(sqlite3_vtab_cursor* cur) {
   BaseCursor* pCur = (BaseCursor*)cur;
   pCur->row++;
+  if (pCur->generator != nullptr) {
+    return pullRow(pCur, true);
+  }
   return SQLITE_OK;
 }
 
@@ -145,13 +308,23 @@ int xCreate(sqlite3* db,
   pVtab->content = new VirtualTableContent;
   pVtab->instance = (SQLiteDBInstance*)pAux;
 
-  // Create a TablePlugin Registry call, expect column details as the response.
+  // A lazily attached table is connected as an eponymous table in the main
+  // schema, the first time a statement references it. Its module may be
+  // named after a table alias.
+  bool lazy = (argc > 1 && argv[1] != nullptr && strcmp(argv[1], "main") == 0);
+
+  // Generated tables are connected using the schema compiled from their spec.
+  // Otherwise create a TablePlugin Registry call, expect column details.
   PluginResponse response;
-  pVtab->content->name = std::string(argv[0]);
+  Status status;
+  if (!lazy || !getLazySchema(argv[0], pVtab->content->name, response)) {
+    pVtab->content->name = std::string(argv[0]);
+    // Get the table column information.
+    status = Registry::call(
+        "table", pVtab->content->name, {{"action", "columns"}}, response);
+  }
+
   const auto& name = pVtab->content->name;
-  // Get the table column information.
-  auto status =
-      Registry::call("table", name, {{"action", "columns"}}, response);
   if (!status.ok() || response.size() == 0) {
     delete pVtab->content;
     delete pVtab;
@@ -190,8 +363,9 @@ int xCreate(sqlite3* db,
           column.at("name"),
           columnTypeName(column.at("type")),
           (ColumnOptions)AS_LITERAL(INTEGER_LITERAL, column.at("op"))));
-    } else if (column.at("id") == "alias" && column.count("alias")) {
-      // Create associated views for table aliases.
+    } else if (column.at("id") == "alias" && column.count("alias") && !lazy) {
+      // Create associated views for table aliases, lazily attached tables
+      // attach their aliases as modules.
       views.insert(column.at("alias"));
     } else if (column.at("id") == "columnAlias" && column.count("name") &&
                column.count("target")) {
@@ -233,58 +407,69 @@ int xColumn(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int col) {
     // Requested column index greater than column set size.
     return SQLITE_ERROR;
   }
-  if (pCur->row >= pCur->data.size()) {
+  auto row = (pCur->generator != nullptr) ? 0 : pCur->row;
+  if (row >= pCur->data.rows()) {
     // Request row index greater than row set size.
     return SQLITE_ERROR;
   }
 
-  auto& column_name = std::get<0>(pVtab->content->columns[col]);
-  auto& type = std::get<1>(pVtab->content->columns[col]);
-  if (pVtab->content->aliases.count(column_name)) {
-    // Overwrite the aliased column with the type and name of the new column.
-    type = std::get<1>(
-        pVtab->content->columns[pVtab->content->aliases.at(column_name)]);
-    column_name = std::get<0>(
-        pVtab->content->columns[pVtab->content->aliases.at(column_name)]);
+  // The cursor's data columns are in table schema order, an aliased column
+  // reads the value and type of its target column.
+  size_t index = col;
+  const auto& columns = pVtab->content->columns;
+  auto alias = pVtab->content->aliases.find(std::get<0>(columns[index]));
+  if (alias != pVtab->content->aliases.end()) {
+    index = alias->second;
   }
+  const auto& column_name = std::get<0>(columns[index]);
+  const auto& type = std::get<1>(columns[index]);
 
-  // Attempt to cast each xFilter-populated row/column to the SQLite type.
-  const auto& value = pCur->data[pCur->row][column_name];
-  if (pCur->data[pCur->row].count(column_name) == 0) {
+  // Numeric cells were parsed when the row was added, or generated natively.
+  const auto& data = pCur->data;
+  auto cell = data.type(row, index);
+  if (cell == CellType::NONE) {
     // Missing content.
     VLOG(1) << "Error " << column_name << " is empty";
     sqlite3_result_null(ctx);
-  } else if (type == TEXT_TYPE) {
-    sqlite3_result_text(
-        ctx, value.c_str(), static_cast<int>(value.size()), SQLITE_STATIC);
+  } else if (type == TEXT_TYPE || type == BLOB_TYPE) {
+    const auto& value = data.get(row, index);
+    if (type == TEXT_TYPE) {
+      sqlite3_result_text(
+          ctx, value.c_str(), static_cast<int>(value.size()), SQLITE_STATIC);
+    } else {
+      sqlite3_result_blob(
+          ctx, value.data(), static_cast<int>(value.size()), SQLITE_STATIC);
+    }
   } else if (type == INTEGER_TYPE) {
-    long afinite;
-    if (!safeStrtol(value, 0, afinite) || afinite < INT_MIN ||
-        afinite > INT_MAX) {
-      VLOG(1) << "Error casting " << column_name << " (" << value
-              << ") to INTEGER";
+    long long afinite = 0;
+    if (cell == CellType::INTEGER) {
+      afinite = data.getInteger(row, index);
+    }
+    if (cell != CellType::INTEGER || afinite < INT_MIN || afinite > INT_MAX) {
+      VLOG(1) << "Error casting " << column_name << " ("
+              << data.get(row, index) << ") to INTEGER";
       sqlite3_result_null(ctx);
     } else {
-      sqlite3_result_int(ctx, (int)afinite);
+      sqlite3_result_int(ctx, static_cast<int>(afinite));
     }
   } else if (type == BIGINT_TYPE || type == UNSIGNED_BIGINT_TYPE) {
-    long long afinite;
-    if (!safeStrtoll(value, 0, afinite)) {
-      VLOG(1) << "Error casting " << column_name << " (" << value
-              << ") to BIGINT";
+    if (cell != CellType::INTEGER) {
+      VLOG(1) << "Error casting " << column_name << " ("
+              << data.get(row, index) << ") to BIGINT";
       sqlite3_result_null(ctx);
     } else {
-      sqlite3_result_int64(ctx, afinite);
+      sqlite3_result_int64(ctx, data.getInteger(row, index));
     }
   } else if (type == DOUBLE_TYPE) {
-    char* end = nullptr;
-    double afinite = strtod(value.c_str(), &end);
-    if (end == nullptr || end == value.c_str() || *end != '\0') {
-      VLOG(1) << "Error casting " << column_name << " (" << value
-              << ") to DOUBLE";
-      sqlite3_result_null(ctx);
-    } else {
+    if (cell == CellType::DOUBLE) {
+      sqlite3_result_double(ctx, data.getDouble(row, index));
+    } else if (cell == CellType::INTEGER) {
+      auto afinite = static_cast<double>(data.getInteger(row, index));
       sqlite3_result_double(ctx, afinite);
+    } else {
+      VLOG(1) << "Error casting " << column_name << " ("
+              << data.get(row, index) << ") to DOUBLE";
+      sqlite3_result_null(ctx);
     }
   } else {
     LOG(ERROR) << "Error unknown column type " << column_name;
@@ -293,6 +478,73 @@ int xColumn(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int col) {
   return SQLITE_OK;
 }
 
+/**
+ * @brief Encode a constraint set and used columns as an xBestIndex idxStr.
+ *
+ * The SQLite colUsed mask is written first as "mask|", then each constraint
+ * as "column_index,op;" such that the plan can be read back within xFilter,
+ * after the statement is reused.
+ */
+static std::string encodeIndexPlan(const TableColumns& columns,
+                                   const ConstraintSet& constraints,
+                                   sqlite3_uint64 used) {
+  std::string encoded = std::to_string(used) + "|";
+  for (const auto& constraint : constraints) {
+    for (size_t i = 0; i < columns.size(); i++) {
+      if (std::get<0>(columns[i]) == constraint.first) {
+        encoded += std::to_string(i) + "," +
+                   std::to_string(constraint.second.op) + ";";
+        break;
+      }
+    }
+  }
+  return encoded;
+}
+
+/// Decode an xBestIndex idxStr written by encodeIndexPlan.
+static void decodeIndexPlan(const char* encoded,
+                            const VirtualTableContent& content,
+                            ConstraintSet& constraints,
+                            UsedColumns& used_columns) {
+  const auto& columns = content.columns;
+  char* end = nullptr;
+  auto used = (encoded != nullptr) ? strtoull(encoded, &end, 10) : 0;
+  if (end == nullptr || *end != '|') {
+    // The mask is missing, every column may be used.
+    used = ~0ULL;
+  } else {
+    encoded = end + 1;
+  }
+
+  for (size_t i = 0; i < columns.size(); i++) {
+    // Bit 63 is set if any column after the 63rd is used.
+    if ((used & (1ULL << std::min(i, static_cast<size_t>(63)))) == 0) {
+      continue;
+    }
+    const auto& name = std::get<0>(columns[i]);
+    used_columns.insert(name);
+    if (content.aliases.count(name) > 0) {
+      // Values for an aliased column are read from its target.
+      used_columns.insert(std::get<0>(columns[content.aliases.at(name)]));
+    }
+  }
+
+  while (encoded != nullptr && *encoded != 0) {
+    auto column = strtoul(encoded, &end, 10);
+    if (end == nullptr || *end != ',') {
+      break;
+    }
+    auto op = strtoul(end + 1, &end, 10);
+    if (end == nullptr || *end != ';' || column >= columns.size()) {
+      break;
+    }
+    constraints.push_back(
+        std::make_pair(std::get<0>(columns[column]),
+                       Constraint(static_cast<unsigned char>(op))));
+    encoded = end + 1;
+  }
+}
+
 static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
   auto* pVtab = (VirtualTable*)tab;
   const auto& columns = pVtab->content->columns;
@@ -383,8 +635,15 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
        std::to_string(constraints.size()) + " idx=" +
        std::to_string(pIdxInfo->idxNum) + "]");
 #endif
-  // Add the constraint set to the table's tracked constraints.
-  pVtab->content->constraints[pIdxInfo->idxNum] = std::move(constraints);
+  // The constraint set is kept by SQLite alongside the statement's plan.
+  // A prepared statement may be reused without another xBestIndex call.
+  auto encoded = encodeIndexPlan(columns, constraints, pIdxInfo->colUsed);
+  pIdxInfo->idxStr = static_cast<char*>(sqlite3_malloc(encoded.size() + 1));
+  if (pIdxInfo->idxStr == nullptr) {
+    return SQLITE_NOMEM;
+  }
+  memcpy(pIdxInfo->idxStr, encoded.c_str(), encoded.size() + 1);
+  pIdxInfo->needToFreeIdxStr = 1;
   pIdxInfo->estimatedCost = cost;
   return SQLITE_OK;
 }
@@ -401,7 +660,7 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
 
   pCur->row = 0;
   pCur->n = 0;
-  QueryContext context(content);
+  auto context = std::make_unique<QueryContext>(content);
 
   // Track required columns, this is different than the requirements check
   // that occurs within BestIndex because this scan includes a cursor.
@@ -425,7 +684,7 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
     // Set the column affinity for each optional constraint list.
     // There is a separate list for each column name.
     auto column_name = std::get<0>(content->columns[i]);
-    context.constraints[column_name].affinity =
+    context->constraints[column_name].affinity =
         std::get<1>(content->columns[i]);
     // Save the column options for comparison within constraints enumeration.
     options[column_name] = std::get<2>(content->columns[i]);
@@ -437,16 +696,20 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
 // Filtering between cursors happens iteratively, not consecutively.
 // If there are multiple sets of constraints, they apply to each cursor.
 #if defined(DEBUG)
-  plan("Filtering called for table: " + content->name + " [constraint_count=" +
-       std::to_string(content->constraints.size()) + " argc=" +
+  plan("Filtering called for table: " + content->name + " [idx_str=" +
+       std::string((idxStr != nullptr) ? idxStr : "") + " argc=" +
        std::to_string(argc) + " idx=" + std::to_string(idxNum) + "]");
 #endif
 
   // Iterate over every argument to xFilter, filling in constraint values.
-  if (content->constraints.size() > 0) {
-    auto& constraints = content->constraints[idxNum];
+  ConstraintSet constraints;
+  UsedColumns used_columns;
+  decodeIndexPlan(idxStr, *content, constraints, used_columns);
+  context->colsUsed = std::move(used_columns);
+  if (constraints.size() > 0) {
     if (argc > 0) {
-      for (size_t i = 0; i < static_cast<size_t>(argc); ++i) {
+      auto count = std::min(static_cast<size_t>(argc), constraints.size());
+      for (size_t i = 0; i < count; ++i) {
         auto expr = (const char*)sqlite3_value_text(argv[i]);
         if (expr == nullptr || expr[0] == 0) {
           // SQLite did not expose the expression value.
@@ -459,7 +722,7 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
              "): " + constraint.first + " " + opString(constraint.second.op) +
              " " + constraint.second.expr);
         // Add the constraint to the column-sorted query request map.
-        context.constraints[constraint.first].add(constraint.second);
+        context->constraints[constraint.first].add(constraint.second);
       }
     } else if (constraints.size() > 0) {
       // Constraints failed.
@@ -500,21 +763,107 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
                  << table_doc(pVtab->content->name);
   }
 
-  // Reset the virtual table contents.
+  // Reset the virtual table contents, a cursor may be filtered many times.
+  recordCursorUsage(pCur);
+  pCur->scanned = true;
+  pCur->generator.reset();
+  pCur->context.reset();
   pCur->data.clear();
+  if (pCur->data.columns().empty()) {
+    // Index the cursor's columns by their position in the table schema.
+    std::vector<std::string> names;
+    for (const auto& column : content->columns) {
+      names.push_back(std::get<0>(column));
+    }
+    pCur->data = CompactQueryData(names);
+  }
   options.clear();
 
   // Generate the row data set.
   plan("Scanning rows for cursor (" + std::to_string(pCur->id) + ")");
-  Registry::callTable(pVtab->content->name, context, pCur->data);
+  auto plugin = std::dynamic_pointer_cast<TablePlugin>(
+      Registry::get().plugin("table", pVtab->content->name));
+  if (plugin != nullptr && plugin->usesGenerator()) {
+    // Rows are pulled from the generator as SQLite steps the cursor. Closing
+    // the cursor early, for a LIMIT, unwinds and cancels the generator.
+    pCur->context = std::move(context);
+    auto* request = pCur->context.get();
+    try {
+      pCur->generator = std::make_unique<RowGenerator::pull_type>(
+          [plugin, request](RowGenerator::push_type& push) {
+            RowYield yield(push);
+            plugin->generator(yield, *request);
+          });
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "Error generating rows: " << e.what();
+      return SQLITE_ERROR;
+    }
+    return pullRow(pCur, false);
+  }
+
+  QueryData results;
+  auto& cache = TableCache::get();
+  bool cacheable = (content->attributes & TableAttributes::EVENT_BASED) == 0 &&
+                   cache.getTTL(content->name) > 0;
+  std::string cache_key;
+  if (cacheable) {
+    cache_key = TableCache::getKey(*context);
+  }
+
+  if (!cacheable || !cache.lookup(content->name, cache_key, results)) {
+    auto status = Registry::callTable(content->name, *context, results);
+    if (cacheable && status.ok()) {
+      cache.store(content->name, cache_key, results);
+    }
+  } else {
+    plan("Using cached rows for cursor (" + std::to_string(pCur->id) + ")");
+  }
+  // The generated rows are converted after the table returns, only tables
+  // using a generator avoid holding every row as a Row.
+  pCur->data.reserve(results.size());
+  for (auto& r : results) {
+    TableRow generated(std::move(r));
+    pCur->generated_bytes +=
+        addCursorRow(pCur->data, content->columns, generated);
+  }
+  pCur->generated_rows = pCur->data.rows();
 
   // Set the number of rows.
-  pCur->n = pCur->data.size();
+  pCur->n = pCur->data.rows();
   return SQLITE_OK;
 }
 }
 }
 
+// A static module structure does not need specific logic per-table.
+// clang-format off
+static sqlite3_module kModule = {
+    0,
+    tables::sqlite::xCreate,
+    tables::sqlite::xCreate,
+    tables::sqlite::xBestIndex,
+    tables::sqlite::xDestroy,
+    tables::sqlite::xDestroy,
+    tables::sqlite::xOpen,
+    tables::sqlite::xClose,
+    tables::sqlite::xFilter,
+    tables::sqlite::xNext,
+    tables::sqlite::xEof,
+    tables::sqlite::xColumn,
+    tables::sqlite::xRowid,
+    nullptr, /* Update */
+    nullptr, /* Begin */
+    nullptr, /* Sync */
+    nullptr, /* Commit */
+    nullptr, /* Rollback */
+    nullptr, /* FindFunction */
+    nullptr, /* Rename */
+    nullptr, /* Savepoint */
+    nullptr, /* Release */
+    nullptr, /* RollbackTo */
+};
+// clang-format on
+
 Status attachTableInternal(const std::string& name,
                            const std::string& statement,
                            const SQLiteDBInstanceRef& instance) {
@@ -523,46 +872,26 @@ Status attachTableInternal(const std::string& name,
     return Status(0, getStringForSQLiteReturnCode(0));
   }
 
-  // A static module structure does not need specific logic per-table.
-  // clang-format off
-  static sqlite3_module module = {
-      0,
-      tables::sqlite::xCreate,
-      tables::sqlite::xCreate,
-      tables::sqlite::xBestIndex,
-      tables::sqlite::xDestroy,
-      tables::sqlite::xDestroy,
-      tables::sqlite::xOpen,
-      tables::sqlite::xClose,
-      tables::sqlite::xFilter,
-      tables::sqlite::xNext,
-      tables::sqlite::xEof,
-      tables::sqlite::xColumn,
-      tables::sqlite::xRowid,
-      nullptr, /* Update */
-      nullptr, /* Begin */
-      nullptr, /* Sync */
-      nullptr, /* Commit */
-      nullptr, /* Rollback */
-      nullptr, /* FindFunction */
-      nullptr, /* Rename */
-      nullptr, /* Savepoint */
-      nullptr, /* Release */
-      nullptr, /* RollbackTo */
-  };
-  // clang-format on
 
   // Note, if the clientData API is used then this will save a registry call
   // within xCreate.
-  RecursiveLock lock(kAttachMutex);
-  int rc = sqlite3_create_module(
-      instance->db(), name.c_str(), &module, (void*)&(*instance));
-  if (rc == SQLITE_OK || rc == SQLITE_MISUSE) {
-    auto format =
-        "CREATE VIRTUAL TABLE temp." + name + " USING " + name + statement;
-    rc = sqlite3_exec(instance->db(), format.c_str(), nullptr, nullptr, 0);
-  } else {
-    LOG(ERROR) << "Error attaching table: " << name << " (" << rc << ")";
+  int rc = SQLITE_OK;
+  {
+    RecursiveLock lock(kAttachMutex);
+    rc = sqlite3_create_module(
+        instance->db(), name.c_str(), &kModule, (void*)&(*instance));
+    if (rc == SQLITE_OK || rc == SQLITE_MISUSE) {
+      auto format =
+          "CREATE VIRTUAL TABLE temp." + name + " USING " + name + statement;
+      rc = sqlite3_exec(instance->db(), format.c_str(), nullptr, nullptr, 0);
+    } else {
+      LOG(ERROR) << "Error attaching table: " << name << " (" << rc << ")";
+    }
+  }
+
+  if (rc == SQLITE_OK) {
+    // The schema changed, statements prepared before the attach are stale.
+    instance->clearStatements();
   }
   return Status(rc, getStringForSQLiteReturnCode(rc));
 }
@@ -607,6 +936,22 @@ void attachVirtualTables(const SQLiteDBInstanceRef& instance) {
   }
 
   PluginResponse response;
+  if (FLAGS_lazy_table_attach) {
+    // Local tables are attached when a statement first references them.
+    attachLazyTables(instance);
+    // Tables from extensions are created eagerly so they may be detached.
+    auto tables = RegistryFactory::get().registry("table");
+    for (const auto& table : tables->getExternal()) {
+      auto status = Registry::call(
+          "table", table.first, {{"action", "columns"}}, response);
+      if (status.ok()) {
+        auto statement = columnDefinition(response, true);
+        attachTableInternal(table.first, statement, instance);
+      }
+    }
+    return;
+  }
+
   for (const auto& name : RegistryFactory::get().names("table")) {
     // Column information is nice for virtual table create call.
     auto status =
@@ -617,4 +962,53 @@ void attachVirtualTables(const SQLiteDBInstanceRef& instance) {
     }
   }
 }
+
+void attachLazyTables(const SQLiteDBInstanceRef& instance) {
+  // No module is registered until a statement references its table.
+  RecursiveLock lock(kAttachMutex);
+  kLazyConnections[instance->db()] = {instance.get(), {}};
+}
+
+bool attachLazyTable(sqlite3* db) {
+  std::string error = sqlite3_errmsg(db);
+  if (error.compare(0, kNoSuchTable.size(), kNoSuchTable) != 0) {
+    return false;
+  }
+
+  // Eponymous tables are only connected in the main schema.
+  auto module = error.substr(kNoSuchTable.size());
+  if (module.compare(0, 5, "main.") == 0) {
+    module = module.substr(5);
+  }
+
+  RecursiveLock lock(kAttachMutex);
+  auto connection = kLazyConnections.find(db);
+  if (connection == kLazyConnections.end() ||
+      connection->second.modules.count(module) > 0) {
+    return false;
+  }
+
+  // Resolve table aliases using the generated schemas, other local tables
+  // are resolved with a columns call when SQLite connects them.
+  std::string name = module;
+  getTableSchema(module, name);
+  if (SQLiteDBManager::isDisabled(name) ||
+      !RegistryFactory::get().exists("table", name, true)) {
+    return false;
+  }
+
+  auto rc = sqlite3_create_module(
+      db, module.c_str(), &kModule, (void*)connection->second.instance);
+  if (rc != SQLITE_OK) {
+    LOG(ERROR) << "Error attaching table: " << module << " (" << rc << ")";
+    return false;
+  }
+  connection->second.modules.insert(module);
+  return true;
+}
+
+void detachLazyTables(sqlite3* db) {
+  RecursiveLock lock(kAttachMutex);
+  kLazyConnections.erase(db);
+}
 }
@@ -10,6 +10,9 @@
 
 #pragma once
 
+#include <map>
+#include <memory>
+
 #include <boost/noncopyable.hpp>
 
 #include <osquery/tables.h>
@@ -41,14 +44,27 @@ struct BaseCursor : private boost::noncopyable {
   /// Track cursors for optional planner output.
   size_t id{0};
 
-  /// Table data generated from last access.
-  QueryData data;
+  /// Table data generated from last access, columns follow the table schema.
+  CompactQueryData data;
 
   /// Current cursor position.
   size_t row{0};
 
   /// Total number of rows.
   size_t n{0};
+
+  /// Query context for a generator scan, it must outlive the generator.
+  std::unique_ptr<QueryContext> context;
+
+  /// Lazy row source, set when the table uses a generator.
+  std::unique_ptr<RowGenerator::pull_type> generator;
+
+  /// Set when the cursor was filtered and its usage is not yet recorded.
+  bool scanned{false};
+
+  /// Rows and approximate bytes generated since the last filter.
+  size_t generated_rows{0};
+  size_t generated_bytes{0};
 };
 
 /**
@@ -68,6 +84,33 @@ struct VirtualTable : private boost::noncopyable {
   SQLiteDBInstance* instance{nullptr};
 };
 
+/**
+ * @brief Collect the rows and bytes generated by each table on this thread.
+ *
+ * While a collector exists, every virtual table scan finished on the thread
+ * that created it is added to it. The schedule monitor uses this to report
+ * the tables a query read without a per-row cost when nothing is collecting.
+ */
+class TableUsageCollector : private boost::noncopyable {
+ public:
+  TableUsageCollector();
+  ~TableUsageCollector();
+
+  /// Add a scan to the innermost collector on this thread, if there is one.
+  static void record(const std::string& table, size_t rows, size_t bytes);
+
+  /// The usage collected for each table.
+  const std::map<std::string, QueryTableUsage>& getUsage() const {
+    return usage_;
+  }
+
+ private:
+  std::map<std::string, QueryTableUsage> usage_;
+
+  /// The collector this one replaced, restored when it is destroyed.
+  TableUsageCollector* previous_{nullptr};
+};
+
 /// Attach a table plugin name to an in-memory SQLite database.
 Status attachTableInternal(const std::string& name,
                            const std::string& statement,
@@ -84,6 +127,31 @@ Status attachFunctionInternal(
 /// Attach all table plugins to an in-memory SQLite database.
 void attachVirtualTables(const SQLiteDBInstanceRef& instance);
 
+/**
+ * @brief Attach local tables to a connection when they are first referenced.
+ *
+ * No module is registered and no table is created when the connection opens.
+ * When a statement fails to prepare because it names a missing table, the
+ * caller uses attachLazyTable to register that table as an eponymous module,
+ * which SQLite connects in the main schema, then prepares the statement again.
+ * Table aliases are registered as modules instead of views.
+ *
+ * @param instance The database connection.
+ */
+void attachLazyTables(const SQLiteDBInstanceRef& instance);
+
+/**
+ * @brief Register the local table a statement failed to find.
+ *
+ * @param db A connection that failed to prepare a statement.
+ * @return true if a module was registered and the statement may be prepared
+ * again, false if the error does not name an unregistered local table.
+ */
+bool attachLazyTable(sqlite3* db);
+
+/// Forget the lazily attached tables of a connection before it is closed.
+void detachLazyTables(sqlite3* db);
+
 #if !defined(OSQUERY_EXTERNAL)
 /**
  * A generated foreign amalgamation file includes schema for all tables.
@@ -0,0 +1,72 @@
+/*
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include <osquery/events.h>
+#include <osquery/tables.h>
+
+#include "osquery/events/linux/audit.h"
+
+namespace osquery {
+namespace tables {
+
+/// Find the running audit publisher.
+static std::shared_ptr<AuditEventPublisher> getAuditPublisher() {
+  auto pubref = EventFactory::getEventPublisher("audit");
+  if (pubref == nullptr || !pubref->hasStarted() || pubref->isEnding()) {
+    return nullptr;
+  }
+
+  auto base = std::static_pointer_cast<EventPublisherPlugin>(pubref);
+  return std::dynamic_pointer_cast<AuditEventPublisher>(base);
+}
+
+QueryData genAuditStatus(QueryContext& context) {
+  auto publisher = getAuditPublisher();
+  if (publisher == nullptr) {
+    return {};
+  }
+
+  auto status = publisher->getStatus();
+  Row r;
+  r["enabled"] = INTEGER(status.status.enabled);
+  r["failure"] = INTEGER(status.status.failure);
+  r["pid"] = INTEGER(status.status.pid);
+  r["control"] = INTEGER(status.control ? 1 : 0);
+  r["rate_limit"] = INTEGER(status.status.rate_limit);
+  r["backlog_limit"] = INTEGER(status.status.backlog_limit);
+  r["backlog"] = INTEGER(status.status.backlog);
+  r["lost"] = BIGINT(status.status.lost);
+  r["receive_buffer"] = BIGINT(status.receive_buffer);
+  r["records"] = BIGINT(status.records);
+  r["batches"] = BIGINT(status.batches);
+  r["overflows"] = BIGINT(status.overflows);
+  return {r};
+}
+
+QueryData genAuditRecordTypes(QueryContext& context) {
+  QueryData results;
+  auto publisher = getAuditPublisher();
+  if (publisher == nullptr) {
+    return results;
+  }
+
+  auto status = publisher->getStatus();
+  for (const auto& type : status.type_records) {
+    Row r;
+    r["type"] = INTEGER(type.first);
+    r["records"] = BIGINT(type.second);
+    auto rate = status.type_rates.find(type.first);
+    r["rate"] = DOUBLE((rate == status.type_rates.end()) ? 0 : rate->second);
+    results.push_back(r);
+  }
+  return results;
+}
+}
+}
@@ -8,42 +8,190 @@
  *
  */
 
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+#include <list>
+
 #include <osquery/config.h>
+#include <osquery/flags.h>
 #include <osquery/logger.h>
-#include <osquery/sql.h>
 #include <osquery/system.h>
 
+#include "osquery/core/conversions.h"
 #include "osquery/events/linux/audit.h"
 
 namespace osquery {
 
 #define AUDIT_SYSCALL_EXECVE 59
 
+FLAG(bool,
+     audit_process_file_times,
+     true,
+     "Add the executed file's times to process_events");
+
+FLAG(uint64,
+     audit_process_queue_size,
+     4096,
+     "Audit records queued for process_events, 0 uses events_queue_size");
+
 // Depend on the external getUptime table method.
 namespace tables {
 extern long getUptime();
 }
 
-bool ProcessUpdate(size_t type, const AuditFields& fields, AuditFields& r) {
-  if (type == AUDIT_SYSCALL) {
-    r["pid"] = (fields.count("pid")) ? fields.at("pid") : "0";
-    r["parent"] = fields.count("ppid") ? fields.at("ppid") : "0";
-    r["uid"] = fields.count("uid") ? fields.at("uid") : "0";
-    r["euid"] = fields.count("euid") ? fields.at("euid") : "0";
-    r["gid"] = fields.count("gid") ? fields.at("gid") : "0";
-    r["egid"] = fields.count("egid") ? fields.at("euid") : "0";
-    r["path"] = (fields.count("exe")) ? decodeAuditValue(fields.at("exe")) : "";
-
-    auto qd = SQL::selectAllFrom("file", "path", EQUALS, r.at("path"));
-    if (qd.size() == 1) {
-      r["ctime"] = qd.front().at("ctime");
-      r["atime"] = qd.front().at("atime");
-      r["mtime"] = qd.front().at("mtime");
-      r["btime"] = "0";
+/// The number of executed files with cached times.
+const size_t kFileTimesCacheSize = 1024;
+
+/// Cached file times are read again after this many seconds.
+const size_t kFileTimesCacheExpiry = 60;
+
+/**
+ * @brief A small LRU of executed file times keyed by device and inode.
+ *
+ * Audit PATH records include the device and inode of the executed file, so
+ * repeated executions of the same binary, common in build farms, do not stat
+ * the file again until the cached times expire.
+ */
+class FileTimesCache : private boost::noncopyable {
+ public:
+  using Key = std::pair<uint64_t, uint64_t>;
+
+  struct Times {
+    std::string atime;
+    std::string mtime;
+    std::string ctime;
+  };
+
+  /// Copy the cached times of a file, false if missing or expired.
+  bool get(const Key& key, size_t now, Times& times) {
+    WriteLock lock(mutex_);
+    auto entry = entries_.find(key);
+    if (entry == entries_.end()) {
+      return false;
     }
 
+    if (now >= entry->second.expires) {
+      lru_.erase(entry->second.lru);
+      entries_.erase(entry);
+      return false;
+    }
+
+    lru_.splice(lru_.begin(), lru_, entry->second.lru);
+    times = entry->second.times;
+    return true;
+  }
+
+  /// Store the times of a file, evicting the least recently used.
+  void put(const Key& key, size_t now, const Times& times) {
+    WriteLock lock(mutex_);
+    auto entry = entries_.find(key);
+    if (entry != entries_.end()) {
+      lru_.erase(entry->second.lru);
+      entries_.erase(entry);
+    } else if (entries_.size() >= kFileTimesCacheSize) {
+      entries_.erase(lru_.back());
+      lru_.pop_back();
+    }
+
+    lru_.push_front(key);
+    auto& cached = entries_[key];
+    cached.times = times;
+    cached.expires = now + kFileTimesCacheExpiry;
+    cached.lru = lru_.begin();
+  }
+
+ private:
+  struct Entry {
+    Times times;
+    size_t expires{0};
+    std::list<Key>::iterator lru;
+  };
+
+  std::map<Key, Entry> entries_;
+  std::list<Key> lru_;
+  Mutex mutex_;
+};
+
+static FileTimesCache& getFileTimesCache() {
+  static FileTimesCache cache;
+  return cache;
+}
+
+/// Parse the device and inode of an audit PATH record.
+static bool getAuditFileKey(const AuditRecord& fields,
+                            FileTimesCache::Key& key) {
+  auto dev = fields.get(AuditFieldKey::DEV);
+  auto colon = dev.find(':');
+  if (colon == boost::string_ref::npos) {
+    return false;
+  }
+
+  // The device is formatted as hex major:minor.
+  unsigned long int major = 0;
+  unsigned long int minor = 0;
+  unsigned long int inode = 0;
+  if (!safeStrtoul(dev.substr(0, colon).to_string(), 16, major) ||
+      !safeStrtoul(dev.substr(colon + 1).to_string(), 16, minor) ||
+      !safeStrtoul(fields.get(AuditFieldKey::INODE).to_string(), 10, inode)) {
+    return false;
+  }
+
+  key = std::make_pair(makedev(major, minor), inode);
+  return true;
+}
+
+/**
+ * @brief Add the executed file's times to a process_events row.
+ *
+ * The times are read with stat on a cache miss, this replaced a query of the
+ * file table for every execution.
+ */
+static void addFileTimes(const AuditRecord& fields, AuditFields& r) {
+  auto path = r.find("path");
+  if (path == r.end() || path->second.empty()) {
+    return;
+  }
+
+  auto& cache = getFileTimesCache();
+  auto now = getUnixTime();
+  FileTimesCache::Key key;
+  FileTimesCache::Times times;
+  bool audited = getAuditFileKey(fields, key);
+  if (!audited || !cache.get(key, now, times)) {
+    struct stat file_stat;
+    if (stat(path->second.c_str(), &file_stat) != 0) {
+      return;
+    }
+
+    // If the file was replaced since the execution its current times are used.
+    times.atime = BIGINT(file_stat.st_atime);
+    times.mtime = BIGINT(file_stat.st_mtime);
+    times.ctime = BIGINT(file_stat.st_ctime);
+    if (audited) {
+      // Keep the audit key, stat may report a different device number.
+      cache.put(key, now, times);
+    }
+  }
+
+  r["ctime"] = std::move(times.ctime);
+  r["atime"] = std::move(times.atime);
+  r["mtime"] = std::move(times.mtime);
+  r["btime"] = "0";
+}
+
+bool ProcessUpdate(size_t type, const AuditRecord& fields, AuditFields& r) {
+  if (type == AUDIT_SYSCALL) {
+    r["pid"] = fields.get(AuditFieldKey::PID, "0").to_string();
+    r["parent"] = fields.get(AuditFieldKey::PPID, "0").to_string();
+    r["uid"] = fields.get(AuditFieldKey::UID, "0").to_string();
+    r["euid"] = fields.get(AuditFieldKey::EUID, "0").to_string();
+    r["gid"] = fields.get(AuditFieldKey::GID, "0").to_string();
+    r["egid"] = fields.get(AuditFieldKey::EGID, "0").to_string();
+    r["path"] = fields.decode(AuditFieldKey::EXE);
+
     // This should get overwritten during the EXECVE state.
-    r["cmdline"] = (fields.count("comm")) ? fields.at("comm") : "";
+    r["cmdline"] = fields.get(AuditFieldKey::COMM).to_string();
     // Do not record a cmdline size. If the final state is reached and no
     // 'argc'
     // has been filled in then the EXECVE state was not used.
@@ -56,18 +204,28 @@ bool ProcessUpdate(size_t type, const AuditFields& fields, AuditFields& r) {
   }
 
   if (type == AUDIT_EXECVE) {
-    // Reset the temporary storage from the SYSCALL state.
-    r["cmdline"] = "";
-    for (const auto& arg : fields) {
-      if (arg.first == "argc") {
+    // Reset the temporary storage from the SYSCALL state. Only the first
+    // EXECVE record includes argc, a long cmdline continues in more records.
+    auto& cmdline = r["cmdline"];
+    if (fields.has(AuditFieldKey::ARGC)) {
+      cmdline.clear();
+    }
+    for (size_t i = 0; i < fields.size(); i++) {
+      // Amalgamate all the "arg*" fields, in argument order. The pieces of a
+      // long argument, "aN[0]", "aN[1]", ..., are joined without a space.
+      auto id = fields.id(i);
+      if (id == AuditFieldKey::ARGN_PART) {
+        if (fields.key(i).ends_with("[0]") && cmdline.size() > 0) {
+          cmdline += " ";
+        }
+      } else if (id == AuditFieldKey::ARGN) {
+        if (cmdline.size() > 0) {
+          cmdline += " ";
+        }
+      } else {
         continue;
       }
-
-      // Amalgamate all the "arg*" fields.
-      if (r.at("cmdline").size() > 0) {
-        r["cmdline"] += " ";
-      }
-      r["cmdline"] += decodeAuditValue(arg.second);
+      cmdline += decodeAuditValue(fields.value(i));
     }
 
     // There may be a better way to calculate actual size from audit.
@@ -79,10 +237,17 @@ bool ProcessUpdate(size_t type, const AuditFields& fields, AuditFields& r) {
     r["uptime"] = std::to_string(tables::getUptime());
   }
 
-  if (type == AUDIT_PATH) {
-    r["mode"] = (fields.count("mode")) ? fields.at("mode") : "";
-    r["owner_uid"] = fields.count("ouid") ? fields.at("ouid") : "0";
-    r["owner_gid"] = fields.count("ogid") ? fields.at("ogid") : "0";
+  // Only the first PATH record describes the executed file, later items
+  // describe the interpreter or loader.
+  if (type == AUDIT_PATH && (!fields.has(AuditFieldKey::ITEM) ||
+                             fields.get(AuditFieldKey::ITEM) == "0")) {
+    r["mode"] = fields.get(AuditFieldKey::MODE).to_string();
+    r["owner_uid"] = fields.get(AuditFieldKey::OUID, "0").to_string();
+    r["owner_gid"] = fields.get(AuditFieldKey::OGID, "0").to_string();
+
+    if (FLAGS_audit_process_file_times) {
+      addFileTimes(fields, r);
+    }
   }
   return true;
 }
@@ -95,6 +260,22 @@ class ProcessEventSubscriber : public EventSubscriber<AuditEventPublisher> {
   /// Kernel events matching the event type will fire.
   Status Callback(const ECRef& ec, const SCRef& sc);
 
+  /// Assemble and enrich records on the subscriber's thread.
+  size_t getEventsQueueSize() override {
+    if (FLAGS_audit_process_queue_size == 0) {
+      return EventSubscriberPlugin::getEventsQueueSize();
+    }
+    return FLAGS_audit_process_queue_size;
+  }
+
+  /// A dropped record loses an execution, wait for space in this queue.
+  bool getEventsQueueBlocks() override {
+    if (FLAGS_audit_process_queue_size == 0) {
+      return EventSubscriberPlugin::getEventsQueueBlocks();
+    }
+    return true;
+  }
+
  private:
   AuditAssembler asm_;
 };
@@ -121,12 +302,12 @@ Status ProcessEventSubscriber::init() {
 Status ProcessEventSubscriber::Callback(const ECRef& ec, const SCRef& sc) {
   // Check and set the valid state change.
   // If this is an unacceptable change reset the state and clear row data.
-  if (ec->fields.count("success") && ec->fields.at("success") == "no") {
+  if (ec->fields.get(AuditFieldKey::SUCCESS) == "no") {
     return Status(0, "OK");
   }
 
-  if (ec->type == AUDIT_PATH && ec->fields.count("item") &&
-      ec->fields.at("item") != "0") {
+  if (ec->type == AUDIT_PATH && ec->fields.has(AuditFieldKey::ITEM) &&
+      ec->fields.get(AuditFieldKey::ITEM) != "0") {
     return Status(0, "OK");
   }
 
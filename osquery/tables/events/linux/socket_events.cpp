@@ -109,9 +109,9 @@ void parseSockAddr(const std::string& saddr, AuditFields& r) {
   }
 }
 
-bool SocketUpdate(size_t type, const AuditFields& fields, AuditFields& r) {
+bool SocketUpdate(size_t type, const AuditRecord& fields, AuditFields& r) {
   if (type == AUDIT_TYPE_SOCKADDR) {
-    const auto& saddr = fields.at("saddr");
+    auto saddr = fields.get(AuditFieldKey::SADDR);
     if (saddr.size() < 4 || saddr[0] == '1') {
       return false;
     }
@@ -120,16 +120,16 @@ bool SocketUpdate(size_t type, const AuditFields& fields, AuditFields& r) {
     r["local_port"] = "0";
     r["remote_port"] = "0";
     // Parse the struct and emit the row.
-    parseSockAddr(saddr, r);
+    parseSockAddr(saddr.to_string(), r);
     return true;
   }
 
-  r["pid"] = fields.at("pid");
-  r["path"] = decodeAuditValue(fields.at("exe"));
+  r["pid"] = fields.get(AuditFieldKey::PID).to_string();
+  r["path"] = fields.decode(AuditFieldKey::EXE);
   // TODO: This is a hex value.
-  r["fd"] = fields.at("a0");
+  r["fd"] = fields.get("a0").to_string();
   // The open/bind success status.
-  r["success"] = (fields.at("success") == "yes") ? "1" : "0";
+  r["success"] = (fields.get(AuditFieldKey::SUCCESS) == "yes") ? "1" : "0";
   r["uptime"] = std::to_string(tables::getUptime());
   return true;
 }
@@ -154,7 +154,8 @@ Status SocketEventSubscriber::init() {
 
 Status SocketEventSubscriber::Callback(const ECRef& ec, const SCRef&) {
   if (ec->syscall == AUDIT_SYSCALL_CONNECT) {
-    if (ec->fields.count("exit") && ec->fields.at("exit") != "-115") {
+    if (ec->fields.has(AuditFieldKey::EXIT) &&
+        ec->fields.get(AuditFieldKey::EXIT) != "-115") {
       // The connect syscall may want an exit with EINPROGRESS.
     }
   } else if (ec->type == AUDIT_TYPE_SYSCALL &&
@@ -149,10 +149,12 @@ QueryData genOpenSockets(QueryContext &context) {
   QueryData results;
 
   // If a pid is given then set that as the only item in processes.
+  // Reading every process descriptor is expensive, only do so if the socket
+  // owner (pid or fd) is used by the query.
   std::set<std::string> pids;
   if (context.constraints["pid"].exists(EQUALS)) {
     pids = context.constraints["pid"].getAll(EQUALS);
-  } else {
+  } else if (context.isAnyColumnUsed({"pid", "fd"})) {
     osquery::procProcesses(pids);
   }
 
@@ -225,9 +225,7 @@ proc_args getProcRawArgs(int pid, size_t argmax) {
   return args;
 }
 
-QueryData genProcesses(QueryContext& context) {
-  QueryData results;
-
+void genProcesses(RowYield& yield, QueryContext& context) {
   // Initialize time conversions.
   static mach_timebase_info_data_t time_base;
   if (time_base.denom == 0) {
@@ -332,10 +330,8 @@ QueryData genProcesses(QueryContext& context) {
       r["threads"] = "-1";
     }
 
-    results.push_back(r);
+    yield(r);
   }
-
-  return results;
 }
 
 QueryData genProcessEnvs(QueryContext& context) {
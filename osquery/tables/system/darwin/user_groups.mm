@@ -86,7 +86,7 @@ QueryData genGroups(QueryContext &context) {
   return results;
 }
 
-void setRow(Row &r, passwd *pwd) {
+void setRow(const QueryContext &context, Row &r, passwd *pwd) {
   r["gid"] = BIGINT(pwd->pw_gid);
   r["uid_signed"] = BIGINT((int32_t)pwd->pw_uid);
   r["gid_signed"] = BIGINT((int32_t)pwd->pw_gid);
@@ -94,6 +94,11 @@ void setRow(Row &r, passwd *pwd) {
   r["directory"] = TEXT(pwd->pw_dir);
   r["shell"] = TEXT(pwd->pw_shell);
 
+  // The UUID is resolved through the directory service, skip it if unused.
+  if (!context.isColumnUsed("uuid")) {
+    return;
+  }
+
   uuid_t uuid = {0};
   uuid_string_t uuid_string = {0};
 
@@ -119,7 +124,7 @@ QueryData genUsers(QueryContext &context) {
       Row r;
       r["uid"] = BIGINT(uid);
       r["username"] = std::string(pwd->pw_name);
-      setRow(r, pwd);
+      setRow(context, r, pwd);
       results.push_back(r);
     }
   } else {
@@ -134,7 +139,7 @@ QueryData genUsers(QueryContext &context) {
       Row r;
       r["uid"] = BIGINT(pwd->pw_uid);
       r["username"] = username;
-      setRow(r, pwd);
+      setRow(context, r, pwd);
       results.push_back(r);
     }
   }
@@ -10,6 +10,7 @@
 
 #include <string>
 #include <map>
+#include <memory>
 
 #include <stdlib.h>
 #include <unistd.h>
@@ -109,7 +110,7 @@ void genProcessMap(struct procstat* pstat,
 
 void genProcess(struct procstat* pstat,
                 struct kinfo_proc* proc,
-                QueryData& results) {
+                RowYield& yield) {
   Row r;
   static char path[PATH_MAX];
   char** args;
@@ -186,22 +187,22 @@ void genProcess(struct procstat* pstat,
   r["user_time"] = INTEGER(proc->ki_rusage.ru_utime.tv_sec);
   r["start_time"] = INTEGER(proc->ki_start.tv_sec);
 
-  results.push_back(r);
+  yield(r);
 }
 
-QueryData genProcesses(QueryContext& context) {
-  QueryData results;
+void genProcesses(RowYield& yield, QueryContext& context) {
   struct kinfo_proc* procs = nullptr;
   struct procstat* pstat = nullptr;
 
   auto cnt = getProcesses(context, &pstat, &procs);
 
+  // The scan may be cancelled between rows, release the list when unwinding.
+  auto cleanup = [procs](struct procstat* p) { procstatCleanup(p, procs); };
+  std::unique_ptr<struct procstat, decltype(cleanup)> guard(pstat, cleanup);
+
   for (size_t i = 0; i < cnt; i++) {
-    genProcess(pstat, &procs[i], results);
+    genProcess(pstat, &procs[i], yield);
   }
-
-  procstatCleanup(pstat, procs);
-  return results;
 }
 
 QueryData genProcessEnvs(QueryContext& context) {
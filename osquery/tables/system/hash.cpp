@@ -100,27 +100,31 @@ std::string hashFromBuffer(HashType hash_type,
 }
 
 MultiHashes hashMultiFromFile(int mask, const std::string& path) {
-  std::map<HashType, std::shared_ptr<Hash>> hashes = {
-      {HASH_TYPE_MD5, std::make_shared<Hash>(HASH_TYPE_MD5)},
-      {HASH_TYPE_SHA1, std::make_shared<Hash>(HASH_TYPE_SHA1)},
-      {HASH_TYPE_SHA256, std::make_shared<Hash>(HASH_TYPE_SHA256)},
-  };
+  MultiHashes mh;
+  mh.mask = mask;
+  if (mask == 0) {
+    // No digest was requested, do not read the file.
+    return mh;
+  }
+
+  std::map<HashType, std::shared_ptr<Hash>> hashes;
+  for (const auto& type : {HASH_TYPE_MD5, HASH_TYPE_SHA1, HASH_TYPE_SHA256}) {
+    if (mask & type) {
+      hashes[type] = std::make_shared<Hash>(type);
+    }
+  }
 
   readFile(path,
            0,
            HASH_CHUNK_SIZE,
            false,
            true,
-           ([&hashes, &mask](std::string& buffer, size_t size) {
+           ([&hashes](std::string& buffer, size_t size) {
              for (auto& hash : hashes) {
-               if (mask & hash.first) {
-                 hash.second->update(&buffer[0], size);
-               }
+               hash.second->update(&buffer[0], size);
              }
            }));
 
-  MultiHashes mh;
-  mh.mask = mask;
   if (mask & HASH_TYPE_MD5) {
     mh.md5 = hashes.at(HASH_TYPE_MD5)->digest();
   }
@@ -149,28 +153,34 @@ namespace tables {
 void genHashForFile(const std::string& path,
                     const std::string& dir,
                     QueryContext& context,
-                    QueryData& results) {
+                    RowYield& yield) {
   // Must provide the path, filename, directory separate from boost path->string
   // helpers to match any explicit (query-parsed) predicate constraints.
+  // Only compute the digests that the query uses.
+  int mask = 0;
+  mask |= context.isColumnUsed("md5") ? HASH_TYPE_MD5 : 0;
+  mask |= context.isColumnUsed("sha1") ? HASH_TYPE_SHA1 : 0;
+  mask |= context.isColumnUsed("sha256") ? HASH_TYPE_SHA256 : 0;
+
+  // The cached row is only complete for the same set of digests.
+  auto index = std::to_string(mask) + ":" + path;
   Row r;
-  if (context.isCached(path)) {
-    r = context.getCache(path);
+  if (context.isCached(index)) {
+    r = context.getCache(index);
   } else {
-    auto hashes = hashMultiFromFile(
-        HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, path);
+    auto hashes = hashMultiFromFile(mask, path);
 
     r["path"] = path;
     r["directory"] = dir;
     r["md5"] = std::move(hashes.md5);
     r["sha1"] = std::move(hashes.sha1);
     r["sha256"] = std::move(hashes.sha256);
-    context.setCache(path, r);
+    context.setCache(index, r);
   }
-  results.push_back(r);
+  yield(r);
 }
 
-QueryData genHash(QueryContext& context) {
-  QueryData results;
+void genHash(RowYield& yield, QueryContext& context) {
   boost::system::error_code ec;
 
   // The query must provide a predicate with constraints including path or
@@ -200,7 +210,7 @@ QueryData genHash(QueryContext& context) {
       continue;
     }
 
-    genHashForFile(path_string, path.parent_path().string(), context, results);
+    genHashForFile(path_string, path.parent_path().string(), context, yield);
   }
 
   // Now loop through constraints using the directory column constraint.
@@ -234,12 +244,10 @@ QueryData genHash(QueryContext& context) {
     for (; begin != end; ++begin) {
       if (boost::filesystem::is_regular_file(begin->path(), ec)) {
         genHashForFile(
-            begin->path().string(), directory_string, context, results);
+            begin->path().string(), directory_string, context, yield);
       }
     }
   }
-
-  return results;
 }
 }
 }
@@ -123,7 +123,9 @@ const struct fieldinfo fieldinfos[] = {
     {FIELD("Revision"), f_revision, w_revision, 0},
     {}};
 
-void extractDebPackageInfo(const struct pkginfo *pkg, QueryData &results) {
+void extractDebPackageInfo(const struct pkginfo *pkg,
+                           const QueryContext &context,
+                           QueryData &results) {
   Row r;
 
   struct varbuf vb;
@@ -133,6 +135,13 @@ void extractDebPackageInfo(const struct pkginfo *pkg, QueryData &results) {
   // to extract the package's information.
   const struct fieldinfo *fip = nullptr;
   for (fip = fieldinfos; fip->name; fip++) {
+    auto column = kFieldMappings.find(fip->name);
+    if (column != kFieldMappings.end() &&
+        !context.isColumnUsed(column->second)) {
+      // The query does not use this field.
+      continue;
+    }
+
     fip->wcall(&vb, pkg, &pkg->installed, fw_printheader, fip);
 
     std::string line = vb.string();
@@ -177,7 +186,7 @@ QueryData genDebPackages(QueryContext &context) {
       continue;
     }
 
-    extractDebPackageInfo(pkg, results);
+    extractDebPackageInfo(pkg, context, results);
   }
 
   dpkg_teardown(&packages);
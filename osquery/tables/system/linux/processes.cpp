@@ -184,6 +184,19 @@ void genProcessMap(const std::string& pid, QueryData& results) {
   }
 }
 
+/// Process columns that are parsed from /proc/<pid>/status.
+const std::vector<std::string> kProcStatusColumns = {
+    "name",
+    "uid",
+    "euid",
+    "suid",
+    "gid",
+    "egid",
+    "sgid",
+    "resident_size",
+    "total_size",
+};
+
 /**
  *  Output from string parsing /proc/<pid>/status.
  */
@@ -210,10 +223,16 @@ struct SimpleProcStat : private boost::noncopyable {
   /// For errors processing proc data.
   Status status;
 
-  explicit SimpleProcStat(const std::string& pid);
+  /**
+   * @brief Parse the stat and, optionally, the status of a process.
+   *
+   * @param pid The process identifier.
+   * @param read_status Parse /proc/N/status for the name, ids, and memory.
+   */
+  explicit SimpleProcStat(const std::string& pid, bool read_status = true);
 };
 
-SimpleProcStat::SimpleProcStat(const std::string& pid) {
+SimpleProcStat::SimpleProcStat(const std::string& pid, bool read_status) {
   std::string content;
   if (readFile(getProcAttr("stat", pid), content).ok()) {
     auto start = content.find_last_of(")");
@@ -244,7 +263,16 @@ SimpleProcStat::SimpleProcStat(const std::string& pid) {
   }
 
   // /proc/N/status may be not available, or readable by this user.
-  if (!readFile(getProcAttr("status", pid), content).ok()) {
+  auto status_path = getProcAttr("status", pid);
+  if (!read_status) {
+    // Skip the same processes as when the status is parsed.
+    if (!isReadable(status_path).ok()) {
+      status = Status(1, "Cannot read /proc/status");
+    }
+    return;
+  }
+
+  if (!readFile(status_path, content).ok()) {
     status = Status(1, "Cannot read /proc/status");
     return;
   }
@@ -338,28 +366,40 @@ int getOnDisk(const std::string& pid, std::string& path) {
   }
 }
 
-void genProcess(const std::string& pid, QueryData& results) {
-  // Parse the process stat and status.
-  SimpleProcStat proc_stat(pid);
+void genProcess(const std::string& pid,
+                const QueryContext& context,
+                RowYield& yield) {
+  // Parse the process stat and status, the status is only read if needed.
+  SimpleProcStat proc_stat(pid, context.isAnyColumnUsed(kProcStatusColumns));
 
   if (!proc_stat.status.ok()) {
     VLOG(1) << proc_stat.status.getMessage() << " for pid " << pid;
     return;
   }
 
-  Row r;
+  // Cells read from /proc are text, computed cells are native integers.
+  TableRow r;
   r["pid"] = pid;
   r["parent"] = proc_stat.parent;
-  r["path"] = readProcLink("exe", pid);
+  // The links and cmdline are the most expensive reads, skip them if unused.
+  if (context.isAnyColumnUsed({"path", "on_disk"})) {
+    r["path"] = readProcLink("exe", pid);
+  }
   r["name"] = proc_stat.name;
   r["pgroup"] = proc_stat.group;
   r["state"] = proc_stat.state;
   r["nice"] = proc_stat.nice;
   r["threads"] = proc_stat.threads;
   // Read/parse cmdline arguments.
-  r["cmdline"] = readProcCMDLine(pid);
-  r["cwd"] = readProcLink("cwd", pid);
-  r["root"] = readProcLink("root", pid);
+  if (context.isColumnUsed("cmdline")) {
+    r["cmdline"] = readProcCMDLine(pid);
+  }
+  if (context.isColumnUsed("cwd")) {
+    r["cwd"] = readProcLink("cwd", pid);
+  }
+  if (context.isColumnUsed("root")) {
+    r["root"] = readProcLink("root", pid);
+  }
   r["uid"] = proc_stat.real_uid;
   r["euid"] = proc_stat.effective_uid;
   r["suid"] = proc_stat.saved_uid;
@@ -367,10 +407,12 @@ void genProcess(const std::string& pid, QueryData& results) {
   r["egid"] = proc_stat.effective_gid;
   r["sgid"] = proc_stat.saved_gid;
 
-  r["on_disk"] = INTEGER(getOnDisk(pid, r["path"]));
+  if (context.isColumnUsed("on_disk")) {
+    r.setInteger("on_disk", getOnDisk(pid, r["path"]));
+  }
 
   // size/memory information
-  r["wired_size"] = "0"; // No support for unpagable counters in linux.
+  r.setInteger("wired_size", 0); // No support for unpagable counters in linux.
   r["resident_size"] = proc_stat.resident_size;
   r["total_size"] = proc_stat.total_size;
 
@@ -379,18 +421,14 @@ void genProcess(const std::string& pid, QueryData& results) {
   r["system_time"] = proc_stat.system_time;
   r["start_time"] = proc_stat.start_time;
 
-  results.push_back(r);
+  yield(r);
 }
 
-QueryData genProcesses(QueryContext& context) {
-  QueryData results;
-
+void genProcesses(RowYield& yield, QueryContext& context) {
   auto pidlist = getProcList(context);
   for (const auto& pid : pidlist) {
-    genProcess(pid, results);
+    genProcess(pid, context, yield);
   }
-
-  return results;
 }
 
 QueryData genProcessEnvs(QueryContext& context) {
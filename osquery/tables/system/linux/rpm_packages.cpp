@@ -67,6 +67,17 @@ static std::string getRpmAttribute(const Header& header,
   return result;
 }
 
+/// The rpm_packages columns and their header tags.
+const std::vector<std::pair<std::string, rpmTag>> kRpmPackageTags = {
+    {"name", RPMTAG_NAME},
+    {"version", RPMTAG_VERSION},
+    {"release", RPMTAG_RELEASE},
+    {"source", RPMTAG_SOURCERPM},
+    {"size", RPMTAG_SIZE},
+    {"sha1", RPMTAG_SHA1HEADER},
+    {"arch", RPMTAG_ARCH},
+};
+
 class RpmEnvironmentManager : public boost::noncopyable {
  public:
   RpmEnvironmentManager() : config_(getEnvVar("RPM_CONFIGDIR")) {
@@ -112,17 +123,21 @@ QueryData genRpmPackages(QueryContext& context) {
     matches = rpmtsInitIterator(ts, RPMTAG_NAME, nullptr, 0);
   }
 
+  // Only request the header tags for columns used by the query.
+  std::vector<std::pair<std::string, rpmTag>> tags;
+  for (const auto& tag : kRpmPackageTags) {
+    if (context.isColumnUsed(tag.first)) {
+      tags.push_back(tag);
+    }
+  }
+
   Header header;
   while ((header = rpmdbNextIterator(matches)) != nullptr) {
     Row r;
     rpmtd td = rpmtdNew();
-    r["name"] = getRpmAttribute(header, RPMTAG_NAME, td);
-    r["version"] = getRpmAttribute(header, RPMTAG_VERSION, td);
-    r["release"] = getRpmAttribute(header, RPMTAG_RELEASE, td);
-    r["source"] = getRpmAttribute(header, RPMTAG_SOURCERPM, td);
-    r["size"] = getRpmAttribute(header, RPMTAG_SIZE, td);
-    r["sha1"] = getRpmAttribute(header, RPMTAG_SHA1HEADER, td);
-    r["arch"] = getRpmAttribute(header, RPMTAG_ARCH, td);
+    for (const auto& tag : tags) {
+      r[tag.first] = getRpmAttribute(header, tag.second, td);
+    }
 
     rpmtdFree(td);
     results.push_back(r);
@@ -183,10 +198,12 @@ QueryData genRpmPackageFiles(QueryContext& context) {
       r["mode"] = lsperms(rpmfiFMode(fi));
       r["size"] = BIGINT(rpmfiFSize(fi));
 
-      int digest_algo;
-      auto digest = rpmfiFDigestHex(fi, &digest_algo);
-      if (digest_algo == PGPHASHALGO_SHA256) {
-        r["sha256"] = (digest != nullptr) ? digest : "";
+      if (context.isColumnUsed("sha256")) {
+        int digest_algo;
+        auto digest = rpmfiFDigestHex(fi, &digest_algo);
+        if (digest_algo == PGPHASHALGO_SHA256) {
+          r["sha256"] = (digest != nullptr) ? digest : "";
+        }
       }
 
       results.push_back(r);
@@ -50,7 +50,7 @@ std::set<long> getSelectedPids(const QueryContext& context) {
   return pidlist;
 }
 
-void genProcess(const WmiResultItem& result, QueryData& results_data) {
+void genProcess(const WmiResultItem& result, RowYield& yield) {
   Row r;
   Status s;
   long pid;
@@ -149,12 +149,10 @@ void genProcess(const WmiResultItem& result, QueryData& results_data) {
     CloseHandle(tok);
     tok = nullptr;
   }
-  results_data.push_back(r);
+  yield(r);
 }
 
-QueryData genProcesses(QueryContext& context) {
-  QueryData results;
-
+void genProcesses(RowYield& yield, QueryContext& context) {
   std::string query = "SELECT * FROM Win32_Process";
 
   auto pidlist = getSelectedPids(context);
@@ -173,12 +171,10 @@ QueryData genProcesses(QueryContext& context) {
     for (const auto& item : request.results()) {
       long pid = 0;
       if (item.GetLong("ProcessId", pid).ok()) {
-        genProcess(item, results);
+        genProcess(item, yield);
       }
     }
   }
-
-  return results;
 }
 }
 }
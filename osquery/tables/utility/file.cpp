@@ -36,7 +36,8 @@ const std::map<fs::file_type, std::string> kTypeNames{
 void genFileInfo(const fs::path& path,
                  const fs::path& parent,
                  const std::string& pattern,
-                 QueryData& results) {
+                 const QueryContext& context,
+                 RowYield& yield) {
   // Must provide the path, filename, directory separate from boost path->string
   // helpers to match any explicit (query-parsed) predicate constraints.
 #if !defined(WIN32)
@@ -54,49 +55,51 @@ void genFileInfo(const fs::path& path,
     return;
   }
 
-  Row r;
+  // The stat fields are passed to SQLite as native integers.
+  TableRow r;
   r["path"] = path.string();
   r["filename"] = path.filename().string();
   r["directory"] = parent.string();
 
+  // Inodes and devices are unsigned and may not fit a signed integer.
   r["inode"] = BIGINT(file_stat.st_ino);
-  r["uid"] = BIGINT(file_stat.st_uid);
-  r["gid"] = BIGINT(file_stat.st_gid);
+  r.setInteger("uid", file_stat.st_uid);
+  r.setInteger("gid", file_stat.st_gid);
   r["mode"] = lsperms(file_stat.st_mode);
   r["device"] = BIGINT(file_stat.st_rdev);
-  r["size"] = BIGINT(file_stat.st_size);
+  r.setInteger("size", file_stat.st_size);
 
 #if !defined(WIN32)
-  r["block_size"] = INTEGER(file_stat.st_blksize);
-  r["hard_links"] = INTEGER(file_stat.st_nlink);
+  r.setInteger("block_size", file_stat.st_blksize);
+  r.setInteger("hard_links", file_stat.st_nlink);
 #endif
 
   // Times
-  r["atime"] = BIGINT(file_stat.st_atime);
-  r["mtime"] = BIGINT(file_stat.st_mtime);
-  r["ctime"] = BIGINT(file_stat.st_ctime);
+  r.setInteger("atime", file_stat.st_atime);
+  r.setInteger("mtime", file_stat.st_mtime);
+  r.setInteger("ctime", file_stat.st_ctime);
 #if defined(__linux__) || defined(WIN32)
   // No 'birth' or create time in Linux or Windows.
-  r["btime"] = "0";
+  r.setInteger("btime", 0);
 #else
-  r["btime"] = BIGINT(file_stat.st_birthtimespec.tv_sec);
+  r.setInteger("btime", file_stat.st_birthtimespec.tv_sec);
 #endif
 
-  // Type booleans
-  boost::system::error_code ec;
-  auto status = fs::status(path, ec);
-  if (kTypeNames.count(status.type())) {
-    r["type"] = kTypeNames.at(status.type());
-  } else {
-    r["type"] = "unknown";
+  // Type booleans, this is an additional stat so skip it if unused.
+  if (context.isColumnUsed("type")) {
+    boost::system::error_code ec;
+    auto status = fs::status(path, ec);
+    if (kTypeNames.count(status.type())) {
+      r["type"] = kTypeNames.at(status.type());
+    } else {
+      r["type"] = "unknown";
+    }
   }
 
-  results.push_back(r);
+  yield(r);
 }
 
-QueryData genFile(QueryContext& context) {
-  QueryData results;
-
+void genFile(RowYield& yield, QueryContext& context) {
   // Resolve file paths for EQUALS and LIKE operations.
   auto paths = context.constraints["path"].getAll(EQUALS);
   context.expandConstraints(
@@ -118,7 +121,7 @@ QueryData genFile(QueryContext& context) {
   // Iterate through each of the resolved/supplied paths.
   for (const auto& path_string : paths) {
     fs::path path = path_string;
-    genFileInfo(path, path.parent_path(), "", results);
+    genFileInfo(path, path.parent_path(), "", context, yield);
   }
 
   // Resolve directories for EQUALS and LIKE operations.
@@ -149,14 +152,12 @@ QueryData genFile(QueryContext& context) {
       // Iterate over the directory and generate info for each regular file.
       fs::directory_iterator begin(directory_string), end;
       for (; begin != end; ++begin) {
-        genFileInfo(begin->path(), directory_string, "", results);
+        genFileInfo(begin->path(), directory_string, "", context, yield);
       }
     } catch (const fs::filesystem_error& /* e */) {
       continue;
     }
   }
-
-  return results;
 }
 }
 }
@@ -22,11 +22,14 @@
 #include <osquery/tables.h>
 
 #include "osquery/core/process.h"
+#include "osquery/sql/sqlite_util.h"
+#include "osquery/sql/table_cache.h"
 
 namespace osquery {
 
 DECLARE_bool(disable_logging);
 DECLARE_bool(disable_events);
+DECLARE_uint64(sql_pool_size);
 
 namespace tables {
 
@@ -39,6 +42,9 @@ QueryData genOsqueryEvents(QueryContext& context) {
     r["name"] = publisher;
     r["publisher"] = publisher;
     r["type"] = "publisher";
+    // Queues belong to subscribers.
+    r["queue_depth"] = "0";
+    r["queue_drops"] = "0";
 
     auto pubref = EventFactory::getEventPublisher(publisher);
     if (pubref != nullptr) {
@@ -68,12 +74,16 @@ QueryData genOsqueryEvents(QueryContext& context) {
       r["publisher"] = subref->getType();
       r["subscriptions"] = INTEGER(subref->numSubscriptions());
       r["events"] = INTEGER(subref->numEvents());
+      r["queue_depth"] = INTEGER(subref->queueDepth());
+      r["queue_drops"] = BIGINT(subref->queueDrops());
 
       // Subscribers are always active, even if their publisher is not.
       r["active"] = (subref->state() == EventState::EVENT_RUNNING) ? "1" : "0";
     } else {
       r["subscriptions"] = "0";
       r["events"] = "0";
+      r["queue_depth"] = "0";
+      r["queue_drops"] = "0";
       r["active"] = "-1";
     }
     results.push_back(r);
@@ -252,10 +262,14 @@ QueryData genOsquerySchedule(QueryContext& context) {
         r["executions"] = "0";
         r["output_size"] = "0";
         r["wall_time"] = "0";
+        r["wall_time_ms"] = "0";
         r["user_time"] = "0";
         r["system_time"] = "0";
         r["average_memory"] = "0";
         r["last_executed"] = "0";
+        r["statement_cache_hits"] = "0";
+        r["lag"] = "0";
+        r["max_lag"] = "0";
 
         // Report optional performance information.
         Config::getInstance().getPerformanceStats(
@@ -264,14 +278,69 @@ QueryData genOsquerySchedule(QueryContext& context) {
               r["last_executed"] = BIGINT(perf.last_executed);
               r["output_size"] = BIGINT(perf.output_size);
               r["wall_time"] = BIGINT(perf.wall_time);
-              r["user_time"] = BIGINT(perf.user_time);
-              r["system_time"] = BIGINT(perf.system_time);
+              r["wall_time_ms"] = BIGINT(perf.wall_time_ns / 1000000);
+              r["user_time"] = BIGINT(perf.user_time / 1000);
+              r["system_time"] = BIGINT(perf.system_time / 1000);
               r["average_memory"] = BIGINT(perf.average_memory);
+              r["statement_cache_hits"] = BIGINT(perf.statement_cache_hits);
+              r["lag"] = BIGINT(perf.lag);
+              r["max_lag"] = BIGINT(perf.max_lag);
             });
 
         results.push_back(r);
       });
   return results;
 }
+
+QueryData genOsqueryScheduleTables(QueryContext& context) {
+  QueryData results;
+
+  Config::getInstance().scheduledQueries(
+      [&results](const std::string& name, const ScheduledQuery& query) {
+        Config::getInstance().getPerformanceStats(
+            name, [&results, &name](const QueryPerformance& perf) {
+              for (const auto& table : perf.tables) {
+                Row r;
+                r["name"] = SQL_TEXT(name);
+                r["table_name"] = table.first;
+                r["scans"] = BIGINT(table.second.scans);
+                r["rows"] = BIGINT(table.second.rows);
+                r["bytes"] = BIGINT(table.second.bytes);
+                results.push_back(r);
+              }
+            });
+      });
+  return results;
+}
+
+QueryData genOsqueryTableCache(QueryContext& context) {
+  QueryData results;
+  for (const auto& table : TableCache::get().getStats()) {
+    Row r;
+    r["name"] = table.first;
+    r["ttl"] = INTEGER(table.second.ttl);
+    r["hits"] = BIGINT(table.second.hits);
+    r["misses"] = BIGINT(table.second.misses);
+    r["evictions"] = BIGINT(table.second.evictions);
+    r["entries"] = INTEGER(table.second.entries);
+    r["size"] = BIGINT(table.second.size);
+    results.push_back(r);
+  }
+  return results;
+}
+
+QueryData genOsquerySQLPool(QueryContext& context) {
+  auto stats = SQLiteDBManager::getPoolStats();
+  Row r;
+  r["idle"] = INTEGER(stats.idle);
+  r["max_idle"] = INTEGER(FLAGS_sql_pool_size);
+  r["acquired"] = BIGINT(stats.acquired);
+  r["reused"] = BIGINT(stats.reused);
+  r["created"] = BIGINT(stats.created);
+  r["invalidated"] = BIGINT(stats.invalidated);
+  r["wait_time"] = BIGINT(stats.wait_time);
+  r["max_wait_time"] = BIGINT(stats.max_wait_time);
+  return {r};
+}
 }
 }
@@ -212,6 +212,10 @@ class TableState(Singleton):
             if len(set(all_options).intersection(NON_CACHEABLE)) > 0:
                 print(lightred("Table cannot be marked cacheable: %s" % (path)))
                 exit(1)
+        if "generator" in self.attributes:
+            if "cacheable" in self.attributes or self.class_name != "":
+                print(lightred("Table cannot use a generator: %s" % (path)))
+                exit(1)
         if self.table_name == "" or self.function == "":
             print(lightred("Invalid table spec: %s" % (path)))
             exit(1)
@@ -249,7 +253,8 @@ class TableState(Singleton):
             aliases=self.aliases,
             has_options=self.has_options,
             has_column_aliases=self.has_column_aliases,
-            attribute_set=[TABLE_ATTRIBUTES[attr] for attr in self.attributes],
+            attribute_set=[TABLE_ATTRIBUTES[attr] for attr in self.attributes
+                           if attr in TABLE_ATTRIBUTES],
         )
 
         with open(path, "w+") as file_h:
@@ -6,7 +6,7 @@ class Boost < AbstractOsqueryFormula
   url "https://downloads.sourceforge.net/project/boost/boost/1.63.0/boost_1_63_0.tar.bz2"
   sha256 "beae2529f759f6b3bf3f4969a19c2e9d6f0c503edcb2de4a61d1428519fcb3b0"
   head "https://github.com/boostorg/boost.git"
-  revision 4
+  revision 5
 
   bottle do
     root_url "https://osquery-packages.s3.amazonaws.com/bottles"
@@ -56,6 +56,7 @@ class Boost < AbstractOsqueryFormula
       "--ignore-site-config",
       "--user-config=user-config.jam",
       "--disable-icu",
+      "--with-context",
       "--with-filesystem",
       "--with-regex",
       "--with-system",